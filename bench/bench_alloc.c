@@ -0,0 +1,93 @@
+#include <cwist/allocator.h>
+#include <cwist/http.h>
+#include <cwist/session_manager.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Request path under different allocators: parse a request with ten headers,
+// build a response with a few headers and a body, tear everything down.
+
+#define ITERATIONS 200000
+
+static const char *RAW_REQUEST =
+    "GET /api/items?page=2 HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: bench/1.0\r\n"
+    "Accept: application/json\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=0123456789abcdef\r\n"
+    "Referer: http://localhost:8080/\r\n"
+    "X-Request-Id: 42\r\n"
+    "\r\n";
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void request_path(const cwist_allocator *allocator) {
+    cwist_http_request *req = cwist_http_parse_request_with(allocator, RAW_REQUEST);
+    cwist_http_response *res = cwist_http_response_create_with(allocator);
+    if (!req || !res) {
+        fprintf(stderr, "allocation failed\n");
+        exit(1);
+    }
+
+    cwist_http_header_add_with(allocator, &res->headers, "Server", "Cwist-Bench/1.0");
+    cwist_http_header_add_with(allocator, &res->headers, "Content-Type", "application/json");
+    cwist_http_header_add_with(allocator, &res->headers, "Cache-Control", "no-store");
+    cwist_sstring_assign(res->body, "{\"items\": [1, 2, 3], \"page\": 2}");
+    cwist_sstring_append(res->body, "\n");
+
+    cwist_http_response_destroy(res);
+    cwist_http_request_destroy(req);
+}
+
+static void report(const char *name, double start, double end, const cwist_allocator *parent) {
+    // One more pass through a counter to show what each request costs the parent.
+    cwist_counting_allocator counter;
+    cwist_counting_allocator_init(&counter, parent);
+    request_path(&counter.base);
+    printf("%-8s %8.1f ns/request  %4zu allocs  %4zu reallocs  %4zu frees\n",
+           name, (end - start) / ITERATIONS,
+           counter.stats.allocs, counter.stats.reallocs, counter.stats.frees);
+}
+
+int main(void) {
+    double start, end;
+
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) request_path(cwist_allocator_libc());
+    end = now_ns();
+    report("glibc", start, end, cwist_allocator_libc());
+
+    cwist_pool_allocator pool;
+    cwist_pool_allocator_init(&pool, NULL);
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) request_path(&pool.base);
+    end = now_ns();
+    report("pool", start, end, &pool.base);
+    cwist_pool_allocator_destroy(&pool);
+
+    static uint8_t arena_buffer[64 * 1024];
+    struct session_manager manager;
+    session_manager_init(&manager, arena_buffer, sizeof(arena_buffer));
+    const cwist_allocator *bump = session_arena_allocator(&manager.request_arena);
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        request_path(bump);
+        session_manager_reset(&manager);
+    }
+    end = now_ns();
+    report("bump", start, end, bump);
+    printf("bump arena high-water: %zu bytes/request\n", manager.request_arena.offset);
+
+    return 0;
+}
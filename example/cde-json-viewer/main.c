@@ -6,6 +6,7 @@
 #include <netinet/in.h>
 #include <cwist/sstring.h>
 #include <cwist/http.h>
+#include <cwist/template.h>
 #include <cjson/cJSON.h>
 
 #define PORT 8080
@@ -21,104 +22,82 @@ const char *MOCK_JSON_INPUT = "{"
     "\"Load\": \"0.01, 0.05, 0.00\""
 "}";
 
-void generate_cde_html(cwist_sstring *html, cJSON *json) {
-    // 1. Write HTML Header & CSS (CDE Retro Style)
-    cwist_sstring_append(html, 
-        "<!DOCTYPE html>\n<html>\n<head>\n"
-        "<title>System Monitor</title>\n"
-        "<style>\n"
-        "  body { background-color: #5d97a6; font-family: 'Helvetica', sans-serif; display: flex; justify-content: center; align-items: center; height: 100vh; margin: 0; }\n"
-        "  .cde-window {\n"
-        "    background-color: #bebebe;\n"
-        "    border-top: 2px solid #ffffff;\n"
-        "    border-left: 2px solid #ffffff;\n"
-        "    border-right: 2px solid #666666;\n"
-        "    border-bottom: 2px solid #666666;\n"
-        "    padding: 5px;\n"
-        "    width: 400px;\n"
-        "    box-shadow: 10px 10px 0px rgba(0,0,0,0.2);\n"
-        "  }\n"
-        "  .title-bar {\n"
-        "    background-color: #4b6983;\n" /* CDE Active Title Color */
-        "    color: white;\n"
-        "    padding: 4px 8px;\n"
-        "    font-weight: bold;\n"
-        "    border-top: 1px solid #99b6d4;\n"
-        "    border-left: 1px solid #99b6d4;\n"
-        "    border-right: 1px solid #283745;\n"
-        "    border-bottom: 1px solid #283745;\n"
-        "    margin-bottom: 8px;\n"
-        "    display: flex; justify-content: space-between;\n"
-        "  }\n"
-        "  .content-area {\n"
-        "    border-top: 2px solid #666666;\n"
-        "    border-left: 2px solid #666666;\n"
-        "    border-right: 2px solid #ffffff;\n"
-        "    border-bottom: 2px solid #ffffff;\n"
-        "    padding: 10px;\n"
-        "  }\n"
-        "  table { width: 100%; border-collapse: collapse; font-size: 14px; }\n"
-        "  td { padding: 4px; border: 1px solid transparent; }\n"
-        "  tr:nth-child(odd) { background-color: #cccccc; }\n"
-        "  .key { font-weight: bold; width: 40%; text-align: right; padding-right: 15px; color: #333; }\n"
-        "  .value { font-family: 'Courier New', monospace; color: #000; }\n"
-        "</style>\n</head>\n<body>\n");
-
-    // 2. Start Window Structure
-    cwist_sstring_append(html, 
-        "<div class=\"cde-window\">\n"
-        "  <div class=\"title-bar\"><span>Terminal Info</span><span>[X]</span></div>\n"
-        "  <div class=\"content-area\">\n"
-        "    <table>\n");
-
-    // 3. Iterate JSON and generate Table Rows
+// Compiled once in main(); each request only fills the slots.
+static const char CDE_PAGE[] =
+    "<!DOCTYPE html>\n<html>\n<head>\n"
+    "<title>System Monitor</title>\n"
+    "<style>\n"
+    "  body { background-color: #5d97a6; font-family: 'Helvetica', sans-serif; display: flex; justify-content: center; align-items: center; height: 100vh; margin: 0; }\n"
+    "  .cde-window {\n"
+    "    background-color: #bebebe;\n"
+    "    border-top: 2px solid #ffffff;\n"
+    "    border-left: 2px solid #ffffff;\n"
+    "    border-right: 2px solid #666666;\n"
+    "    border-bottom: 2px solid #666666;\n"
+    "    padding: 5px;\n"
+    "    width: 400px;\n"
+    "    box-shadow: 10px 10px 0px rgba(0,0,0,0.2);\n"
+    "  }\n"
+    "  .title-bar {\n"
+    "    background-color: #4b6983;\n" /* CDE Active Title Color */
+    "    color: white;\n"
+    "    padding: 4px 8px;\n"
+    "    font-weight: bold;\n"
+    "    border-top: 1px solid #99b6d4;\n"
+    "    border-left: 1px solid #99b6d4;\n"
+    "    border-right: 1px solid #283745;\n"
+    "    border-bottom: 1px solid #283745;\n"
+    "    margin-bottom: 8px;\n"
+    "    display: flex; justify-content: space-between;\n"
+    "  }\n"
+    "  .content-area {\n"
+    "    border-top: 2px solid #666666;\n"
+    "    border-left: 2px solid #666666;\n"
+    "    border-right: 2px solid #ffffff;\n"
+    "    border-bottom: 2px solid #ffffff;\n"
+    "    padding: 10px;\n"
+    "  }\n"
+    "  table { width: 100%; border-collapse: collapse; font-size: 14px; }\n"
+    "  td { padding: 4px; border: 1px solid transparent; }\n"
+    "  tr:nth-child(odd) { background-color: #cccccc; }\n"
+    "  .key { font-weight: bold; width: 40%; text-align: right; padding-right: 15px; color: #333; }\n"
+    "  .value { font-family: 'Courier New', monospace; color: #000; }\n"
+    "</style>\n</head>\n<body>\n"
+    "<div class=\"cde-window\">\n"
+    "  <div class=\"title-bar\"><span>{{title}}</span><span>[X]</span></div>\n"
+    "  <div class=\"content-area\">\n"
+    "    <table>\n"
+    "{{#rows}}"
+    "      <tr><td class=\"key\"> {{key}}</td><td class=\"value\"> {{value}}</td></tr>\n"
+    "{{/rows}}"
+    "    </table>\n"
+    "  </div>\n"
+    "</div>\n"
+    "</body>\n</html>";
+
+static cwist_template *page;
+static int slot_title, slot_rows, slot_key, slot_value;
+
+// Fills args for page from the JSON object's string members. Row args point
+// into json, so it must outlive the send.
+static cwist_template_arg *cde_page_args(cJSON *json, cwist_template_arg *args) {
+    size_t slots = cwist_template_slot_count(page);
+    size_t count = (size_t)cJSON_GetArraySize(json);
+    cwist_template_arg *rows = calloc(count ? count * slots : 1, sizeof(*rows));
+    if (!rows) return NULL;
+
+    size_t row = 0;
     cJSON *item = NULL;
     cJSON_ArrayForEach(item, json) {
         if (cJSON_IsString(item)) {
-            cwist_sstring_append(html, "      <tr><td class=\"key\"> ");
-            cwist_sstring_append(html, item->string); // JSON Key
-            cwist_sstring_append(html, "</td><td class=\"value\"> ");
-            cwist_sstring_append(html, item->valuestring); // JSON Value
-            cwist_sstring_append(html, "</td></tr>\n");
+            rows[row * slots + slot_key] = cwist_template_str(item->string);      // JSON Key
+            rows[row * slots + slot_value] = cwist_template_str(item->valuestring); // JSON Value
+            row++;
         }
     }
-
-    // 4. Close Tags
-    cwist_sstring_append(html, 
-        "    </table>\n"
-        "  </div>\n"
-        "</div>\n"
-        "</body>\n</html>");
-}
-
-void send_response(int client_fd, cwist_http_response *res) {
-    cwist_sstring *raw = cwist_sstring_create();
-    
-    // Status Line
-    char status_line[128];
-    snprintf(status_line, 127, "%s %d %s\r\n", res->version->data, res->status_code, res->status_text->data);
-    cwist_sstring_append(raw, status_line);
-
-    // Headers
-    cwist_http_header_node *curr = res->headers;
-    while(curr) {
-        cwist_sstring_append(raw, curr->key->data);
-        cwist_sstring_append(raw, ": ");
-        cwist_sstring_append(raw, curr->value->data);
-        cwist_sstring_append(raw, "\r\n");
-        curr = curr->next;
-    }
-    cwist_sstring_append(raw, "\r\n"); // End of headers
-
-    // Body
-    if(res->body->data) {
-        cwist_sstring_append(raw, res->body->data);
-    }
-
-    if (raw->data) {
-        send(client_fd, raw->data, strlen(raw->data), 0);
-    }
-    cwist_sstring_destroy(raw);
+    args[slot_title] = cwist_template_str("Terminal Info");
+    args[slot_rows] = cwist_template_rows(rows, row);
+    return rows;
 }
 
 void handle_client(int client_fd) {
@@ -135,25 +114,26 @@ void handle_client(int client_fd) {
 
     // Prepare Response
     cwist_http_response *res = cwist_http_response_create();
+    res->keep_alive = false;
+    cwist_template_output out;
+    cwist_template_output_init(&out, NULL);
     
-    // Generate Body
+    // Generate Body: static page text goes out as-is, only values are escaped.
     cJSON *json = cJSON_Parse(MOCK_JSON_INPUT);
-    if (json) {
-        generate_cde_html(res->body, json);
-        cJSON_Delete(json);
+    cwist_template_arg args[4] = {0};
+    cwist_template_arg *rows = json ? cde_page_args(json, args) : NULL;
+    if (rows && cwist_error_code(cwist_template_render(page, args, &out)) == 0) {
         cwist_http_header_add(&res->headers, "Content-Type", "text/html");
-        
-        char len_str[32];
-        if (res->body->data) {
-            sprintf(len_str, "%zu", strlen(res->body->data));
-            cwist_http_header_add(&res->headers, "Content-Length", len_str);
-        }
     } else {
-         res->status_code = CWIST_HTTP_INTERNAL_ERROR;
-         cwist_sstring_assign(res->status_text, "Internal Server Error");
+        cwist_template_output_reset(&out);
+        res->status_code = CWIST_HTTP_INTERNAL_ERROR;
+        cwist_sstring_assign(res->status_text, "Internal Server Error");
     }
 
-    send_response(client_fd, res);
+    cwist_http_send_response_iov(client_fd, res, out.iov, out.count);
+    free(rows);
+    cJSON_Delete(json);
+    cwist_template_output_destroy(&out);
     cwist_http_response_destroy(res);
     close(client_fd);
 }
@@ -162,6 +142,17 @@ int main() {
     int port = 8080, backlog = 128;
     const char *addr = "127.0.0.1";
     struct sockaddr_in sockv4;
+
+    size_t error_at = 0;
+    cwist_error_t err = cwist_template_compile(cwist_sview_make(CDE_PAGE, sizeof(CDE_PAGE) - 1), &page, &error_at);
+    if (cwist_error_code(err) != 0) {
+        printf("Failed to compile page template at %zu: %s\n", error_at, cwist_error_message(err));
+        return 1;
+    }
+    slot_title = cwist_template_slot(page, "title");
+    slot_rows = cwist_template_slot(page, "rows");
+    slot_key = cwist_template_slot(page, "key");
+    slot_value = cwist_template_slot(page, "value");
     
     int server_fd =  cwist_make_socket_ipv4(&sockv4, addr, port, backlog);
     if (server_fd < 0) {
@@ -173,5 +164,6 @@ int main() {
     printf("Visit http://%s:%d to see the CDE JSON Viewer\n", addr, port);
 
     cwist_accept_socket(server_fd, (struct sockaddr*)&sockv4, handle_client);
+    cwist_template_destroy(page);
     return 0;
 }
@@ -1,18 +1,51 @@
 #include <cwist/http.h>
 #include <cwist/sstring.h>
+#include <cwist/buffer_pool.h>
+#include <cwist/log.h>
+#include <cwist/json.h>
+#include <cwist/session_manager.h>
+#include <cwist/compress.h>
+#include <cwist/body.h>
+#include <cwist/multipart.h>
+#include <cwist/conditional.h>
+#include <cwist/hash.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
-#define BUFFER_SIZE 8192
+#define MAX_REQUEST_SIZE (64 * 1024) // largest pool class
+#define REQUEST_ARENA_SIZE (4 * MAX_REQUEST_SIZE) // parsed request plus its cJSON trees
 #define PORT 8080
+#define EXPORT_ROWS 100000 // /export streams this many JSON lines
+#define UPLOAD_DIR "/tmp"
+#define UPLOAD_MAX_BODY ((uint64_t)512 << 20) // /upload bodies never sit in memory
+#define UPLOAD_PREFIX UPLOAD_DIR "/cwist-upload-"
+
+// Static bodies built once and shared copy-on-write by every response.
+static cwist_sstring *index_body;
+static cwist_sstring *health_body;
+// Their ETags: known before the body is touched, so a revalidation costs nothing.
+static uint64_t index_version;
+static uint64_t health_version;
+
+// Compressed variants of repeated bodies, shared by every connection thread.
+static cwist_compress_config compress_config;
+
+static cwist_sstring *make_cached_body(const char *text) {
+    cwist_sstring *body = cwist_sstring_create();
+    cwist_sstring_assign(body, (char *)text);
+    cwist_sstring_make_shared(body);
+    return body;
+}
 
 // Return index (after "\r\n\r\n") or -1 if not found
 static int find_header_end(const char *buf, size_t len) {
@@ -66,6 +99,55 @@ static int has_chunked_encoding(const char *headers, size_t header_len) {
     return 0;
 }
 
+// Describes the request straight into the body; no cJSON tree in between.
+static void write_request_json(cwist_sstring *body, cwist_http_request *req) {
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, body, true);
+    cwist_json_begin_object(&w);
+    cwist_json_key(&w, "server");
+    cwist_json_string(&w, "Cwist-Simple/1.0");
+    cwist_json_key(&w, "method");
+    cwist_json_string(&w, cwist_http_method_to_string(req->method));
+    cwist_json_key(&w, "path");
+    cwist_json_string_view(&w, cwist_http_request_path_view(req));
+    cwist_json_key(&w, "headers");
+    cwist_json_begin_array(&w);
+    for (cwist_http_header_node *h = req->headers; h; h = h->next) {
+        cwist_json_begin_object(&w);
+        cwist_json_key(&w, "name");
+        cwist_json_string_view(&w, cwist_sstring_view(h->key));
+        cwist_json_key(&w, "value");
+        cwist_json_string_view(&w, cwist_sstring_view(h->value));
+        cwist_json_end_object(&w);
+    }
+    cwist_json_end_array(&w);
+    cwist_json_end_object(&w);
+    cwist_json_writer_finish(&w);
+}
+
+static int append_chunk(void *ctx, const char *data, size_t len) {
+    return cwist_error_code(cwist_sstring_append_view((cwist_sstring *)ctx, cwist_sview_make(data, len))) != 0;
+}
+
+// Streams EXPORT_ROWS JSON lines as chunks, gzip'd when the client accepts it.
+// Memory stays at one batch plus the compressor's window however many rows go out.
+static bool stream_export(int client_fd, cwist_http_request *req, cwist_http_response *res) {
+    cwist_http_chunked_writer writer;
+    char batch[4096];
+    size_t used = 0;
+
+    cwist_http_chunked_begin(&writer, client_fd, res, cwist_http_negotiate_encoding(req));
+    for (int i = 0; i < EXPORT_ROWS && !writer.failed; i++) {
+        used += (size_t)snprintf(batch + used, sizeof(batch) - used, "{\"id\":%d,\"name\":\"row-%d\"}\n", i, i);
+        if (sizeof(batch) - used < 64) {
+            cwist_http_chunked_write(&writer, batch, used);
+            used = 0;
+        }
+    }
+    cwist_http_chunked_write(&writer, batch, used);
+    return cwist_error_code(cwist_http_chunked_end(&writer)) == 0;
+}
+
 // Helper to send a simple error response (always closes)
 static void send_error_response_close(int client_fd, int code, const char *msg) {
     cwist_http_response *res = cwist_http_response_create();
@@ -73,9 +155,12 @@ static void send_error_response_close(int client_fd, int code, const char *msg)
     res->status_code = code;
     cwist_sstring_assign(res->status_text, (char *)msg);
 
-    char body[256];
-    snprintf(body, sizeof(body), "{\"error\": \"%s\"}", msg);
-    cwist_sstring_assign(res->body, body);
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, res->body, false);
+    cwist_json_begin_object(&w);
+    cwist_json_key(&w, "error");
+    cwist_json_string(&w, msg);
+    cwist_json_end_object(&w);
 
     cwist_http_header_add(&res->headers, "Content-Type", "application/json");
     cwist_http_header_add(&res->headers, "Connection", "close");
@@ -92,15 +177,289 @@ static int request_wants_close(cwist_http_request *req) {
     return (strcasecmp(conn, "close") == 0);
 }
 
+// Stores the body in a new file under UPLOAD_DIR. Content-Length bodies are
+// spliced socket -> file, so they never pass through user space.
+static void handle_upload(cwist_http_request *req, cwist_body_reader *reader, cwist_http_response *res) {
+    (void)req;
+    char path[] = UPLOAD_PREFIX "XXXXXX";
+    int file = mkstemp(path);
+    uint64_t written = 0;
+    int code = file < 0 ? errno : (int)cwist_error_code(cwist_body_reader_splice(reader, file, &written));
+    if (file >= 0) close(file);
+
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, res->body, false);
+    cwist_json_begin_object(&w);
+    if (code == 0) {
+        res->status_code = CWIST_HTTP_CREATED;
+        cwist_sstring_assign(res->status_text, "Created");
+        cwist_json_key(&w, "path");
+        cwist_json_string(&w, path);
+        char url[32];
+        snprintf(url, sizeof(url), "/uploads/%s", path + strlen(UPLOAD_PREFIX));
+        cwist_json_key(&w, "url");
+        cwist_json_string(&w, url);
+        cwist_json_key(&w, "bytes");
+        cwist_json_uint(&w, written);
+    } else {
+        if (file >= 0) unlink(path);
+        res->status_code = code == EFBIG ? 413 : file < 0 ? CWIST_HTTP_INTERNAL_ERROR : CWIST_HTTP_BAD_REQUEST;
+        cwist_sstring_assign(res->status_text, code == EFBIG ? "Request Entity Too Large" : "Upload Failed");
+        cwist_json_key(&w, "error");
+        cwist_json_string(&w, strerror(code));
+    }
+    cwist_json_end_object(&w);
+    cwist_json_writer_finish(&w);
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+}
+
+// GET /uploads/<id>: an uploaded file back, with ETag/Last-Modified
+// revalidation and Range for resumed downloads. Only mkstemp's six-character
+// names are accepted, so the path cannot leave UPLOAD_DIR.
+static bool serve_upload(int client_fd, cwist_http_request *req, cwist_http_response *res) {
+    const char *id = req->path->data + strlen("/uploads/");
+    bool valid = strlen(id) == 6;
+    for (size_t i = 0; valid && i < 6; i++) {
+        char c = id[i];
+        valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+    char path[sizeof(UPLOAD_PREFIX) + 6];
+    snprintf(path, sizeof(path), UPLOAD_PREFIX "%s", valid ? id : "");
+    int file = valid ? open(path, O_RDONLY) : -1;
+    if (file < 0) {
+        res->status_code = CWIST_HTTP_NOT_FOUND;
+        cwist_sstring_assign(res->status_text, "Not Found");
+        cwist_http_header_add(&res->headers, "Content-Type", "text/plain");
+        cwist_sstring_assign(res->body, "404 - Not Found");
+        return cwist_error_code(cwist_http_send_response(client_fd, res)) == 0;
+    }
+
+    res->status_code = CWIST_HTTP_OK;
+    cwist_sstring_assign(res->status_text, "OK");
+    cwist_http_header_add(&res->headers, "Content-Type", "application/octet-stream");
+    cwist_http_header_add(&res->headers, "Cache-Control", "no-cache");
+    bool ok = cwist_error_code(cwist_http_send_file(client_fd, req, res, file)) == 0;
+    close(file);
+    return ok;
+}
+
+// /form summary: one JSON object per part, written while the parts stream by.
+struct form_summary {
+    cwist_json_writer json;
+    uint64_t part_bytes;
+};
+
+static int form_part_begin(void *ctx, const cwist_multipart_part *part) {
+    struct form_summary *summary = ctx;
+    summary->part_bytes = 0;
+    cwist_json_begin_object(&summary->json);
+    cwist_json_key(&summary->json, "name");
+    cwist_json_string_view(&summary->json, part->name);
+    if (part->filename.ptr) {
+        cwist_json_key(&summary->json, "filename");
+        cwist_json_string_view(&summary->json, part->filename);
+    }
+    if (part->content_type.ptr) {
+        cwist_json_key(&summary->json, "content_type");
+        cwist_json_string_view(&summary->json, part->content_type);
+    }
+    return 0;
+}
+
+static int form_part_data(void *ctx, const char *data, size_t len) {
+    (void)data;
+    ((struct form_summary *)ctx)->part_bytes += len;
+    return 0;
+}
+
+static int form_part_end(void *ctx) {
+    struct form_summary *summary = ctx;
+    cwist_json_key(&summary->json, "bytes");
+    cwist_json_uint(&summary->json, summary->part_bytes);
+    cwist_json_end_object(&summary->json);
+    return 0;
+}
+
+static const cwist_multipart_handlers form_handlers = { form_part_begin, form_part_data, form_part_end };
+
+// Parses multipart/form-data as it arrives; no part is ever held in memory.
+static void handle_form(cwist_http_request *req, cwist_body_reader *reader, cwist_http_response *res) {
+    cwist_sview boundary;
+    cwist_multipart_parser *parser = malloc(sizeof(*parser));
+    if (!parser || !cwist_multipart_boundary(cwist_http_request_header_view(req, "Content-Type"), &boundary)) {
+        free(parser);
+        res->status_code = CWIST_HTTP_BAD_REQUEST;
+        cwist_sstring_assign(res->status_text, "Bad Request");
+        cwist_http_header_add(&res->headers, "Content-Type", "text/plain");
+        cwist_sstring_assign(res->body, "400 - Expected multipart/form-data");
+        return;
+    }
+
+    struct form_summary summary;
+    cwist_json_writer_init(&summary.json, res->body, false);
+    cwist_json_begin_array(&summary.json);
+    cwist_multipart_parser_init(parser, boundary, &form_handlers, &summary);
+    cwist_error_t err = cwist_body_reader_stream(reader, cwist_multipart_on_body, parser);
+    bool ok = cwist_error_code(err) == 0 && parser->status == CWIST_MULTIPART_DONE;
+    free(parser);
+
+    if (ok) {
+        cwist_json_end_array(&summary.json);
+        cwist_json_writer_finish(&summary.json);
+        res->status_code = CWIST_HTTP_OK;
+        cwist_sstring_assign(res->status_text, "OK");
+        cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    } else {
+        bool too_large = cwist_error_code(err) == EFBIG;
+        res->status_code = too_large ? 413 : CWIST_HTTP_BAD_REQUEST;
+        cwist_sstring_assign(res->status_text, too_large ? "Request Entity Too Large" : "Bad Request");
+        cwist_http_header_add(&res->headers, "Content-Type", "text/plain");
+        cwist_sstring_assign(res->body, too_large ? "413 - Form too large" : "400 - Malformed multipart body");
+    }
+}
+
+// Routes that read their body from the socket as it arrives instead of
+// waiting for all of it in the read buffer; each has its own size cap.
+struct stream_route {
+    const char *method;
+    const char *path;
+    uint64_t max_body;
+    void (*handler)(cwist_http_request *req, cwist_body_reader *reader, cwist_http_response *res);
+};
+
+static const struct stream_route stream_routes[] = {
+    { "POST", "/upload", UPLOAD_MAX_BODY, handle_upload },
+    { "POST", "/form", UPLOAD_MAX_BODY, handle_form },
+};
+
+// Matches the request line alone, so other requests are not parsed twice.
+static const struct stream_route *find_stream_route(const char *head) {
+    for (size_t i = 0; i < sizeof(stream_routes) / sizeof(stream_routes[0]); i++) {
+        const struct stream_route *route = &stream_routes[i];
+        size_t m = strlen(route->method), p = strlen(route->path);
+        if (strncmp(head, route->method, m) != 0 || head[m] != ' ') continue;
+        if (strncmp(head + m + 1, route->path, p) != 0) continue;
+        if (head[m + 1 + p] == ' ' || head[m + 1 + p] == '?') return route;
+    }
+    return NULL;
+}
+
+// Parses the headers, lets the route consume the body, and leaves whatever
+// followed the body at the front of buf. Returns false to close the connection.
+static bool serve_stream_route(int client_fd, struct session_manager *manager, cwist_buffer **bufp,
+                               size_t header_end, const struct stream_route *route) {
+    cwist_buffer *buf = *bufp;
+    char saved = buf->data[header_end];
+    buf->data[header_end] = '\0';
+    cwist_http_request *req = cwist_http_parse_request_in(&manager->request_arena, buf->data);
+    buf->data[header_end] = saved;
+    if (!req) {
+        send_error_response_close(client_fd, CWIST_HTTP_BAD_REQUEST, "Bad Request");
+        return false;
+    }
+    cwist_log(CWIST_LOG_INFO, "[%s] %s (streamed)", cwist_http_method_to_string(req->method), req->path->data);
+
+    cwist_body_reader reader;
+    cwist_error_t err = cwist_body_reader_init(&reader, client_fd, req, buf->data + header_end,
+                                               buf->len - header_end, route->max_body);
+    if (cwist_error_code(err) != 0) {
+        // Refused before reading: the body is still on the wire, so close.
+        int code = (int)cwist_error_code(err);
+        send_error_response_close(client_fd, code == EFBIG ? 413 : code == ENOSYS ? CWIST_HTTP_NOT_IMPLEMENTED : CWIST_HTTP_BAD_REQUEST,
+                                  code == EFBIG ? "Request Entity Too Large" : "Bad Request");
+        session_manager_reset(manager);
+        return false;
+    }
+
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Server", "Cwist-Simple/1.0");
+    route->handler(req, &reader, res);
+
+    // A body the handler did not finish cannot be skipped reliably.
+    bool keep = reader.done && !request_wants_close(req);
+    res->keep_alive = keep;
+    cwist_http_header_add(&res->headers, "Connection", keep ? "keep-alive" : "close");
+    cwist_http_send_response(client_fd, res);
+    cwist_http_response_destroy(res);
+
+    size_t left = 0;
+    const char *rest = cwist_body_reader_leftover(&reader, &left);
+    if (keep && left + 1 > buf->capacity) buf = *bufp = cwist_buffer_grow(buf, left + 1);
+    if (keep && (!buf || buf->capacity < left + 1)) keep = false;
+    if (keep) {
+        memmove(buf->data, rest, left);
+        buf->len = left;
+        buf->data[left] = '\0';
+    }
+    cwist_http_request_destroy(req);
+    session_manager_reset(manager);
+    return keep;
+}
+
+// Legacy-style handler: a cJSON tree of the body, pretty-printed back. Inside
+// the arena scope the nodes and the printed text are bumps in the request
+// arena, and the deletes below cost nothing.
+static void reply_with_reformatted_json(cwist_http_request *req, cwist_http_response *res) {
+    cwist_json_doc doc;
+    cJSON *tree = NULL;
+    if (cwist_error_code(cwist_http_request_json(req, &doc)) == 0) {
+        tree = cwist_json_to_cjson(cwist_json_root(&doc));
+    }
+    char *printed = tree ? cJSON_Print(tree) : NULL;
+
+    if (printed) {
+        res->status_code = CWIST_HTTP_OK;
+        cwist_sstring_assign(res->status_text, "OK");
+        cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+        cwist_sstring_assign(res->body, printed);
+    } else {
+        res->status_code = CWIST_HTTP_BAD_REQUEST;
+        cwist_sstring_assign(res->status_text, "Bad Request");
+        cwist_http_header_add(&res->headers, "Content-Type", "text/plain");
+        cwist_sstring_assign(res->body, "400 - Body is not valid JSON");
+    }
+    cJSON_free(printed);
+    cJSON_Delete(tree);
+}
+
 // Actual request handler logic (keep-alive capable)
+// The read buffer comes from the pool only once the socket is readable and
+// goes back as soon as it drains, so idle keep-alive connections hold none.
+// Each connection parses into its own arena, reset after every request.
 void handle_client(int client_fd) {
-    char buffer[BUFFER_SIZE];
-    size_t buf_len = 0;
+    cwist_buffer *buf = NULL;
+    uint8_t *arena_buffer = malloc(REQUEST_ARENA_SIZE);
+    // A chunked body is decoded as it arrives; buf keeps only its headers
+    // and the bytes not decoded yet.
+    cwist_sstring *chunked_body = cwist_sstring_create();
+    if (!arena_buffer || !chunked_body) {
+        free(arena_buffer);
+        cwist_sstring_destroy(chunked_body);
+        close(client_fd);
+        return;
+    }
+    struct session_manager manager;
+    session_manager_init(&manager, arena_buffer, REQUEST_ARENA_SIZE);
+    cwist_chunked_decoder chunked;
+    bool chunked_active = false;
 
     while (1) {
+        if (!buf) {
+            struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
+            int ready = poll(&pfd, 1, -1);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                perror("poll failed");
+                break;
+            }
+            buf = cwist_buffer_acquire(1);
+            if (!buf) break;
+        }
+
         // Read more data if we don't have at least a full header
-        ssize_t n = recv(client_fd, buffer + buf_len, (BUFFER_SIZE - 1) - buf_len, 0);
+        ssize_t n = recv(client_fd, buf->data + buf->len, (buf->capacity - 1) - buf->len, 0);
         if (n < 0) {
+            if (errno == EINTR) continue;
             perror("recv failed");
             break;
         }
@@ -109,57 +468,111 @@ void handle_client(int client_fd) {
             break;
         }
 
-        buf_len += (size_t)n;
-        buffer[buf_len] = '\0';
+        buf->len += (size_t)n;
+        buf->data[buf->len] = '\0';
 
         // Process as many complete requests as possible from the buffer
-        while (1) {
-            int header_end = find_header_end(buffer, buf_len);
+        while (buf->len > 0) {
+            int header_end = find_header_end(buf->data, buf->len);
             if (header_end < 0) {
                 // Need more data for headers
-                if (buf_len >= BUFFER_SIZE - 1) {
-                    // Headers too big for demo buffer
-                    send_error_response_close(client_fd, 413, "Request Entity Too Large");
-                    goto out;
+                if (buf->len >= buf->capacity - 1) {
+                    if (buf->capacity >= MAX_REQUEST_SIZE) {
+                        send_error_response_close(client_fd, 413, "Request Entity Too Large");
+                        goto out;
+                    }
+                    buf = cwist_buffer_grow(buf, buf->capacity * 2);
                 }
                 break;
             }
 
-            // Demo: reject chunked requests (not implemented)
-            if (has_chunked_encoding(buffer, (size_t)header_end)) {
-                send_error_response_close(client_fd, 501, "Chunked Transfer-Encoding Not Implemented");
-                goto out;
+            const struct stream_route *route = find_stream_route(buf->data);
+            if (route) {
+                if (!serve_stream_route(client_fd, &manager, &buf, (size_t)header_end, route)) goto out;
+                continue;
             }
 
-            long cl = parse_content_length(buffer, (size_t)header_end);
-            if (cl < 0) cl = 0;
+            size_t total_needed;
+            size_t parse_end;   // the body is parsed with the headers unless it was chunked
+            bool is_chunked = has_chunked_encoding(buf->data, (size_t)header_end);
+            if (is_chunked) {
+                if (!chunked_active) {
+                    cwist_chunked_decoder_init(&chunked, MAX_REQUEST_SIZE);
+                    cwist_sstring_assign(chunked_body, "");
+                    chunked_active = true;
+                }
+                size_t consumed = 0;
+                cwist_chunked_status_t status = cwist_chunked_decode(&chunked, buf->data + header_end,
+                                                                     buf->len - (size_t)header_end, &consumed,
+                                                                     append_chunk, chunked_body);
+                if (status == CWIST_CHUNKED_MALFORMED) {
+                    send_error_response_close(client_fd, CWIST_HTTP_BAD_REQUEST, "Bad Request");
+                    goto out;
+                }
+                if (status == CWIST_CHUNKED_TOO_LARGE) {
+                    send_error_response_close(client_fd, 413, "Request Entity Too Large");
+                    goto out;
+                }
+                if (status != CWIST_CHUNKED_DONE) {
+                    size_t keep = buf->len - (size_t)header_end - consumed;
+                    memmove(buf->data + header_end, buf->data + header_end + consumed, keep);
+                    buf->len = (size_t)header_end + keep;
+                    buf->data[buf->len] = '\0';
+                    if (buf->len >= buf->capacity - 1) {
+                        if (buf->capacity >= MAX_REQUEST_SIZE) {
+                            send_error_response_close(client_fd, 413, "Request Entity Too Large");
+                            goto out;
+                        }
+                        buf = cwist_buffer_grow(buf, buf->capacity * 2);
+                    }
+                    break;
+                }
+                chunked_active = false;
+                total_needed = (size_t)header_end + consumed;
+                parse_end = (size_t)header_end;
+            } else {
+                long cl = parse_content_length(buf->data, (size_t)header_end);
+                if (cl < 0) cl = 0;
 
-            size_t total_needed = (size_t)header_end + (size_t)cl;
-            if (total_needed > BUFFER_SIZE - 1) {
-                send_error_response_close(client_fd, 413, "Request Entity Too Large");
-                goto out;
-            }
+                total_needed = (size_t)header_end + (size_t)cl;
+                if (total_needed > MAX_REQUEST_SIZE - 1) {
+                    send_error_response_close(client_fd, 413, "Request Entity Too Large");
+                    goto out;
+                }
 
-            if (buf_len < total_needed) {
-                // Need more body
-                break;
+                if (buf->len < total_needed) {
+                    // Need more body; make sure it will fit
+                    if (total_needed > buf->capacity - 1) {
+                        buf = cwist_buffer_grow(buf, total_needed + 1);
+                        if (buf->capacity < total_needed + 1) {
+                            send_error_response_close(client_fd, 500, "Internal Server Error");
+                            goto out;
+                        }
+                    }
+                    break;
+                }
+                parse_end = total_needed;
             }
 
-            // We have one complete request in buffer[0..total_needed)
-            char saved = buffer[total_needed];
-            buffer[total_needed] = '\0';
+            // We have one complete request in buf->data[0..total_needed)
+            char saved = buf->data[parse_end];
+            buf->data[parse_end] = '\0';
 
-            cwist_http_request *req = cwist_http_parse_request(buffer);
-
-            buffer[total_needed] = saved;
+            cwist_http_request *req = cwist_http_parse_request_in(&manager.request_arena, buf->data);
 
+            buf->data[parse_end] = saved;
+            if (req && is_chunked) cwist_sstring_assign_view(req->body, cwist_sstring_view(chunked_body));
             if (!req) {
                 // Malformed request (we had complete headers/body)
                 send_error_response_close(client_fd, CWIST_HTTP_BAD_REQUEST, "Bad Request");
                 goto out;
             }
 
-            printf("[%s] %s\n", cwist_http_method_to_string(req->method), req->path->data);
+            cwist_log(CWIST_LOG_INFO, "[%s] %s", cwist_http_method_to_string(req->method), req->path->data);
+
+            // cJSON on this thread allocates from the request arena until the reset.
+            struct session_cjson_scope cjson_scope;
+            session_arena_cjson_begin(&cjson_scope, &manager.request_arena);
 
             // Prepare Response
             cwist_http_response *res = cwist_http_response_create();
@@ -176,27 +589,69 @@ void handle_client(int client_fd) {
             }
 
             // Routing Logic
+            bool streamed = false;
             if (strcmp(req->path->data, "/") == 0 && req->method == CWIST_HTTP_GET) {
                 res->status_code = CWIST_HTTP_OK;
                 cwist_sstring_assign(res->status_text, "OK");
                 cwist_http_header_add(&res->headers, "Content-Type", "text/html");
-
-                cwist_sstring_assign(res->body,
-                    "<html>"
-                    "<head><title>Cwist Server</title></head>"
-                    "<body>"
-                    "<h1>Hello from Cwist!</h1>"
-                    "<p>This is a robust, simple example server.</p>"
-                    "<a href='/health'>Check Health</a> | <a href='/json'>Get JSON</a>"
-                    "</body>"
-                    "</html>"
-                );
+                cwist_http_header_add(&res->headers, "Cache-Control", "no-cache");
+                cwist_http_response_set_etag(res, index_version, false);
+                if (!cwist_http_response_conditional(req, res)) cwist_sstring_copy_sstring(res->body, index_body);
             }
             else if (strcmp(req->path->data, "/health") == 0 && req->method == CWIST_HTTP_GET) {
                 res->status_code = CWIST_HTTP_OK;
                 cwist_sstring_assign(res->status_text, "OK");
                 cwist_http_header_add(&res->headers, "Content-Type", "application/json");
-                cwist_sstring_assign(res->body, "{\"status\": \"ok\", \"uptime\": \"forever\"}");
+                cwist_http_header_add(&res->headers, "Cache-Control", "no-cache");
+                cwist_http_response_set_etag(res, health_version, false);
+                if (!cwist_http_response_conditional(req, res)) cwist_sstring_copy_sstring(res->body, health_body);
+            }
+            else if (strcmp(req->path->data, "/json") == 0 && req->method == CWIST_HTTP_GET) {
+                res->status_code = CWIST_HTTP_OK;
+                cwist_sstring_assign(res->status_text, "OK");
+                cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+                write_request_json(res->body, req);
+            }
+            else if (strcmp(req->path->data, "/greet") == 0 && req->method == CWIST_HTTP_GET) {
+                // Only "name" is split out and decoded, however long the query or cookie jar.
+                cwist_sview name = cwist_http_query_get(req, "name");
+                if (!name.ptr || name.len == 0) name = cwist_http_cookie_get(req, "name");
+                if (!name.ptr || name.len == 0) name = CWIST_SVIEW_LIT("world");
+                res->status_code = CWIST_HTTP_OK;
+                cwist_sstring_assign(res->status_text, "OK");
+                cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+                cwist_json_writer w;
+                cwist_json_writer_init(&w, res->body, false);
+                cwist_json_begin_object(&w);
+                cwist_json_key(&w, "hello");
+                cwist_json_string_view(&w, name);
+                cwist_json_end_object(&w);
+                cwist_json_writer_finish(&w);
+                // No version to ask up front: the ETag is a hash of the body.
+                cwist_http_response_etag_body(res);
+                cwist_http_response_conditional(req, res);
+            }
+            else if (strcmp(req->path->data, "/export") == 0 && req->method == CWIST_HTTP_GET) {
+                res->status_code = CWIST_HTTP_OK;
+                cwist_sstring_assign(res->status_text, "OK");
+                cwist_http_header_add(&res->headers, "Content-Type", "application/x-ndjson");
+                if (!stream_export(client_fd, req, res)) close_after = 1;
+                streamed = true;
+            }
+            else if (strncmp(req->path->data, "/uploads/", 9) == 0 &&
+                     (req->method == CWIST_HTTP_GET || req->method == CWIST_HTTP_HEAD)) {
+                if (!serve_upload(client_fd, req, res)) close_after = 1;
+                streamed = true;
+            }
+            else if (strcmp(req->path->data, "/json") == 0 && req->method == CWIST_HTTP_POST) {
+                reply_with_reformatted_json(req, res);
+            }
+            else if (strcmp(req->path->data, "/echo") == 0 && req->method == CWIST_HTTP_POST &&
+                     !cwist_sview_utf8_valid(cwist_http_request_body_view(req))) {
+                res->status_code = CWIST_HTTP_BAD_REQUEST;
+                cwist_sstring_assign(res->status_text, "Bad Request");
+                cwist_http_header_add(&res->headers, "Content-Type", "text/plain");
+                cwist_sstring_assign(res->body, "400 - Body is not valid UTF-8");
             }
             else if (strcmp(req->path->data, "/echo") == 0 && req->method == CWIST_HTTP_POST) {
                 res->status_code = CWIST_HTTP_OK;
@@ -214,30 +669,48 @@ void handle_client(int client_fd) {
                 cwist_sstring_assign(res->body, "404 - Not Found");
             }
 
-            cwist_http_send_response(client_fd, res);
+            if (!streamed) {
+                cwist_http_response_compress(res, req, &compress_config);
+                cwist_http_send_response(client_fd, res);
+            }
 
             cwist_http_response_destroy(res);
             cwist_http_request_destroy(req);
+            session_arena_cjson_end(&cjson_scope);
+            session_manager_reset(&manager);
 
             // Consume this request from buffer
-            size_t remain = buf_len - total_needed;
-            if (remain > 0) memmove(buffer, buffer + total_needed, remain);
-            buf_len = remain;
-            buffer[buf_len] = '\0';
+            size_t remain = buf->len - total_needed;
+            if (remain > 0) memmove(buf->data, buf->data + total_needed, remain);
+            buf->len = remain;
+            buf->data[buf->len] = '\0';
 
             if (close_after) goto out;
 
             // Continue loop to see if another full request is already buffered
         }
+
+        // Fully drained: hand the buffer back while the connection idles
+        if (buf && buf->len == 0) {
+            cwist_buffer_release(buf);
+            buf = NULL;
+        }
     }
 
 out:
+    cwist_sstring_destroy(chunked_body);
+    cwist_buffer_release(buf);
+    session_manager_reset(&manager);
+    free(arena_buffer);
     close(client_fd);
 }
 
 int main() {
     struct sockaddr_in server_addr;
 
+    // Request lines go through the async logger instead of stdio's lock.
+    cwist_log_init(NULL);
+
     // Create and bind socket
     // Backlog increased to 512 to handle high concurrency
     int server_fd = cwist_make_socket_ipv4(&server_addr, "0.0.0.0", PORT, 512);
@@ -246,6 +719,20 @@ int main() {
         return 1;
     }
 
+    index_body = make_cached_body(
+        "<html>"
+        "<head><title>Cwist Server</title></head>"
+        "<body>"
+        "<h1>Hello from Cwist!</h1>"
+        "<p>This is a robust, simple example server.</p>"
+        "<a href='/health'>Check Health</a> | <a href='/json'>Get JSON</a>"
+        "</body>"
+        "</html>");
+    health_body = make_cached_body("{\"status\": \"ok\", \"uptime\": \"forever\"}");
+    index_version = cwist_hash64(index_body->data, index_body->size, 0);
+    health_version = cwist_hash64(health_body->data, health_body->size, 0);
+    compress_config.cache = cwist_compress_cache_create(8 << 20);
+
     printf("Server listening on http://localhost:%d\n", PORT);
     printf("Ctrl+C to stop.\n");
 
@@ -255,6 +742,8 @@ int main() {
     config.use_threading = true;
 
     cwist_http_server_loop(server_fd, &config, handle_client);
+    cwist_compress_cache_destroy(compress_config.cache);
+    cwist_log_shutdown();
     return 0;
 }
 
@@ -0,0 +1,101 @@
+#ifndef __CWIST_ALLOCATOR_H__
+#define __CWIST_ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Allocator vtable taken by every library object (sstring, http request,
+ * response and headers, shared sessions, session store).
+ * Objects remember the allocator they were created with and release through it.
+ * free/realloc receive the size the caller believes the block has; it is
+ * never larger than what was requested, and may be 0 when unknown.
+ */
+typedef struct cwist_allocator {
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void  (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+} cwist_allocator;
+
+// malloc/realloc/free
+const cwist_allocator *cwist_allocator_libc(void);
+
+// Process-wide default used by the plain constructors (libc unless overridden).
+// Set it once at startup, before objects are created.
+const cwist_allocator *cwist_allocator_default(void);
+void cwist_allocator_set_default(const cwist_allocator *allocator); // NULL restores libc
+
+static inline void *cwist_alloc(const cwist_allocator *a, size_t size) {
+    return a->alloc(a->ctx, size);
+}
+
+static inline void *cwist_realloc(const cwist_allocator *a, void *ptr, size_t old_size, size_t new_size) {
+    return a->realloc(a->ctx, ptr, old_size, new_size);
+}
+
+static inline void cwist_free(const cwist_allocator *a, void *ptr, size_t size) {
+    if (ptr) a->free(a->ctx, ptr, size);
+}
+
+/* --- Counting wrapper (allocations per request, leak checks) --- */
+
+typedef struct cwist_allocator_stats {
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+    size_t bytes_requested;
+} cwist_allocator_stats;
+
+typedef struct cwist_counting_allocator {
+    cwist_allocator base;           // hand &counter->base to objects
+    const cwist_allocator *parent;
+    cwist_allocator_stats stats;    // not atomic: one counter per thread/request
+} cwist_counting_allocator;
+
+void cwist_counting_allocator_init(cwist_counting_allocator *counter, const cwist_allocator *parent);
+
+/* --- Small-object pool --- */
+
+// Power-of-two classes from 16 to 1024 bytes carved out of 64 KB blocks;
+// larger requests go to the parent. Not thread-safe: one pool per worker.
+#define CWIST_POOL_CLASS_COUNT 7
+
+typedef struct cwist_pool_allocator {
+    cwist_allocator base;
+    const cwist_allocator *parent;
+    void *free_lists[CWIST_POOL_CLASS_COUNT];
+    void *blocks;                   // chained 64 KB blocks
+    char *cursor;
+    char *limit;
+} cwist_pool_allocator;
+
+void cwist_pool_allocator_init(cwist_pool_allocator *pool, const cwist_allocator *parent);
+void cwist_pool_allocator_destroy(cwist_pool_allocator *pool);
+
+/* --- cJSON --- */
+
+// Routes cJSON's malloc/free (cJSON_InitHooks) through allocator.
+// NULL installs the process default.
+void cwist_allocator_install_cjson(const cwist_allocator *allocator);
+
+// Per-thread override of the above, for the calling thread only. While bound,
+// cJSON allocates from binding.allocator, and frees of blocks inside
+// [base, base + size) go back to it; other blocks (trees built before the
+// binding) still go to the process-wide allocator. size 0 sends every free to
+// binding.allocator. With a range, an allocation the bound allocator refuses
+// falls back to the process-wide one. Returns the previous binding so scopes
+// nest; a zeroed binding clears the override. A ranged binding that is
+// replaced keeps receiving frees of its blocks on this thread until
+// cwist_allocator_forget_cjson(base), so trees may be deleted after the scope.
+typedef struct cwist_cjson_binding {
+    const cwist_allocator *allocator;
+    const void *base;
+    size_t size;
+} cwist_cjson_binding;
+
+cwist_cjson_binding cwist_allocator_bind_cjson(cwist_cjson_binding binding);
+// Call before [base, base + size) is reused or released.
+void cwist_allocator_forget_cjson(const void *base);
+
+#endif
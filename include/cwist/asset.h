@@ -0,0 +1,59 @@
+#ifndef __CWIST_ASSET_H__
+#define __CWIST_ASSET_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/sview.h>
+
+struct cwist_http_request;
+
+/*
+ * Static files compiled into the binary by the cwist-embed generator
+ * (`make cwist-embed`, then `cwist-embed -n site_assets assets/ site_assets.c`).
+ * Every field is a constant: the response head (status line, Content-Type,
+ * Content-Length, ETag, Cache-Control, blank line) and the 304 head are
+ * built at generation time, so serving an asset is one writev of head +
+ * body (or of the 304 head alone) and startup never touches the filesystem.
+ * should be used in this form:
+ * #include "site_assets.h"
+ * const cwist_asset *a = cwist_asset_find(site_assets, site_assets_count, path);
+ * if (a) cwist_asset_serve(fd, a, req);
+ */
+
+typedef struct cwist_asset {
+  const char *path;             // URL path, "/" + path under the embedded directory
+  const char *content_type;
+  const char *etag;             // quoted, e.g. "\"5f2c...\""
+  const unsigned char *body;
+  size_t body_len;
+  const char *head;             // full response head for body
+  size_t head_len;
+  const unsigned char *gzip;    // precompressed body, NULL when not worth it
+  size_t gzip_len;
+  const char *gzip_head;        // head with Content-Encoding: gzip
+  size_t gzip_head_len;
+  const char *cache_control;
+  const char *gzip_etag;        // NULL without a gzip variant
+  const char *not_modified;     // 304 heads: ETag, Cache-Control, Vary
+  size_t not_modified_len;
+  const char *gzip_not_modified;
+  size_t gzip_not_modified_len;
+} cwist_asset;
+
+// assets must be sorted by path (the generator emits them sorted). NULL when absent.
+const cwist_asset *cwist_asset_find(const cwist_asset *assets, size_t count, cwist_sview path);
+
+// Head and body in one writev; the gzip variant when gzip is true and one exists.
+cwist_error_t cwist_asset_send(int client_fd, const cwist_asset *asset, bool gzip);
+// Head only, for HEAD requests.
+cwist_error_t cwist_asset_send_head(int client_fd, const cwist_asset *asset, bool gzip);
+// Picks the variant from Accept-Encoding, answers If-None-Match with the
+// prebuilt 304 and a single Range with a 206 (or 416) slice of the identity
+// body, and sends the head alone for HEAD requests.
+cwist_error_t cwist_asset_serve(int client_fd, const cwist_asset *asset, const struct cwist_http_request *req);
+
+// True when the request's Accept-Encoding allows gzip (and does not set q=0).
+bool cwist_http_accepts_gzip(const struct cwist_http_request *req);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __CWIST_BODY_H__
+#define __CWIST_BODY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/http.h>
+
+/*
+ * Request bodies read from the socket as they arrive instead of being
+ * buffered whole into req->body. The server parses the header block only,
+ * then hands the bytes it already read past the headers to the reader.
+ * Content-Length and chunked framing are both handled; the size limit is
+ * checked before any body byte is read.
+ * should be used in this form:
+ * cwist_body_reader reader;
+ * if (cwist_error_code(cwist_body_reader_init(&reader, fd, req, extra, extra_len, 512 << 20)) == EFBIG) -> 413
+ * while (cwist_error_code(cwist_body_read(&reader, buf, sizeof(buf), &n)) == 0 && n > 0) { ... }
+ */
+
+#define CWIST_BODY_RAW_SIZE 16384  // socket reads that do not go straight into the caller's buffer
+
+typedef struct cwist_body_reader {
+  int fd;
+  const char *pending;          // read but not yet consumed: the caller's extra bytes, then raw
+  size_t pending_len;
+  bool chunked;
+  cwist_chunked_decoder decoder;
+  uint64_t remaining;           // Content-Length bytes still to come
+  uint64_t limit;               // 0 = unlimited
+  uint64_t received;            // body bytes handed out so far
+  bool done;
+  int error;                    // errno of the first failure; every later call returns it
+  char raw[CWIST_BODY_RAW_SIZE];
+} cwist_body_reader;
+
+// Reads the framing from req's headers. extra is what the caller already
+// read past the header block; it must outlive the reader. Fails with EFBIG
+// when Content-Length exceeds limit, EINVAL on a bad Content-Length, and
+// ENOSYS for a Transfer-Encoding other than chunked.
+cwist_error_t cwist_body_reader_init(cwist_body_reader *reader, int fd, const cwist_http_request *req,
+                                     const char *extra, size_t extra_len, uint64_t limit);
+
+// Pull: copies up to cap body bytes into buf; *out_len == 0 once the body is
+// complete. A chunked body past limit fails with EFBIG, bad framing with
+// EBADMSG, a peer that closes early with ECONNRESET.
+cwist_error_t cwist_body_read(cwist_body_reader *reader, void *buf, size_t cap, size_t *out_len);
+
+// Push: calls on_body for each piece until the body ends; a nonzero return
+// stops with ECANCELED.
+cwist_error_t cwist_body_reader_stream(cwist_body_reader *reader, cwist_chunk_handler on_body, void *ctx);
+
+// Writes the rest of the body to out_fd. Content-Length bodies move
+// socket -> pipe -> out_fd with splice(2) on Linux, never entering user
+// space; chunked bodies, and fds splice refuses, are copied.
+cwist_error_t cwist_body_reader_splice(cwist_body_reader *reader, int out_fd, uint64_t *written);
+
+// Bytes read past the end of the body (the next pipelined request); valid
+// until the reader goes away.
+const char *cwist_body_reader_leftover(const cwist_body_reader *reader, size_t *len);
+
+#endif
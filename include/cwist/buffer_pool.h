@@ -0,0 +1,47 @@
+#ifndef __CWIST_BUFFER_POOL_H__
+#define __CWIST_BUFFER_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Pooled I/O buffers in fixed size classes.
+ * Slabs are cache-line aligned. Each thread keeps a small free list per class
+ * and refills from (or spills to) a global list in batches, so acquire/release
+ * are lock-free in the steady state.
+ * Connections should only hold a buffer while they have unprocessed bytes:
+ * acquire when the socket turns readable, release once the buffer drains.
+ */
+
+typedef enum cwist_buffer_class_t {
+    CWIST_BUFFER_4K,
+    CWIST_BUFFER_16K,
+    CWIST_BUFFER_64K,
+    CWIST_BUFFER_CLASS_COUNT
+} cwist_buffer_class_t;
+
+typedef struct cwist_buffer {
+    char *data;
+    size_t capacity;
+    size_t len;                     // bytes currently held
+    cwist_buffer_class_t size_class;
+    struct cwist_buffer *next;      // free-list link, owned by the pool
+} cwist_buffer;
+
+typedef struct cwist_buffer_pool_stats {
+    size_t allocated[CWIST_BUFFER_CLASS_COUNT];    // slabs obtained from the system
+    size_t global_free[CWIST_BUFFER_CLASS_COUNT];  // slabs parked on the global lists
+} cwist_buffer_pool_stats;
+
+// Smallest class holding min_capacity bytes; NULL if larger than 64 KB.
+cwist_buffer *cwist_buffer_acquire(size_t min_capacity);
+void cwist_buffer_release(cwist_buffer *buf);
+// Moves the contents into a buffer of at least min_capacity and releases the old one.
+// On failure the original buffer is returned untouched.
+cwist_buffer *cwist_buffer_grow(cwist_buffer *buf, size_t min_capacity);
+
+// Returns this thread's cached slabs to the global lists.
+void cwist_buffer_pool_flush_thread(void);
+void cwist_buffer_pool_get_stats(cwist_buffer_pool_stats *stats);
+
+#endif
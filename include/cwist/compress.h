@@ -0,0 +1,90 @@
+#ifndef __CWIST_COMPRESS_H__
+#define __CWIST_COMPRESS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/sstring.h>
+#include <cwist/sview.h>
+
+struct cwist_http_request;
+struct cwist_http_response;
+
+/*
+ * gzip/deflate response encoding (zlib). Negotiated from Accept-Encoding;
+ * small bodies, already-encoded bodies and types that do not compress are
+ * left alone. A cwist_compress_cache keeps compressed variants keyed by the
+ * body's content hash, so a hot static body is compressed once.
+ * should be used in this form:
+ * static struct cwist_compress_cache *cache;   // cwist_compress_cache_create(8 << 20)
+ * cwist_compress_config config = { .cache = cache };
+ * cwist_http_response_compress(res, req, &config);
+ * cwist_http_send_response(fd, res);
+ */
+
+#define CWIST_COMPRESS_MIN_SIZE 1024   // bytes; below this the header costs more than it saves
+#define CWIST_COMPRESS_LEVEL 6         // zlib's default speed/size balance
+
+typedef enum cwist_encoding_t {
+  CWIST_ENCODING_IDENTITY,
+  CWIST_ENCODING_GZIP,
+  CWIST_ENCODING_DEFLATE,   // zlib stream (RFC 1950), which is what HTTP calls deflate
+} cwist_encoding_t;
+
+struct cwist_compress_cache;
+
+typedef struct cwist_compress_config {
+  size_t min_size;          // 0 = CWIST_COMPRESS_MIN_SIZE
+  int level;                // zlib 1-9, 0 = CWIST_COMPRESS_LEVEL
+  struct cwist_compress_cache *cache; // NULL = compress every time
+} cwist_compress_config;
+
+typedef struct cwist_compress_cache_stats {
+  uint64_t hits;
+  uint64_t misses;
+  size_t entries;
+  size_t memory_used;
+} cwist_compress_cache_stats;
+
+const char *cwist_encoding_name(cwist_encoding_t encoding); // "gzip", "deflate", "identity"
+
+// Quality (0-1000) the request's Accept-Encoding gives coding, falling back
+// to "*"; 0 when neither is listed or there is no header.
+int cwist_http_encoding_q(const struct cwist_http_request *req, const char *coding);
+// The best of gzip/deflate the client accepts (gzip on ties), else identity.
+cwist_encoding_t cwist_http_negotiate_encoding(const struct cwist_http_request *req);
+// text/*, JSON, JavaScript, XML and SVG (with or without parameters).
+bool cwist_compress_type_ok(cwist_sview content_type);
+
+// One-shot compression appended to out.
+cwist_error_t cwist_compress(cwist_encoding_t encoding, int level, cwist_sview data, cwist_sstring *out);
+
+// Compresses res->body in place when the request allows it and it pays off:
+// sets Content-Encoding and Vary, and weakens a strong ETag. Leaves the
+// response untouched (and returns success) for 206 and 304, small bodies,
+// unknown types, responses that already have a Content-Encoding or
+// Content-Length, and Cache-Control: no-transform.
+// The cache is skipped for Cache-Control: no-store / private.
+cwist_error_t cwist_http_response_compress(struct cwist_http_response *res, const struct cwist_http_request *req,
+                                           const cwist_compress_config *config);
+
+// Thread-safe; evicts with CLOCK once memory_cap bytes are held (0 = unlimited).
+struct cwist_compress_cache *cwist_compress_cache_create(size_t memory_cap);
+void cwist_compress_cache_destroy(struct cwist_compress_cache *cache);
+// Appends data's compressed form to out, compressing and storing it on a miss.
+cwist_error_t cwist_compress_cached(struct cwist_compress_cache *cache, cwist_encoding_t encoding, int level,
+                                    cwist_sview data, cwist_sstring *out);
+cwist_compress_cache_stats cwist_compress_cache_stats_get(struct cwist_compress_cache *cache);
+
+// Incremental compression for bodies sent in pieces (chunked responses).
+// Each write appends whatever output is ready; flush forces everything so
+// far out (Z_SYNC_FLUSH) so the client can decode it before the next piece.
+typedef struct cwist_compress_stream cwist_compress_stream;
+
+cwist_compress_stream *cwist_compress_stream_create(cwist_encoding_t encoding, int level);
+cwist_error_t cwist_compress_stream_write(cwist_compress_stream *stream, cwist_sview data, bool flush, cwist_sstring *out);
+cwist_error_t cwist_compress_stream_finish(cwist_compress_stream *stream, cwist_sstring *out);
+void cwist_compress_stream_destroy(cwist_compress_stream *stream);
+
+#endif
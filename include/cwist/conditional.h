@@ -0,0 +1,86 @@
+#ifndef __CWIST_CONDITIONAL_H__
+#define __CWIST_CONDITIONAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/http.h>
+#include <cwist/sview.h>
+
+/*
+ * Conditional requests (RFC 9110 section 13) and byte ranges (section 14).
+ * A handler that knows its version up front sets the validators and asks
+ * before it builds anything; one that does not hashes the finished body.
+ * Either way a matching If-None-Match / If-Modified-Since turns the
+ * response into a 304, which cwist_http_send_response sends without a body.
+ * should be used in this form:
+ * cwist_http_response_set_etag(res, row->version, false);
+ * if (cwist_http_response_conditional(req, res)) return;   // 304 or 412
+ * ... build res->body ...
+ * or, after the body is built:
+ * cwist_http_response_etag_body(res);
+ * cwist_http_response_conditional(req, res);
+ */
+
+#define CWIST_ETAG_SIZE 24          // W/"<16 hex digits>" and the NUL
+#define CWIST_HTTP_DATE_SIZE 30     // "Sun, 06 Nov 1994 08:49:37 GMT" and the NUL
+
+typedef enum cwist_precondition_t {
+  CWIST_PRECONDITION_PASS,           // go on and serve the request
+  CWIST_PRECONDITION_NOT_MODIFIED,   // answer 304
+  CWIST_PRECONDITION_FAILED,         // answer 412
+} cwist_precondition_t;
+
+typedef enum cwist_range_status_t {
+  CWIST_RANGE_NONE,                  // serve the whole representation
+  CWIST_RANGE_OK,                    // serve [offset, offset + length) as 206
+  CWIST_RANGE_UNSATISFIABLE,         // answer 416
+} cwist_range_status_t;
+
+// Quoted entity-tag for version, "W/"-prefixed when weak. Returns its length.
+size_t cwist_http_etag_make(char out[CWIST_ETAG_SIZE], uint64_t version, bool weak);
+// Replace (or add) the response's ETag.
+cwist_error_t cwist_http_response_set_etag(cwist_http_response *res, uint64_t version, bool weak);
+// Strong ETag from a cwist_hash64 of res->body.
+cwist_error_t cwist_http_response_etag_body(cwist_http_response *res);
+
+// IMF-fixdate; always GMT, independent of the locale.
+size_t cwist_http_date_format(time_t t, char out[CWIST_HTTP_DATE_SIZE]);
+// Accepts IMF-fixdate and the obsolete RFC 850 and asctime forms.
+bool cwist_http_date_parse(cwist_sview value, time_t *out);
+cwist_error_t cwist_http_response_set_last_modified(cwist_http_response *res, time_t t);
+
+// True when the entity-tag list (an If-Match / If-None-Match value, or "*")
+// contains etag. Weak comparison ignores W/ prefixes; strong never matches
+// a weak tag.
+bool cwist_http_etag_match(cwist_sview list, cwist_sview etag, bool weak);
+
+// Evaluates If-Match, If-Unmodified-Since, If-None-Match and
+// If-Modified-Since in the order RFC 9110 section 13.2.2 gives. etag.ptr ==
+// NULL or last_modified == 0 means that validator is unknown.
+cwist_precondition_t cwist_http_evaluate_preconditions(const cwist_http_request *req, cwist_sview etag,
+                                                       time_t last_modified);
+// Evaluates against the ETag / Last-Modified already on res. On 304 or 412
+// rewrites res (status, empty body) and returns true; the caller just sends it.
+bool cwist_http_response_conditional(const cwist_http_request *req, cwist_http_response *res);
+
+// One `bytes=` range against a representation of size bytes. Multiple
+// ranges, other units and syntax errors give NONE: the full body is a
+// valid answer to all of them.
+cwist_range_status_t cwist_http_range_parse(cwist_sview value, uint64_t size, uint64_t *offset, uint64_t *length);
+// Range for a GET, honouring If-Range against etag / last_modified.
+cwist_range_status_t cwist_http_request_range(const cwist_http_request *req, uint64_t size, cwist_sview etag,
+                                              time_t last_modified, uint64_t *offset, uint64_t *length);
+// Applies the request's Range to a 200 res: slices res->body into a 206 with
+// Content-Range, or makes it a 416. Adds Accept-Ranges either way.
+cwist_error_t cwist_http_response_range(const cwist_http_request *req, cwist_http_response *res);
+
+// Serves a regular file: ETag (size, mtime, inode) and Last-Modified unless
+// res has them, the preconditions above, a single Range, then the head and
+// the file via sendfile(2). HEAD gets the head only. res supplies status
+// and extra headers (Content-Type, Cache-Control); its body is ignored.
+cwist_error_t cwist_http_send_file(int client_fd, const cwist_http_request *req, cwist_http_response *res, int file_fd);
+
+#endif
@@ -37,9 +37,19 @@ typedef enum cwist_errtype_t {
   CWIST_ERR_DOUBLE,
 } cwist_errtype_t;
 
-typedef struct __prim_cwist_error_t {
-  /* These types are widely used when handling internal errcodes.
-   * User-oriented errors are beautified as JSON.
+/* Who defines the code, so it can be described later. */
+typedef enum cwist_errdomain_t {
+  CWIST_ERRDOMAIN_NONE,    // bare code (HTTP helpers use 0 / -1)
+  CWIST_ERRDOMAIN_ERRNO,   // code is an errno value
+  CWIST_ERRDOMAIN_SSTRING, // code is an enum cwist_sstring_error_t
+  CWIST_ERRDOMAIN_JSON,    // code is an enum cwist_json_error_t
+  CWIST_ERRDOMAIN_TEMPLATE, // code is an enum cwist_template_error_t
+} cwist_errdomain_t;
+
+typedef union __prim_cwist_error_t {
+  /* Only the member named by errtype is meaningful; make_error zeroes the rest.
+   * User-oriented details (JSON, text) are built on demand by
+   * cwist_error_message / cwist_error_to_json instead of on every call.
    */
   int8_t   err_i8;
   int16_t  err_i16;
@@ -47,6 +57,7 @@ typedef struct __prim_cwist_error_t {
   int64_t  err_i64;
 #if (defined(__clang__) || defined(__GNUC__)) && defined(USE_128BIT_ERRCODE)
   int64_t err_i128;
+  uint64_t err_u128;
 #endif
 
   /* Unsigned error types. These types are often utilised when handling raw bytes;
@@ -57,19 +68,26 @@ typedef struct __prim_cwist_error_t {
   uint32_t  err_u32;
   uint64_t  err_u64;
 
-#if (defined(__clang__) || defined(__GNUC__)) && defined(USE_128BIT_ERRCODE)
-  int64_t err_i128;
-#endif
   struct cwist_sstring *err_string;
   cJSON       *err_json;
-
 } __prim_cwist_error_t;
 
+// 16 bytes: returned by value in two registers on x86-64 / AArch64.
 typedef struct cwist_error_t {
   cwist_errtype_t errtype;
-__prim_cwist_error_t error;
+  cwist_errdomain_t domain;
+  __prim_cwist_error_t error;
 } cwist_error_t;
 
+_Static_assert(sizeof(cwist_error_t) <= 16, "cwist_error_t must stay register-sized");
+
 /* FUNCITONS */
-cwist_error_t make_error(cwist_errtype_t type);
+cwist_error_t make_error(cwist_errtype_t type); // zeroed payload, CWIST_ERRDOMAIN_NONE
+cwist_error_t cwist_error_make(cwist_errdomain_t domain, cwist_errtype_t type, int64_t code);
+// The integer payload sign- or zero-extended per errtype; 0 for STRING/JSON/float.
+int64_t cwist_error_code(cwist_error_t err);
+// Static text for the code; never allocates. "" when nothing is known.
+const char *cwist_error_message(cwist_error_t err);
+// {"domain": ..., "code": ..., "err": ...} built on demand; caller frees with cJSON_Delete.
+cJSON *cwist_error_to_json(cwist_error_t err);
 #endif
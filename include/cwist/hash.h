@@ -0,0 +1,12 @@
+#ifndef __CWIST_HASH_H__
+#define __CWIST_HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fast non-cryptographic 64-bit hash (8 bytes per step).
+// Good for hash tables, cache keys and ETags; never for anything adversarial
+// unless seeded with a per-process secret.
+uint64_t cwist_hash64(const void *data, size_t len, uint64_t seed);
+
+#endif
@@ -2,9 +2,14 @@
 #define __CWIST_HTTP_H__
 
 #include <cwist/sstring.h>
+#include <cwist/compress.h>
 #include <cwist/err/cwist_err.h>
+#include <cwist/allocator.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+
+struct session_arena;
 
 /* --- Enums --- */
 
@@ -23,10 +28,14 @@ typedef enum cwist_http_status_t {
     CWIST_HTTP_OK = 200,
     CWIST_HTTP_CREATED = 201,
     CWIST_HTTP_NO_CONTENT = 204,
+    CWIST_HTTP_PARTIAL_CONTENT = 206,
+    CWIST_HTTP_NOT_MODIFIED = 304,
     CWIST_HTTP_BAD_REQUEST = 400,
     CWIST_HTTP_UNAUTHORIZED = 401,
     CWIST_HTTP_FORBIDDEN = 403,
     CWIST_HTTP_NOT_FOUND = 404,
+    CWIST_HTTP_PRECONDITION_FAILED = 412,
+    CWIST_HTTP_RANGE_NOT_SATISFIABLE = 416,
     CWIST_HTTP_INTERNAL_ERROR = 500,
     CWIST_HTTP_NOT_IMPLEMENTED = 501
 } cwist_http_status_t;
@@ -38,16 +47,23 @@ typedef struct cwist_http_header_node {
     cwist_sstring *key;
     cwist_sstring *value;
     struct cwist_http_header_node *next;
+    const cwist_allocator *allocator; // node and its strings
 } cwist_http_header_node;
 
+struct cwist_http_params;
+
 typedef struct cwist_http_request {
     cwist_http_method_t method;
     cwist_sstring *path;        // e.g., "/users/1"
-    cwist_sstring *query;       // e.g., "active=true" (parsed later)
+    cwist_sstring *query;       // e.g., "active=true", raw; split on first cwist_http_query_get
     cwist_sstring *version;     // e.g., "HTTP/1.1"
     cwist_http_header_node *headers;
     cwist_sstring *body;
     bool keep_alive;
+    const cwist_allocator *allocator; // the request, its strings and headers
+    struct cwist_http_params *query_params;  // lazy parameter indexes, built on first lookup
+    struct cwist_http_params *cookie_params;
+    struct cwist_http_params *form_params;
 } cwist_http_request;
 
 typedef struct cwist_http_response {
@@ -57,6 +73,7 @@ typedef struct cwist_http_response {
     cwist_http_header_node *headers;
     cwist_sstring *body;
     bool keep_alive;
+    const cwist_allocator *allocator; // the response, its strings and headers
 } cwist_http_response;
 
 /* --- API Functions --- */
@@ -65,17 +82,114 @@ typedef struct cwist_http_response {
 cwist_http_request *cwist_http_request_create(void);
 void cwist_http_request_destroy(cwist_http_request *req);
 cwist_http_request *cwist_http_parse_request(const char *raw_request); // New
+// A chunked body (Transfer-Encoding: chunked) is decoded into req->body;
+// malformed or incomplete chunking fails the parse. Header-only input gives an empty body.
 
 // Response Lifecycle
 cwist_http_response *cwist_http_response_create(void);
 void cwist_http_response_destroy(cwist_http_response *res);
 cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res); // New
+// A 304 goes out as a fixed status line plus the handler's validator and
+// caching headers (ETag, Last-Modified, Cache-Control, Vary, Date, Expires,
+// Content-Location), straight from the header list: no body, no allocation.
+// Sends res's status line and headers, then body (res->body is ignored) in
+// one writev. Content-Length is the iov total unless the handler set one.
+cwist_error_t cwist_http_send_response_iov(int client_fd, cwist_http_response *res, const struct iovec *body, size_t count);
+
+// Explicit allocator (NULL = process default); headers added later should use
+// the object's allocator too.
+cwist_http_request *cwist_http_request_create_with(const cwist_allocator *allocator);
+cwist_http_request *cwist_http_parse_request_with(const cwist_allocator *allocator, const char *raw_request);
+cwist_http_response *cwist_http_response_create_with(const cwist_allocator *allocator);
+
+// Arena-backed lifecycle: the object, its headers and strings are carved out of
+// the arena and reclaimed by session_manager_reset (destroy frees nothing).
+// Returns NULL when the arena runs out of space.
+cwist_http_request *cwist_http_request_create_in(struct session_arena *arena);
+cwist_http_request *cwist_http_parse_request_in(struct session_arena *arena, const char *raw_request);
+cwist_http_response *cwist_http_response_create_in(struct session_arena *arena);
 
 // Header Manipulation
 cwist_error_t cwist_http_header_add(cwist_http_header_node **head, const char *key, const char *value);
+cwist_error_t cwist_http_header_add_with(const cwist_allocator *allocator, cwist_http_header_node **head, const char *key, const char *value);
+cwist_error_t cwist_http_header_add_in(struct session_arena *arena, cwist_http_header_node **head, const char *key, const char *value);
 char *cwist_http_header_get(cwist_http_header_node *head, const char *key); // Returns raw char* for convenience, NULL if not found
 void cwist_http_header_free_all(cwist_http_header_node *head);
 
+// Copy-free accessors. Views borrow the request's storage and stay valid until
+// the field is modified or the request destroyed. Header lookup ignores case;
+// a missing header gives a view with ptr == NULL.
+cwist_sview cwist_http_header_get_view(const cwist_http_header_node *head, cwist_sview key);
+cwist_sview cwist_http_request_path_view(const cwist_http_request *req);
+cwist_sview cwist_http_request_query_view(const cwist_http_request *req);
+cwist_sview cwist_http_request_version_view(const cwist_http_request *req);
+cwist_sview cwist_http_request_body_view(const cwist_http_request *req);
+cwist_sview cwist_http_request_header_view(const cwist_http_request *req, const char *key);
+
+// Lazy parameter lookup. The first call for a source copies it once into the
+// request's allocator and indexes it; values are percent-decoded in that copy
+// only when their key is asked for, so reading one parameter out of a long
+// query string decodes one parameter. First match wins; ptr == NULL when the
+// key is absent. The index is not rebuilt if query/body/Cookie change later.
+cwist_sview cwist_http_query_get(cwist_http_request *req, const char *key);
+cwist_sview cwist_http_cookie_get(cwist_http_request *req, const char *key); // values are not decoded
+// application/x-www-form-urlencoded bodies only.
+cwist_sview cwist_http_form_get(cwist_http_request *req, const char *key);
+// In-place percent-decoding ('+' as space when asked); returns the new length.
+// Malformed escapes are kept as they are.
+size_t cwist_http_url_decode(char *data, size_t len, bool plus_is_space);
+
+// Chunked transfer-encoding (RFC 9112 section 7.1).
+// The decoder is incremental: feed it bytes as they arrive and it hands each
+// piece of chunk data to on_data without copying, straight out of `in`.
+// CRLFs are required, and size and trailer lines are bounded.
+// should be used in this form:
+// cwist_chunked_decoder dec;
+// cwist_chunked_decoder_init(&dec, 1 << 20);          // body limit, 0 = none
+// status = cwist_chunked_decode(&dec, buf, len, &used, on_data, ctx);
+// // drop `used` bytes; NEED_MORE: read more and call again
+typedef enum cwist_chunked_status_t {
+    CWIST_CHUNKED_NEED_MORE,    // every byte consumed, body not finished
+    CWIST_CHUNKED_DONE,         // last chunk and trailers seen; bytes past *consumed are the next message
+    CWIST_CHUNKED_MALFORMED,
+    CWIST_CHUNKED_TOO_LARGE,    // body passed the decoder's limit
+    CWIST_CHUNKED_ABORTED,      // on_data returned nonzero
+} cwist_chunked_status_t;
+
+typedef struct cwist_chunked_decoder {
+    int state;
+    uint64_t remaining;         // data bytes left in the current chunk
+    uint64_t total;             // data bytes so far
+    uint64_t limit;             // 0 = unlimited
+    size_t line;                // bytes in the current size or trailer line(s)
+    bool digits;                // current size line has a digit
+} cwist_chunked_decoder;
+
+typedef int (*cwist_chunk_handler)(void *ctx, const char *data, size_t len); // nonzero stops decoding
+
+void cwist_chunked_decoder_init(cwist_chunked_decoder *dec, uint64_t limit);
+bool cwist_http_request_is_chunked(const cwist_http_request *req); // last Transfer-Encoding coding is chunked
+cwist_chunked_status_t cwist_chunked_decode(cwist_chunked_decoder *dec, const char *in, size_t len, size_t *consumed,
+                                            cwist_chunk_handler on_data, void *ctx);
+
+// Streams a response of unknown length. begin sends the head with
+// Transfer-Encoding: chunked (a handler's Content-Length is dropped);
+// write sends one chunk straight from data (one writev, no copy); end sends
+// the last chunk. With an encoding, data is compressed on the way out and
+// flush pushes what was compressed so far to the client. HTTP/1.1 only.
+typedef struct cwist_http_chunked_writer {
+    int fd;
+    struct cwist_compress_stream *stream;  // NULL for identity
+    cwist_sstring *pending;     // compressed bytes not yet sent
+    bool failed;                // a send failed; later calls do nothing
+} cwist_http_chunked_writer;
+
+cwist_error_t cwist_http_chunked_begin(cwist_http_chunked_writer *writer, int client_fd, cwist_http_response *res,
+                                       cwist_encoding_t encoding);
+cwist_error_t cwist_http_chunked_write(cwist_http_chunked_writer *writer, const void *data, size_t len);
+cwist_error_t cwist_http_chunked_flush(cwist_http_chunked_writer *writer);
+cwist_error_t cwist_http_chunked_end(cwist_http_chunked_writer *writer); // also releases the writer
+
 // Helper to convert method enum to string and vice versa
 const char *cwist_http_method_to_string(cwist_http_method_t method);
 cwist_http_method_t cwist_http_string_to_method(const char *method_str);
@@ -84,6 +198,10 @@ cwist_http_method_t cwist_http_string_to_method(const char *method_str);
 // socket -> bind -> listen
 int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog);
 cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (*handler_func)(int client_fd));
+// Writes every byte of iov[0..count) (sendmsg on sockets, no SIGPIPE;
+// writev otherwise), retrying partial writes and EINTR. Advances iov in
+// place. Errors are in CWIST_ERRDOMAIN_ERRNO.
+cwist_error_t cwist_writev_all(int fd, struct iovec *iov, size_t count);
 
 typedef struct cwist_server_config {
     bool use_forking;     // Process per request
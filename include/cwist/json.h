@@ -0,0 +1,170 @@
+#ifndef __CWIST_JSON_H__
+#define __CWIST_JSON_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/allocator.h>
+#include <cwist/sstring.h>
+#include <cwist/sview.h>
+#include <cjson/cJSON.h>
+
+/*
+ * Streaming JSON writer: appends straight to a cwist_sstring (typically
+ * res->body), with no intermediate tree.
+ * Every call returns the writer's sticky error; after the first failure the
+ * remaining calls do nothing, so a handler can write the whole document and
+ * check once (cwist_json_writer_finish).
+ * should be used in this form:
+ * cwist_json_writer w;
+ * cwist_json_writer_init(&w, res->body, false);
+ * cwist_json_begin_object(&w);
+ * cwist_json_key(&w, "status"); cwist_json_string(&w, "ok");
+ * cwist_json_end_object(&w);
+ * cwist_error_t err = cwist_json_writer_finish(&w);
+ */
+
+#define CWIST_JSON_MAX_DEPTH 64
+
+enum cwist_json_error_t {
+  ERR_JSON_OKAY,
+  ERR_JSON_TOO_DEEP,     // nesting beyond CWIST_JSON_MAX_DEPTH
+  ERR_JSON_UNBALANCED,   // end without begin, or finish with open containers
+  ERR_JSON_MISPLACED,    // key outside an object, value where a key is due, ...
+  ERR_JSON_SYNTAX,       // reader: malformed document
+  ERR_JSON_ENCODING,     // reader: body is not UTF-8
+};
+
+typedef struct cwist_json_writer {
+  cwist_sstring *out;
+  bool pretty;            // two-space indent, one member per line
+  bool after_key;         // a key was written, its value is due
+  bool done;              // a complete top-level value was written
+  unsigned depth;
+  uint64_t in_object;     // bit d: the container at depth d is an object
+  uint64_t has_items;     // bit d: the container at depth d is non-empty
+  cwist_error_t err;
+} cwist_json_writer;
+
+void cwist_json_writer_init(cwist_json_writer *writer, cwist_sstring *out, bool pretty);
+// The sticky error, plus ERR_JSON_UNBALANCED if containers are still open.
+cwist_error_t cwist_json_writer_finish(cwist_json_writer *writer);
+
+cwist_error_t cwist_json_begin_object(cwist_json_writer *writer);
+cwist_error_t cwist_json_end_object(cwist_json_writer *writer);
+cwist_error_t cwist_json_begin_array(cwist_json_writer *writer);
+cwist_error_t cwist_json_end_array(cwist_json_writer *writer);
+
+cwist_error_t cwist_json_key(cwist_json_writer *writer, const char *key);
+cwist_error_t cwist_json_key_view(cwist_json_writer *writer, cwist_sview key);
+
+cwist_error_t cwist_json_string(cwist_json_writer *writer, const char *value); // NULL writes null
+cwist_error_t cwist_json_string_view(cwist_json_writer *writer, cwist_sview value);
+cwist_error_t cwist_json_int(cwist_json_writer *writer, int64_t value);
+cwist_error_t cwist_json_uint(cwist_json_writer *writer, uint64_t value);
+// Shortest text that reads back as the same double; NaN/Inf become null.
+cwist_error_t cwist_json_double(cwist_json_writer *writer, double value);
+cwist_error_t cwist_json_bool(cwist_json_writer *writer, bool value);
+cwist_error_t cwist_json_null(cwist_json_writer *writer);
+// Pre-serialized JSON inserted as one value (not validated).
+cwist_error_t cwist_json_raw(cwist_json_writer *writer, cwist_sview json);
+
+/*
+ * On-demand reader: cwist_json_doc_parse makes one vectorized pass over the
+ * text (cwist_simd_json_classify) and records the offset of every structural
+ * token, plus a jump from each '{' / '[' to its closer. Nothing else is
+ * decoded up front; numbers and strings are read when a handler asks for them,
+ * and lookups skip whole subtrees through the jumps.
+ * The text is borrowed and must outlive the document. The index and any
+ * unescaped strings come from the document's allocator; for an arena-built
+ * request (cwist_http_parse_request_in) that is the arena, so
+ * session_manager_reset reclaims everything and cwist_json_doc_release is
+ * optional.
+ * cwist_json_doc doc;
+ * if (cwist_error_code(cwist_http_request_json(req, &doc)) == 0) {
+ *     int64_t id;
+ *     cwist_json_value user = cwist_json_get(cwist_json_root(&doc), "user");
+ *     if (cwist_json_get_int64(cwist_json_get(user, "id"), &id)) ...
+ * }
+ */
+
+#define CWIST_JSON_MAX_NESTING 256
+
+typedef enum cwist_json_type_t {
+  CWIST_JSON_MISSING,    // absent key, index past the end, or a failed lookup
+  CWIST_JSON_INVALID,    // token that is no JSON scalar ("tru", "01x", ...)
+  CWIST_JSON_NULL,
+  CWIST_JSON_BOOL,
+  CWIST_JSON_NUMBER,
+  CWIST_JSON_STRING,
+  CWIST_JSON_ARRAY,
+  CWIST_JSON_OBJECT,
+} cwist_json_type_t;
+
+struct cwist_http_request;
+struct json_chunk;
+
+typedef struct cwist_json_doc {
+  const char *json;
+  size_t len;
+  uint32_t *tokens;       // byte offset of each token: { } [ ] : , opening quote, scalar start
+  uint32_t *close;        // for '{' / '[' tokens: position of the matching closer
+  size_t count;
+  const cwist_allocator *allocator;
+  struct json_chunk *chunks;   // strings handed out by cwist_json_get_string
+} cwist_json_doc;
+
+// A position in a document; copy freely. Lookups on a missing value yield
+// missing values, so chains need one check at the end.
+typedef struct cwist_json_value {
+  cwist_json_doc *doc;
+  uint32_t pos;
+} cwist_json_value;
+
+typedef struct cwist_json_iter {
+  cwist_json_value container;
+  uint32_t pos;           // next member / element, or the closer when done
+} cwist_json_iter;
+
+// Indexes json (UTF-8 checked, structure validated; scalars are checked on access).
+// allocator NULL uses the process default.
+cwist_error_t cwist_json_doc_parse(cwist_json_doc *doc, cwist_sview json, const cwist_allocator *allocator);
+// Parses req->body with the request's allocator.
+cwist_error_t cwist_http_request_json(struct cwist_http_request *req, cwist_json_doc *doc);
+void cwist_json_doc_release(cwist_json_doc *doc);
+
+cwist_json_value cwist_json_root(cwist_json_doc *doc);
+cwist_json_type_t cwist_json_type(cwist_json_value value);
+static inline bool cwist_json_exists(cwist_json_value value) { return value.doc != NULL; }
+
+// Object member by key (first match), array element by index.
+cwist_json_value cwist_json_get(cwist_json_value object, const char *key);
+cwist_json_value cwist_json_get_view(cwist_json_value object, cwist_sview key);
+cwist_json_value cwist_json_at(cwist_json_value array, size_t index);
+size_t cwist_json_size(cwist_json_value container); // members or elements, 0 for scalars
+
+// Walks an object's members or an array's elements in order. raw_key (may be
+// NULL) is the key still escaped as written; it is empty for arrays.
+cwist_json_iter cwist_json_iterate(cwist_json_value container);
+bool cwist_json_iter_next(cwist_json_iter *iter, cwist_sview *raw_key, cwist_json_value *value);
+
+// Each returns false on a type mismatch or out-of-range number.
+bool cwist_json_get_int64(cwist_json_value value, int64_t *out);
+bool cwist_json_get_uint64(cwist_json_value value, uint64_t *out);
+bool cwist_json_get_double(cwist_json_value value, double *out);
+bool cwist_json_get_bool(cwist_json_value value, bool *out);
+bool cwist_json_is_null(cwist_json_value value);
+// String contents between the quotes, escapes untouched (no allocation).
+cwist_sview cwist_json_raw_string(cwist_json_value value);
+// Unescaped, NUL-terminated copy owned by the document; NULL on mismatch or
+// a bad escape. Strings without escapes still copy (the text is not terminated).
+const char *cwist_json_get_string(cwist_json_value value, size_t *len);
+// The value's exact source text (containers included).
+cwist_sview cwist_json_value_text(cwist_json_value value);
+
+// cJSON tree of value for code written against cJSON; nodes come from cJSON's
+// allocation hooks (the request arena inside session_arena_cjson_begin) and
+// are released with cJSON_Delete as usual.
+cJSON *cwist_json_to_cjson(cwist_json_value value);
+
+#endif
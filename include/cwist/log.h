@@ -0,0 +1,60 @@
+#ifndef __CWIST_LOG_H__
+#define __CWIST_LOG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Asynchronous logger.
+ * Each thread owns a single-producer/single-consumer ring of fixed-size binary
+ * records (timestamp, level, format, raw arguments). cwist_log never formats,
+ * never writes and never takes a lock after the thread's first call; when the
+ * ring is full the record is dropped and counted. A background thread drains
+ * every ring, formats the records and writes them in batches.
+ *
+ * The format string is the record's format id and must have static storage
+ * (a literal). %s arguments are copied into the record (up to
+ * CWIST_LOG_TEXT_MAX bytes in total, truncated beyond that); all other
+ * arguments are stored by value. Supported conversions: d i u x X o c p s
+ * e f g a (with flags, width, precision and length modifiers; no '*' or %n).
+ *
+ * Before cwist_log_init (and in a forked child) records are formatted and
+ * written to stderr synchronously.
+ */
+
+#define CWIST_LOG_MAX_ARGS 6
+#define CWIST_LOG_TEXT_MAX 56
+
+typedef enum cwist_log_level_t {
+    CWIST_LOG_DEBUG,
+    CWIST_LOG_INFO,
+    CWIST_LOG_WARN,
+    CWIST_LOG_ERROR,
+} cwist_log_level_t;
+
+typedef struct cwist_log_config {
+    const char *path;              // appended to; NULL writes to stdout
+    size_t ring_records;           // per thread, rounded up to a power of two (default 1024)
+    unsigned flush_interval_ms;    // drain period (default 10)
+    cwist_log_level_t min_level;   // records below this are discarded at the call site
+} cwist_log_config;
+
+typedef struct cwist_log_stats {
+    uint64_t written;   // records formatted and handed to write()
+    uint64_t dropped;   // records lost to full rings
+} cwist_log_stats;
+
+// NULL config uses the defaults. Returns false if already running or the
+// file/thread cannot be set up.
+bool cwist_log_init(const cwist_log_config *config);
+// Drains everything, stops the writer thread and closes the file.
+void cwist_log_shutdown(void);
+
+void cwist_log(cwist_log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+// Synchronously drains all rings (e.g. before exit or in tests).
+void cwist_log_flush(void);
+void cwist_log_get_stats(cwist_log_stats *stats);
+const char *cwist_log_level_name(cwist_log_level_t level);
+
+#endif
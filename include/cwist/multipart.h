@@ -0,0 +1,71 @@
+#ifndef __CWIST_MULTIPART_H__
+#define __CWIST_MULTIPART_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/sview.h>
+
+/*
+ * Incremental multipart/form-data parser (RFC 7578). Feed it the body in
+ * whatever pieces it arrives; part data is handed out as views into the
+ * fed buffer, so a part is never buffered whole. Only the part headers
+ * (bounded by CWIST_MULTIPART_HEADER_MAX) and a partial boundary at the
+ * end of a feed are copied.
+ * should be used in this form:
+ * cwist_sview boundary;
+ * cwist_multipart_boundary(cwist_http_request_header_view(req, "Content-Type"), &boundary);
+ * cwist_multipart_parser_init(&parser, boundary, &handlers, ctx);
+ * cwist_body_reader_stream(&reader, cwist_multipart_on_body, &parser);
+ * parser.status == CWIST_MULTIPART_DONE
+ */
+
+#define CWIST_MULTIPART_BOUNDARY_MAX 70     // RFC 2046
+#define CWIST_MULTIPART_HEADER_MAX 8192     // one part's header block
+
+typedef enum cwist_multipart_status_t {
+  CWIST_MULTIPART_NEED_MORE,
+  CWIST_MULTIPART_DONE,        // closing boundary seen; the epilogue is ignored
+  CWIST_MULTIPART_MALFORMED,
+  CWIST_MULTIPART_ABORTED,     // a handler returned nonzero
+} cwist_multipart_status_t;
+
+typedef struct cwist_multipart_part {
+  cwist_sview name;            // Content-Disposition name
+  cwist_sview filename;        // ptr == NULL when not a file
+  cwist_sview content_type;    // ptr == NULL when absent
+  cwist_sview headers;         // the raw header block
+} cwist_multipart_part;
+
+// Views passed to the handlers are valid only during the call.
+// Each returns nonzero to stop parsing.
+typedef struct cwist_multipart_handlers {
+  int (*on_part_begin)(void *ctx, const cwist_multipart_part *part);
+  int (*on_part_data)(void *ctx, const char *data, size_t len);
+  int (*on_part_end)(void *ctx);
+} cwist_multipart_handlers;
+
+typedef struct cwist_multipart_parser {
+  cwist_multipart_status_t status;
+  int state;
+  const cwist_multipart_handlers *handlers;
+  void *ctx;
+  char delimiter[4 + CWIST_MULTIPART_BOUNDARY_MAX]; // "\r\n--" boundary
+  size_t delimiter_len;
+  size_t held;                 // delimiter prefix seen at the end of the last feed
+  size_t header_len;
+  char headers[CWIST_MULTIPART_HEADER_MAX];
+} cwist_multipart_parser;
+
+// Extracts the boundary parameter of a multipart/form-data Content-Type.
+bool cwist_multipart_boundary(cwist_sview content_type, cwist_sview *boundary);
+
+// Fails with EINVAL for an empty or over-long boundary.
+cwist_error_t cwist_multipart_parser_init(cwist_multipart_parser *parser, cwist_sview boundary,
+                                          const cwist_multipart_handlers *handlers, void *ctx);
+// Consumes all of data unless the result is MALFORMED or ABORTED, which stick.
+cwist_multipart_status_t cwist_multipart_feed(cwist_multipart_parser *parser, const char *data, size_t len);
+// cwist_chunk_handler adapter for cwist_body_reader_stream; ctx is the parser.
+int cwist_multipart_on_body(void *ctx, const char *data, size_t len);
+
+#endif
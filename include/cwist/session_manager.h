@@ -1,18 +1,38 @@
 #ifndef cwist_session_manager_h
 #define cwist_session_manager_h
 
+#include <cwist/allocator.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+// Payload is reclaimed through the epoch scheme instead of immediately when
+// its count drops to zero, so epoch readers may borrow it without a reference.
+// Only for session_shared_alloc_ex/_with: the block reserves its limbo link.
+#define SESSION_SHARED_DEFERRED 0x1u
+
 struct session_rc_header {
-    uint32_t ref_count;
+    _Atomic uint32_t ref_count;
+    uint32_t flags;
     void (*destructor)(void *);
+    const cwist_allocator *allocator;
+} __attribute__((aligned(16)));
+
+// Cleanup hook for arena objects that own something outside the arena
+// (fds, shared refs, ...). Nodes live in the arena itself.
+struct session_arena_destructor {
+    void (*fn)(void *);
+    void *ctx;
+    struct session_arena_destructor *next;
 };
 
 struct session_arena {
     uint8_t *buffer;
     size_t capacity;
     size_t offset;
+    struct session_arena_destructor *destructors; // run LIFO on reset
+    cwist_allocator allocator;  // bump allocator view; free is a no-op
 };
 
 struct session_manager {
@@ -22,11 +42,41 @@ struct session_manager {
 void session_arena_init(struct session_arena *arena, uint8_t *buffer, size_t capacity);
 void *session_arena_alloc(struct session_arena *arena, size_t size);
 void session_arena_reset(struct session_arena *arena);
+int session_arena_register_destructor(struct session_arena *arena, void (*fn)(void *), void *ctx);
+const cwist_allocator *session_arena_allocator(struct session_arena *arena);
+// The arena behind an allocator from session_arena_allocator, NULL for any other.
+struct session_arena *session_arena_from_allocator(const cwist_allocator *allocator);
+
+// Binds cJSON on the calling thread to the arena until the matching end:
+// nodes and printed strings cost a bump, cJSON_Delete of them does nothing,
+// and the next reset drops them with the request. Other threads, and trees
+// built outside the scope, keep the process-wide hooks. Trees made inside
+// must not outlive the reset; deleting them after the end is fine on the
+// same thread. Scopes nest; end them in reverse order.
+struct session_cjson_scope {
+    cwist_cjson_binding previous;
+};
+
+void session_arena_cjson_begin(struct session_cjson_scope *scope, struct session_arena *arena);
+void session_arena_cjson_end(struct session_cjson_scope *scope);
 
 void session_rc_init(struct session_rc_header *header, void (*destructor)(void *));
 void *session_shared_alloc(size_t payload_size, void (*destructor)(void *));
+void *session_shared_alloc_ex(size_t payload_size, void (*destructor)(void *), uint32_t flags);
+void *session_shared_alloc_with(const cwist_allocator *allocator, size_t payload_size, void (*destructor)(void *), uint32_t flags);
 void session_shared_inc(void *payload);
+bool session_shared_try_inc(void *payload); // fails once the count reached zero
 void session_shared_dec(void *payload);
+uint32_t session_shared_count(void *payload);
+
+// Epoch-based reclamation for SESSION_SHARED_DEFERRED payloads.
+// Between enter and exit a thread may dereference deferred payloads it found
+// through a shared structure without touching their ref counts; they are not
+// freed until every thread that could have seen them has left its epoch.
+// enter returns false if no reader slot is left (use inc/dec instead).
+bool session_epoch_enter(void);
+void session_epoch_exit(void);
+void session_epoch_collect(void);
 
 void session_manager_init(struct session_manager *manager, uint8_t *buffer, size_t capacity);
 void session_manager_reset(struct session_manager *manager);
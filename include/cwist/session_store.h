@@ -0,0 +1,59 @@
+#ifndef cwist_session_store_h
+#define cwist_session_store_h
+
+#include <cwist/allocator.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Concurrent session lookup by token.
+ *
+ * Payloads come from session_shared_alloc; the store holds one reference per
+ * entry. Keys are split over power-of-two shards, each with its own rwlock,
+ * so lookups only contend with writers of the same shard.
+ * Idle sessions expire after ttl_seconds (sliding: every hit pushes the
+ * deadline). Expiry is driven by a per-shard timer wheel, so a sweep only
+ * touches entries whose slot came due. When memory_cap is set, inserts evict
+ * with CLOCK (second chance) inside the shard.
+ */
+
+struct session_store;
+
+struct session_store_config {
+    size_t shard_count;         // rounded up to a power of two, default 16
+    uint32_t ttl_seconds;       // idle timeout, 0 = never expire
+    size_t memory_cap;          // total bytes charged across shards, 0 = unlimited
+    uint32_t wheel_slots;       // one-second slots per wheel, default 256
+    uint64_t (*clock)(void);    // seconds; defaults to CLOCK_MONOTONIC
+    const cwist_allocator *allocator; // entries and buckets; NULL = process default
+};
+
+struct session_store *session_store_create(const struct session_store_config *config);
+void session_store_destroy(struct session_store *store);
+
+// Takes its own reference on payload; an existing entry for token is replaced.
+// charge is the payload size accounted against memory_cap.
+int session_store_put(struct session_store *store, const char *token, void *payload, size_t charge);
+
+// Returns the payload with a new reference (release with session_shared_dec),
+// or NULL when missing or expired. Slides the entry's TTL.
+void *session_store_get(struct session_store *store, const char *token);
+
+// Same lookup without touching the payload's ref count. Only valid for
+// SESSION_SHARED_DEFERRED payloads, between session_epoch_enter/exit.
+void *session_store_borrow(struct session_store *store, const char *token);
+
+bool session_store_remove(struct session_store *store, const char *token);
+
+// Expires every entry whose deadline is <= now. Returns how many were dropped.
+size_t session_store_sweep(struct session_store *store);
+
+size_t session_store_count(struct session_store *store);
+size_t session_store_memory_used(struct session_store *store);
+
+// Background sweeper thread calling session_store_sweep every interval_ms.
+int session_store_start_sweeper(struct session_store *store, unsigned interval_ms);
+void session_store_stop_sweeper(struct session_store *store);
+
+#endif
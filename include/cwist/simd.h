@@ -0,0 +1,58 @@
+#ifndef __CWIST_SIMD_H__
+#define __CWIST_SIMD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Byte-string kernels behind sview/sstring search, trim, case-insensitive
+ * compare, UTF-8 validation and escaping. The implementation is picked once
+ * at runtime (AVX2, SSE2 on x86, scalar elsewhere); every level gives
+ * identical results.
+ * Whitespace means the C-locale isspace set: ' ', \t, \n, \v, \f, \r.
+ */
+
+typedef enum cwist_simd_level_t {
+    CWIST_SIMD_SCALAR,
+    CWIST_SIMD_SSE2,
+    CWIST_SIMD_AVX2,
+} cwist_simd_level_t;
+
+cwist_simd_level_t cwist_simd_level(void);
+// Caps the level (tests, benchmarks); clamped to what the CPU supports.
+// Returns the level now in effect.
+cwist_simd_level_t cwist_simd_set_level(cwist_simd_level_t level);
+const char *cwist_simd_level_name(cwist_simd_level_t level);
+
+// Offset of the first match, (size_t)-1 when absent. An empty needle matches at 0.
+size_t cwist_simd_find(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len);
+// First byte that is any of set[0..set_len), (size_t)-1 when absent.
+size_t cwist_simd_find_first_of(const char *data, size_t len, const char *set, size_t set_len);
+// ASCII case-folding equality of two ranges of the same length.
+bool cwist_simd_equals_nocase(const char *left, const char *right, size_t len);
+// Number of leading whitespace bytes.
+size_t cwist_simd_skip_space(const char *data, size_t len);
+// Length left after dropping trailing whitespace.
+size_t cwist_simd_trim_space_end(const char *data, size_t len);
+
+// Well-formed UTF-8 (RFC 3629): no overlongs, surrogates or values past U+10FFFF.
+bool cwist_simd_utf8_valid(const char *data, size_t len);
+// Number of leading bytes that go into a JSON string / HTML text unescaped.
+size_t cwist_simd_json_plain(const char *data, size_t len);
+size_t cwist_simd_html_plain(const char *data, size_t len);
+
+// Per-byte classes of one 64-byte block for the JSON structural index;
+// bit i describes block[i]. op covers { } [ ] : , and space the four JSON
+// whitespace bytes. The block must be readable for all 64 bytes.
+#define CWIST_SIMD_JSON_BLOCK 64
+typedef struct cwist_simd_json_masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t space;
+} cwist_simd_json_masks;
+
+void cwist_simd_json_classify(const char *block, cwist_simd_json_masks *masks);
+
+#endif
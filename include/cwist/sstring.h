@@ -3,45 +3,106 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <cwist/err/cwist_err.h>
+#include <cwist/allocator.h>
+#include <cwist/sview.h>
+
+struct session_arena;
+
+// Strings up to this many bytes live inside the struct; longer ones go to the heap.
+#define CWIST_SSTRING_INLINE_CAP 22
 
 typedef struct cwist_sstring {
   char   *data;  // please access this data if raw handling is necessary
-  bool   is_fixed;
-  size_t size;
+                 // points at inline_buf for short strings: never copy a cwist_sstring by value
+  size_t size;   // length, excluding the terminator
+  const cwist_allocator *allocator; // storage and (for _create*) the struct itself
+  union {
+    struct {
+      char   inline_buf[CWIST_SSTRING_INLINE_CAP + 1];
+      bool   is_fixed  : 1;  // the flag byte sits past capacity, so it is valid in both modes
+      bool   is_inline : 1;
+      bool   is_shared : 1;  // data is a read-only refcounted block (copy-on-write)
+      bool   shared_in_arena : 1; // that reference is dropped by the arena's reset
+    };
+    size_t capacity; // heap storage only; use cwist_sstring_capacity()
+  };
+} cwist_sstring;
+
+// Shared method table; replaces the per-instance function pointers.
+// should be used in this form:
+// cwist_sstring str1;
+// cwist_sstring str2;
+// cwist_sstring_init(&str1);
+// cwist_sstring_init(&str2);
+// cwist_error_t err = cwist_sstring_methods.copy(&str1, &str2);
+// cwist_error_t err = cwist_sstring_methods.append(&str2, &str1);
+// ...
+typedef struct cwist_sstring_vtable {
   size_t (*get_size)(struct cwist_sstring *str);
   int     (*compare )(struct cwist_sstring *left, const struct cwist_sstring *right); // should mimic strcmp, internally use strncmp
   cwist_error_t (*copy  )(struct cwist_sstring *str, const struct cwist_sstring *from);
   cwist_error_t (*append)(struct cwist_sstring *str, const struct cwist_sstring *from);
-                                   // returns 1 on success, returns 0 on failure
-                                   // should be used in this form:
-                                   // cwist_sstring str1;
-                                   // cwist_sstring str2;
-                                   // cwist_sstring_init(&str);
-                                   // cwist_sstring_init(&str2);
-                                   // cwist_error_t err = str1.copy(&str1, &str2);
-                                   // cwist_error_t err = str2.append(&str2, &str1);
-                                   // ...
-} cwist_sstring;
+} cwist_sstring_vtable;
+
+extern const cwist_sstring_vtable cwist_sstring_methods;
 
 cwist_sstring *cwist_sstring_create(void);
+cwist_sstring *cwist_sstring_create_with(const cwist_allocator *allocator);
+cwist_sstring *cwist_sstring_create_in(struct session_arena *arena); // freed by session_arena_reset
 void cwist_sstring_destroy(cwist_sstring *str);
+void cwist_sstring_release(cwist_sstring *str); // frees storage of an _init'ed string, leaves it empty
 
 // String manipulation API
 cwist_error_t cwist_sstring_init (cwist_sstring *str);
+cwist_error_t cwist_sstring_init_with(cwist_sstring *str, const cwist_allocator *allocator);
 cwist_error_t cwist_sstring_ltrim(cwist_sstring *str);
 cwist_error_t cwist_sstring_rtrim(cwist_sstring *str);
 cwist_error_t cwist_sstring_trim(cwist_sstring *str);
-cwist_error_t cwist_sstring_change_size(cwist_sstring *str, size_t size, bool blow_data);
+cwist_error_t cwist_sstring_change_size(cwist_sstring *str, size_t size, bool blow_data); // sets the capacity, truncating with blow_data
+cwist_error_t cwist_sstring_reserve(cwist_sstring *str, size_t capacity);
+cwist_error_t cwist_sstring_shrink_to_fit(cwist_sstring *str);
+size_t cwist_sstring_capacity(const cwist_sstring *str);
 cwist_error_t cwist_sstring_assign(cwist_sstring *str, char *data);
 cwist_error_t cwist_sstring_append(cwist_sstring *str, const char *data);
 cwist_error_t cwist_sstring_append_sstring(cwist_sstring *str, const cwist_sstring *from);
+cwist_error_t cwist_sstring_assign_view(cwist_sstring *str, cwist_sview view);
+cwist_error_t cwist_sstring_append_view(cwist_sstring *str, cwist_sview view);
+cwist_sview cwist_sstring_view(const cwist_sstring *str); // borrows data; invalidated by the next write
+
+// Formatted output straight into the spare capacity (grows as needed).
+// The typed appends skip printf entirely; append_double writes fixed notation
+// with at most `precision` (0-9) fraction digits, trailing zeros dropped
+// (%.17g for non-finite values and magnitudes too large to scale exactly).
+cwist_error_t cwist_sstring_appendf(cwist_sstring *str, const char *format, ...) __attribute__((format(printf, 2, 3)));
+cwist_error_t cwist_sstring_vappendf(cwist_sstring *str, const char *format, va_list args);
+cwist_error_t cwist_sstring_append_int(cwist_sstring *str, int64_t value);
+cwist_error_t cwist_sstring_append_uint(cwist_sstring *str, uint64_t value);
+cwist_error_t cwist_sstring_append_hex(cwist_sstring *str, uint64_t value, bool uppercase);
+cwist_error_t cwist_sstring_append_double(cwist_sstring *str, double value, int precision);
+
+// Escaped appends for building JSON string literals (without the quotes) and
+// HTML text/attribute values. Bytes >= 0x80 pass through untouched, so check
+// untrusted input with cwist_sview_utf8_valid first. text must not point into str.
+cwist_error_t cwist_sstring_append_json_escaped(cwist_sstring *str, cwist_sview text);
+cwist_error_t cwist_sstring_append_html_escaped(cwist_sstring *str, cwist_sview text);
 cwist_error_t cwist_sstring_seek(cwist_sstring *str, char *substr, int location);
 cwist_error_t cwist_sstring_copy(cwist_sstring *origin, char *destination);
-cwist_error_t cwist_sstring_copy_sstring(cwist_sstring *origin, const cwist_sstring *from);
+cwist_error_t cwist_sstring_copy_sstring(cwist_sstring *origin, const cwist_sstring *from); // shares the buffer when from is shared
+
+// Copy-on-write: moves the text into an immutable refcounted block
+// (session_shared_alloc). Copies of a shared string take a reference instead
+// of copying; any write through the cwist_sstring_* API clones first.
+// Never write through ->data of a shared string.
+cwist_error_t cwist_sstring_make_shared(cwist_sstring *str);
+bool cwist_sstring_is_shared(const cwist_sstring *str);
 int cwist_sstring_compare(cwist_sstring *str, const char *compare_to);
 int cwist_sstring_compare_sstring(cwist_sstring *left, const cwist_sstring *right);
+size_t cwist_sstring_find(const cwist_sstring *str, const char *needle); // CWIST_SVIEW_NPOS when absent
+bool cwist_sstring_equals_nocase(const cwist_sstring *str, const char *other); // ASCII case folding
 size_t cwist_sstring_get_size(cwist_sstring *str);
 cwist_sstring *cwist_sstring_substr(cwist_sstring *str, int start, int length);
 
@@ -0,0 +1,60 @@
+#ifndef __CWIST_SVIEW_H__
+#define __CWIST_SVIEW_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Non-owning view of a byte range; not NUL-terminated.
+ * A view is only valid while the storage it points into is alive and unchanged
+ * (for sstrings: until the next assign/append/resize).
+ * ptr == NULL means "absent" (e.g. a missing header), as opposed to empty.
+ */
+typedef struct cwist_sview {
+  const char *ptr;
+  size_t len;
+} cwist_sview;
+
+#define CWIST_SVIEW_NPOS ((size_t)-1)
+#define CWIST_SVIEW_LIT(s) ((cwist_sview){ (s), sizeof(s) - 1 })
+
+cwist_sview cwist_sview_make(const char *ptr, size_t len);
+cwist_sview cwist_sview_from_cstr(const char *str); // NULL gives the absent view
+
+// Comparison; mimics strcmp ordering, shorter prefix sorts first
+int  cwist_sview_compare(cwist_sview left, cwist_sview right);
+int  cwist_sview_casecmp(cwist_sview left, cwist_sview right); // ASCII case folding
+bool cwist_sview_equals(cwist_sview left, cwist_sview right);
+bool cwist_sview_equals_nocase(cwist_sview left, cwist_sview right);
+bool cwist_sview_starts_with(cwist_sview view, cwist_sview prefix);
+bool cwist_sview_ends_with(cwist_sview view, cwist_sview suffix);
+
+// Search; CWIST_SVIEW_NPOS when not found. find, find_first_of, trim and
+// equals_nocase run on the vector kernels in cwist/simd.h.
+size_t cwist_sview_find(cwist_sview haystack, cwist_sview needle);
+size_t cwist_sview_find_char(cwist_sview view, char c);
+size_t cwist_sview_find_first_of(cwist_sview view, cwist_sview set); // any byte of set
+
+// Slicing; out-of-range positions are clamped
+cwist_sview cwist_sview_substr(cwist_sview view, size_t pos, size_t len);
+cwist_sview cwist_sview_ltrim(cwist_sview view);
+cwist_sview cwist_sview_rtrim(cwist_sview view);
+cwist_sview cwist_sview_trim(cwist_sview view);
+
+// Pops the text before the next delim off *rest into *token.
+// "a,,b" yields "a", "", "b"; returns false once *rest is used up.
+// should be used in this form:
+// cwist_sview rest = CWIST_SVIEW_LIT("a,b"), token;
+// while (cwist_sview_split(&rest, ',', &token)) { ... }
+bool cwist_sview_split(cwist_sview *rest, char delim, cwist_sview *token);
+
+// Well-formed UTF-8 per RFC 3629 (vectorized); the empty view is valid
+bool cwist_sview_utf8_valid(cwist_sview view);
+
+// Numeric parsing; the whole view must be consumed, overflow fails
+bool cwist_sview_to_int64(cwist_sview view, int64_t *out);
+bool cwist_sview_to_uint64(cwist_sview view, int base, uint64_t *out); // base 10 or 16
+bool cwist_sview_to_double(cwist_sview view, double *out);
+
+#endif
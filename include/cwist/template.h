@@ -0,0 +1,106 @@
+#ifndef __CWIST_TEMPLATE_H__
+#define __CWIST_TEMPLATE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <cwist/allocator.h>
+#include <cwist/err/cwist_err.h>
+#include <cwist/sstring.h>
+#include <cwist/sview.h>
+
+/*
+ * Precompiled templates: compile once at startup, render per request into an
+ * iovec list for writev. Static text is never copied; it points into the
+ * template. Dynamic values point at the caller's bytes when they need no
+ * escaping, and otherwise at an escaped copy in the output's scratch string.
+ * Tags:
+ *   {{name}}            HTML-escaped text
+ *   {{{name}}}          raw text
+ *   {{name|json}}       JSON-string-escaped text (no quotes)
+ *   {{name|int}}        arg.number in decimal
+ *   {{#name}}..{{/name}} section, rendered once per row of arg.rows
+ *   {{! comment }}      dropped
+ * Names are resolved to slot indices at compile time, so rendering does no
+ * lookups: fill an args array of cwist_template_slot_count entries.
+ * should be used in this form:
+ * static cwist_template *page;               // compiled in main()
+ * cwist_template_arg args[8] = {0};
+ * args[cwist_template_slot(page, "user")] = cwist_template_str(name);
+ * cwist_template_render(page, args, &out);
+ * cwist_http_send_response_iov(fd, res, out.iov, out.count);
+ */
+
+#define CWIST_TEMPLATE_MAX_DEPTH 16   // nested sections
+
+enum cwist_template_error_t {
+  ERR_TEMPLATE_OKAY,
+  ERR_TEMPLATE_UNCLOSED_TAG,    // "{{" without "}}"
+  ERR_TEMPLATE_BAD_NAME,        // empty name or characters outside [A-Za-z0-9_.-]
+  ERR_TEMPLATE_UNKNOWN_FILTER,  // "|x" other than json / int
+  ERR_TEMPLATE_UNBALANCED,      // {{/x}} without {{#x}}, or a section left open
+  ERR_TEMPLATE_TOO_DEEP,        // sections nested beyond CWIST_TEMPLATE_MAX_DEPTH
+};
+
+typedef struct cwist_template cwist_template;
+
+// One value per slot. Text slots read text (ptr NULL renders nothing), |int
+// slots read number, sections read rows: count rows of slot_count args each,
+// indexed by the same slot numbers.
+typedef struct cwist_template_arg {
+  cwist_sview text;
+  int64_t number;
+  const struct cwist_template_arg *rows;
+  size_t count;
+} cwist_template_arg;
+
+// The iovec list of one render. Entries point into the template, the args
+// and scratch, so all three must stay unchanged until the list is sent.
+typedef struct cwist_template_output {
+  struct iovec *iov;
+  size_t count;
+  size_t capacity;
+  size_t total;            // bytes across iov
+  cwist_sstring *scratch;  // escaped values and numbers
+  size_t *scratch_at;      // per entry: offset into scratch, SIZE_MAX for borrowed bytes
+  const cwist_allocator *allocator;
+} cwist_template_output;
+
+// source is copied; *error_at (may be NULL) gets the byte offset of a failure.
+cwist_error_t cwist_template_compile(cwist_sview source, cwist_template **out, size_t *error_at);
+void cwist_template_destroy(cwist_template *tpl);
+
+// Slot index for a name, -1 when the template has none.
+int cwist_template_slot(const cwist_template *tpl, const char *name);
+size_t cwist_template_slot_count(const cwist_template *tpl);
+
+void cwist_template_output_init(cwist_template_output *out, const cwist_allocator *allocator); // NULL = default
+void cwist_template_output_reset(cwist_template_output *out); // keeps capacity for the next render
+void cwist_template_output_destroy(cwist_template_output *out);
+
+// Appends to out (after earlier renders), so pages can be built from parts.
+cwist_error_t cwist_template_render(const cwist_template *tpl, const cwist_template_arg *args, cwist_template_output *out);
+// Concatenated copy, for callers that want one buffer (tests, caches).
+cwist_error_t cwist_template_output_flatten(const cwist_template_output *out, cwist_sstring *dst);
+
+static inline cwist_template_arg cwist_template_view(cwist_sview text) {
+  cwist_template_arg arg = { text, 0, NULL, 0 };
+  return arg;
+}
+
+static inline cwist_template_arg cwist_template_str(const char *text) {
+  return cwist_template_view(cwist_sview_from_cstr(text));
+}
+
+static inline cwist_template_arg cwist_template_int(int64_t number) {
+  cwist_template_arg arg = { { NULL, 0 }, number, NULL, 0 };
+  return arg;
+}
+
+static inline cwist_template_arg cwist_template_rows(const cwist_template_arg *rows, size_t count) {
+  cwist_template_arg arg = { { NULL, 0 }, 0, rows, count };
+  return arg;
+}
+
+#endif
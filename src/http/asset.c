@@ -0,0 +1,115 @@
+#include <cwist/asset.h>
+#include <cwist/http.h>
+#include <cwist/compress.h>
+#include <cwist/conditional.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+const cwist_asset *cwist_asset_find(const cwist_asset *assets, size_t count, cwist_sview path) {
+    if (!assets || !path.ptr) return NULL;
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = cwist_sview_compare(cwist_sview_from_cstr(assets[mid].path), path);
+        if (cmp == 0) return &assets[mid];
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+static cwist_error_t asset_write(int client_fd, const cwist_asset *asset, bool gzip, bool with_body) {
+    if (client_fd < 0 || !asset) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+
+    bool zipped = gzip && asset->gzip;
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)(zipped ? asset->gzip_head : asset->head);
+    iov[0].iov_len = zipped ? asset->gzip_head_len : asset->head_len;
+    iov[1].iov_base = (void *)(zipped ? asset->gzip : asset->body);
+    iov[1].iov_len = with_body ? (zipped ? asset->gzip_len : asset->body_len) : 0;
+    return cwist_writev_all(client_fd, iov, 2);
+}
+
+cwist_error_t cwist_asset_send(int client_fd, const cwist_asset *asset, bool gzip) {
+    return asset_write(client_fd, asset, gzip, true);
+}
+
+cwist_error_t cwist_asset_send_head(int client_fd, const cwist_asset *asset, bool gzip) {
+    return asset_write(client_fd, asset, gzip, false);
+}
+
+static cwist_error_t asset_write_head(int client_fd, const char *head, size_t len) {
+    struct iovec iov = { (void *)head, len };
+    return cwist_writev_all(client_fd, &iov, 1);
+}
+
+// 206 for [offset, offset + length) of the identity body. The head is the
+// only part formatted per request; the slice is sent from the table.
+static cwist_error_t asset_write_range(int client_fd, const cwist_asset *asset, uint64_t offset, uint64_t length) {
+    char head[1024];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 206 Partial Content\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %llu\r\n"
+                     "Content-Range: bytes %llu-%llu/%zu\r\n"
+                     "ETag: %s\r\n"
+                     "Cache-Control: %s\r\n"
+                     "%s"
+                     "\r\n",
+                     asset->content_type, (unsigned long long)length, (unsigned long long)offset,
+                     (unsigned long long)(offset + length - 1), asset->body_len, asset->etag,
+                     asset->cache_control ? asset->cache_control : "no-cache",
+                     asset->gzip ? "Vary: Accept-Encoding\r\n" : "");
+    if (n < 0 || (size_t)n >= sizeof(head)) return asset_write(client_fd, asset, false, true);
+
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = (size_t)n;
+    iov[1].iov_base = (void *)(asset->body + offset);
+    iov[1].iov_len = (size_t)length;
+    return cwist_writev_all(client_fd, iov, 2);
+}
+
+cwist_error_t cwist_asset_serve(int client_fd, const cwist_asset *asset, const cwist_http_request *req) {
+    static const char failed[] = "HTTP/1.1 412 Precondition Failed\r\nContent-Length: 0\r\n\r\n";
+    if (client_fd < 0 || !asset || !req) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+
+    // A range is a slice of the identity body, so a Range request never gets gzip.
+    bool zipped = asset->gzip && !cwist_http_request_header_view(req, "Range").ptr && cwist_http_accepts_gzip(req);
+    const char *etag = zipped ? asset->gzip_etag : asset->etag;
+
+    switch (cwist_http_evaluate_preconditions(req, cwist_sview_from_cstr(etag), 0)) {
+        case CWIST_PRECONDITION_NOT_MODIFIED:
+            return zipped ? asset_write_head(client_fd, asset->gzip_not_modified, asset->gzip_not_modified_len)
+                          : asset_write_head(client_fd, asset->not_modified, asset->not_modified_len);
+        case CWIST_PRECONDITION_FAILED:
+            return asset_write_head(client_fd, failed, sizeof(failed) - 1);
+        default:
+            break;
+    }
+
+    if (!zipped) {
+        uint64_t offset, length;
+        char head[128];
+        int n;
+        switch (cwist_http_request_range(req, asset->body_len, cwist_sview_from_cstr(asset->etag), 0, &offset, &length)) {
+            case CWIST_RANGE_OK:
+                return asset_write_range(client_fd, asset, offset, length);
+            case CWIST_RANGE_UNSATISFIABLE:
+                n = snprintf(head, sizeof(head),
+                             "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%zu\r\nContent-Length: 0\r\n\r\n",
+                             asset->body_len);
+                return asset_write_head(client_fd, head, (size_t)n);
+            default:
+                break;
+        }
+    }
+    return asset_write(client_fd, asset, zipped, req->method != CWIST_HTTP_HEAD);
+}
+
+bool cwist_http_accepts_gzip(const cwist_http_request *req) {
+    return cwist_http_encoding_q(req, "gzip") > 0;
+}
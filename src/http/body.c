@@ -0,0 +1,330 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // splice(2)
+#endif
+#include <cwist/body.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define BODY_SPLICE_MAX (1 << 16) // one pipe's worth per splice
+
+static cwist_error_t body_status(int code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, code);
+}
+
+static cwist_error_t body_fail(cwist_body_reader *reader, int code) {
+    reader->error = code;
+    return body_status(code);
+}
+
+static bool body_content_length(cwist_sview value, uint64_t *out) {
+    value = cwist_sview_trim(value);
+    if (value.len == 0) return false;
+    uint64_t n = 0;
+    for (size_t i = 0; i < value.len; i++) {
+        char c = value.ptr[i];
+        if (c < '0' || c > '9') return false;
+        if (n > (UINT64_MAX - (uint64_t)(c - '0')) / 10) return false;
+        n = n * 10 + (uint64_t)(c - '0');
+    }
+    *out = n;
+    return true;
+}
+
+cwist_error_t cwist_body_reader_init(cwist_body_reader *reader, int fd, const cwist_http_request *req,
+                                     const char *extra, size_t extra_len, uint64_t limit) {
+    if (!reader || !req || (extra_len > 0 && !extra)) return body_status(EINVAL);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = fd;
+    reader->pending = extra;
+    reader->pending_len = extra_len;
+    reader->limit = limit;
+
+    cwist_sview encoding = cwist_http_request_header_view(req, "Transfer-Encoding");
+    if (encoding.ptr) {
+        if (!cwist_http_request_is_chunked(req)) return body_fail(reader, ENOSYS);
+        reader->chunked = true;
+        cwist_chunked_decoder_init(&reader->decoder, limit);
+        return body_status(0);
+    }
+
+    cwist_sview length = cwist_http_request_header_view(req, "Content-Length");
+    if (length.ptr && !body_content_length(length, &reader->remaining)) return body_fail(reader, EINVAL);
+    if (limit && reader->remaining > limit) return body_fail(reader, EFBIG);
+    reader->done = reader->remaining == 0;
+    return body_status(0);
+}
+
+// Reads from the socket into raw when nothing is pending. Content-Length
+// reads stop at the end of the body so a pipelined request stays unread.
+static cwist_error_t body_fill(cwist_body_reader *reader) {
+    if (reader->pending_len > 0) return body_status(0);
+    size_t want = sizeof(reader->raw);
+    if (!reader->chunked && reader->remaining < want) want = (size_t)reader->remaining;
+    ssize_t n;
+    do {
+        n = recv(reader->fd, reader->raw, want, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return body_fail(reader, errno);
+    if (n == 0) return body_fail(reader, ECONNRESET);
+    reader->pending = reader->raw;
+    reader->pending_len = (size_t)n;
+    return body_status(0);
+}
+
+static void body_consume(cwist_body_reader *reader, size_t n) {
+    reader->pending += n;
+    reader->pending_len -= n;
+}
+
+// Runs the chunked decoder over what is pending, passing data to on_data.
+static cwist_error_t body_decode(cwist_body_reader *reader, size_t feed, cwist_chunk_handler on_data, void *ctx) {
+    size_t consumed = 0;
+    cwist_chunked_status_t status =
+        cwist_chunked_decode(&reader->decoder, reader->pending, feed, &consumed, on_data, ctx);
+    body_consume(reader, consumed);
+    switch (status) {
+        case CWIST_CHUNKED_DONE:
+            reader->done = true;
+            return body_status(0);
+        case CWIST_CHUNKED_NEED_MORE:
+            return body_status(0);
+        case CWIST_CHUNKED_TOO_LARGE:
+            return body_fail(reader, EFBIG);
+        case CWIST_CHUNKED_ABORTED:
+            return body_fail(reader, ECANCELED);
+        default:
+            return body_fail(reader, EBADMSG);
+    }
+}
+
+struct body_sink {
+    char *buf;
+    size_t len;
+};
+
+static int body_copy(void *ctx, const char *data, size_t len) {
+    struct body_sink *sink = ctx;
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    return 0;
+}
+
+cwist_error_t cwist_body_read(cwist_body_reader *reader, void *buf, size_t cap, size_t *out_len) {
+    if (out_len) *out_len = 0;
+    if (!reader || !out_len || (cap > 0 && !buf)) return body_status(EINVAL);
+    if (reader->error) return body_status(reader->error);
+    if (reader->done || cap == 0) return body_status(0);
+
+    if (!reader->chunked) {
+        size_t want = cap;
+        if (reader->remaining < want) want = (size_t)reader->remaining;
+        size_t n;
+        if (reader->pending_len > 0) {
+            n = reader->pending_len < want ? reader->pending_len : want;
+            memcpy(buf, reader->pending, n);
+            body_consume(reader, n);
+        } else {
+            // Straight into the caller's buffer; nothing to copy.
+            ssize_t got;
+            do {
+                got = recv(reader->fd, buf, want, 0);
+            } while (got < 0 && errno == EINTR);
+            if (got < 0) return body_fail(reader, errno);
+            if (got == 0) return body_fail(reader, ECONNRESET);
+            n = (size_t)got;
+        }
+        reader->remaining -= n;
+        reader->received += n;
+        reader->done = reader->remaining == 0;
+        *out_len = n;
+        return body_status(0);
+    }
+
+    // Decoded bytes never outnumber the encoded ones, so feeding at most cap
+    // bytes keeps the output within buf.
+    struct body_sink sink = { buf, 0 };
+    while (sink.len == 0 && !reader->done) {
+        cwist_error_t err = body_fill(reader);
+        if (cwist_error_code(err) != 0) return err;
+        size_t feed = reader->pending_len < cap ? reader->pending_len : cap;
+        err = body_decode(reader, feed, body_copy, &sink);
+        if (cwist_error_code(err) != 0 && sink.len == 0) return err;
+        if (cwist_error_code(err) != 0) break;   // data first; the sticky error comes next call
+    }
+    reader->received += sink.len;
+    *out_len = sink.len;
+    return body_status(0);
+}
+
+struct body_counter {
+    cwist_chunk_handler on_body;
+    void *ctx;
+    uint64_t *received;
+};
+
+static int body_count(void *ctx, const char *data, size_t len) {
+    struct body_counter *counter = ctx;
+    *counter->received += len;
+    return counter->on_body(counter->ctx, data, len);
+}
+
+cwist_error_t cwist_body_reader_stream(cwist_body_reader *reader, cwist_chunk_handler on_body, void *ctx) {
+    if (!reader || !on_body) return body_status(EINVAL);
+    if (reader->error) return body_status(reader->error);
+
+    // on_body sees the socket reads (or the caller's extra bytes) in place.
+    struct body_counter counter = { on_body, ctx, &reader->received };
+    while (!reader->done) {
+        cwist_error_t err = body_fill(reader);
+        if (cwist_error_code(err) != 0) return err;
+        if (reader->chunked) {
+            err = body_decode(reader, reader->pending_len, body_count, &counter);
+            if (cwist_error_code(err) != 0) return err;
+            continue;
+        }
+        size_t n = reader->pending_len;
+        if (reader->remaining < n) n = (size_t)reader->remaining;
+        const char *data = reader->pending;
+        body_consume(reader, n);
+        reader->remaining -= n;
+        reader->done = reader->remaining == 0;
+        if (body_count(&counter, data, n) != 0) return body_fail(reader, ECANCELED);
+    }
+    return body_status(0);
+}
+
+struct body_file {
+    int fd;
+    uint64_t written;
+    int error;
+};
+
+static int body_write_all(void *ctx, const char *data, size_t len) {
+    struct body_file *file = ctx;
+    while (len > 0) {
+        ssize_t n = write(file->fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            file->error = n < 0 ? errno : EIO;
+            return 1;
+        }
+        data += n;
+        len -= (size_t)n;
+        file->written += (uint64_t)n;
+    }
+    return 0;
+}
+
+#ifdef __linux__
+// Copies len bytes already taken off the socket out of the pipe.
+static void body_pipe_drain(int pipe_in, size_t len, struct body_file *file) {
+    char buf[4096];
+    while (len > 0 && !file->error) {
+        ssize_t n = read(pipe_in, buf, len < sizeof(buf) ? len : sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            file->error = n < 0 ? errno : EIO;
+            break;
+        }
+        body_write_all(file, buf, (size_t)n);
+        len -= (size_t)n;
+    }
+}
+
+// Moves the remaining Content-Length bytes socket -> pipe -> file in the
+// kernel. Returns false when splice is unsupported for these fds; anything
+// already in the pipe has been written, and the copy path takes the rest.
+static bool body_splice(cwist_body_reader *reader, struct body_file *file) {
+    int pipefd[2];
+    if (pipe(pipefd) != 0) return false;
+    bool spliced = false;
+    bool out_spliced = false;
+
+    while (reader->remaining > 0) {
+        size_t want = reader->remaining < BODY_SPLICE_MAX ? (size_t)reader->remaining : BODY_SPLICE_MAX;
+        ssize_t in = splice(reader->fd, NULL, pipefd[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in < 0 && errno == EINTR) continue;
+        if (in < 0 && !spliced && (errno == EINVAL || errno == ENOSYS)) break;
+        spliced = true;
+        if (in <= 0) {
+            file->error = in < 0 ? errno : ECONNRESET;
+            break;
+        }
+        reader->remaining -= (uint64_t)in;
+        reader->received += (uint64_t)in;
+        while (in > 0) {
+            ssize_t out = splice(pipefd[0], NULL, file->fd, NULL, (size_t)in, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out < 0 && errno == EINTR) continue;
+            if (out < 0 && !out_spliced && (errno == EINVAL || errno == ENOSYS)) {
+                // The output side cannot take splice: hand over to copying.
+                body_pipe_drain(pipefd[0], (size_t)in, file);
+                spliced = file->error != 0;
+                goto done;
+            }
+            out_spliced = true;
+            if (out <= 0) {
+                file->error = out < 0 ? errno : EIO;
+                break;
+            }
+            in -= out;
+            file->written += (uint64_t)out;
+        }
+        if (file->error) break;
+    }
+
+done:
+    close(pipefd[0]);
+    close(pipefd[1]);
+    if (!file->error) reader->done = reader->remaining == 0;
+    return spliced;
+}
+#endif
+
+cwist_error_t cwist_body_reader_splice(cwist_body_reader *reader, int out_fd, uint64_t *written) {
+    if (written) *written = 0;
+    if (!reader || out_fd < 0) return body_status(EINVAL);
+    if (reader->error) return body_status(reader->error);
+
+    struct body_file file = { out_fd, 0, 0 };
+#ifdef __linux__
+    // splice refuses O_APPEND outputs; those take the copy path.
+    int flags = fcntl(out_fd, F_GETFL);
+    if (!reader->chunked && flags >= 0 && !(flags & O_APPEND)) {
+        // Whatever arrived with the headers goes out first.
+        size_t n = reader->pending_len;
+        if (reader->remaining < n) n = (size_t)reader->remaining;
+        if (n > 0) {
+            if (body_write_all(&file, reader->pending, n) != 0) {
+                if (written) *written = file.written;
+                return body_fail(reader, file.error);
+            }
+            body_consume(reader, n);
+            reader->remaining -= n;
+            reader->received += n;
+        }
+        if (reader->remaining == 0) reader->done = true;
+        if (reader->done || body_splice(reader, &file)) {
+            if (written) *written = file.written;
+            return file.error ? body_fail(reader, file.error) : body_status(0);
+        }
+    }
+#endif
+    cwist_error_t err = cwist_body_reader_stream(reader, body_write_all, &file);
+    if (written) *written = file.written;
+    if (file.error) {
+        reader->error = file.error;
+        return body_status(file.error);
+    }
+    return err;
+}
+
+const char *cwist_body_reader_leftover(const cwist_body_reader *reader, size_t *len) {
+    if (len) *len = 0;
+    if (!reader || !reader->done) return NULL;
+    if (len) *len = reader->pending_len;
+    return reader->pending;
+}
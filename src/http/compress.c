@@ -0,0 +1,451 @@
+#include <cwist/compress.h>
+#include <cwist/http.h>
+#include <cwist/hash.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define COMPRESS_CACHE_BUCKETS 1024
+#define COMPRESS_STREAM_CHUNK 16384
+
+static cwist_error_t compress_status(int code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, code);
+}
+
+static cwist_error_t compress_zlib_error(int rc) {
+    return compress_status(rc == Z_MEM_ERROR ? ENOMEM : EINVAL);
+}
+
+const char *cwist_encoding_name(cwist_encoding_t encoding) {
+    switch (encoding) {
+        case CWIST_ENCODING_GZIP:    return "gzip";
+        case CWIST_ENCODING_DEFLATE: return "deflate";
+        default:                     return "identity";
+    }
+}
+
+/* --- Negotiation --- */
+
+// "q=0.5" -> 500; malformed values count as 1000, as if absent.
+static int encoding_quality(cwist_sview params) {
+    cwist_sview param;
+    while (cwist_sview_split(&params, ';', &param)) {
+        param = cwist_sview_trim(param);
+        if (param.len < 2 || (param.ptr[0] != 'q' && param.ptr[0] != 'Q') || param.ptr[1] != '=') continue;
+        cwist_sview q = cwist_sview_trim(cwist_sview_substr(param, 2, param.len));
+        if (q.len == 0 || (q.ptr[0] != '0' && q.ptr[0] != '1')) return 1000;
+        int value = (q.ptr[0] - '0') * 1000;
+        int scale = 100;
+        for (size_t i = 2; i < q.len && i < 5 && q.ptr[1] == '.'; i++, scale /= 10) {
+            if (q.ptr[i] < '0' || q.ptr[i] > '9') return 1000;
+            value += (q.ptr[i] - '0') * scale;
+        }
+        return value > 1000 ? 1000 : value;
+    }
+    return 1000;
+}
+
+int cwist_http_encoding_q(const cwist_http_request *req, const char *coding) {
+    cwist_sview rest = cwist_http_request_header_view(req, "Accept-Encoding");
+    if (!rest.ptr || !coding) return 0;
+
+    cwist_sview name = cwist_sview_from_cstr(coding);
+    bool gzip = cwist_sview_equals_nocase(name, CWIST_SVIEW_LIT("gzip"));
+    int listed = -1, any = -1;
+    cwist_sview item;
+    while (cwist_sview_split(&rest, ',', &item)) {
+        size_t semi = cwist_sview_find_char(item, ';');
+        cwist_sview token = cwist_sview_trim(semi == CWIST_SVIEW_NPOS ? item : cwist_sview_substr(item, 0, semi));
+        int q = semi == CWIST_SVIEW_NPOS ? 1000 : encoding_quality(cwist_sview_substr(item, semi + 1, item.len));
+        if (cwist_sview_equals_nocase(token, name) ||
+            (gzip && cwist_sview_equals_nocase(token, CWIST_SVIEW_LIT("x-gzip")))) {
+            if (q > listed) listed = q;
+        } else if (cwist_sview_equals(token, CWIST_SVIEW_LIT("*"))) {
+            any = q;
+        }
+    }
+    if (listed >= 0) return listed;
+    return any > 0 ? any : 0;
+}
+
+cwist_encoding_t cwist_http_negotiate_encoding(const cwist_http_request *req) {
+    int gzip = cwist_http_encoding_q(req, "gzip");
+    int deflate = cwist_http_encoding_q(req, "deflate");
+    if (gzip > 0 && gzip >= deflate) return CWIST_ENCODING_GZIP;
+    if (deflate > 0) return CWIST_ENCODING_DEFLATE;
+    return CWIST_ENCODING_IDENTITY;
+}
+
+bool cwist_compress_type_ok(cwist_sview content_type) {
+    size_t semi = cwist_sview_find_char(content_type, ';');
+    cwist_sview type = cwist_sview_trim(semi == CWIST_SVIEW_NPOS ? content_type : cwist_sview_substr(content_type, 0, semi));
+    if (type.len == 0) return false;
+
+    static const cwist_sview exact[] = {
+        CWIST_SVIEW_LIT("application/json"),
+        CWIST_SVIEW_LIT("application/javascript"),
+        CWIST_SVIEW_LIT("application/xml"),
+        CWIST_SVIEW_LIT("application/wasm"),
+        CWIST_SVIEW_LIT("image/svg+xml"),
+    };
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); i++) {
+        if (cwist_sview_equals_nocase(type, exact[i])) return true;
+    }
+    if (type.len > 5 && cwist_sview_equals_nocase(cwist_sview_substr(type, 0, 5), CWIST_SVIEW_LIT("text/"))) return true;
+    // application/problem+json, application/atom+xml, ...
+    return (type.len > 5 && cwist_sview_equals_nocase(cwist_sview_substr(type, type.len - 5, 5), CWIST_SVIEW_LIT("+json"))) ||
+           (type.len > 4 && cwist_sview_equals_nocase(cwist_sview_substr(type, type.len - 4, 4), CWIST_SVIEW_LIT("+xml")));
+}
+
+/* --- zlib --- */
+
+static int compress_level(int level) {
+    if (level <= 0) return CWIST_COMPRESS_LEVEL;
+    return level > 9 ? 9 : level;
+}
+
+static int compress_init(z_stream *z, cwist_encoding_t encoding, int level) {
+    memset(z, 0, sizeof(*z));
+    int window = encoding == CWIST_ENCODING_GZIP ? 15 + 16 : 15;   // +16 selects the gzip wrapper
+    return deflateInit2(z, compress_level(level), Z_DEFLATED, window, 8, Z_DEFAULT_STRATEGY);
+}
+
+// Runs deflate with flush until it has nothing more to emit, growing out as needed.
+static cwist_error_t compress_pump(z_stream *z, int flush, cwist_sstring *out) {
+    int rc;
+    do {
+        size_t room = z->avail_in / 2 + 64 > COMPRESS_STREAM_CHUNK ? z->avail_in / 2 + 64 : COMPRESS_STREAM_CHUNK;
+        cwist_error_t err = cwist_sstring_reserve(out, out->size + room + 1);
+        if (cwist_error_code(err) != 0) return err;
+
+        z->next_out = (Bytef *)out->data + out->size;
+        z->avail_out = (uInt)room;
+        rc = deflate(z, flush);
+        if (rc == Z_STREAM_ERROR) return compress_zlib_error(rc);
+        out->size += room - z->avail_out;
+        out->data[out->size] = '\0';
+    } while (z->avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+    return compress_status(0);
+}
+
+cwist_error_t cwist_compress(cwist_encoding_t encoding, int level, cwist_sview data, cwist_sstring *out) {
+    if (!out || encoding == CWIST_ENCODING_IDENTITY || (data.len && !data.ptr)) return compress_status(EINVAL);
+
+    z_stream z;
+    int rc = compress_init(&z, encoding, level);
+    if (rc != Z_OK) return compress_zlib_error(rc);
+
+    // deflateBound is exact enough that one deflate call usually finishes.
+    cwist_error_t err = cwist_sstring_reserve(out, out->size + deflateBound(&z, (uLong)data.len) + 1);
+    if (cwist_error_code(err) == 0) {
+        z.next_in = (Bytef *)data.ptr;
+        z.avail_in = (uInt)data.len;
+        err = compress_pump(&z, Z_FINISH, out);
+    }
+    deflateEnd(&z);
+    return err;
+}
+
+/* --- Variant cache --- */
+
+struct compress_cache_entry {
+    struct compress_cache_entry *hash_next;
+    struct compress_cache_entry *clock_prev;
+    struct compress_cache_entry *clock_next;
+    uint64_t hash;              // content hash, one seed
+    uint64_t check;             // second seed, so one collision is not enough
+    size_t source_len;
+    cwist_encoding_t encoding;
+    int level;
+    bool referenced;            // CLOCK second-chance bit
+    size_t len;
+    unsigned char data[];
+};
+
+struct cwist_compress_cache {
+    pthread_mutex_t lock;
+    struct compress_cache_entry *buckets[COMPRESS_CACHE_BUCKETS];
+    struct compress_cache_entry *clock_hand;
+    size_t memory_cap;
+    size_t memory_used;
+    size_t count;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t seed;
+};
+
+struct cwist_compress_cache *cwist_compress_cache_create(size_t memory_cap) {
+    struct cwist_compress_cache *cache = calloc(1, sizeof(*cache));
+    if (!cache) return NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->memory_cap = memory_cap;
+    uintptr_t addr = (uintptr_t)cache;
+    cache->seed = cwist_hash64(&addr, sizeof(addr), (uint64_t)time(NULL));
+    return cache;
+}
+
+void cwist_compress_cache_destroy(struct cwist_compress_cache *cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < COMPRESS_CACHE_BUCKETS; i++) {
+        struct compress_cache_entry *entry = cache->buckets[i];
+        while (entry) {
+            struct compress_cache_entry *next = entry->hash_next;
+            free(entry);
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static size_t cache_charge(const struct compress_cache_entry *entry) {
+    return sizeof(*entry) + entry->len;
+}
+
+static void cache_unlink(struct cwist_compress_cache *cache, struct compress_cache_entry *entry) {
+    struct compress_cache_entry **link = &cache->buckets[entry->hash & (COMPRESS_CACHE_BUCKETS - 1)];
+    while (*link && *link != entry) link = &(*link)->hash_next;
+    if (*link) *link = entry->hash_next;
+
+    if (entry->clock_next == entry) {
+        cache->clock_hand = NULL;
+    } else {
+        if (cache->clock_hand == entry) cache->clock_hand = entry->clock_next;
+        entry->clock_prev->clock_next = entry->clock_next;
+        entry->clock_next->clock_prev = entry->clock_prev;
+    }
+    cache->count--;
+    cache->memory_used -= cache_charge(entry);
+    free(entry);
+}
+
+static void cache_insert(struct cwist_compress_cache *cache, struct compress_cache_entry *entry) {
+    struct compress_cache_entry **bucket = &cache->buckets[entry->hash & (COMPRESS_CACHE_BUCKETS - 1)];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+
+    // New entries go right behind the hand so they get a full lap first.
+    if (!cache->clock_hand) {
+        entry->clock_next = entry->clock_prev = entry;
+        cache->clock_hand = entry;
+    } else {
+        struct compress_cache_entry *hand = cache->clock_hand;
+        entry->clock_next = hand;
+        entry->clock_prev = hand->clock_prev;
+        hand->clock_prev->clock_next = entry;
+        hand->clock_prev = entry;
+    }
+    cache->count++;
+    cache->memory_used += cache_charge(entry);
+}
+
+static struct compress_cache_entry *cache_find(struct cwist_compress_cache *cache, uint64_t hash, uint64_t check,
+                                               size_t source_len, cwist_encoding_t encoding, int level) {
+    struct compress_cache_entry *entry = cache->buckets[hash & (COMPRESS_CACHE_BUCKETS - 1)];
+    for (; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && entry->check == check && entry->source_len == source_len &&
+            entry->encoding == encoding && entry->level == level) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+cwist_error_t cwist_compress_cached(struct cwist_compress_cache *cache, cwist_encoding_t encoding, int level,
+                                    cwist_sview data, cwist_sstring *out) {
+    if (!cache) return cwist_compress(encoding, level, data, out);
+    if (!out || encoding == CWIST_ENCODING_IDENTITY || (data.len && !data.ptr)) return compress_status(EINVAL);
+
+    level = compress_level(level);
+    uint64_t hash = cwist_hash64(data.ptr, data.len, cache->seed);
+    uint64_t check = cwist_hash64(data.ptr, data.len, ~cache->seed);
+
+    pthread_mutex_lock(&cache->lock);
+    struct compress_cache_entry *hit = cache_find(cache, hash, check, data.len, encoding, level);
+    if (hit) {
+        hit->referenced = true;
+        cache->hits++;
+        cwist_error_t err = cwist_sstring_append_view(out, cwist_sview_make((const char *)hit->data, hit->len));
+        pthread_mutex_unlock(&cache->lock);
+        return err;
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    // Compress outside the lock; two threads missing together both insert
+    // and the second replaces the first.
+    size_t start = out->size;
+    cwist_error_t err = cwist_compress(encoding, level, data, out);
+    if (cwist_error_code(err) != 0) return err;
+
+    size_t len = out->size - start;
+    struct compress_cache_entry *entry = malloc(sizeof(*entry) + len);
+    if (!entry) return err;   // still compressed, just not cached
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = hash;
+    entry->check = check;
+    entry->source_len = data.len;
+    entry->encoding = encoding;
+    entry->level = level;
+    entry->len = len;
+    memcpy(entry->data, out->data + start, len);
+
+    pthread_mutex_lock(&cache->lock);
+    struct compress_cache_entry *old = cache_find(cache, hash, check, data.len, encoding, level);
+    if (old) cache_unlink(cache, old);
+    if (cache->memory_cap && cache_charge(entry) > cache->memory_cap) {
+        free(entry);
+    } else {
+        size_t budget = cache->count * 2; // every entry gets at most one second chance
+        while (cache->clock_hand && cache->memory_cap &&
+               cache->memory_used + cache_charge(entry) > cache->memory_cap && budget-- > 0) {
+            struct compress_cache_entry *victim = cache->clock_hand;
+            if (victim->referenced) {
+                victim->referenced = false;
+                cache->clock_hand = victim->clock_next;
+                continue;
+            }
+            cache_unlink(cache, victim);
+        }
+        cache_insert(cache, entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return err;
+}
+
+cwist_compress_cache_stats cwist_compress_cache_stats_get(struct cwist_compress_cache *cache) {
+    cwist_compress_cache_stats stats = { 0, 0, 0, 0 };
+    if (!cache) return stats;
+    pthread_mutex_lock(&cache->lock);
+    stats.hits = cache->hits;
+    stats.misses = cache->misses;
+    stats.entries = cache->count;
+    stats.memory_used = cache->memory_used;
+    pthread_mutex_unlock(&cache->lock);
+    return stats;
+}
+
+/* --- Responses --- */
+
+static bool header_has_token(cwist_sview value, cwist_sview token) {
+    cwist_sview item;
+    while (cwist_sview_split(&value, ',', &item)) {
+        size_t eq = cwist_sview_find_char(item, '=');
+        item = cwist_sview_trim(eq == CWIST_SVIEW_NPOS ? item : cwist_sview_substr(item, 0, eq));
+        if (cwist_sview_equals_nocase(item, token)) return true;
+    }
+    return false;
+}
+
+// A strong ETag names the identity bytes; the encoded body only matches it
+// semantically, so it becomes weak (If-None-Match still compares weakly).
+static cwist_error_t compress_weaken_etag(cwist_http_response *res) {
+    for (cwist_http_header_node *curr = res->headers; curr; curr = curr->next) {
+        if (!curr->key->data || !cwist_sstring_equals_nocase(curr->key, "ETag")) continue;
+        cwist_sview etag = cwist_sstring_view(curr->value);
+        if (etag.len == 0 || etag.ptr[0] != '"') return compress_status(0);
+        cwist_sstring weak;
+        cwist_sstring_init_with(&weak, curr->value->allocator);
+        cwist_error_t err = cwist_sstring_append(&weak, "W/");
+        if (cwist_error_code(err) == 0) err = cwist_sstring_append_view(&weak, etag);
+        if (cwist_error_code(err) == 0) err = cwist_sstring_assign_view(curr->value, cwist_sstring_view(&weak));
+        cwist_sstring_release(&weak);
+        return err;
+    }
+    return compress_status(0);
+}
+
+cwist_error_t cwist_http_response_compress(cwist_http_response *res, const cwist_http_request *req,
+                                           const cwist_compress_config *config) {
+    if (!res || !req) return compress_status(EINVAL);
+
+    size_t min_size = config && config->min_size ? config->min_size : CWIST_COMPRESS_MIN_SIZE;
+    int level = compress_level(config ? config->level : 0);
+    cwist_sview body = cwist_sstring_view(res->body);
+    if (!body.ptr || body.len < min_size) return compress_status(0);
+    if (res->status_code < 200 || res->status_code == 204 || res->status_code == 206 || res->status_code == 304) {
+        return compress_status(0);
+    }
+
+    cwist_sview cache_control = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Cache-Control"));
+    if (!cwist_compress_type_ok(cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Content-Type"))) ||
+        cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Content-Encoding")).ptr ||
+        cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Content-Length")).ptr ||
+        header_has_token(cache_control, CWIST_SVIEW_LIT("no-transform"))) {
+        return compress_status(0);
+    }
+
+    // From here the body depends on Accept-Encoding, whatever is chosen.
+    cwist_error_t err = cwist_http_header_add_with(res->allocator, &res->headers, "Vary", "Accept-Encoding");
+    if (cwist_error_code(err) != 0) return err;
+
+    cwist_encoding_t encoding = cwist_http_negotiate_encoding(req);
+    if (encoding == CWIST_ENCODING_IDENTITY) return compress_status(0);
+
+    bool cacheable = config && config->cache &&
+                     !header_has_token(cache_control, CWIST_SVIEW_LIT("no-store")) &&
+                     !header_has_token(cache_control, CWIST_SVIEW_LIT("private"));
+
+    cwist_sstring packed;
+    cwist_sstring_init_with(&packed, res->body->allocator);
+    err = cacheable ? cwist_compress_cached(config->cache, encoding, level, body, &packed)
+                    : cwist_compress(encoding, level, body, &packed);
+
+    // Incompressible bodies go out as they are.
+    if (cwist_error_code(err) == 0 && packed.size < body.len) {
+        err = cwist_sstring_assign_view(res->body, cwist_sstring_view(&packed));
+        if (cwist_error_code(err) == 0) {
+            err = cwist_http_header_add_with(res->allocator, &res->headers, "Content-Encoding", cwist_encoding_name(encoding));
+        }
+        if (cwist_error_code(err) == 0) err = compress_weaken_etag(res);
+    }
+    cwist_sstring_release(&packed);
+    return err;
+}
+
+/* --- Streaming --- */
+
+struct cwist_compress_stream {
+    z_stream z;
+    bool finished;
+};
+
+cwist_compress_stream *cwist_compress_stream_create(cwist_encoding_t encoding, int level) {
+    if (encoding == CWIST_ENCODING_IDENTITY) return NULL;
+    cwist_compress_stream *stream = malloc(sizeof(*stream));
+    if (!stream) return NULL;
+    if (compress_init(&stream->z, encoding, level) != Z_OK) {
+        free(stream);
+        return NULL;
+    }
+    stream->finished = false;
+    return stream;
+}
+
+cwist_error_t cwist_compress_stream_write(cwist_compress_stream *stream, cwist_sview data, bool flush, cwist_sstring *out) {
+    if (!stream || !out || stream->finished || (data.len && !data.ptr)) return compress_status(EINVAL);
+    stream->z.next_in = (Bytef *)data.ptr;
+    stream->z.avail_in = (uInt)data.len;
+    cwist_error_t err = compress_pump(&stream->z, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH, out);
+    stream->z.next_in = NULL;   // data is the caller's; never keep it past the call
+    return err;
+}
+
+cwist_error_t cwist_compress_stream_finish(cwist_compress_stream *stream, cwist_sstring *out) {
+    if (!stream || !out || stream->finished) return compress_status(EINVAL);
+    stream->z.next_in = NULL;
+    stream->z.avail_in = 0;
+    cwist_error_t err = compress_pump(&stream->z, Z_FINISH, out);
+    if (cwist_error_code(err) == 0) stream->finished = true;
+    return err;
+}
+
+void cwist_compress_stream_destroy(cwist_compress_stream *stream) {
+    if (!stream) return;
+    deflateEnd(&stream->z);
+    free(stream);
+}
@@ -0,0 +1,473 @@
+#include <cwist/conditional.h>
+#include <cwist/hash.h>
+#include <cwist/sstring.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#define CONDITIONAL_COPY_SIZE 65536         // pread/write fallback buffer
+#define CONDITIONAL_SENDFILE_MAX (1 << 30)  // per call; sendfile stops near 2 GB anyway
+
+static cwist_error_t conditional_status(int code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, code);
+}
+
+// Replaces the first key header's value, or adds one.
+static cwist_error_t conditional_header_set(cwist_http_response *res, const char *key, const char *value) {
+    cwist_sview name = cwist_sview_from_cstr(key);
+    for (cwist_http_header_node *curr = res->headers; curr; curr = curr->next) {
+        if (curr->key->data && cwist_sview_equals_nocase(cwist_sstring_view(curr->key), name)) {
+            cwist_error_t err = cwist_sstring_assign_view(curr->value, cwist_sview_from_cstr(value));
+            return conditional_status(cwist_error_code(err) == 0 ? 0 : ENOMEM);
+        }
+    }
+    cwist_error_t err = cwist_http_header_add_with(res->allocator, &res->headers, key, value);
+    return conditional_status(cwist_error_code(err) == 0 ? 0 : ENOMEM);
+}
+
+static void conditional_set_status(cwist_http_response *res, cwist_http_status_t code, const char *text) {
+    res->status_code = code;
+    cwist_sstring_assign(res->status_text, (char *)text);
+}
+
+/* --- Validators --- */
+
+size_t cwist_http_etag_make(char out[CWIST_ETAG_SIZE], uint64_t version, bool weak) {
+    return (size_t)snprintf(out, CWIST_ETAG_SIZE, "%s\"%016llx\"", weak ? "W/" : "", (unsigned long long)version);
+}
+
+cwist_error_t cwist_http_response_set_etag(cwist_http_response *res, uint64_t version, bool weak) {
+    if (!res) return conditional_status(EINVAL);
+    char etag[CWIST_ETAG_SIZE];
+    cwist_http_etag_make(etag, version, weak);
+    return conditional_header_set(res, "ETag", etag);
+}
+
+cwist_error_t cwist_http_response_etag_body(cwist_http_response *res) {
+    if (!res) return conditional_status(EINVAL);
+    cwist_sview body = cwist_sstring_view(res->body);
+    return cwist_http_response_set_etag(res, cwist_hash64(body.ptr ? body.ptr : "", body.len, 0), false);
+}
+
+static const char conditional_days[7][4] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char conditional_months[12][4] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+size_t cwist_http_date_format(time_t t, char out[CWIST_HTTP_DATE_SIZE]) {
+    struct tm tm;
+    if (!gmtime_r(&t, &tm) || tm.tm_year + 1900 > 9999 || tm.tm_year + 1900 < 0) {
+        out[0] = '\0';
+        return 0;
+    }
+    return (size_t)snprintf(out, CWIST_HTTP_DATE_SIZE, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                            conditional_days[tm.tm_wday], tm.tm_mday, conditional_months[tm.tm_mon],
+                            tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date; timegm without the
+// time zone machinery.
+static int64_t conditional_days_from_civil(int64_t y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+struct date_cursor {
+    const char *p;
+    const char *end;
+};
+
+static bool date_char(struct date_cursor *c, char ch) {
+    if (c->p == c->end || *c->p != ch) return false;
+    c->p++;
+    return true;
+}
+
+static bool date_digits(struct date_cursor *c, int n, int *out) {
+    if (c->end - c->p < n) return false;
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        char ch = c->p[i];
+        if (ch < '0' || ch > '9') return false;
+        value = value * 10 + (ch - '0');
+    }
+    c->p += n;
+    *out = value;
+    return true;
+}
+
+static bool date_month(struct date_cursor *c, int *month) {
+    if (c->end - c->p < 3) return false;
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(c->p, conditional_months[i], 3) == 0) {
+            c->p += 3;
+            *month = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool date_time(struct date_cursor *c, int *h, int *m, int *s) {
+    return date_digits(c, 2, h) && date_char(c, ':') && date_digits(c, 2, m) && date_char(c, ':') &&
+           date_digits(c, 2, s) && *h < 24 && *m < 60 && *s <= 60;
+}
+
+static bool date_gmt(struct date_cursor *c) {
+    return c->end - c->p == 4 && memcmp(c->p, " GMT", 4) == 0;
+}
+
+bool cwist_http_date_parse(cwist_sview value, time_t *out) {
+    value = cwist_sview_trim(value);
+    if (!value.ptr || !out || value.len < 4) return false;
+    size_t comma = cwist_sview_find_char(value, ',');
+    struct date_cursor c = { value.ptr, value.ptr + value.len };
+    int year, month, day, h, m, s;
+
+    if (comma == 3) {
+        // IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+        c.p += 4;
+        if (!date_char(&c, ' ') || !date_digits(&c, 2, &day) || !date_char(&c, ' ') || !date_month(&c, &month) ||
+            !date_char(&c, ' ') || !date_digits(&c, 4, &year) || !date_char(&c, ' ') ||
+            !date_time(&c, &h, &m, &s) || !date_gmt(&c)) {
+            return false;
+        }
+    } else if (comma != CWIST_SVIEW_NPOS) {
+        // RFC 850: Sunday, 06-Nov-94 08:49:37 GMT
+        c.p += comma + 1;
+        if (!date_char(&c, ' ') || !date_digits(&c, 2, &day) || !date_char(&c, '-') || !date_month(&c, &month) ||
+            !date_char(&c, '-') || !date_digits(&c, 2, &year) || !date_char(&c, ' ') ||
+            !date_time(&c, &h, &m, &s) || !date_gmt(&c)) {
+            return false;
+        }
+        year += year < 70 ? 2000 : 1900;
+    } else {
+        // asctime: Sun Nov  6 08:49:37 1994
+        c.p += 3;
+        if (!date_char(&c, ' ') || !date_month(&c, &month) || !date_char(&c, ' ')) return false;
+        // The day is space-padded: "Nov  6".
+        if (!(date_char(&c, ' ') ? date_digits(&c, 1, &day) : date_digits(&c, 2, &day)) || !date_char(&c, ' ') ||
+            !date_time(&c, &h, &m, &s) || !date_char(&c, ' ') || !date_digits(&c, 4, &year) || c.p != c.end) {
+            return false;
+        }
+    }
+    if (day < 1 || day > 31) return false;
+
+    int64_t days = conditional_days_from_civil(year, month, day);
+    *out = (time_t)(days * 86400 + h * 3600 + m * 60 + s);
+    return true;
+}
+
+cwist_error_t cwist_http_response_set_last_modified(cwist_http_response *res, time_t t) {
+    if (!res) return conditional_status(EINVAL);
+    char date[CWIST_HTTP_DATE_SIZE];
+    if (cwist_http_date_format(t, date) == 0) return conditional_status(EINVAL);
+    return conditional_header_set(res, "Last-Modified", date);
+}
+
+/* --- Preconditions --- */
+
+// Next entity-tag of a comma-separated list: the quoted opaque-tag and
+// whether it carried W/. False at the end or on a malformed tag.
+static bool etag_next(cwist_sview *list, cwist_sview *opaque, bool *weak) {
+    const char *p = list->ptr, *end = list->ptr + list->len;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+    if (p == end) return false;
+
+    *weak = end - p >= 2 && p[0] == 'W' && p[1] == '/';
+    if (*weak) p += 2;
+    if (p == end || *p != '"') return false;
+    const char *close = memchr(p + 1, '"', (size_t)(end - p - 1));
+    if (!close) return false;
+    *opaque = cwist_sview_make(p, (size_t)(close + 1 - p));
+    list->ptr = close + 1;
+    list->len = (size_t)(end - close - 1);
+    return true;
+}
+
+bool cwist_http_etag_match(cwist_sview list, cwist_sview etag, bool weak) {
+    list = cwist_sview_trim(list);
+    if (!list.ptr) return false;
+    if (cwist_sview_equals(list, CWIST_SVIEW_LIT("*"))) return true;   // any current representation
+
+    cwist_sview mine, theirs;
+    bool mine_weak, theirs_weak;
+    cwist_sview rest = cwist_sview_trim(etag);
+    if (!rest.ptr || !etag_next(&rest, &mine, &mine_weak)) return false;
+    if (mine_weak && !weak) return false;
+
+    while (etag_next(&list, &theirs, &theirs_weak)) {
+        if (theirs_weak && !weak) continue;
+        if (cwist_sview_equals(theirs, mine)) return true;
+    }
+    return false;
+}
+
+cwist_precondition_t cwist_http_evaluate_preconditions(const cwist_http_request *req, cwist_sview etag,
+                                                       time_t last_modified) {
+    if (!req) return CWIST_PRECONDITION_PASS;
+    bool safe = req->method == CWIST_HTTP_GET || req->method == CWIST_HTTP_HEAD;
+    time_t since;
+
+    cwist_sview if_match = cwist_http_request_header_view(req, "If-Match");
+    if (if_match.ptr) {
+        if (!cwist_http_etag_match(if_match, etag, false)) return CWIST_PRECONDITION_FAILED;
+    } else {
+        cwist_sview value = cwist_http_request_header_view(req, "If-Unmodified-Since");
+        if (value.ptr && last_modified && cwist_http_date_parse(value, &since) && last_modified > since) {
+            return CWIST_PRECONDITION_FAILED;
+        }
+    }
+
+    // If-None-Match wins over If-Modified-Since: a date is only a fallback.
+    cwist_sview if_none_match = cwist_http_request_header_view(req, "If-None-Match");
+    if (if_none_match.ptr) {
+        if (cwist_http_etag_match(if_none_match, etag, true)) {
+            return safe ? CWIST_PRECONDITION_NOT_MODIFIED : CWIST_PRECONDITION_FAILED;
+        }
+    } else if (safe) {
+        cwist_sview value = cwist_http_request_header_view(req, "If-Modified-Since");
+        if (value.ptr && last_modified && cwist_http_date_parse(value, &since) && last_modified <= since) {
+            return CWIST_PRECONDITION_NOT_MODIFIED;
+        }
+    }
+    return CWIST_PRECONDITION_PASS;
+}
+
+static time_t conditional_last_modified(const cwist_http_response *res) {
+    time_t t = 0;
+    cwist_sview value = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Last-Modified"));
+    if (value.ptr && !cwist_http_date_parse(value, &t)) t = 0;
+    return t;
+}
+
+bool cwist_http_response_conditional(const cwist_http_request *req, cwist_http_response *res) {
+    // Only a response that would otherwise succeed is subject to preconditions.
+    if (!req || !res || res->status_code < 200 || res->status_code > 299) return false;
+
+    cwist_sview etag = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("ETag"));
+    switch (cwist_http_evaluate_preconditions(req, etag, conditional_last_modified(res))) {
+        case CWIST_PRECONDITION_NOT_MODIFIED:
+            conditional_set_status(res, CWIST_HTTP_NOT_MODIFIED, "Not Modified");
+            break;
+        case CWIST_PRECONDITION_FAILED:
+            conditional_set_status(res, CWIST_HTTP_PRECONDITION_FAILED, "Precondition Failed");
+            if (headers_have_content_length(res->headers)) conditional_header_set(res, "Content-Length", "0");
+            break;
+        default:
+            return false;
+    }
+    cwist_sstring_assign_view(res->body, CWIST_SVIEW_LIT(""));
+    return true;
+}
+
+/* --- Ranges --- */
+
+cwist_range_status_t cwist_http_range_parse(cwist_sview value, uint64_t size, uint64_t *offset, uint64_t *length) {
+    const cwist_sview unit = CWIST_SVIEW_LIT("bytes=");
+    value = cwist_sview_trim(value);
+    if (!offset || !length || value.len <= unit.len ||
+        !cwist_sview_equals_nocase(cwist_sview_substr(value, 0, unit.len), unit)) {
+        return CWIST_RANGE_NONE;
+    }
+    cwist_sview spec = cwist_sview_trim(cwist_sview_substr(value, unit.len, CWIST_SVIEW_NPOS));
+    size_t dash = cwist_sview_find_char(spec, '-');
+    if (dash == CWIST_SVIEW_NPOS || cwist_sview_find_char(spec, ',') != CWIST_SVIEW_NPOS) return CWIST_RANGE_NONE;
+    cwist_sview first = cwist_sview_trim(cwist_sview_substr(spec, 0, dash));
+    cwist_sview last = cwist_sview_trim(cwist_sview_substr(spec, dash + 1, CWIST_SVIEW_NPOS));
+
+    uint64_t start, end;
+    if (first.len == 0) {
+        // bytes=-N: the final N bytes.
+        if (!cwist_sview_to_uint64(last, 10, &end)) return CWIST_RANGE_NONE;
+        if (end == 0 || size == 0) return CWIST_RANGE_UNSATISFIABLE;
+        *length = end < size ? end : size;
+        *offset = size - *length;
+        return CWIST_RANGE_OK;
+    }
+    if (!cwist_sview_to_uint64(first, 10, &start)) return CWIST_RANGE_NONE;
+    if (last.len == 0) {
+        end = UINT64_MAX;
+    } else if (!cwist_sview_to_uint64(last, 10, &end) || end < start) {
+        return CWIST_RANGE_NONE;
+    }
+    if (start >= size) return CWIST_RANGE_UNSATISFIABLE;
+    if (end > size - 1) end = size - 1;
+    *offset = start;
+    *length = end - start + 1;
+    return CWIST_RANGE_OK;
+}
+
+cwist_range_status_t cwist_http_request_range(const cwist_http_request *req, uint64_t size, cwist_sview etag,
+                                              time_t last_modified, uint64_t *offset, uint64_t *length) {
+    if (!req || req->method != CWIST_HTTP_GET) return CWIST_RANGE_NONE;
+    cwist_sview range = cwist_http_request_header_view(req, "Range");
+    if (!range.ptr) return CWIST_RANGE_NONE;
+
+    // If-Range: the range only applies to the representation the client
+    // already holds part of; otherwise it gets the whole thing.
+    cwist_sview if_range = cwist_sview_trim(cwist_http_request_header_view(req, "If-Range"));
+    if (if_range.ptr) {
+        time_t t;
+        if (if_range.len > 0 && (if_range.ptr[0] == '"' || if_range.ptr[0] == 'W')) {
+            if (!cwist_http_etag_match(if_range, etag, false)) return CWIST_RANGE_NONE;
+        } else if (!last_modified || !cwist_http_date_parse(if_range, &t) || t != last_modified) {
+            return CWIST_RANGE_NONE;
+        }
+    }
+    return cwist_http_range_parse(range, size, offset, length);
+}
+
+static cwist_error_t conditional_unsatisfiable(cwist_http_response *res, uint64_t size) {
+    char content_range[48];
+    snprintf(content_range, sizeof(content_range), "bytes */%llu", (unsigned long long)size);
+    conditional_set_status(res, CWIST_HTTP_RANGE_NOT_SATISFIABLE, "Range Not Satisfiable");
+    cwist_sstring_assign_view(res->body, CWIST_SVIEW_LIT(""));
+    if (headers_have_content_length(res->headers)) conditional_header_set(res, "Content-Length", "0");
+    return conditional_header_set(res, "Content-Range", content_range);
+}
+
+static cwist_error_t conditional_partial(cwist_http_response *res, uint64_t offset, uint64_t length, uint64_t size) {
+    char content_range[80];
+    snprintf(content_range, sizeof(content_range), "bytes %llu-%llu/%llu", (unsigned long long)offset,
+             (unsigned long long)(offset + length - 1), (unsigned long long)size);
+    conditional_set_status(res, CWIST_HTTP_PARTIAL_CONTENT, "Partial Content");
+    return conditional_header_set(res, "Content-Range", content_range);
+}
+
+cwist_error_t cwist_http_response_range(const cwist_http_request *req, cwist_http_response *res) {
+    if (!req || !res) return conditional_status(EINVAL);
+    cwist_error_t err = conditional_header_set(res, "Accept-Ranges", "bytes");
+    if (cwist_error_code(err) != 0 || res->status_code != CWIST_HTTP_OK) return err;
+
+    cwist_sview body = cwist_sstring_view(res->body);
+    cwist_sview etag = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("ETag"));
+    uint64_t offset, length;
+    switch (cwist_http_request_range(req, body.len, etag, conditional_last_modified(res), &offset, &length)) {
+        case CWIST_RANGE_OK:
+            // Moves the slice to the front of the body in place.
+            if (cwist_error_code(cwist_sstring_assign_view(res->body, cwist_sview_substr(body, (size_t)offset, (size_t)length))) != 0) {
+                return conditional_status(ENOMEM);
+            }
+            return conditional_partial(res, offset, length, body.len);
+        case CWIST_RANGE_UNSATISFIABLE:
+            return conditional_unsatisfiable(res, body.len);
+        default:
+            return conditional_status(0);
+    }
+}
+
+/* --- Files --- */
+
+static cwist_error_t conditional_copy(int out_fd, int in_fd, uint64_t offset, uint64_t length) {
+    char buf[CONDITIONAL_COPY_SIZE];
+    while (length > 0) {
+        size_t want = length < sizeof(buf) ? (size_t)length : sizeof(buf);
+        ssize_t n = pread(in_fd, buf, want, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return conditional_status(errno);
+        if (n == 0) return conditional_status(EIO);   // the file shrank under us
+        struct iovec iov = { buf, (size_t)n };
+        cwist_error_t err = cwist_writev_all(out_fd, &iov, 1);
+        if (cwist_error_code(err) != 0) return err;
+        offset += (uint64_t)n;
+        length -= (uint64_t)n;
+    }
+    return conditional_status(0);
+}
+
+// File to socket in the kernel. SIGPIPE is held back while sendfile runs,
+// as MSG_NOSIGNAL does for cwist_writev_all.
+static cwist_error_t conditional_sendfile(int out_fd, int in_fd, uint64_t offset, uint64_t length) {
+#ifdef __linux__
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    off_t pos = (off_t)offset;
+    bool sent = false;
+    int error = 0;
+    while (length > 0) {
+        size_t want = length < CONDITIONAL_SENDFILE_MAX ? (size_t)length : CONDITIONAL_SENDFILE_MAX;
+        ssize_t n = sendfile(out_fd, in_fd, &pos, want);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && !sent && (errno == EINVAL || errno == ENOSYS)) break;
+        if (n <= 0) {
+            error = n < 0 ? errno : EIO;
+            break;
+        }
+        sent = true;
+        length -= (uint64_t)n;
+    }
+
+    if (error == EPIPE) {
+        struct timespec zero = { 0, 0 };
+        sigtimedwait(&pipe_set, NULL, &zero);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    if (error) return conditional_status(error);
+    if (length == 0) return conditional_status(0);
+    offset = (uint64_t)pos;
+#endif
+    return conditional_copy(out_fd, in_fd, offset, length);
+}
+
+cwist_error_t cwist_http_send_file(int client_fd, const cwist_http_request *req, cwist_http_response *res, int file_fd) {
+    if (client_fd < 0 || !req || !res || file_fd < 0) return conditional_status(EINVAL);
+    struct stat st;
+    if (fstat(file_fd, &st) != 0) return conditional_status(errno);
+    if (!S_ISREG(st.st_mode)) return conditional_status(EINVAL);
+    uint64_t size = (uint64_t)st.st_size;
+
+    cwist_error_t err = conditional_status(0);
+    if (!cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("ETag")).ptr) {
+        uint64_t identity[4] = { size, (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec, (uint64_t)st.st_ino };
+        err = cwist_http_response_set_etag(res, cwist_hash64(identity, sizeof(identity), 0), false);
+    }
+    if (cwist_error_code(err) == 0 && !cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Last-Modified")).ptr) {
+        err = cwist_http_response_set_last_modified(res, st.st_mtime);
+    }
+    if (cwist_error_code(err) == 0) err = conditional_header_set(res, "Accept-Ranges", "bytes");
+    if (cwist_error_code(err) != 0) return err;
+
+    if (cwist_http_response_conditional(req, res)) {
+        return conditional_status(cwist_error_code(cwist_http_send_response(client_fd, res)) == 0 ? 0 : EIO);
+    }
+
+    uint64_t offset = 0, length = size;
+    if (res->status_code == CWIST_HTTP_OK) {
+        cwist_sview etag = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("ETag"));
+        switch (cwist_http_request_range(req, size, etag, conditional_last_modified(res), &offset, &length)) {
+            case CWIST_RANGE_OK:
+                err = conditional_partial(res, offset, length, size);
+                break;
+            case CWIST_RANGE_UNSATISFIABLE:
+                err = conditional_unsatisfiable(res, size);
+                if (cwist_error_code(err) != 0) return err;
+                return conditional_status(cwist_error_code(cwist_http_send_response(client_fd, res)) == 0 ? 0 : EIO);
+            default:
+                break;
+        }
+        if (cwist_error_code(err) != 0) return err;
+    }
+
+    char content_length[24];
+    snprintf(content_length, sizeof(content_length), "%llu", (unsigned long long)length);
+    err = conditional_header_set(res, "Content-Length", content_length);
+    if (cwist_error_code(err) != 0) return err;
+    if (cwist_error_code(cwist_http_send_response_iov(client_fd, res, NULL, 0)) != 0) return conditional_status(EIO);
+    if (req->method == CWIST_HTTP_HEAD || length == 0) return conditional_status(0);
+    return conditional_sendfile(client_fd, file_fd, offset, length);
+}
@@ -1,13 +1,15 @@
 #include <cwist/http.h>
 #include <cwist/sstring.h>
 #include <cwist/err/cwist_err.h>
+#include <cwist/log.h>
+#include <cwist/session_manager.h>
+#include <cwist/simd.h>
 
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <strings.h>
 #include <errno.h>
 
 #include <sys/types.h>
@@ -16,6 +18,7 @@
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #ifdef __linux__
 #include <sys/epoll.h>
@@ -24,6 +27,10 @@
 #include <sys/event.h>
 #endif
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024   // POSIX leaves it to <limits.h>; glibc hides it without _XOPEN_SOURCE
+#endif
+
 const int CWIST_CREATE_SOCKET_FAILED     = -1;
 const int CWIST_HTTP_UNAVAILABLE_ADDRESS = -2;
 const int CWIST_HTTP_BIND_FAILED         = -3;
@@ -45,36 +52,60 @@ const char *cwist_http_method_to_string(cwist_http_method_t method) {
     }
 }
 
-cwist_http_method_t cwist_http_string_to_method(const char *method_str) {
-    if (strcmp(method_str, "GET") == 0) return CWIST_HTTP_GET;
-    if (strcmp(method_str, "POST") == 0) return CWIST_HTTP_POST;
-    if (strcmp(method_str, "PUT") == 0) return CWIST_HTTP_PUT;
-    if (strcmp(method_str, "DELETE") == 0) return CWIST_HTTP_DELETE;
-    if (strcmp(method_str, "PATCH") == 0) return CWIST_HTTP_PATCH;
-    if (strcmp(method_str, "HEAD") == 0) return CWIST_HTTP_HEAD;
-    if (strcmp(method_str, "OPTIONS") == 0) return CWIST_HTTP_OPTIONS;
+static cwist_http_method_t http_method_from_view(cwist_sview method) {
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("GET"))) return CWIST_HTTP_GET;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("POST"))) return CWIST_HTTP_POST;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("PUT"))) return CWIST_HTTP_PUT;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("DELETE"))) return CWIST_HTTP_DELETE;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("PATCH"))) return CWIST_HTTP_PATCH;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("HEAD"))) return CWIST_HTTP_HEAD;
+    if (cwist_sview_equals(method, CWIST_SVIEW_LIT("OPTIONS"))) return CWIST_HTTP_OPTIONS;
     return CWIST_HTTP_UNKNOWN;
 }
 
+cwist_http_method_t cwist_http_string_to_method(const char *method_str) {
+    return http_method_from_view(cwist_sview_from_cstr(method_str));
+}
+
 /* --- Header Manipulation --- */
 
+static cwist_error_t http_header_add_view(const cwist_allocator *allocator, cwist_http_header_node **head, cwist_sview key, cwist_sview value);
+
 cwist_error_t cwist_http_header_add(cwist_http_header_node **head, const char *key, const char *value) {
+    return cwist_http_header_add_with(NULL, head, key, value);
+}
+
+cwist_error_t cwist_http_header_add_in(struct session_arena *arena, cwist_http_header_node **head, const char *key, const char *value) {
+    return cwist_http_header_add_with(session_arena_allocator(arena), head, key, value);
+}
+
+cwist_error_t cwist_http_header_add_with(const cwist_allocator *allocator, cwist_http_header_node **head, const char *key, const char *value) {
+    return http_header_add_view(allocator, head, cwist_sview_from_cstr(key), cwist_sview_from_cstr(value));
+}
+
+// The parser hands in views straight into the raw request, so no scratch copy.
+static cwist_error_t http_header_add_view(const cwist_allocator *allocator, cwist_http_header_node **head, cwist_sview key, cwist_sview value) {
     cwist_error_t err = make_error(CWIST_ERR_INT16);
+    if (!allocator) allocator = cwist_allocator_default();
     
-    cwist_http_header_node *node = (cwist_http_header_node *)malloc(sizeof(cwist_http_header_node));
+    cwist_http_header_node *node = (cwist_http_header_node *)cwist_alloc(allocator, sizeof(cwist_http_header_node));
     if (!node) {
-        err = make_error(CWIST_ERR_JSON);
-        err.error.err_json = cJSON_CreateObject();
-        cJSON_AddStringToObject(err.error.err_json, "http_error", "Failed to allocate header");
-        return err;
+        return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
     }
 
-    node->key = cwist_sstring_create();
-    node->value = cwist_sstring_create();
+    node->allocator = allocator;
+    node->key = cwist_sstring_create_with(allocator);
+    node->value = cwist_sstring_create_with(allocator);
     node->next = NULL;
+    if (!node->key || !node->value) {
+        cwist_sstring_destroy(node->key);
+        cwist_sstring_destroy(node->value);
+        cwist_free(allocator, node, sizeof(cwist_http_header_node));
+        return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+    }
 
-    cwist_sstring_assign(node->key, (char *)key);
-    cwist_sstring_assign(node->value, (char *)value);
+    cwist_sstring_assign_view(node->key, key);
+    cwist_sstring_assign_view(node->value, value);
 
     node->next = *head;
     *head = node;
@@ -83,16 +114,41 @@ cwist_error_t cwist_http_header_add(cwist_http_header_node **head, const char *k
     return err;
 }
 
+// Field names are case-insensitive (RFC 9110); the value's own storage is returned.
 char *cwist_http_header_get(cwist_http_header_node *head, const char *key) {
-    cwist_http_header_node *curr = head;
-    while (curr) {
-        // case-insensitive comparison for headers is standard, but keeping it strict for now for simplicity
-        if (curr->key->data && strcmp(curr->key->data, key) == 0) {
-            return curr->value->data;
+    if (!key) return NULL;
+    return (char *)cwist_http_header_get_view(head, cwist_sview_from_cstr(key)).ptr;
+}
+
+cwist_sview cwist_http_header_get_view(const cwist_http_header_node *head, cwist_sview key) {
+    for (const cwist_http_header_node *curr = head; curr; curr = curr->next) {
+        cwist_sview name = cwist_sstring_view(curr->key);
+        if (name.ptr && cwist_sview_equals_nocase(name, key)) {
+            return cwist_sstring_view(curr->value);
         }
-        curr = curr->next;
     }
-    return NULL;
+    return cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_request_path_view(const cwist_http_request *req) {
+    return req ? cwist_sstring_view(req->path) : cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_request_query_view(const cwist_http_request *req) {
+    return req ? cwist_sstring_view(req->query) : cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_request_version_view(const cwist_http_request *req) {
+    return req ? cwist_sstring_view(req->version) : cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_request_body_view(const cwist_http_request *req) {
+    return req ? cwist_sstring_view(req->body) : cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_request_header_view(const cwist_http_request *req, const char *key) {
+    if (!req || !key) return cwist_sview_make(NULL, 0);
+    return cwist_http_header_get_view(req->headers, cwist_sview_from_cstr(key));
 }
 
 void cwist_http_header_free_all(cwist_http_header_node *head) {
@@ -101,30 +157,27 @@ void cwist_http_header_free_all(cwist_http_header_node *head) {
         cwist_http_header_node *next = curr->next;
         cwist_sstring_destroy(curr->key);
         cwist_sstring_destroy(curr->value);
-        free(curr);
+        cwist_free(curr->allocator, curr, sizeof(cwist_http_header_node));
         curr = next;
     }
 }
 
-static bool header_key_is_connection(const char *key) {
-    if (!key) return false;
-    return strcasecmp(key, "connection") == 0;
+static bool header_key_is_connection(cwist_sview key) {
+    return cwist_sview_equals_nocase(key, CWIST_SVIEW_LIT("connection"));
 }
 
-static bool header_value_is_close(const char *value) {
-    if (!value) return false;
-    return strcasecmp(value, "close") == 0;
+static bool header_value_is_close(cwist_sview value) {
+    return cwist_sview_equals_nocase(value, CWIST_SVIEW_LIT("close"));
 }
 
-static bool header_value_is_keep_alive(const char *value) {
-    if (!value) return false;
-    return strcasecmp(value, "keep-alive") == 0;
+static bool header_value_is_keep_alive(cwist_sview value) {
+    return cwist_sview_equals_nocase(value, CWIST_SVIEW_LIT("keep-alive"));
 }
 
 static bool headers_have_connection(cwist_http_header_node *head) {
     cwist_http_header_node *curr = head;
     while (curr) {
-        if (curr->key && curr->key->data && header_key_is_connection(curr->key->data)) {
+        if (curr->key && curr->key->data && header_key_is_connection(cwist_sstring_view(curr->key))) {
             return true;
         }
         curr = curr->next;
@@ -135,16 +188,35 @@ static bool headers_have_connection(cwist_http_header_node *head) {
 /* --- Request Lifecycle --- */
 
 cwist_http_request *cwist_http_request_create(void) {
-    cwist_http_request *req = (cwist_http_request *)malloc(sizeof(cwist_http_request));
+    return cwist_http_request_create_with(NULL);
+}
+
+cwist_http_request *cwist_http_request_create_in(struct session_arena *arena) {
+    return cwist_http_request_create_with(session_arena_allocator(arena));
+}
+
+cwist_http_request *cwist_http_request_create_with(const cwist_allocator *allocator) {
+    if (!allocator) allocator = cwist_allocator_default();
+
+    cwist_http_request *req = (cwist_http_request *)cwist_alloc(allocator, sizeof(cwist_http_request));
     if (!req) return NULL;
 
+    req->allocator = allocator;
     req->method = CWIST_HTTP_GET; // Default
-    req->path = cwist_sstring_create();
-    req->query = cwist_sstring_create();
-    req->version = cwist_sstring_create();
+    req->path = cwist_sstring_create_with(allocator);
+    req->query = cwist_sstring_create_with(allocator);
+    req->version = cwist_sstring_create_with(allocator);
     req->headers = NULL;
-    req->body = cwist_sstring_create();
+    req->body = cwist_sstring_create_with(allocator);
     req->keep_alive = true;
+    req->query_params = NULL;
+    req->cookie_params = NULL;
+    req->form_params = NULL;
+
+    if (!req->path || !req->query || !req->version || !req->body) {
+        cwist_http_request_destroy(req);
+        return NULL;
+    }
 
     // Defaults
     cwist_sstring_assign(req->version, "HTTP/1.1");
@@ -153,30 +225,69 @@ cwist_http_request *cwist_http_request_create(void) {
     return req;
 }
 
+// One allocation per source: this header, the entries, then a private copy
+// of the source that keys and values are decoded in.
+typedef struct cwist_http_param {
+    char *key;
+    size_t key_len;
+    char *value;
+    size_t value_len;
+    bool value_ready;   // decoded (or needs no decoding)
+} cwist_http_param;
+
+struct cwist_http_params {
+    size_t alloc_size;
+    size_t count;
+    cwist_http_param items[];
+};
+
+static void http_params_free(const cwist_allocator *allocator, struct cwist_http_params *params) {
+    if (params) cwist_free(allocator, params, params->alloc_size);
+}
+
 void cwist_http_request_destroy(cwist_http_request *req) {
     if (req) {
+        http_params_free(req->allocator, req->query_params);
+        http_params_free(req->allocator, req->cookie_params);
+        http_params_free(req->allocator, req->form_params);
         cwist_sstring_destroy(req->path);
         cwist_sstring_destroy(req->query);
         cwist_sstring_destroy(req->version);
         cwist_sstring_destroy(req->body);
         cwist_http_header_free_all(req->headers);
-        free(req);
+        cwist_free(req->allocator, req, sizeof(cwist_http_request));
     }
 }
 
 /* --- Response Lifecycle --- */
 
 cwist_http_response *cwist_http_response_create(void) {
-    cwist_http_response *res = (cwist_http_response *)malloc(sizeof(cwist_http_response));
+    return cwist_http_response_create_with(NULL);
+}
+
+cwist_http_response *cwist_http_response_create_in(struct session_arena *arena) {
+    return cwist_http_response_create_with(session_arena_allocator(arena));
+}
+
+cwist_http_response *cwist_http_response_create_with(const cwist_allocator *allocator) {
+    if (!allocator) allocator = cwist_allocator_default();
+
+    cwist_http_response *res = (cwist_http_response *)cwist_alloc(allocator, sizeof(cwist_http_response));
     if (!res) return NULL;
 
-    res->version = cwist_sstring_create();
+    res->allocator = allocator;
+    res->version = cwist_sstring_create_with(allocator);
     res->status_code = CWIST_HTTP_OK;
-    res->status_text = cwist_sstring_create();
+    res->status_text = cwist_sstring_create_with(allocator);
     res->headers = NULL;
-    res->body = cwist_sstring_create();
+    res->body = cwist_sstring_create_with(allocator);
     res->keep_alive = true;
 
+    if (!res->version || !res->status_text || !res->body) {
+        cwist_http_response_destroy(res);
+        return NULL;
+    }
+
     // Defaults
     cwist_sstring_assign(res->version, "HTTP/1.1");
     cwist_sstring_assign(res->status_text, "OK");
@@ -190,90 +301,395 @@ void cwist_http_response_destroy(cwist_http_response *res) {
         cwist_sstring_destroy(res->status_text);
         cwist_sstring_destroy(res->body);
         cwist_http_header_free_all(res->headers);
-        free(res);
+        cwist_free(res->allocator, res, sizeof(cwist_http_response));
     }
 }
 
+/* --- Chunked Transfer-Encoding --- */
+
+#define HTTP_CHUNK_LINE_MAX 1024      // size line with extensions
+#define HTTP_CHUNK_TRAILER_MAX 8192   // all trailer lines together
+
+enum http_chunk_state {
+    HTTP_CHUNK_SIZE,
+    HTTP_CHUNK_SIZE_WS,     // whitespace after the digits
+    HTTP_CHUNK_EXT,         // ";name=value" up to CR, ignored
+    HTTP_CHUNK_SIZE_LF,
+    HTTP_CHUNK_DATA,
+    HTTP_CHUNK_DATA_CR,
+    HTTP_CHUNK_DATA_LF,
+    HTTP_CHUNK_TRAILER,     // start of a trailer line, or the final CRLF
+    HTTP_CHUNK_TRAILER_LINE,
+    HTTP_CHUNK_TRAILER_LF,
+    HTTP_CHUNK_FINAL_LF,
+    HTTP_CHUNK_DONE,
+    HTTP_CHUNK_FAILED,
+};
+
+static int http_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void cwist_chunked_decoder_init(cwist_chunked_decoder *dec, uint64_t limit) {
+    if (!dec) return;
+    memset(dec, 0, sizeof(*dec));
+    dec->state = HTTP_CHUNK_SIZE;
+    dec->limit = limit;
+}
+
+cwist_chunked_status_t cwist_chunked_decode(cwist_chunked_decoder *dec, const char *in, size_t len, size_t *consumed,
+                                            cwist_chunk_handler on_data, void *ctx) {
+    size_t pos = 0;
+    cwist_chunked_status_t status = CWIST_CHUNKED_NEED_MORE;
+    if (consumed) *consumed = 0;
+    if (!dec || (len > 0 && !in)) return CWIST_CHUNKED_MALFORMED;
+    if (dec->state == HTTP_CHUNK_FAILED) return CWIST_CHUNKED_MALFORMED;
+
+    while (pos < len && dec->state != HTTP_CHUNK_DONE) {
+        if (dec->state == HTTP_CHUNK_DATA) {
+            size_t n = len - pos;
+            if (n > dec->remaining) n = (size_t)dec->remaining;
+            int stop = on_data ? on_data(ctx, in + pos, n) : 0;
+            pos += n;
+            dec->remaining -= n;
+            if (dec->remaining == 0) dec->state = HTTP_CHUNK_DATA_CR;
+            if (stop) {
+                status = CWIST_CHUNKED_ABORTED;
+                goto out;
+            }
+            continue;
+        }
+
+        char c = in[pos];
+        bool bad = false;
+        switch (dec->state) {
+            case HTTP_CHUNK_SIZE: {
+                int hex = http_hex_value(c);
+                if (hex >= 0) {
+                    if (dec->remaining >> 60) bad = true;   // would overflow 64 bits
+                    dec->remaining = dec->remaining * 16 + (uint64_t)hex;
+                    dec->digits = true;
+                } else if (!dec->digits) {
+                    bad = true;
+                } else if (c == ';') {
+                    dec->state = HTTP_CHUNK_EXT;
+                } else if (c == ' ' || c == '\t') {
+                    dec->state = HTTP_CHUNK_SIZE_WS;
+                } else if (c == '\r') {
+                    dec->state = HTTP_CHUNK_SIZE_LF;
+                } else {
+                    bad = true;
+                }
+                break;
+            }
+            case HTTP_CHUNK_SIZE_WS:
+                if (c == ';') dec->state = HTTP_CHUNK_EXT;
+                else if (c == '\r') dec->state = HTTP_CHUNK_SIZE_LF;
+                else bad = c != ' ' && c != '\t';
+                break;
+            case HTTP_CHUNK_EXT:
+                if (c == '\r') dec->state = HTTP_CHUNK_SIZE_LF;
+                else bad = c == '\n';
+                break;
+            case HTTP_CHUNK_SIZE_LF:
+                if (c != '\n') {
+                    bad = true;
+                } else if (dec->remaining == 0) {
+                    dec->state = HTTP_CHUNK_TRAILER;
+                    dec->line = 0;
+                } else if (dec->limit && (dec->remaining > dec->limit || dec->total + dec->remaining > dec->limit)) {
+                    // Refused on the declared size, before any of the data is read.
+                    dec->state = HTTP_CHUNK_FAILED;
+                    status = CWIST_CHUNKED_TOO_LARGE;
+                    goto out;
+                } else {
+                    dec->total += dec->remaining;
+                    dec->state = HTTP_CHUNK_DATA;
+                }
+                break;
+            case HTTP_CHUNK_DATA_CR:
+                if (c == '\r') dec->state = HTTP_CHUNK_DATA_LF;
+                else bad = true;
+                break;
+            case HTTP_CHUNK_DATA_LF:
+                if (c == '\n') {
+                    dec->state = HTTP_CHUNK_SIZE;
+                    dec->remaining = 0;
+                    dec->digits = false;
+                    dec->line = 0;
+                } else {
+                    bad = true;
+                }
+                break;
+            case HTTP_CHUNK_TRAILER:
+                if (c == '\r') dec->state = HTTP_CHUNK_FINAL_LF;
+                else if (c == '\n') bad = true;
+                else dec->state = HTTP_CHUNK_TRAILER_LINE;
+                break;
+            case HTTP_CHUNK_TRAILER_LINE:
+                if (c == '\r') dec->state = HTTP_CHUNK_TRAILER_LF;
+                else bad = c == '\n';
+                break;
+            case HTTP_CHUNK_TRAILER_LF:
+                if (c == '\n') dec->state = HTTP_CHUNK_TRAILER;
+                else bad = true;
+                break;
+            case HTTP_CHUNK_FINAL_LF:
+                if (c == '\n') dec->state = HTTP_CHUNK_DONE;
+                else bad = true;
+                break;
+            default:
+                bad = true;
+                break;
+        }
+
+        bool trailer = dec->state >= HTTP_CHUNK_TRAILER && dec->state <= HTTP_CHUNK_FINAL_LF;
+        if (!bad && ++dec->line > (trailer ? HTTP_CHUNK_TRAILER_MAX : HTTP_CHUNK_LINE_MAX)) bad = true;
+        if (bad) {
+            dec->state = HTTP_CHUNK_FAILED;
+            status = CWIST_CHUNKED_MALFORMED;
+            goto out;
+        }
+        pos++;
+    }
+    if (dec->state == HTTP_CHUNK_DONE) status = CWIST_CHUNKED_DONE;
+
+out:
+    if (consumed) *consumed = pos;
+    return status;
+}
+
+static int http_chunk_append(void *ctx, const char *data, size_t len) {
+    return cwist_error_code(cwist_sstring_append_view((cwist_sstring *)ctx, cwist_sview_make(data, len))) != 0;
+}
+
+bool cwist_http_request_is_chunked(const cwist_http_request *req) {
+    cwist_sview codings = cwist_http_request_header_view(req, "Transfer-Encoding");
+    cwist_sview coding, last = { NULL, 0 };
+    while (cwist_sview_split(&codings, ',', &coding)) {
+        coding = cwist_sview_trim(coding);
+        if (coding.len) last = coding;
+    }
+    return cwist_sview_equals_nocase(last, CWIST_SVIEW_LIT("chunked"));
+}
+
+/* --- Query, cookie and form parameters --- */
+
+size_t cwist_http_url_decode(char *data, size_t len, bool plus_is_space) {
+    if (!data) return 0;
+    const char *special = plus_is_space ? "%+" : "%";
+    size_t special_len = plus_is_space ? 2 : 1;
+    size_t in = 0, out = 0;
+    while (in < len) {
+        // Plain runs are found with the SIMD scanner and moved in bulk.
+        size_t run = cwist_simd_find_first_of(data + in, len - in, special, special_len);
+        if (run == (size_t)-1) run = len - in;
+        if (out != in) memmove(data + out, data + in, run);
+        in += run;
+        out += run;
+        if (in == len) break;
+
+        int hi, lo;
+        if (data[in] == '+') {
+            data[out++] = ' ';
+            in++;
+        } else if (in + 2 < len && (hi = http_hex_value(data[in + 1])) >= 0 && (lo = http_hex_value(data[in + 2])) >= 0) {
+            data[out++] = (char)((hi << 4) | lo);
+            in += 3;
+        } else {
+            data[out++] = data[in++];
+        }
+    }
+    return out;
+}
+
+enum http_param_source {
+    HTTP_PARAMS_QUERY,
+    HTTP_PARAMS_COOKIE,
+    HTTP_PARAMS_FORM,
+};
+
+// Splits source into entries over a private copy. Query and form keys are
+// decoded now (they are short and every lookup compares them); values wait.
+static struct cwist_http_params *http_params_build(const cwist_allocator *allocator, cwist_sview source,
+                                                   enum http_param_source kind) {
+    const char sep = kind == HTTP_PARAMS_COOKIE ? ';' : '&';
+    size_t slots = 1;
+    for (const char *p = source.ptr, *end = source.ptr + source.len; p && (p = memchr(p, sep, (size_t)(end - p))); p++) {
+        slots++;
+    }
+
+    size_t size = sizeof(struct cwist_http_params) + slots * sizeof(cwist_http_param) + source.len + 1;
+    struct cwist_http_params *params = cwist_alloc(allocator, size);
+    if (!params) return NULL;
+    params->alloc_size = size;
+    params->count = 0;
+    char *copy = (char *)(params->items + slots);
+    if (source.len) memcpy(copy, source.ptr, source.len);
+    copy[source.len] = '\0';
+
+    cwist_sview rest = cwist_sview_make(copy, source.len), field;
+    while (cwist_sview_split(&rest, sep, &field)) {
+        if (kind == HTTP_PARAMS_COOKIE) field = cwist_sview_trim(field);
+        if (field.len == 0) continue;
+
+        size_t eq = cwist_sview_find_char(field, '=');
+        cwist_sview key = eq == CWIST_SVIEW_NPOS ? field : cwist_sview_substr(field, 0, eq);
+        cwist_sview value = eq == CWIST_SVIEW_NPOS ? cwist_sview_make(field.ptr + field.len, 0)
+                                                   : cwist_sview_substr(field, eq + 1, field.len);
+        cwist_http_param *item = &params->items[params->count++];
+        item->key = (char *)key.ptr;
+        item->value = (char *)value.ptr;
+        if (kind == HTTP_PARAMS_COOKIE) {
+            key = cwist_sview_trim(key);
+            value = cwist_sview_trim(value);
+            if (value.len >= 2 && value.ptr[0] == '"' && value.ptr[value.len - 1] == '"') {
+                value = cwist_sview_substr(value, 1, value.len - 2);
+            }
+            item->key = (char *)key.ptr;
+            item->key_len = key.len;
+            item->value = (char *)value.ptr;
+            item->value_len = value.len;
+            item->value_ready = true;
+        } else {
+            item->key_len = cwist_http_url_decode(item->key, key.len, true);
+            item->value_len = value.len;
+            item->value_ready = false;
+        }
+    }
+    return params;
+}
+
+static cwist_sview http_params_get(cwist_http_request *req, struct cwist_http_params **slot, cwist_sview source,
+                                   enum http_param_source kind, const char *key) {
+    if (!req || !key) return cwist_sview_make(NULL, 0);
+    if (!*slot) {
+        *slot = http_params_build(req->allocator, source, kind);
+        if (!*slot) return cwist_sview_make(NULL, 0);
+    }
+
+    size_t key_len = strlen(key);
+    struct cwist_http_params *params = *slot;
+    for (size_t i = 0; i < params->count; i++) {
+        cwist_http_param *item = &params->items[i];
+        if (item->key_len != key_len || memcmp(item->key, key, key_len) != 0) continue;
+        if (!item->value_ready) {
+            item->value_len = cwist_http_url_decode(item->value, item->value_len, true);
+            item->value_ready = true;
+        }
+        return cwist_sview_make(item->value, item->value_len);
+    }
+    return cwist_sview_make(NULL, 0);
+}
+
+cwist_sview cwist_http_query_get(cwist_http_request *req, const char *key) {
+    return http_params_get(req, req ? &req->query_params : NULL, cwist_http_request_query_view(req), HTTP_PARAMS_QUERY,
+                           key);
+}
+
+cwist_sview cwist_http_cookie_get(cwist_http_request *req, const char *key) {
+    return http_params_get(req, req ? &req->cookie_params : NULL, cwist_http_request_header_view(req, "Cookie"),
+                           HTTP_PARAMS_COOKIE, key);
+}
+
+cwist_sview cwist_http_form_get(cwist_http_request *req, const char *key) {
+    if (!req) return cwist_sview_make(NULL, 0);
+    cwist_sview type = cwist_http_request_header_view(req, "Content-Type"), mime;
+    cwist_sview_split(&type, ';', &mime);
+    if (!cwist_sview_equals_nocase(cwist_sview_trim(mime), CWIST_SVIEW_LIT("application/x-www-form-urlencoded"))) {
+        return cwist_sview_make(NULL, 0);
+    }
+    return http_params_get(req, &req->form_params, cwist_http_request_body_view(req), HTTP_PARAMS_FORM, key);
+}
+
 cwist_http_request *cwist_http_parse_request(const char *raw_request) {
+    return cwist_http_parse_request_with(NULL, raw_request);
+}
+
+cwist_http_request *cwist_http_parse_request_in(struct session_arena *arena, const char *raw_request) {
+    return cwist_http_parse_request_with(session_arena_allocator(arena), raw_request);
+}
+
+cwist_http_request *cwist_http_parse_request_with(const cwist_allocator *allocator, const char *raw_request) {
     if (!raw_request) return NULL;
 
-    cwist_http_request *req = cwist_http_request_create();
+    cwist_http_request *req = cwist_http_request_create_with(allocator);
     if (!req) return NULL;
+    allocator = req->allocator;
     
-    const char *line_start = raw_request;
-    const char *line_end = strstr(line_start, "\r\n");
-    if (!line_end) { 
-        cwist_http_request_destroy(req); 
-        return NULL; 
-    }
-
-    // 1. Request Line
-    int request_line_len = line_end - line_start;
-    char *request_line = (char*)malloc(request_line_len + 1);
-    if (!request_line) {
+    const cwist_sview crlf = CWIST_SVIEW_LIT("\r\n");
+    cwist_sview rest = cwist_sview_from_cstr(raw_request);
+    size_t line_end = cwist_sview_find(rest, crlf);
+    if (line_end == CWIST_SVIEW_NPOS) {
         cwist_http_request_destroy(req);
         return NULL;
     }
-    strncpy(request_line, line_start, request_line_len);
-    request_line[request_line_len] = '\0';
-    
-    char *method_str = strtok(request_line, " ");
-    char *path_str = strtok(NULL, " ");
-    char *version_str = strtok(NULL, " ");
-    
-    if (method_str) req->method = cwist_http_string_to_method(method_str);
-    if (path_str) cwist_sstring_assign(req->path, path_str);
-    if (version_str) {
-        cwist_sstring_assign(req->version, version_str);
-        if (strcmp(version_str, "HTTP/1.1") == 0) {
-            req->keep_alive = true;
+
+    // 1. Request Line: method, path and version separated by runs of spaces
+    cwist_sview line = cwist_sview_substr(rest, 0, line_end);
+    rest = cwist_sview_substr(rest, line_end + 2, rest.len);
+
+    cwist_sview parts[3];
+    size_t part_count = 0;
+    cwist_sview token;
+    while (part_count < 3 && cwist_sview_split(&line, ' ', &token)) {
+        if (token.len > 0) parts[part_count++] = token;
+    }
+
+    if (part_count > 0) req->method = http_method_from_view(parts[0]);
+    if (part_count > 1) {
+        // The query stays raw here; it is only split when a parameter is asked for.
+        size_t question = cwist_sview_find_char(parts[1], '?');
+        if (question == CWIST_SVIEW_NPOS) {
+            cwist_sstring_assign_view(req->path, parts[1]);
         } else {
-            req->keep_alive = false;
+            cwist_sstring_assign_view(req->path, cwist_sview_substr(parts[1], 0, question));
+            cwist_sstring_assign_view(req->query, cwist_sview_substr(parts[1], question + 1, parts[1].len));
         }
     }
-    
-    free(request_line);
+    if (part_count > 2) {
+        cwist_sstring_assign_view(req->version, parts[2]);
+        req->keep_alive = cwist_sview_equals(parts[2], CWIST_SVIEW_LIT("HTTP/1.1"));
+    }
 
     // 2. Headers
-    line_start = line_end + 2; // Skip \r\n
-    while ((line_end = strstr(line_start, "\r\n")) != NULL) {
-        if (line_end == line_start) {
+    while ((line_end = cwist_sview_find(rest, crlf)) != CWIST_SVIEW_NPOS) {
+        line = cwist_sview_substr(rest, 0, line_end);
+        rest = cwist_sview_substr(rest, line_end + 2, rest.len);
+        if (line.len == 0) {
             // Empty line found, body follows
-            line_start += 2;
             break;
         }
-        
-        int header_len = line_end - line_start;
-        char *header_line = (char*)malloc(header_len + 1);
-        if (header_line) {
-            strncpy(header_line, line_start, header_len);
-            header_line[header_len] = '\0';
-            
-            char *colon = strchr(header_line, ':');
-            if (colon) {
-                *colon = '\0';
-                char *key = header_line;
-                char *value = colon + 1;
-                while (*value == ' ') value++; // Trim leading space
-                
-                cwist_http_header_add(&req->headers, key, value);
-                if (header_key_is_connection(key)) {
-                    if (header_value_is_close(value)) {
-                        req->keep_alive = false;
-                    } else if (header_value_is_keep_alive(value)) {
-                        req->keep_alive = true;
-                    }
-                }
+
+        size_t colon = cwist_sview_find_char(line, ':');
+        if (colon == CWIST_SVIEW_NPOS) continue;
+
+        cwist_sview key = cwist_sview_substr(line, 0, colon);
+        cwist_sview value = cwist_sview_ltrim(cwist_sview_substr(line, colon + 1, line.len));
+
+        http_header_add_view(allocator, &req->headers, key, value);
+        if (header_key_is_connection(key)) {
+            if (header_value_is_close(value)) {
+                req->keep_alive = false;
+            } else if (header_value_is_keep_alive(value)) {
+                req->keep_alive = true;
             }
-            free(header_line);
         }
-        
-        line_start = line_end + 2;
     }
 
     // 3. Body
-    if (*line_start) {
-        cwist_sstring_assign(req->body, (char*)line_start);
+    if (rest.len > 0 && cwist_http_request_is_chunked(req)) {
+        cwist_chunked_decoder dec;
+        cwist_chunked_decoder_init(&dec, 0);
+        if (cwist_chunked_decode(&dec, rest.ptr, rest.len, NULL, http_chunk_append, req->body) != CWIST_CHUNKED_DONE) {
+            cwist_http_request_destroy(req);
+            return NULL;
+        }
+    } else if (rest.len > 0) {
+        cwist_sstring_assign_view(req->body, rest);
     }
 
     return req;
@@ -282,7 +698,7 @@ cwist_http_request *cwist_http_parse_request(const char *raw_request) {
 int headers_have_content_length(cwist_http_header_node *headers) {
     cwist_http_header_node *curr = headers;
     while (curr) {
-        if (curr->key && curr->key->data && strcasecmp(curr->key->data, "Content-Length") == 0) {
+        if (curr->key && cwist_sstring_equals_nocase(curr->key, "Content-Length")) {
             return 1;
         }
         curr = curr->next;
@@ -291,97 +707,313 @@ int headers_have_content_length(cwist_http_header_node *headers) {
 }
 
 
-cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res) {
-    cwist_error_t err = make_error(CWIST_ERR_INT16);
-
-    if (client_fd < 0 || !res) {
-        err.error.err_i16 = -1;
-        return err;
-    }
-
-    cwist_sstring *response_str = cwist_sstring_create();
-    size_t body_len = 0;
-    if (res->body && res->body->data) {
-        body_len = strlen(res->body->data);
-    }
+// Status line and headers, plus Content-Length / Connection when the handler
+// did not set them. Chunked heads carry Transfer-Encoding instead of any
+// Content-Length.
+static cwist_sstring *http_response_head(cwist_http_response *res, size_t body_len, bool chunked) {
+    cwist_sstring *head = cwist_sstring_create();
+    if (!head) return NULL;
+    cwist_sstring_reserve(head, 256);
 
     // Status Line
-    char status_line[256];
-    snprintf(status_line, sizeof(status_line), "%s %d %s\r\n",
-             res->version->data ? res->version->data : "HTTP/1.1",
-             res->status_code,
-             res->status_text->data ? res->status_text->data : "OK");
-    cwist_sstring_append(response_str, status_line);
+    cwist_sstring_append(head, res->version->data ? res->version->data : "HTTP/1.1");
+    cwist_sstring_append(head, " ");
+    cwist_sstring_append_int(head, res->status_code);
+    cwist_sstring_append(head, " ");
+    cwist_sstring_append(head, res->status_text->data ? res->status_text->data : "OK");
+    cwist_sstring_append(head, "\r\n");
 
     // Headers
     cwist_http_header_node *curr = res->headers;
     while (curr) {
-        if (curr->key->data && curr->value->data) {
-            cwist_sstring_append(response_str, curr->key->data);
-            cwist_sstring_append(response_str, ": ");
-            cwist_sstring_append(response_str, curr->value->data);
-            cwist_sstring_append(response_str, "\r\n");
+        bool skip = chunked && curr->key->data && cwist_sstring_equals_nocase(curr->key, "Content-Length");
+        if (curr->key->data && curr->value->data && !skip) {
+            cwist_sstring_append_sstring(head, curr->key);
+            cwist_sstring_append(head, ": ");
+            cwist_sstring_append_sstring(head, curr->value);
+            cwist_sstring_append(head, "\r\n");
         }
         curr = curr->next;
     }
 
-    if (!headers_have_content_length(res->headers)) {
-        char cl_header[64];
-        snprintf(cl_header, sizeof(cl_header), "Content-Length: %zu\r\n", body_len);
-        cwist_sstring_append(response_str, cl_header);
+    if (chunked) {
+        cwist_sstring_append(head, "Transfer-Encoding: chunked\r\n");
+    } else if (!headers_have_content_length(res->headers)) {
+        cwist_sstring_append(head, "Content-Length: ");
+        cwist_sstring_append_uint(head, body_len);
+        cwist_sstring_append(head, "\r\n");
     }
 
     if (!headers_have_connection(res->headers)) {
         if (res->keep_alive) {
-            cwist_sstring_append(response_str, "Connection: keep-alive\r\n");
+            cwist_sstring_append(head, "Connection: keep-alive\r\n");
         } else {
-            cwist_sstring_append(response_str, "Connection: close\r\n");
+            cwist_sstring_append(head, "Connection: close\r\n");
         }
     }
 
     // End of headers
-    cwist_sstring_append(response_str, "\r\n");
+    cwist_sstring_append(head, "\r\n");
+    return head;
+}
 
-    // Body
-    if (res->body && res->body->data) {
-        cwist_sstring_append(response_str, res->body->data);
-    }
-    // Send
-    err.error.err_i16 = 0;
+cwist_error_t cwist_writev_all(int fd, struct iovec *iov, size_t count) {
+    bool socket = true;
 
-    const char *p = response_str->data;
-    size_t left = response_str->size;
+    while (count > 0) {
+        // Drop finished (and empty) entries.
+        if (iov->iov_len == 0) {
+            iov++;
+            count--;
+            continue;
+        }
 
-    while (left > 0) {
+        int batch = count > IOV_MAX ? IOV_MAX : (int)count;
         ssize_t sent;
-
-        #ifdef MSG_NOSIGNAL
-        sent = send(client_fd, p, left, MSG_NOSIGNAL);
-        #else
-        sent = send(client_fd, p, left, 0);
-        #endif
-
-        if (sent < 0) {
-            if (errno == EINTR) {
+        if (socket) {
+            // sendmsg is writev with flags: MSG_NOSIGNAL keeps a closed peer
+            // from raising SIGPIPE.
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = (size_t)batch;
+            #ifdef MSG_NOSIGNAL
+            sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            #else
+            sent = sendmsg(fd, &msg, 0);
+            #endif
+            if (sent < 0 && errno == ENOTSOCK) {
+                socket = false;
                 continue;
             }
-            if (errno == EPIPE || errno == ECONNRESET) {
-                err.error.err_i16 = -1;
-                break;
-            }
-            err.error.err_i16 = -1;
-            break;
+        } else {
+            sent = writev(fd, iov, batch);
         }
-        if (sent == 0) {
-            err.error.err_i16 = -1;
-            break;
+
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, errno);
+        }
+        if (sent == 0) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EPIPE);
+
+        size_t done = (size_t)sent;
+        while (done > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (done > 0) {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, 0);
+}
+
+// Headers a 304 carries over from the 200 it stands for (RFC 9110 15.4.5).
+static const cwist_sview http_not_modified_keep[] = {
+    CWIST_SVIEW_LIT("ETag"), CWIST_SVIEW_LIT("Last-Modified"), CWIST_SVIEW_LIT("Cache-Control"),
+    CWIST_SVIEW_LIT("Vary"), CWIST_SVIEW_LIT("Date"), CWIST_SVIEW_LIT("Expires"),
+    CWIST_SVIEW_LIT("Content-Location"), CWIST_SVIEW_LIT("Connection"),
+};
+
+static bool http_not_modified_keeps(cwist_sview key) {
+    for (size_t i = 0; i < sizeof(http_not_modified_keep) / sizeof(http_not_modified_keep[0]); i++) {
+        if (cwist_sview_equals_nocase(key, http_not_modified_keep[i])) return true;
+    }
+    return false;
+}
+
+#define HTTP_NOT_MODIFIED_IOV 64
+
+// 304 fast path: the status line is a constant and header lines point into
+// the header list, so nothing is formatted or allocated. A header list too
+// long for one iov array goes out in several writes.
+static cwist_error_t http_send_not_modified(int client_fd, cwist_http_response *res) {
+    static const char status_11[] = "HTTP/1.1 304 Not Modified\r\n";
+    static const char status_tail[] = " 304 Not Modified\r\n";
+    static const char keep_alive[] = "Connection: keep-alive\r\n\r\n";
+    static const char close_line[] = "Connection: close\r\n\r\n";
+
+    struct iovec iov[HTTP_NOT_MODIFIED_IOV];
+    size_t n = 0;
+    cwist_sview version = cwist_sstring_view(res->version);
+    if (version.len == 0 || cwist_sview_equals(version, CWIST_SVIEW_LIT("HTTP/1.1"))) {
+        iov[n++] = (struct iovec){ (void *)status_11, sizeof(status_11) - 1 };
+    } else {
+        iov[n++] = (struct iovec){ (void *)version.ptr, version.len };
+        iov[n++] = (struct iovec){ (void *)status_tail, sizeof(status_tail) - 1 };
+    }
+
+    bool connection = false;
+    for (cwist_http_header_node *curr = res->headers; curr; curr = curr->next) {
+        if (!curr->key->data || !curr->value->data || !http_not_modified_keeps(cwist_sstring_view(curr->key))) continue;
+        if (n + 4 > HTTP_NOT_MODIFIED_IOV - 1) {
+            cwist_error_t err = cwist_writev_all(client_fd, iov, n);
+            if (cwist_error_code(err) != 0) return err;
+            n = 0;
         }
+        connection = connection || header_key_is_connection(cwist_sstring_view(curr->key));
+        iov[n++] = (struct iovec){ curr->key->data, curr->key->size };
+        iov[n++] = (struct iovec){ (void *)": ", 2 };
+        iov[n++] = (struct iovec){ curr->value->data, curr->value->size };
+        iov[n++] = (struct iovec){ (void *)"\r\n", 2 };
+    }
+
+    if (connection) iov[n++] = (struct iovec){ (void *)"\r\n", 2 };
+    else if (res->keep_alive) iov[n++] = (struct iovec){ (void *)keep_alive, sizeof(keep_alive) - 1 };
+    else iov[n++] = (struct iovec){ (void *)close_line, sizeof(close_line) - 1 };
+    return cwist_writev_all(client_fd, iov, n);
+}
 
-        p += (size_t)sent;
-        left -= (size_t)sent;
+// Head and body leave in one writev; the body is never copied.
+cwist_error_t cwist_http_send_response_iov(int client_fd, cwist_http_response *res, const struct iovec *body, size_t count) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+
+    if (client_fd < 0 || !res || (count > 0 && !body)) {
+        err.error.err_i16 = -1;
+        return err;
+    }
+
+    if (res->status_code == CWIST_HTTP_NOT_MODIFIED) {
+        if (cwist_error_code(http_send_not_modified(client_fd, res)) != 0) err.error.err_i16 = -1;
+        return err;
     }
 
-    cwist_sstring_destroy(response_str);
+    size_t body_len = 0;
+    for (size_t i = 0; i < count; i++) body_len += body[i].iov_len;
+
+    cwist_sstring *head = http_response_head(res, body_len, false);
+    struct iovec small[8];
+    struct iovec *iov = count + 1 <= sizeof(small) / sizeof(small[0]) ? small : malloc((count + 1) * sizeof(*iov));
+    if (!head || !iov) {
+        cwist_sstring_destroy(head);
+        err.error.err_i16 = -1;
+        return err;
+    }
+
+    iov[0].iov_base = head->data;
+    iov[0].iov_len = head->size;
+    if (count > 0) memcpy(iov + 1, body, count * sizeof(*iov));   // writev_all advances its copy
+
+    if (cwist_error_code(cwist_writev_all(client_fd, iov, count + 1)) != 0) err.error.err_i16 = -1;
+
+    if (iov != small) free(iov);
+    cwist_sstring_destroy(head);
+    return err;
+}
+
+cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res) {
+    struct iovec body = { NULL, 0 };
+    if (res && res->body && res->body->data) {
+        body.iov_base = res->body->data;
+        body.iov_len = res->body->size;
+    }
+    return cwist_http_send_response_iov(client_fd, res, &body, 1);
+}
+
+static cwist_error_t http_chunk_send(cwist_http_chunked_writer *writer, const void *data, size_t len) {
+    if (len == 0) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, 0);
+    char size[24];
+    int size_len = snprintf(size, sizeof(size), "%zx\r\n", len);
+    struct iovec iov[3] = {
+        { size, (size_t)size_len },
+        { (void *)data, len },
+        { (void *)"\r\n", 2 },
+    };
+    cwist_error_t err = cwist_writev_all(writer->fd, iov, 3);
+    if (cwist_error_code(err) != 0) writer->failed = true;
+    return err;
+}
+
+// Sends and clears the compressor's pending output.
+static cwist_error_t http_chunk_drain(cwist_http_chunked_writer *writer) {
+    cwist_error_t err = http_chunk_send(writer, writer->pending->data, writer->pending->size);
+    writer->pending->size = 0;
+    if (writer->pending->data) writer->pending->data[0] = '\0';
+    return err;
+}
+
+static cwist_error_t http_chunk_check(cwist_http_chunked_writer *writer) {
+    if (!writer || writer->fd < 0) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, writer->failed ? EPIPE : 0);
+}
+
+cwist_error_t cwist_http_chunked_begin(cwist_http_chunked_writer *writer, int client_fd, cwist_http_response *res,
+                                       cwist_encoding_t encoding) {
+    if (!writer) return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = client_fd;
+    if (client_fd < 0 || !res) {
+        writer->failed = true;
+        return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+    }
+
+    // A body the handler already encoded is passed through as is.
+    if (cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("Content-Encoding")).ptr) encoding = CWIST_ENCODING_IDENTITY;
+    if (encoding != CWIST_ENCODING_IDENTITY) {
+        writer->stream = cwist_compress_stream_create(encoding, 0);
+        writer->pending = cwist_sstring_create();
+        if (!writer->stream || !writer->pending) {
+            // Nothing is on the wire yet, so no terminator either.
+            cwist_compress_stream_destroy(writer->stream);
+            cwist_sstring_destroy(writer->pending);
+            writer->stream = NULL;
+            writer->pending = NULL;
+            writer->failed = true;
+            return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+        }
+        cwist_http_header_add_with(res->allocator, &res->headers, "Content-Encoding", cwist_encoding_name(encoding));
+        cwist_http_header_add_with(res->allocator, &res->headers, "Vary", "Accept-Encoding");
+    }
+
+    cwist_sstring *head = http_response_head(res, 0, true);
+    if (!head) {
+        writer->failed = true;
+        return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+    }
+    struct iovec iov = { head->data, head->size };
+    cwist_error_t err = cwist_writev_all(client_fd, &iov, 1);
+    if (cwist_error_code(err) != 0) writer->failed = true;
+    cwist_sstring_destroy(head);
+    return err;
+}
+
+cwist_error_t cwist_http_chunked_write(cwist_http_chunked_writer *writer, const void *data, size_t len) {
+    cwist_error_t err = http_chunk_check(writer);
+    if (cwist_error_code(err) != 0 || len == 0) return err;
+    if (!writer->stream) return http_chunk_send(writer, data, len);
+
+    err = cwist_compress_stream_write(writer->stream, cwist_sview_make(data, len), false, writer->pending);
+    if (cwist_error_code(err) != 0) return err;
+    return http_chunk_drain(writer);   // usually empty: zlib emits in blocks
+}
+
+cwist_error_t cwist_http_chunked_flush(cwist_http_chunked_writer *writer) {
+    cwist_error_t err = http_chunk_check(writer);
+    if (cwist_error_code(err) != 0 || !writer->stream) return err;
+    err = cwist_compress_stream_write(writer->stream, CWIST_SVIEW_LIT(""), true, writer->pending);
+    if (cwist_error_code(err) != 0) return err;
+    return http_chunk_drain(writer);
+}
+
+cwist_error_t cwist_http_chunked_end(cwist_http_chunked_writer *writer) {
+    cwist_error_t err = http_chunk_check(writer);
+    if (cwist_error_code(err) == 0 && writer->stream) {
+        err = cwist_compress_stream_finish(writer->stream, writer->pending);
+        if (cwist_error_code(err) == 0) err = http_chunk_drain(writer);
+    }
+    if (cwist_error_code(err) == 0) {
+        struct iovec iov = { (void *)"0\r\n\r\n", 5 };
+        err = cwist_writev_all(writer->fd, &iov, 1);
+    }
+    if (writer) {
+        cwist_compress_stream_destroy(writer->stream);
+        cwist_sstring_destroy(writer->pending);
+        writer->stream = NULL;
+        writer->pending = NULL;
+        writer->failed = true;   // nothing more may follow the last chunk
+    }
     return err;
 }
 
@@ -397,23 +1029,13 @@ int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint
   }
 
   if((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    cJSON *err_json = cJSON_CreateObject();
-    cJSON_AddStringToObject(err_json, "err", "Failed to create IPv4 socket");
-    char *cjson_error_log = cJSON_Print(err_json);
-    perror(cjson_error_log);
-    free(cjson_error_log);
-    cJSON_Delete(err_json);
+    cwist_log(CWIST_LOG_ERROR, "Failed to create IPv4 socket: %s", strerror(errno));
 
     return CWIST_CREATE_SOCKET_FAILED;
   }
 
   if(setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-    cJSON *err_json = cJSON_CreateObject();
-    cJSON_AddStringToObject(err_json, "err", "Failed to set up IPv4 socket options");
-    char *cjson_error_log = cJSON_Print(err_json);
-    perror(cjson_error_log);
-    free(cjson_error_log);
-    cJSON_Delete(err_json);
+    cwist_log(CWIST_LOG_ERROR, "Failed to set up IPv4 socket options: %s", strerror(errno));
 
     return CWIST_HTTP_SETSOCKOPT_FAILED;  
   }
@@ -423,27 +1045,13 @@ int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint
   sockv4->sin_port = htons(port);
 
   if(bind(server_fd, (struct sockaddr *)sockv4, sizeof(struct sockaddr_in)) < 0) {
-    cJSON *err_json = cJSON_CreateObject();
-    cJSON_AddStringToObject(err_json, "err", "Failed to bind IPv4 socket");
-    char *cjson_error_log = cJSON_Print(err_json);
-    perror(cjson_error_log);
-    free(cjson_error_log);
-    cJSON_Delete(err_json);
+    cwist_log(CWIST_LOG_ERROR, "Failed to bind IPv4 socket: %s", strerror(errno));
 
     return CWIST_HTTP_BIND_FAILED;
   }
 
   if(listen(server_fd, backlog) < 0) {
-    cJSON *err_json = cJSON_CreateObject();
-    char err_msg[128];
-    char err_format[128] = "Failed to listen at %s:%d";
-    snprintf(err_msg, 127, err_format, address, port);
-
-    cJSON_AddStringToObject(err_json, "err", err_msg);
-    char *cjson_error_log = cJSON_Print(err_json);
-    perror(cjson_error_log);
-    free(cjson_error_log);
-    cJSON_Delete(err_json);
+    cwist_log(CWIST_LOG_ERROR, "Failed to listen at %s:%d: %s", address, port, strerror(errno));
 
     return CWIST_HTTP_LISTEN_FAILED;
   }
@@ -485,15 +1093,10 @@ cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (
     if((client_fd = accept(server_fd, (struct sockaddr *)&peer_addr, &addrlen)) < 0) {
       if (errno == EINTR) continue;
 
-      cJSON *err_json = cJSON_CreateObject();
-      cJSON_AddStringToObject(err_json, "err", "Failed to accept socket");
-      char *cjson_error_log = cJSON_Print(err_json);
-      perror(cjson_error_log);
-      free(cjson_error_log);
-      cJSON_Delete(err_json);
+      cwist_log(CWIST_LOG_ERROR, "Failed to accept socket: %s", strerror(errno));
 
       if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK) {
-          fprintf(stderr, "Fatal socket error %d. Exiting accept loop.\n", errno);
+          cwist_log(CWIST_LOG_ERROR, "Fatal socket error %d. Exiting accept loop.", errno);
           break;
       }
       continue;
@@ -0,0 +1,248 @@
+#include <cwist/multipart.h>
+#include <cwist/simd.h>
+
+#include <errno.h>
+#include <string.h>
+
+enum multipart_state {
+    MP_PREAMBLE,        // before the first boundary; discarded
+    MP_BOUNDARY_TAIL,   // right after a delimiter: "--" closes, CRLF opens a part
+    MP_CLOSE_DASH,
+    MP_PADDING,         // transport padding before the CRLF
+    MP_BOUNDARY_LF,
+    MP_HEADERS,
+    MP_BODY,
+    MP_DONE,
+};
+
+// RFC 2046 bchars are printable; a boundary with CR or LF would break the
+// rule that a delimiter can only start at a CR.
+static bool multipart_boundary_ok(cwist_sview boundary) {
+    if (boundary.len == 0 || boundary.len > CWIST_MULTIPART_BOUNDARY_MAX) return false;
+    for (size_t i = 0; i < boundary.len; i++) {
+        unsigned char c = (unsigned char)boundary.ptr[i];
+        if (c < 0x20 || c > 0x7e) return false;
+    }
+    return boundary.ptr[boundary.len - 1] != ' ';
+}
+
+// Next `key=value` of a `; key=value; key="value"` list. Quoted values come
+// back without their quotes; a quoted ';' does not end the value.
+static bool multipart_next_param(cwist_sview *rest, cwist_sview *key, cwist_sview *value) {
+    const char *p = rest->ptr, *end = rest->ptr + rest->len;
+    while (p < end && (*p == ';' || *p == ' ' || *p == '\t')) p++;
+    if (p == end) return false;
+
+    const char *key_start = p;
+    while (p < end && *p != '=' && *p != ';') p++;
+    *key = cwist_sview_trim(cwist_sview_make(key_start, (size_t)(p - key_start)));
+    *value = cwist_sview_make(NULL, 0);
+    if (p < end && *p == '=') {
+        p++;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (p < end && *p == '"') {
+            const char *value_start = ++p;
+            while (p < end && *p != '"') p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            *value = cwist_sview_make(value_start, (size_t)(p - value_start));
+            if (p < end) p++;
+            while (p < end && *p != ';') p++;
+        } else {
+            const char *value_start = p;
+            while (p < end && *p != ';') p++;
+            *value = cwist_sview_trim(cwist_sview_make(value_start, (size_t)(p - value_start)));
+        }
+    }
+    rest->ptr = p;
+    rest->len = (size_t)(end - p);
+    return true;
+}
+
+bool cwist_multipart_boundary(cwist_sview content_type, cwist_sview *boundary) {
+    if (!boundary || !content_type.ptr) return false;
+    cwist_sview rest = content_type, type;
+    cwist_sview_split(&rest, ';', &type);
+    type = cwist_sview_trim(type);
+    const cwist_sview prefix = CWIST_SVIEW_LIT("multipart/");
+    if (type.len <= prefix.len || !cwist_sview_equals_nocase(cwist_sview_make(type.ptr, prefix.len), prefix)) return false;
+
+    cwist_sview key, value;
+    while (multipart_next_param(&rest, &key, &value)) {
+        if (cwist_sview_equals_nocase(key, CWIST_SVIEW_LIT("boundary"))) {
+            if (!multipart_boundary_ok(value)) return false;
+            *boundary = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+cwist_error_t cwist_multipart_parser_init(cwist_multipart_parser *parser, cwist_sview boundary,
+                                          const cwist_multipart_handlers *handlers, void *ctx) {
+    if (!parser || !multipart_boundary_ok(boundary)) {
+        return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, EINVAL);
+    }
+    parser->status = CWIST_MULTIPART_NEED_MORE;
+    parser->state = MP_PREAMBLE;
+    parser->handlers = handlers;
+    parser->ctx = ctx;
+    memcpy(parser->delimiter, "\r\n--", 4);
+    memcpy(parser->delimiter + 4, boundary.ptr, boundary.len);
+    parser->delimiter_len = 4 + boundary.len;
+    // The body may open with the boundary itself: act as if a CRLF preceded it.
+    parser->held = 2;
+    parser->header_len = 0;
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, 0);
+}
+
+static cwist_multipart_status_t multipart_stop(cwist_multipart_parser *parser, cwist_multipart_status_t status) {
+    parser->status = status;
+    return status;
+}
+
+static int multipart_data(cwist_multipart_parser *parser, const char *data, size_t len) {
+    if (len == 0 || parser->state != MP_BODY || !parser->handlers || !parser->handlers->on_part_data) return 0;
+    return parser->handlers->on_part_data(parser->ctx, data, len);
+}
+
+static int multipart_end(cwist_multipart_parser *parser) {
+    if (parser->state != MP_BODY || !parser->handlers || !parser->handlers->on_part_end) return 0;
+    return parser->handlers->on_part_end(parser->ctx);
+}
+
+// Parses the buffered header block and announces the part.
+static int multipart_begin(cwist_multipart_parser *parser) {
+    cwist_multipart_part part;
+    memset(&part, 0, sizeof(part));
+    part.headers = cwist_sview_make(parser->headers, parser->header_len > 4 ? parser->header_len - 4 : 0);
+
+    const cwist_sview crlf = CWIST_SVIEW_LIT("\r\n");
+    cwist_sview rest = cwist_sview_make(parser->headers, parser->header_len - 2);
+    while (rest.len > 0) {
+        size_t eol = cwist_sview_find(rest, crlf);
+        if (eol == CWIST_SVIEW_NPOS) break;
+        cwist_sview line = cwist_sview_make(rest.ptr, eol);
+        rest = cwist_sview_make(rest.ptr + eol + 2, rest.len - eol - 2);
+
+        size_t colon = cwist_sview_find_char(line, ':');
+        if (colon == CWIST_SVIEW_NPOS) continue;
+        cwist_sview name = cwist_sview_trim(cwist_sview_make(line.ptr, colon));
+        cwist_sview value = cwist_sview_trim(cwist_sview_make(line.ptr + colon + 1, line.len - colon - 1));
+
+        if (cwist_sview_equals_nocase(name, CWIST_SVIEW_LIT("Content-Type"))) {
+            part.content_type = value;
+        } else if (cwist_sview_equals_nocase(name, CWIST_SVIEW_LIT("Content-Disposition"))) {
+            cwist_sview params = value, disposition, key, param;
+            cwist_sview_split(&params, ';', &disposition);
+            while (multipart_next_param(&params, &key, &param)) {
+                if (!param.ptr) continue;
+                if (cwist_sview_equals_nocase(key, CWIST_SVIEW_LIT("name"))) part.name = param;
+                else if (cwist_sview_equals_nocase(key, CWIST_SVIEW_LIT("filename"))) part.filename = param;
+            }
+        }
+    }
+
+    if (!parser->handlers || !parser->handlers->on_part_begin) return 0;
+    return parser->handlers->on_part_begin(parser->ctx, &part);
+}
+
+cwist_multipart_status_t cwist_multipart_feed(cwist_multipart_parser *parser, const char *data, size_t len) {
+    if (!parser) return CWIST_MULTIPART_MALFORMED;
+    if (parser->status != CWIST_MULTIPART_NEED_MORE) return parser->status;
+    if (len > 0 && !data) return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+
+    const size_t dl = parser->delimiter_len;
+    size_t pos = 0;
+    while (pos < len) {
+        switch (parser->state) {
+            case MP_PREAMBLE:
+            case MP_BODY: {
+                // Finish a delimiter that began at the end of the last feed.
+                if (parser->held) {
+                    size_t want = dl - parser->held;
+                    size_t n = len - pos < want ? len - pos : want;
+                    if (memcmp(data + pos, parser->delimiter + parser->held, n) == 0) {
+                        pos += n;
+                        parser->held += n;
+                        if (n < want) break;
+                        parser->held = 0;
+                        if (multipart_end(parser)) return multipart_stop(parser, CWIST_MULTIPART_ABORTED);
+                        parser->state = MP_BOUNDARY_TAIL;
+                        break;
+                    }
+                    // Not a delimiter after all: the held bytes were data.
+                    if (multipart_data(parser, parser->delimiter, parser->held)) {
+                        return multipart_stop(parser, CWIST_MULTIPART_ABORTED);
+                    }
+                    parser->held = 0;
+                }
+
+                size_t at = cwist_simd_find(data + pos, len - pos, parser->delimiter, dl);
+                if (at != (size_t)-1) {
+                    if (multipart_data(parser, data + pos, at) || multipart_end(parser)) {
+                        return multipart_stop(parser, CWIST_MULTIPART_ABORTED);
+                    }
+                    pos += at + dl;
+                    parser->state = MP_BOUNDARY_TAIL;
+                    break;
+                }
+
+                // Hold back a tail that may be the start of a delimiter. The
+                // delimiter's only CR is its first byte, so only a CR can start one.
+                size_t rest = len - pos, keep = 0;
+                for (size_t i = rest > dl - 1 ? rest - (dl - 1) : 0; i < rest; i++) {
+                    if (data[pos + i] == '\r' && memcmp(data + pos + i, parser->delimiter, rest - i) == 0) {
+                        keep = rest - i;
+                        break;
+                    }
+                }
+                if (multipart_data(parser, data + pos, rest - keep)) return multipart_stop(parser, CWIST_MULTIPART_ABORTED);
+                parser->held = keep;
+                pos = len;
+                break;
+            }
+            case MP_BOUNDARY_TAIL: {
+                char c = data[pos++];
+                if (c == '-') parser->state = MP_CLOSE_DASH;
+                else if (c == '\r') parser->state = MP_BOUNDARY_LF;
+                else if (c == ' ' || c == '\t') parser->state = MP_PADDING;
+                else return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+                break;
+            }
+            case MP_CLOSE_DASH:
+                if (data[pos++] != '-') return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+                parser->state = MP_DONE;
+                return multipart_stop(parser, CWIST_MULTIPART_DONE);
+            case MP_PADDING: {
+                char c = data[pos++];
+                if (c == '\r') parser->state = MP_BOUNDARY_LF;
+                else if (c != ' ' && c != '\t') return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+                break;
+            }
+            case MP_BOUNDARY_LF:
+                if (data[pos++] != '\n') return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+                parser->state = MP_HEADERS;
+                parser->header_len = 0;
+                break;
+            case MP_HEADERS: {
+                if (parser->header_len == sizeof(parser->headers)) return multipart_stop(parser, CWIST_MULTIPART_MALFORMED);
+                parser->headers[parser->header_len++] = data[pos++];
+                size_t n = parser->header_len;
+                bool ended = (n == 2 && memcmp(parser->headers, "\r\n", 2) == 0) ||
+                             (n >= 4 && memcmp(parser->headers + n - 4, "\r\n\r\n", 4) == 0);
+                if (!ended) break;
+                if (multipart_begin(parser)) return multipart_stop(parser, CWIST_MULTIPART_ABORTED);
+                parser->state = MP_BODY;
+                break;
+            }
+            default:
+                pos = len;
+                break;
+        }
+    }
+    return parser->status;
+}
+
+int cwist_multipart_on_body(void *ctx, const char *data, size_t len) {
+    cwist_multipart_status_t status = cwist_multipart_feed((cwist_multipart_parser *)ctx, data, len);
+    return status == CWIST_MULTIPART_MALFORMED || status == CWIST_MULTIPART_ABORTED;
+}
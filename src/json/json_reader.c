@@ -0,0 +1,646 @@
+#include <cwist/json.h>
+#include <cwist/http.h>
+#include <cwist/simd.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_KEY_STACK 256     // keys up to this length decode on the stack
+
+struct json_chunk {
+    struct json_chunk *next;
+    size_t size;
+    char data[];
+};
+
+enum json_expect {
+    JSON_EXPECT_VALUE,
+    JSON_EXPECT_VALUE_OR_CLOSE,   // right after '['
+    JSON_EXPECT_KEY,
+    JSON_EXPECT_KEY_OR_CLOSE,     // right after '{'
+    JSON_EXPECT_COLON,
+    JSON_EXPECT_AFTER_VALUE,      // ',' or the closer
+};
+
+static cwist_error_t json_status(int8_t code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_JSON, CWIST_ERR_INT8, code);
+}
+
+static cwist_error_t json_no_memory(void) {
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+}
+
+static const cwist_json_value json_missing = { NULL, 0 };
+
+/* --- Structural index --- */
+
+// Bit i becomes the parity of bits 0..i: 1 from an opening quote up to, not
+// including, its closing quote.
+static inline uint64_t json_prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Bytes preceded by an odd run of backslashes. Backslashes are rare enough
+// that walking them one by one beats the branch-free carry arithmetic;
+// *carry says the previous block ended on an escaping backslash.
+static uint64_t json_escaped(uint64_t backslash, uint64_t *carry) {
+    uint64_t escaped = *carry;
+    *carry = 0;
+    while (backslash) {
+        unsigned i = (unsigned)__builtin_ctzll(backslash);
+        backslash &= backslash - 1;
+        if ((escaped >> i) & 1) continue;   // a literal backslash
+        if (i == 63) *carry = 1;
+        else escaped |= (uint64_t)1 << (i + 1);
+    }
+    return escaped;
+}
+
+static inline bool json_is_op(char c) {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+static inline bool json_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Offsets of every token outside strings, 64 bytes per step: operators,
+// opening quotes and the first byte of each bare word (number, literal).
+static cwist_error_t json_index(cwist_json_doc *doc) {
+    size_t cap = doc->len / 8 + 16;
+    uint32_t *tokens = cwist_alloc(doc->allocator, cap * sizeof(uint32_t));
+    if (!tokens) return json_no_memory();
+
+    size_t count = 0;
+    uint64_t escape_carry = 0;
+    uint64_t in_string = 0;       // all ones while a string spans blocks
+    uint64_t word_carry = 0;      // the previous block ended inside a bare word
+    char pad[CWIST_SIMD_JSON_BLOCK];
+
+    for (size_t base = 0; base < doc->len; base += CWIST_SIMD_JSON_BLOCK) {
+        const char *block = doc->json + base;
+        size_t left = doc->len - base;
+        if (left < CWIST_SIMD_JSON_BLOCK) {
+            memset(pad, ' ', sizeof(pad));
+            memcpy(pad, block, left);
+            block = pad;
+        }
+
+        cwist_simd_json_masks m;
+        cwist_simd_json_classify(block, &m);
+
+        uint64_t escaped = (m.backslash | escape_carry) ? json_escaped(m.backslash, &escape_carry) : 0;
+        uint64_t quotes = m.quote & ~escaped;
+        uint64_t strings = json_prefix_xor(quotes) ^ in_string;
+        in_string = 0 - (strings >> 63);
+
+        uint64_t outside = ~(strings | quotes);
+        uint64_t words = ~(m.space | m.op) & outside;
+        uint64_t word_starts = words & ~((words << 1) | word_carry);
+        word_carry = words >> 63;
+
+        uint64_t found = (m.op & outside) | (quotes & strings) | word_starts;
+        size_t need = count + (size_t)__builtin_popcountll(found);
+        if (need > cap) {
+            size_t grown = cap * 2 > need ? cap * 2 : need;
+            uint32_t *next = cwist_realloc(doc->allocator, tokens, cap * sizeof(uint32_t), grown * sizeof(uint32_t));
+            if (!next) {
+                cwist_free(doc->allocator, tokens, cap * sizeof(uint32_t));
+                return json_no_memory();
+            }
+            tokens = next;
+            cap = grown;
+        }
+        while (found) {
+            tokens[count++] = (uint32_t)(base + (unsigned)__builtin_ctzll(found));
+            found &= found - 1;
+        }
+    }
+
+    doc->tokens = tokens;
+    doc->count = count;
+    doc->close = NULL;
+    if (in_string) return json_status(ERR_JSON_SYNTAX);   // unterminated string
+    return json_status(ERR_JSON_OKAY);
+}
+
+static inline bool json_word_start(char c) {
+    return c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n';
+}
+
+// Checks the token sequence against the JSON grammar and links each opener to
+// its closer. Bare words only have their first byte checked here.
+static cwist_error_t json_link(cwist_json_doc *doc) {
+    if (doc->count == 0) return json_status(ERR_JSON_SYNTAX);
+    doc->close = cwist_alloc(doc->allocator, doc->count * sizeof(uint32_t));
+    if (!doc->close) return json_no_memory();
+
+    uint32_t stack[CWIST_JSON_MAX_NESTING];
+    size_t depth = 0;
+    enum json_expect expect = JSON_EXPECT_VALUE;
+
+    for (uint32_t i = 0; i < doc->count; i++) {
+        char c = doc->json[doc->tokens[i]];
+        bool closes = false;
+
+        switch (expect) {
+            case JSON_EXPECT_VALUE_OR_CLOSE:
+                if (c == ']') {
+                    closes = true;
+                    break;
+                }
+                /* fall through */
+            case JSON_EXPECT_VALUE:
+                if (c == '{' || c == '[') {
+                    if (depth == CWIST_JSON_MAX_NESTING) return json_status(ERR_JSON_TOO_DEEP);
+                    stack[depth++] = i;
+                    expect = c == '{' ? JSON_EXPECT_KEY_OR_CLOSE : JSON_EXPECT_VALUE_OR_CLOSE;
+                    continue;
+                }
+                if (c != '"' && !json_word_start(c)) return json_status(ERR_JSON_SYNTAX);
+                expect = JSON_EXPECT_AFTER_VALUE;
+                continue;
+            case JSON_EXPECT_KEY_OR_CLOSE:
+                if (c == '}') {
+                    closes = true;
+                    break;
+                }
+                /* fall through */
+            case JSON_EXPECT_KEY:
+                if (c != '"') return json_status(ERR_JSON_SYNTAX);
+                expect = JSON_EXPECT_COLON;
+                continue;
+            case JSON_EXPECT_COLON:
+                if (c != ':') return json_status(ERR_JSON_SYNTAX);
+                expect = JSON_EXPECT_VALUE;
+                continue;
+            case JSON_EXPECT_AFTER_VALUE: {
+                if (depth == 0) return json_status(ERR_JSON_SYNTAX);   // trailing token
+                bool object = doc->json[doc->tokens[stack[depth - 1]]] == '{';
+                if (c == ',') {
+                    expect = object ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+                    continue;
+                }
+                if (c != (object ? '}' : ']')) return json_status(ERR_JSON_SYNTAX);
+                closes = true;
+                break;
+            }
+        }
+
+        if (closes) {
+            doc->close[stack[--depth]] = i;
+            expect = JSON_EXPECT_AFTER_VALUE;
+        }
+    }
+
+    if (depth != 0 || expect != JSON_EXPECT_AFTER_VALUE) return json_status(ERR_JSON_SYNTAX);
+    return json_status(ERR_JSON_OKAY);
+}
+
+cwist_error_t cwist_json_doc_parse(cwist_json_doc *doc, cwist_sview json, const cwist_allocator *allocator) {
+    if (!doc) return json_status(ERR_JSON_SYNTAX);
+    memset(doc, 0, sizeof(*doc));
+    doc->allocator = allocator ? allocator : cwist_allocator_default();
+    if (!json.ptr || json.len >= UINT32_MAX) return json_status(ERR_JSON_SYNTAX);
+    if (!cwist_sview_utf8_valid(json)) return json_status(ERR_JSON_ENCODING);
+
+    doc->json = json.ptr;
+    doc->len = json.len;
+    cwist_error_t err = json_index(doc);
+    if (cwist_error_code(err) == 0) err = json_link(doc);
+    if (cwist_error_code(err) != 0) cwist_json_doc_release(doc);
+    return err;
+}
+
+cwist_error_t cwist_http_request_json(cwist_http_request *req, cwist_json_doc *doc) {
+    if (!req) return json_status(ERR_JSON_SYNTAX);
+    return cwist_json_doc_parse(doc, cwist_http_request_body_view(req), req->allocator);
+}
+
+void cwist_json_doc_release(cwist_json_doc *doc) {
+    if (!doc || !doc->allocator) return;
+    cwist_free(doc->allocator, doc->tokens, 0);
+    cwist_free(doc->allocator, doc->close, doc->count * sizeof(uint32_t));
+    struct json_chunk *chunk = doc->chunks;
+    while (chunk) {
+        struct json_chunk *next = chunk->next;
+        cwist_free(doc->allocator, chunk, sizeof(*chunk) + chunk->size);
+        chunk = next;
+    }
+    doc->tokens = NULL;
+    doc->close = NULL;
+    doc->chunks = NULL;
+    doc->count = 0;
+}
+
+/* --- Token helpers --- */
+
+static inline char json_token(const cwist_json_doc *doc, uint32_t pos) {
+    return doc->json[doc->tokens[pos]];
+}
+
+static inline bool json_is_container(char c) {
+    return c == '{' || c == '[';
+}
+
+// Position right after the value at pos: a ',' or the parent's closer.
+static inline uint32_t json_skip(const cwist_json_doc *doc, uint32_t pos) {
+    return json_is_container(json_token(doc, pos)) ? doc->close[pos] + 1 : pos + 1;
+}
+
+// Bytes between the quotes of the string token at pos. The closing quote is
+// the first one not preceded by an odd run of backslashes.
+static cwist_sview json_string_body(const cwist_json_doc *doc, uint32_t pos) {
+    size_t start = doc->tokens[pos] + 1;
+    size_t at = start;
+    for (;;) {
+        const char *quote = memchr(doc->json + at, '"', doc->len - at);
+        at = (size_t)(quote - doc->json);
+        size_t slashes = 0;
+        while (at - slashes > start && doc->json[at - slashes - 1] == '\\') slashes++;
+        if ((slashes & 1) == 0) return cwist_sview_make(doc->json + start, at - start);
+        at++;
+    }
+}
+
+// A bare word runs to the next whitespace, operator or quote.
+static cwist_sview json_word(const cwist_json_doc *doc, uint32_t pos) {
+    size_t start = doc->tokens[pos];
+    size_t end = start;
+    while (end < doc->len && !json_is_space(doc->json[end]) && !json_is_op(doc->json[end]) && doc->json[end] != '"') end++;
+    return cwist_sview_make(doc->json + start, end - start);
+}
+
+// RFC 8259: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool json_number_valid(cwist_sview text) {
+    size_t i = 0, n = text.len;
+    const char *p = text.ptr;
+    if (i < n && p[i] == '-') i++;
+    if (i == n) return false;
+    if (p[i] == '0') i++;
+    else if (p[i] >= '1' && p[i] <= '9') while (i < n && p[i] >= '0' && p[i] <= '9') i++;
+    else return false;
+    if (i < n && p[i] == '.') {
+        size_t digits = ++i;
+        while (i < n && p[i] >= '0' && p[i] <= '9') i++;
+        if (i == digits) return false;
+    }
+    if (i < n && (p[i] == 'e' || p[i] == 'E')) {
+        i++;
+        if (i < n && (p[i] == '+' || p[i] == '-')) i++;
+        size_t digits = i;
+        while (i < n && p[i] >= '0' && p[i] <= '9') i++;
+        if (i == digits) return false;
+    }
+    return i == n;
+}
+
+static bool json_is_integer(cwist_sview text) {
+    return json_number_valid(text) && cwist_sview_find_first_of(text, CWIST_SVIEW_LIT(".eE")) == CWIST_SVIEW_NPOS;
+}
+
+static int json_hex4(const char *p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+static size_t json_put_utf8(char *dst, uint32_t cp) {
+    if (cp < 0x80) {
+        dst[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = (char)(0xC0 | (cp >> 6));
+        dst[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = (char)(0xE0 | (cp >> 12));
+        dst[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    dst[0] = (char)(0xF0 | (cp >> 18));
+    dst[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Decodes a string body into dst, which needs room for raw.len bytes (no
+// escape decodes longer than it is written). Returns the decoded length, or
+// SIZE_MAX on a bad escape, a lone surrogate or a raw control character.
+static size_t json_unescape(cwist_sview raw, char *dst) {
+    const char *p = raw.ptr;
+    const char *end = raw.ptr + raw.len;
+    size_t out = 0;
+
+    while (p < end) {
+        const char *slash = memchr(p, '\\', (size_t)(end - p));
+        size_t plain = slash ? (size_t)(slash - p) : (size_t)(end - p);
+        for (size_t i = 0; i < plain; i++) {
+            if ((unsigned char)p[i] < 0x20) return SIZE_MAX;
+        }
+        memcpy(dst + out, p, plain);
+        out += plain;
+        p += plain;
+        if (!slash) break;
+
+        if (end - p < 2) return SIZE_MAX;
+        char c = p[1];
+        p += 2;
+        switch (c) {
+            case '"':  dst[out++] = '"'; break;
+            case '\\': dst[out++] = '\\'; break;
+            case '/':  dst[out++] = '/'; break;
+            case 'b':  dst[out++] = '\b'; break;
+            case 'f':  dst[out++] = '\f'; break;
+            case 'n':  dst[out++] = '\n'; break;
+            case 'r':  dst[out++] = '\r'; break;
+            case 't':  dst[out++] = '\t'; break;
+            case 'u': {
+                int unit = end - p >= 4 ? json_hex4(p) : -1;
+                if (unit < 0) return SIZE_MAX;
+                p += 4;
+                uint32_t cp = (uint32_t)unit;
+                if (cp >= 0xDC00 && cp <= 0xDFFF) return SIZE_MAX;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    int low = end - p >= 6 && p[0] == '\\' && p[1] == 'u' ? json_hex4(p + 2) : -1;
+                    if (low < 0xDC00 || low > 0xDFFF) return SIZE_MAX;
+                    p += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + ((uint32_t)low - 0xDC00);
+                }
+                out += json_put_utf8(dst + out, cp);
+                break;
+            }
+            default:
+                return SIZE_MAX;
+        }
+    }
+    return out;
+}
+
+/* --- Navigation --- */
+
+cwist_json_value cwist_json_root(cwist_json_doc *doc) {
+    if (!doc || !doc->close) return json_missing;
+    cwist_json_value root = { doc, 0 };
+    return root;
+}
+
+cwist_json_type_t cwist_json_type(cwist_json_value value) {
+    if (!value.doc) return CWIST_JSON_MISSING;
+    switch (json_token(value.doc, value.pos)) {
+        case '{': return CWIST_JSON_OBJECT;
+        case '[': return CWIST_JSON_ARRAY;
+        case '"': return CWIST_JSON_STRING;
+        default: break;
+    }
+    cwist_sview word = json_word(value.doc, value.pos);
+    if (cwist_sview_equals(word, CWIST_SVIEW_LIT("true")) || cwist_sview_equals(word, CWIST_SVIEW_LIT("false"))) {
+        return CWIST_JSON_BOOL;
+    }
+    if (cwist_sview_equals(word, CWIST_SVIEW_LIT("null"))) return CWIST_JSON_NULL;
+    return json_number_valid(word) ? CWIST_JSON_NUMBER : CWIST_JSON_INVALID;
+}
+
+cwist_json_iter cwist_json_iterate(cwist_json_value container) {
+    cwist_json_iter iter = { json_missing, 0 };
+    if (!container.doc || !json_is_container(json_token(container.doc, container.pos))) return iter;
+    iter.container = container;
+    iter.pos = container.pos + 1;
+    return iter;
+}
+
+bool cwist_json_iter_next(cwist_json_iter *iter, cwist_sview *raw_key, cwist_json_value *value) {
+    if (!iter || !iter->container.doc) return false;
+    cwist_json_doc *doc = iter->container.doc;
+    uint32_t end = doc->close[iter->container.pos];
+    if (iter->pos >= end) return false;
+
+    uint32_t at = iter->pos;
+    if (json_token(doc, iter->container.pos) == '{') {
+        if (raw_key) *raw_key = json_string_body(doc, at);
+        at += 2;   // key, ':'
+    } else if (raw_key) {
+        *raw_key = cwist_sview_make(NULL, 0);
+    }
+
+    if (value) {
+        value->doc = doc;
+        value->pos = at;
+    }
+    uint32_t next = json_skip(doc, at);
+    iter->pos = next < end ? next + 1 : end;
+    return true;
+}
+
+static bool json_key_matches(cwist_sview raw, cwist_sview key) {
+    if (!memchr(raw.ptr, '\\', raw.len)) return cwist_sview_equals(raw, key);
+    if (key.len > raw.len) return false;   // escapes only shrink
+
+    char small[JSON_KEY_STACK];
+    char *buf = raw.len <= sizeof(small) ? small : malloc(raw.len);
+    if (!buf) return false;
+    size_t len = json_unescape(raw, buf);
+    bool match = len == key.len && memcmp(buf, key.ptr, len) == 0;
+    if (buf != small) free(buf);
+    return match;
+}
+
+cwist_json_value cwist_json_get_view(cwist_json_value object, cwist_sview key) {
+    if (!object.doc || json_token(object.doc, object.pos) != '{' || !key.ptr) return json_missing;
+    cwist_json_iter iter = cwist_json_iterate(object);
+    cwist_sview raw;
+    cwist_json_value member;
+    while (cwist_json_iter_next(&iter, &raw, &member)) {
+        if (json_key_matches(raw, key)) return member;
+    }
+    return json_missing;
+}
+
+cwist_json_value cwist_json_get(cwist_json_value object, const char *key) {
+    return cwist_json_get_view(object, cwist_sview_from_cstr(key));
+}
+
+cwist_json_value cwist_json_at(cwist_json_value array, size_t index) {
+    if (!array.doc || json_token(array.doc, array.pos) != '[') return json_missing;
+    cwist_json_iter iter = cwist_json_iterate(array);
+    cwist_json_value element;
+    while (cwist_json_iter_next(&iter, NULL, &element)) {
+        if (index-- == 0) return element;
+    }
+    return json_missing;
+}
+
+size_t cwist_json_size(cwist_json_value container) {
+    cwist_json_iter iter = cwist_json_iterate(container);
+    size_t count = 0;
+    while (cwist_json_iter_next(&iter, NULL, NULL)) count++;
+    return count;
+}
+
+/* --- Scalars --- */
+
+static cwist_sview json_scalar_word(cwist_json_value value) {
+    if (!value.doc) return cwist_sview_make(NULL, 0);
+    char c = json_token(value.doc, value.pos);
+    if (json_is_container(c) || c == '"') return cwist_sview_make(NULL, 0);
+    return json_word(value.doc, value.pos);
+}
+
+bool cwist_json_get_int64(cwist_json_value value, int64_t *out) {
+    cwist_sview word = json_scalar_word(value);
+    return json_is_integer(word) && cwist_sview_to_int64(word, out);
+}
+
+bool cwist_json_get_uint64(cwist_json_value value, uint64_t *out) {
+    cwist_sview word = json_scalar_word(value);
+    return json_is_integer(word) && word.ptr[0] != '-' && cwist_sview_to_uint64(word, 10, out);
+}
+
+bool cwist_json_get_double(cwist_json_value value, double *out) {
+    cwist_sview word = json_scalar_word(value);
+    return json_number_valid(word) && cwist_sview_to_double(word, out);
+}
+
+bool cwist_json_get_bool(cwist_json_value value, bool *out) {
+    cwist_sview word = json_scalar_word(value);
+    bool is_true = cwist_sview_equals(word, CWIST_SVIEW_LIT("true"));
+    if (!is_true && !cwist_sview_equals(word, CWIST_SVIEW_LIT("false"))) return false;
+    if (out) *out = is_true;
+    return true;
+}
+
+bool cwist_json_is_null(cwist_json_value value) {
+    return cwist_sview_equals(json_scalar_word(value), CWIST_SVIEW_LIT("null"));
+}
+
+cwist_sview cwist_json_raw_string(cwist_json_value value) {
+    if (!value.doc || json_token(value.doc, value.pos) != '"') return cwist_sview_make(NULL, 0);
+    return json_string_body(value.doc, value.pos);
+}
+
+const char *cwist_json_get_string(cwist_json_value value, size_t *len) {
+    cwist_sview raw = cwist_json_raw_string(value);
+    if (!raw.ptr) return NULL;
+
+    cwist_json_doc *doc = value.doc;
+    struct json_chunk *chunk = cwist_alloc(doc->allocator, sizeof(*chunk) + raw.len + 1);
+    if (!chunk) return NULL;
+    chunk->size = raw.len + 1;
+    size_t decoded = json_unescape(raw, chunk->data);
+    if (decoded == SIZE_MAX) {
+        cwist_free(doc->allocator, chunk, sizeof(*chunk) + chunk->size);
+        return NULL;
+    }
+    chunk->data[decoded] = '\0';
+    chunk->next = doc->chunks;
+    doc->chunks = chunk;
+    if (len) *len = decoded;
+    return chunk->data;
+}
+
+cwist_sview cwist_json_value_text(cwist_json_value value) {
+    if (!value.doc) return cwist_sview_make(NULL, 0);
+    const cwist_json_doc *doc = value.doc;
+    size_t start = doc->tokens[value.pos];
+    char c = json_token(doc, value.pos);
+    if (json_is_container(c)) {
+        return cwist_sview_make(doc->json + start, doc->tokens[doc->close[value.pos]] + 1 - start);
+    }
+    if (c == '"') {
+        cwist_sview body = json_string_body(doc, value.pos);
+        return cwist_sview_make(doc->json + start, body.len + 2);
+    }
+    return json_word(doc, value.pos);
+}
+
+/* --- cJSON bridge --- */
+
+// Decoded, NUL-terminated copy of a string body; small ones use the caller's
+// stack buffer, the rest are malloc'd and freed by the caller.
+static char *json_decode_temp(cwist_sview raw, char *small, size_t small_size) {
+    char *buf = raw.len < small_size ? small : malloc(raw.len + 1);
+    if (!buf) return NULL;
+    size_t len = json_unescape(raw, buf);
+    if (len == SIZE_MAX) {
+        if (buf != small) free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+cJSON *cwist_json_to_cjson(cwist_json_value value) {
+    char small[JSON_KEY_STACK];
+
+    switch (cwist_json_type(value)) {
+        case CWIST_JSON_NULL:
+            return cJSON_CreateNull();
+        case CWIST_JSON_BOOL: {
+            bool flag = false;
+            cwist_json_get_bool(value, &flag);
+            return cJSON_CreateBool(flag);
+        }
+        case CWIST_JSON_NUMBER: {
+            double number;
+            return cwist_json_get_double(value, &number) ? cJSON_CreateNumber(number) : NULL;
+        }
+        case CWIST_JSON_STRING: {
+            char *text = json_decode_temp(cwist_json_raw_string(value), small, sizeof(small));
+            if (!text) return NULL;
+            cJSON *item = cJSON_CreateString(text);
+            if (text != small) free(text);
+            return item;
+        }
+        case CWIST_JSON_ARRAY:
+        case CWIST_JSON_OBJECT: {
+            bool object = cwist_json_type(value) == CWIST_JSON_OBJECT;
+            cJSON *container = object ? cJSON_CreateObject() : cJSON_CreateArray();
+            if (!container) return NULL;
+
+            cwist_json_iter iter = cwist_json_iterate(value);
+            cwist_sview raw_key;
+            cwist_json_value child;
+            while (cwist_json_iter_next(&iter, &raw_key, &child)) {
+                cJSON *item = cwist_json_to_cjson(child);
+                if (!item) {
+                    cJSON_Delete(container);
+                    return NULL;
+                }
+                if (!object) {
+                    cJSON_AddItemToArray(container, item);
+                    continue;
+                }
+                char *key = json_decode_temp(raw_key, small, sizeof(small));
+                if (!key) {
+                    cJSON_Delete(item);
+                    cJSON_Delete(container);
+                    return NULL;
+                }
+                cJSON_AddItemToObject(container, key, item);
+                if (key != small) free(key);
+            }
+            return container;
+        }
+        default:
+            return NULL;
+    }
+}
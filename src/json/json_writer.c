@@ -0,0 +1,243 @@
+#include <cwist/json.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_DOUBLE_EXACT 9007199254740992.0   // 2^53
+#define JSON_INDENT 2
+
+static const char json_spaces[CWIST_JSON_MAX_DEPTH * JSON_INDENT + 1] =
+    "                                                                "
+    "                                                                ";
+
+static cwist_error_t json_status(int8_t code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_JSON, CWIST_ERR_INT8, code);
+}
+
+static bool json_failed(const cwist_json_writer *writer) {
+    return writer->err.error.err_i8 != 0;
+}
+
+static cwist_error_t json_fail(cwist_json_writer *writer, int8_t code) {
+    if (!json_failed(writer)) writer->err = json_status(code);
+    return writer->err;
+}
+
+// Keeps the first sstring failure (fixed-size body, out of memory).
+static bool json_append(cwist_json_writer *writer, cwist_sview text) {
+    if (json_failed(writer)) return false;
+    cwist_error_t err = cwist_sstring_append_view(writer->out, text);
+    if (err.error.err_i8 != ERR_SSTRING_OKAY) {
+        writer->err = err;
+        return false;
+    }
+    return true;
+}
+
+static bool json_check(cwist_json_writer *writer, cwist_error_t err) {
+    if (err.error.err_i8 != ERR_SSTRING_OKAY && !json_failed(writer)) writer->err = err;
+    return !json_failed(writer);
+}
+
+// Container at depth d (1-based) uses bit d - 1.
+static uint64_t json_bit(unsigned depth) {
+    return (uint64_t)1 << (depth - 1);
+}
+
+static void json_newline(cwist_json_writer *writer, unsigned depth) {
+    if (!writer->pretty) return;
+    json_append(writer, CWIST_SVIEW_LIT("\n"));
+    json_append(writer, cwist_sview_make(json_spaces, depth * JSON_INDENT));
+}
+
+// Comma, indentation and placement checks ahead of any value.
+static bool json_before_value(cwist_json_writer *writer) {
+    if (json_failed(writer)) return false;
+
+    if (writer->depth == 0) {
+        if (writer->done) {
+            json_fail(writer, ERR_JSON_MISPLACED);
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t bit = json_bit(writer->depth);
+    if (writer->in_object & bit) {
+        if (!writer->after_key) {
+            json_fail(writer, ERR_JSON_MISPLACED);
+            return false;
+        }
+        writer->after_key = false;   // the key already placed the separator
+        return true;
+    }
+
+    if (writer->has_items & bit) json_append(writer, CWIST_SVIEW_LIT(","));
+    writer->has_items |= bit;
+    json_newline(writer, writer->depth);
+    return !json_failed(writer);
+}
+
+static cwist_error_t json_after_value(cwist_json_writer *writer) {
+    if (writer->depth == 0 && !json_failed(writer)) writer->done = true;
+    return writer->err;
+}
+
+void cwist_json_writer_init(cwist_json_writer *writer, cwist_sstring *out, bool pretty) {
+    if (!writer) return;
+    memset(writer, 0, sizeof(*writer));
+    writer->out = out;
+    writer->pretty = pretty;
+    writer->err = out ? json_status(ERR_JSON_OKAY) : cwist_error_make(CWIST_ERRDOMAIN_SSTRING, CWIST_ERR_INT8, ERR_SSTRING_NULL_STRING);
+}
+
+cwist_error_t cwist_json_writer_finish(cwist_json_writer *writer) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_failed(writer) && (writer->depth != 0 || writer->after_key)) json_fail(writer, ERR_JSON_UNBALANCED);
+    return writer->err;
+}
+
+/* --- Containers --- */
+
+static cwist_error_t json_begin(cwist_json_writer *writer, bool object) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    if (writer->depth == CWIST_JSON_MAX_DEPTH) return json_fail(writer, ERR_JSON_TOO_DEEP);
+
+    json_append(writer, object ? CWIST_SVIEW_LIT("{") : CWIST_SVIEW_LIT("["));
+    writer->depth++;
+    uint64_t bit = json_bit(writer->depth);
+    if (object) writer->in_object |= bit;
+    else writer->in_object &= ~bit;
+    writer->has_items &= ~bit;
+    return writer->err;
+}
+
+static cwist_error_t json_end(cwist_json_writer *writer, bool object) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (json_failed(writer)) return writer->err;
+    if (writer->depth == 0) return json_fail(writer, ERR_JSON_UNBALANCED);
+
+    uint64_t bit = json_bit(writer->depth);
+    if (((writer->in_object & bit) != 0) != object) return json_fail(writer, ERR_JSON_UNBALANCED);
+    if (writer->after_key) return json_fail(writer, ERR_JSON_MISPLACED);
+
+    writer->depth--;
+    if (writer->has_items & bit) json_newline(writer, writer->depth);
+    json_append(writer, object ? CWIST_SVIEW_LIT("}") : CWIST_SVIEW_LIT("]"));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_begin_object(cwist_json_writer *writer) {
+    return json_begin(writer, true);
+}
+
+cwist_error_t cwist_json_end_object(cwist_json_writer *writer) {
+    return json_end(writer, true);
+}
+
+cwist_error_t cwist_json_begin_array(cwist_json_writer *writer) {
+    return json_begin(writer, false);
+}
+
+cwist_error_t cwist_json_end_array(cwist_json_writer *writer) {
+    return json_end(writer, false);
+}
+
+/* --- Keys and scalars --- */
+
+cwist_error_t cwist_json_key_view(cwist_json_writer *writer, cwist_sview key) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (json_failed(writer)) return writer->err;
+    if (writer->depth == 0 || !(writer->in_object & json_bit(writer->depth)) || writer->after_key || !key.ptr) {
+        return json_fail(writer, ERR_JSON_MISPLACED);
+    }
+
+    uint64_t bit = json_bit(writer->depth);
+    if (writer->has_items & bit) json_append(writer, CWIST_SVIEW_LIT(","));
+    writer->has_items |= bit;
+    json_newline(writer, writer->depth);
+
+    json_append(writer, CWIST_SVIEW_LIT("\""));
+    if (!json_failed(writer)) json_check(writer, cwist_sstring_append_json_escaped(writer->out, key));
+    json_append(writer, writer->pretty ? CWIST_SVIEW_LIT("\": ") : CWIST_SVIEW_LIT("\":"));
+    writer->after_key = true;
+    return writer->err;
+}
+
+cwist_error_t cwist_json_key(cwist_json_writer *writer, const char *key) {
+    return cwist_json_key_view(writer, cwist_sview_from_cstr(key));
+}
+
+cwist_error_t cwist_json_string_view(cwist_json_writer *writer, cwist_sview value) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!value.ptr) return cwist_json_null(writer);
+    if (!json_before_value(writer)) return writer->err;
+
+    json_append(writer, CWIST_SVIEW_LIT("\""));
+    if (!json_failed(writer)) json_check(writer, cwist_sstring_append_json_escaped(writer->out, value));
+    json_append(writer, CWIST_SVIEW_LIT("\""));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_string(cwist_json_writer *writer, const char *value) {
+    return cwist_json_string_view(writer, cwist_sview_from_cstr(value));
+}
+
+cwist_error_t cwist_json_int(cwist_json_writer *writer, int64_t value) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    json_check(writer, cwist_sstring_append_int(writer->out, value));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_uint(cwist_json_writer *writer, uint64_t value) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    json_check(writer, cwist_sstring_append_uint(writer->out, value));
+    return json_after_value(writer);
+}
+
+// Integral values take the digit-pair path; the rest try 15 significant
+// digits and fall back to 17 only when 15 does not read back exactly.
+cwist_error_t cwist_json_double(cwist_json_writer *writer, double value) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!isfinite(value)) return cwist_json_null(writer);
+    if (!json_before_value(writer)) return writer->err;
+
+    double magnitude = value < 0 ? -value : value;
+    if (magnitude < JSON_DOUBLE_EXACT && value == (double)(int64_t)value) {
+        json_check(writer, cwist_sstring_append_int(writer->out, (int64_t)value));
+        return json_after_value(writer);
+    }
+
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.15g", value);
+    if (strtod(buf, NULL) != value) len = snprintf(buf, sizeof(buf), "%.17g", value);
+    json_append(writer, cwist_sview_make(buf, (size_t)len));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_bool(cwist_json_writer *writer, bool value) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    json_append(writer, value ? CWIST_SVIEW_LIT("true") : CWIST_SVIEW_LIT("false"));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_null(cwist_json_writer *writer) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    json_append(writer, CWIST_SVIEW_LIT("null"));
+    return json_after_value(writer);
+}
+
+cwist_error_t cwist_json_raw(cwist_json_writer *writer, cwist_sview json) {
+    if (!writer) return json_status(ERR_JSON_MISPLACED);
+    if (!json.ptr || json.len == 0) return json_fail(writer, ERR_JSON_MISPLACED);
+    if (!json_before_value(writer)) return writer->err;
+    json_append(writer, json);
+    return json_after_value(writer);
+}
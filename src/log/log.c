@@ -0,0 +1,573 @@
+#include <cwist/log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_CACHE_LINE 64
+#define LOG_DEFAULT_RING 1024
+#define LOG_DEFAULT_INTERVAL_MS 10
+#define LOG_LINE_MAX 1024           // one formatted record, truncated beyond
+#define LOG_BATCH_SIZE (64 * 1024)  // bytes handed to a single write()
+
+// One record is two cache lines; the text area takes whatever the header leaves.
+struct log_record {
+    uint64_t timestamp_ns;
+    const char *format;
+    uint64_t args[CWIST_LOG_MAX_ARGS];
+    uint8_t level;
+    uint8_t nargs;
+    uint8_t text_len;
+    char text[CWIST_LOG_TEXT_MAX];   // %s arguments, each NUL-terminated
+};
+
+_Static_assert(sizeof(struct log_record) <= 2 * LOG_CACHE_LINE, "log record grew past two cache lines");
+
+// head is only written by the drainer, tail and dropped only by the owning
+// thread; they sit on separate lines so the two sides do not false-share.
+struct log_ring {
+    _Atomic size_t head __attribute__((aligned(LOG_CACHE_LINE)));
+    uint64_t dropped_seen;                 // drainer's copy of dropped
+    _Atomic size_t tail __attribute__((aligned(LOG_CACHE_LINE)));
+    _Atomic uint64_t dropped;
+    bool retired __attribute__((aligned(LOG_CACHE_LINE)));   // owner exited; guarded by log_registry_lock
+    size_t mask;
+    struct log_ring *next;
+    struct log_record records[];
+};
+
+// Records arrive roughly in time order, so the date part is reused until the
+// second changes.
+struct log_clock {
+    time_t sec;
+    char stamp[32];
+};
+
+/* --- Shared state --- */
+
+// Guards the ring list and the output; held by whoever drains.
+static pthread_mutex_t log_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_ring *log_rings = NULL;
+
+static _Atomic bool log_running = false;
+static _Atomic bool log_in_child = false;
+static _Atomic int log_min_level = CWIST_LOG_DEBUG;
+static size_t log_ring_records = LOG_DEFAULT_RING;
+static unsigned log_interval_ms = LOG_DEFAULT_INTERVAL_MS;
+static int log_fd = STDOUT_FILENO;
+static bool log_owns_fd = false;
+
+static _Atomic uint64_t log_written = 0;
+static _Atomic uint64_t log_dropped_retired = 0;   // dropped counts of freed rings
+
+static pthread_t log_writer;
+static pthread_mutex_t log_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_wake_cond = PTHREAD_COND_INITIALIZER;
+static bool log_stop = false;
+
+// Drainer-side state, guarded by log_registry_lock.
+static char log_batch[LOG_BATCH_SIZE];
+static size_t log_batch_len = 0;
+static struct log_clock log_batch_clock = { (time_t)-1, "" };
+
+static _Thread_local struct log_ring *log_thread_ring = NULL;
+static pthread_once_t log_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_key;
+
+const char *cwist_log_level_name(cwist_log_level_t level) {
+    switch (level) {
+        case CWIST_LOG_DEBUG: return "DEBUG";
+        case CWIST_LOG_INFO:  return "INFO";
+        case CWIST_LOG_WARN:  return "WARN";
+        case CWIST_LOG_ERROR: return "ERROR";
+        default:              return "?";
+    }
+}
+
+/* --- Format walking --- */
+
+enum log_length { LOG_LEN_NONE, LOG_LEN_HH, LOG_LEN_H, LOG_LEN_L, LOG_LEN_LL, LOG_LEN_J, LOG_LEN_Z, LOG_LEN_T, LOG_LEN_BIG_L };
+
+struct log_spec {
+    const char *start;       // the '%'
+    const char *length_at;   // first length-modifier byte (or the conversion)
+    const char *end;         // one past the conversion
+    enum log_length length;
+    char conv;               // 0: unsupported, stop here
+};
+
+// Finds the next conversion at or after p, stepping over "%%".
+// Returns false when the format has no more conversions.
+static bool log_next_spec(const char *p, struct log_spec *spec) {
+    for (;;) {
+        p = strchr(p, '%');
+        if (!p) return false;
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+        break;
+    }
+
+    spec->start = p++;
+    while (*p && strchr("-+ #0", *p)) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    spec->length_at = p;
+    spec->length = LOG_LEN_NONE;
+    switch (*p) {
+        case 'h': spec->length = p[1] == 'h' ? LOG_LEN_HH : LOG_LEN_H; p += p[1] == 'h' ? 2 : 1; break;
+        case 'l': spec->length = p[1] == 'l' ? LOG_LEN_LL : LOG_LEN_L; p += p[1] == 'l' ? 2 : 1; break;
+        case 'j': spec->length = LOG_LEN_J; p++; break;
+        case 'z': spec->length = LOG_LEN_Z; p++; break;
+        case 't': spec->length = LOG_LEN_T; p++; break;
+        case 'L': spec->length = LOG_LEN_BIG_L; p++; break;
+        default: break;
+    }
+
+    spec->conv = *p && strchr("diuxXocpseEfFgGaA", *p) ? *p : 0;
+    spec->end = spec->conv ? p + 1 : p;
+    return true;
+}
+
+static int64_t log_pull_signed(enum log_length length, va_list *args) {
+    switch (length) {
+        case LOG_LEN_HH: return (signed char)va_arg(*args, int);
+        case LOG_LEN_H:  return (short)va_arg(*args, int);
+        case LOG_LEN_L:  return va_arg(*args, long);
+        case LOG_LEN_LL: return va_arg(*args, long long);
+        case LOG_LEN_J:  return va_arg(*args, intmax_t);
+        case LOG_LEN_Z:  return (int64_t)va_arg(*args, size_t);
+        case LOG_LEN_T:  return va_arg(*args, ptrdiff_t);
+        default:         return va_arg(*args, int);
+    }
+}
+
+static uint64_t log_pull_unsigned(enum log_length length, va_list *args) {
+    switch (length) {
+        case LOG_LEN_HH: return (unsigned char)va_arg(*args, unsigned int);
+        case LOG_LEN_H:  return (unsigned short)va_arg(*args, unsigned int);
+        case LOG_LEN_L:  return va_arg(*args, unsigned long);
+        case LOG_LEN_LL: return va_arg(*args, unsigned long long);
+        case LOG_LEN_J:  return va_arg(*args, uintmax_t);
+        case LOG_LEN_Z:  return va_arg(*args, size_t);
+        case LOG_LEN_T:  return (uint64_t)va_arg(*args, ptrdiff_t);
+        default:         return va_arg(*args, unsigned int);
+    }
+}
+
+// Copies the raw arguments into the record; no formatting happens here.
+static void log_capture(struct log_record *rec, const char *format, va_list *args) {
+    struct log_spec spec;
+    const char *p = format;
+    rec->nargs = 0;
+    rec->text_len = 0;
+    rec->text[CWIST_LOG_TEXT_MAX - 1] = '\0';
+
+    while (rec->nargs < CWIST_LOG_MAX_ARGS && log_next_spec(p, &spec) && spec.conv) {
+        uint64_t *slot = &rec->args[rec->nargs++];
+        switch (spec.conv) {
+            case 'd': case 'i': case 'c':
+                *slot = (uint64_t)log_pull_signed(spec.length, args);
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                *slot = log_pull_unsigned(spec.length, args);
+                break;
+            case 'p':
+                *slot = (uint64_t)(uintptr_t)va_arg(*args, void *);
+                break;
+            case 's': {
+                const char *s = va_arg(*args, const char *);
+                if (!s) s = "(null)";
+                // The last text byte is always NUL, so a full area still yields "".
+                size_t room = CWIST_LOG_TEXT_MAX - 1 - rec->text_len;
+                size_t len = strnlen(s, room ? room - 1 : 0);
+                *slot = rec->text_len;
+                if (room) {
+                    memcpy(rec->text + rec->text_len, s, len);
+                    rec->text[rec->text_len + len] = '\0';
+                    rec->text_len = (uint8_t)(rec->text_len + len + 1);
+                }
+                break;
+            }
+            default: {
+                double d = spec.length == LOG_LEN_BIG_L ? (double)va_arg(*args, long double) : va_arg(*args, double);
+                memcpy(slot, &d, sizeof(d));
+                break;
+            }
+        }
+        p = spec.end;
+    }
+}
+
+static size_t log_put(char *out, size_t cap, size_t len, const char *data, size_t n) {
+    if (len >= cap) return len;
+    if (n > cap - len) n = cap - len;
+    memcpy(out + len, data, n);
+    return len + n;
+}
+
+static size_t log_putf(char *out, size_t cap, size_t len, const char *spec, ...) __attribute__((format(printf, 4, 5)));
+static size_t log_putf(char *out, size_t cap, size_t len, const char *spec, ...) {
+    if (len >= cap) return len;
+    va_list args;
+    va_start(args, spec);
+    int n = vsnprintf(out + len, cap - len + 1, spec, args);
+    va_end(args);
+    if (n < 0) return len;
+    return (size_t)n > cap - len ? cap : len + (size_t)n;
+}
+
+// Copies literal text, turning "%%" into '%'.
+static size_t log_put_literal(char *out, size_t cap, size_t len, const char *from, const char *to) {
+    while (from < to) {
+        const char *pct = memchr(from, '%', (size_t)(to - from));
+        if (!pct) return log_put(out, cap, len, from, (size_t)(to - from));
+        len = log_put(out, cap, len, from, (size_t)(pct - from) + 1);
+        from = pct + (pct + 1 < to && pct[1] == '%' ? 2 : 1);
+    }
+    return len;
+}
+
+// Rebuilds one conversion with a length modifier matching the stored type.
+static size_t log_put_arg(char *out, size_t cap, size_t len, const struct log_record *rec,
+                          const struct log_spec *spec, uint64_t raw) {
+    char fmt[32];
+    size_t prefix = (size_t)(spec->length_at - spec->start);
+    if (prefix > sizeof(fmt) - 4) prefix = sizeof(fmt) - 4;
+    memcpy(fmt, spec->start, prefix);
+    size_t f = prefix;
+
+    switch (spec->conv) {
+        case 'd': case 'i':
+            fmt[f++] = 'l'; fmt[f++] = 'l'; fmt[f++] = spec->conv; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, (long long)(int64_t)raw);
+        case 'u': case 'x': case 'X': case 'o':
+            fmt[f++] = 'l'; fmt[f++] = 'l'; fmt[f++] = spec->conv; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, (unsigned long long)raw);
+        case 'c':
+            fmt[f++] = 'c'; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, (int)(int64_t)raw);
+        case 'p':
+            fmt[f++] = 'p'; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, (void *)(uintptr_t)raw);
+        case 's':
+            fmt[f++] = 's'; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, rec->text + (raw < CWIST_LOG_TEXT_MAX ? raw : CWIST_LOG_TEXT_MAX - 1));
+        default: {
+            double d;
+            memcpy(&d, &raw, sizeof(d));
+            fmt[f++] = spec->conv; fmt[f] = '\0';
+            return log_putf(out, cap, len, fmt, d);
+        }
+    }
+}
+
+// Formats "2026-01-02T03:04:05.678901Z LEVEL message\n" into out (cap >= 2).
+static size_t log_format_record(const struct log_record *rec, struct log_clock *clock, char *out, size_t cap) {
+    cap--;   // room for the newline
+    time_t sec = (time_t)(rec->timestamp_ns / 1000000000ull);
+    if (sec != clock->sec) {
+        struct tm tm;
+        gmtime_r(&sec, &tm);
+        strftime(clock->stamp, sizeof(clock->stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+        clock->sec = sec;
+    }
+    size_t len = log_putf(out, cap, 0, "%s.%06uZ %-5s ", clock->stamp,
+                          (unsigned)(rec->timestamp_ns % 1000000000ull / 1000),
+                          cwist_log_level_name((cwist_log_level_t)rec->level));
+
+    const char *p = rec->format;
+    struct log_spec spec;
+    for (uint8_t i = 0; log_next_spec(p, &spec); i++) {
+        len = log_put_literal(out, cap, len, p, spec.start);
+        if (!spec.conv || i >= rec->nargs) {
+            // Unsupported or beyond the captured arguments: show it verbatim.
+            p = spec.start;
+            break;
+        }
+        len = log_put_arg(out, cap, len, rec, &spec, rec->args[i]);
+        p = spec.end;
+    }
+    len = log_put_literal(out, cap, len, p, p + strlen(p));
+    out[len++] = '\n';
+    return len;
+}
+
+/* --- Output --- */
+
+static void log_write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;   // nowhere left to report it
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void log_batch_flush(void) {
+    if (log_batch_len == 0) return;
+    log_write_all(log_fd, log_batch, log_batch_len);
+    log_batch_len = 0;
+}
+
+// Caller holds log_registry_lock.
+static void log_batch_record(const struct log_record *rec) {
+    if (LOG_BATCH_SIZE - log_batch_len < LOG_LINE_MAX) log_batch_flush();
+    log_batch_len += log_format_record(rec, &log_batch_clock, log_batch + log_batch_len, LOG_LINE_MAX);
+}
+
+static void log_note_drops(uint64_t dropped) {
+    struct log_record note = { 0 };
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    note.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    note.format = "log: dropped %llu records (ring full)";
+    note.level = CWIST_LOG_WARN;
+    note.nargs = 1;
+    note.args[0] = dropped;
+    log_batch_record(&note);
+}
+
+// Empties every ring and frees the ones whose thread is gone.
+// Caller holds log_registry_lock.
+static void log_drain_locked(void) {
+    struct log_ring **link = &log_rings;
+    while (*link) {
+        struct log_ring *ring = *link;
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (size_t at = head; at != tail; at++) {
+            log_batch_record(&ring->records[at & ring->mask]);
+        }
+        atomic_fetch_add_explicit(&log_written, tail - head, memory_order_relaxed);
+        atomic_store_explicit(&ring->head, tail, memory_order_release);
+
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->dropped_seen) {
+            log_note_drops(dropped - ring->dropped_seen);
+            ring->dropped_seen = dropped;
+        }
+
+        if (ring->retired) {
+            atomic_fetch_add_explicit(&log_dropped_retired, dropped, memory_order_relaxed);
+            *link = ring->next;
+            free(ring);
+            continue;
+        }
+        link = &ring->next;
+    }
+    log_batch_flush();
+}
+
+void cwist_log_flush(void) {
+    pthread_mutex_lock(&log_registry_lock);
+    log_drain_locked();
+    pthread_mutex_unlock(&log_registry_lock);
+}
+
+// Before init, after shutdown and in forked children: format and write now.
+static void log_write_sync(cwist_log_level_t level, const char *format, va_list *args) {
+    struct log_record rec;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    rec.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    rec.format = format;
+    rec.level = (uint8_t)level;
+    log_capture(&rec, format, args);
+
+    struct log_clock clock = { (time_t)-1, "" };
+    char line[LOG_LINE_MAX];
+    size_t len = log_format_record(&rec, &clock, line, sizeof(line));
+    log_write_all(STDERR_FILENO, line, len);
+}
+
+/* --- Per-thread rings --- */
+
+static void log_thread_exit(void *ring_ptr) {
+    struct log_ring *ring = ring_ptr;
+    if (atomic_load(&log_in_child)) return;   // the registry lock may be stale after fork
+
+    pthread_mutex_lock(&log_registry_lock);
+    if (atomic_load(&log_running)) {
+        ring->retired = true;                 // the drainer frees it once empty
+    } else {
+        log_drain_locked();
+        for (struct log_ring **link = &log_rings; *link; link = &(*link)->next) {
+            if (*link == ring) {
+                *link = ring->next;
+                break;
+            }
+        }
+        atomic_fetch_add_explicit(&log_dropped_retired, atomic_load(&ring->dropped), memory_order_relaxed);
+        free(ring);
+    }
+    pthread_mutex_unlock(&log_registry_lock);
+}
+
+static void log_forked_child(void) {
+    atomic_store(&log_in_child, true);
+    atomic_store(&log_running, false);
+}
+
+static void log_key_init(void) {
+    pthread_key_create(&log_key, log_thread_exit);
+    pthread_atfork(NULL, NULL, log_forked_child);
+}
+
+// The only lock on the producer side: once per thread, on its first record.
+static struct log_ring *log_ring_for_thread(void) {
+    if (log_thread_ring) return log_thread_ring;
+    pthread_once(&log_key_once, log_key_init);
+
+    size_t records = 1;
+    while (records < log_ring_records) records <<= 1;
+    struct log_ring *ring = aligned_alloc(LOG_CACHE_LINE,
+        (sizeof(struct log_ring) + records * sizeof(struct log_record) + LOG_CACHE_LINE - 1) & ~(size_t)(LOG_CACHE_LINE - 1));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(*ring));
+    ring->mask = records - 1;
+
+    pthread_mutex_lock(&log_registry_lock);
+    ring->next = log_rings;
+    log_rings = ring;
+    pthread_mutex_unlock(&log_registry_lock);
+
+    pthread_setspecific(log_key, ring);
+    log_thread_ring = ring;
+    return ring;
+}
+
+void cwist_log(cwist_log_level_t level, const char *format, ...) {
+    if (!format || (int)level < atomic_load_explicit(&log_min_level, memory_order_relaxed)) return;
+
+    va_list args;
+    va_start(args, format);
+    if (!atomic_load_explicit(&log_running, memory_order_acquire)) {
+        log_write_sync(level, format, &args);
+        va_end(args);
+        return;
+    }
+
+    struct log_ring *ring = log_ring_for_thread();
+    if (!ring) {
+        va_end(args);
+        return;
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    struct log_record *rec = &ring->records[tail & ring->mask];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    rec->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    rec->format = format;
+    rec->level = (uint8_t)level;
+    log_capture(rec, format, &args);
+    va_end(args);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/* --- Writer thread --- */
+
+static void *log_writer_main(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&log_wake_lock);
+    while (!log_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += log_interval_ms / 1000;
+        deadline.tv_nsec += (long)(log_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&log_wake_cond, &log_wake_lock, &deadline);
+        if (log_stop) break;
+
+        pthread_mutex_unlock(&log_wake_lock);
+        cwist_log_flush();
+        pthread_mutex_lock(&log_wake_lock);
+    }
+    pthread_mutex_unlock(&log_wake_lock);
+    return NULL;
+}
+
+bool cwist_log_init(const cwist_log_config *config) {
+    if (atomic_load(&log_running)) return false;
+
+    int fd = STDOUT_FILENO;
+    if (config && config->path) {
+        fd = open(config->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+    }
+
+    pthread_mutex_lock(&log_registry_lock);
+    log_fd = fd;
+    log_owns_fd = config && config->path;
+    log_ring_records = config && config->ring_records ? config->ring_records : LOG_DEFAULT_RING;
+    log_interval_ms = config && config->flush_interval_ms ? config->flush_interval_ms : LOG_DEFAULT_INTERVAL_MS;
+    atomic_store(&log_min_level, config ? (int)config->min_level : CWIST_LOG_DEBUG);
+    pthread_mutex_unlock(&log_registry_lock);
+
+    log_stop = false;
+    if (pthread_create(&log_writer, NULL, log_writer_main, NULL) != 0) {
+        if (log_owns_fd) close(fd);
+        log_fd = STDOUT_FILENO;
+        log_owns_fd = false;
+        return false;
+    }
+    atomic_store_explicit(&log_running, true, memory_order_release);
+    return true;
+}
+
+void cwist_log_shutdown(void) {
+    if (!atomic_load(&log_running)) return;
+    atomic_store(&log_running, false);
+
+    pthread_mutex_lock(&log_wake_lock);
+    log_stop = true;
+    pthread_cond_signal(&log_wake_cond);
+    pthread_mutex_unlock(&log_wake_lock);
+    pthread_join(log_writer, NULL);
+
+    pthread_mutex_lock(&log_registry_lock);
+    log_drain_locked();
+    if (log_owns_fd) close(log_fd);
+    log_fd = STDOUT_FILENO;
+    log_owns_fd = false;
+    pthread_mutex_unlock(&log_registry_lock);
+}
+
+void cwist_log_get_stats(cwist_log_stats *stats) {
+    if (!stats) return;
+    pthread_mutex_lock(&log_registry_lock);
+    uint64_t dropped = atomic_load_explicit(&log_dropped_retired, memory_order_relaxed);
+    for (struct log_ring *ring = log_rings; ring; ring = ring->next) {
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&log_registry_lock);
+    stats->written = atomic_load_explicit(&log_written, memory_order_relaxed);
+    stats->dropped = dropped;
+}
@@ -0,0 +1,280 @@
+#include <cwist/allocator.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cjson/cJSON.h>
+
+/* --- libc --- */
+
+static void *libc_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *libc_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void libc_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+static const cwist_allocator libc_allocator = { libc_alloc, libc_realloc, libc_free, NULL };
+
+static _Atomic(const cwist_allocator *) default_allocator = &libc_allocator;
+
+const cwist_allocator *cwist_allocator_libc(void) {
+    return &libc_allocator;
+}
+
+const cwist_allocator *cwist_allocator_default(void) {
+    return atomic_load_explicit(&default_allocator, memory_order_acquire);
+}
+
+void cwist_allocator_set_default(const cwist_allocator *allocator) {
+    atomic_store_explicit(&default_allocator, allocator ? allocator : &libc_allocator, memory_order_release);
+}
+
+/* --- Counting wrapper --- */
+
+static void *counting_alloc(void *ctx, size_t size) {
+    cwist_counting_allocator *counter = ctx;
+    counter->stats.allocs++;
+    counter->stats.bytes_requested += size;
+    return cwist_alloc(counter->parent, size);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    cwist_counting_allocator *counter = ctx;
+    if (ptr) counter->stats.reallocs++;
+    else counter->stats.allocs++;
+    counter->stats.bytes_requested += new_size;
+    return cwist_realloc(counter->parent, ptr, old_size, new_size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+    cwist_counting_allocator *counter = ctx;
+    counter->stats.frees++;
+    cwist_free(counter->parent, ptr, size);
+}
+
+void cwist_counting_allocator_init(cwist_counting_allocator *counter, const cwist_allocator *parent) {
+    if (!counter) return;
+    memset(counter, 0, sizeof(*counter));
+    counter->parent = parent ? parent : cwist_allocator_default();
+    counter->base.alloc = counting_alloc;
+    counter->base.realloc = counting_realloc;
+    counter->base.free = counting_free;
+    counter->base.ctx = counter;
+}
+
+/* --- Small-object pool --- */
+
+#define POOL_BLOCK_SIZE (64 * 1024)
+#define POOL_MIN_SHIFT 4                // 16-byte smallest class
+#define POOL_HEADER 16                  // class, and size for large chunks; keeps payloads aligned
+#define POOL_LARGE CWIST_POOL_CLASS_COUNT
+
+// Every pool chunk carries its class (large ones also their size) so
+// free/realloc never trust caller sizes.
+static int pool_class_for(size_t size) {
+    size_t class_size = (size_t)1 << POOL_MIN_SHIFT;
+    for (int i = 0; i < CWIST_POOL_CLASS_COUNT; i++) {
+        if (size <= class_size) return i;
+        class_size <<= 1;
+    }
+    return POOL_LARGE;
+}
+
+static size_t pool_class_size(int size_class) {
+    return (size_t)1 << (POOL_MIN_SHIFT + size_class);
+}
+
+static void *pool_alloc(void *ctx, size_t size) {
+    cwist_pool_allocator *pool = ctx;
+    int size_class = pool_class_for(size);
+    size_t chunk = POOL_HEADER + (size_class == POOL_LARGE ? size : pool_class_size(size_class));
+    uint8_t *raw;
+
+    if (size_class == POOL_LARGE) {
+        raw = cwist_alloc(pool->parent, chunk);
+        if (!raw) return NULL;
+    } else if (pool->free_lists[size_class]) {
+        raw = pool->free_lists[size_class];
+        pool->free_lists[size_class] = *(void **)(raw + POOL_HEADER);
+    } else {
+        if (!pool->cursor || (size_t)(pool->limit - pool->cursor) < chunk) {
+            uint8_t *block = cwist_alloc(pool->parent, POOL_BLOCK_SIZE);
+            if (!block) return NULL;
+            *(void **)block = pool->blocks;
+            pool->blocks = block;
+            pool->cursor = (char *)block + POOL_HEADER;
+            pool->limit = (char *)block + POOL_BLOCK_SIZE;
+        }
+        raw = (uint8_t *)pool->cursor;
+        pool->cursor += chunk;
+    }
+
+    *(uint32_t *)raw = (uint32_t)size_class;
+    if (size_class == POOL_LARGE) *(size_t *)(raw + sizeof(size_t)) = size;
+    return raw + POOL_HEADER;
+}
+
+static void pool_free(void *ctx, void *ptr, size_t size) {
+    (void)size;
+    cwist_pool_allocator *pool = ctx;
+    uint8_t *raw = (uint8_t *)ptr - POOL_HEADER;
+    int size_class = (int)*(uint32_t *)raw;
+
+    if (size_class == POOL_LARGE) {
+        cwist_free(pool->parent, raw, 0);
+        return;
+    }
+    *(void **)ptr = pool->free_lists[size_class];
+    pool->free_lists[size_class] = raw;
+}
+
+static void *pool_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return pool_alloc(ctx, new_size);
+
+    cwist_pool_allocator *pool = ctx;
+    uint8_t *raw = (uint8_t *)ptr - POOL_HEADER;
+    int size_class = (int)*(uint32_t *)raw;
+    size_t held = size_class == POOL_LARGE ? *(size_t *)(raw + sizeof(size_t)) : pool_class_size(size_class);
+    if (size_class != POOL_LARGE && new_size <= held) {
+        return ptr;
+    }
+    if (size_class == POOL_LARGE && pool_class_for(new_size) == POOL_LARGE) {
+        raw = cwist_realloc(pool->parent, raw, POOL_HEADER + held, POOL_HEADER + new_size);
+        if (!raw) return NULL;
+        *(size_t *)(raw + sizeof(size_t)) = new_size;
+        return raw + POOL_HEADER;
+    }
+
+    void *grown = pool_alloc(ctx, new_size);
+    if (!grown) return NULL;
+    memcpy(grown, ptr, held < new_size ? held : new_size);
+    pool_free(ctx, ptr, old_size);
+    return grown;
+}
+
+void cwist_pool_allocator_init(cwist_pool_allocator *pool, const cwist_allocator *parent) {
+    if (!pool) return;
+    memset(pool, 0, sizeof(*pool));
+    pool->parent = parent ? parent : cwist_allocator_libc();
+    pool->base.alloc = pool_alloc;
+    pool->base.realloc = pool_realloc;
+    pool->base.free = pool_free;
+    pool->base.ctx = pool;
+}
+
+// Large chunks still outstanding are the caller's leak; blocks are reclaimed wholesale.
+void cwist_pool_allocator_destroy(cwist_pool_allocator *pool) {
+    if (!pool) return;
+    void *block = pool->blocks;
+    while (block) {
+        void *next = *(void **)block;
+        cwist_free(pool->parent, block, POOL_BLOCK_SIZE);
+        block = next;
+    }
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->blocks = NULL;
+    pool->cursor = pool->limit = NULL;
+}
+
+/* --- cJSON --- */
+
+// cJSON hooks carry no context: the process-wide target is global and the
+// per-thread binding (cwist_allocator_bind_cjson) is thread-local.
+static _Atomic(const cwist_allocator *) cjson_allocator = &libc_allocator;
+static _Thread_local cwist_cjson_binding cjson_binding;
+static pthread_once_t cjson_hooks_once = PTHREAD_ONCE_INIT;
+
+// Ranged bindings no longer current (ended, or shadowed by a nested scope).
+// Their trees may still be deleted, so frees keep routing to them until
+// cwist_allocator_forget_cjson. Oldest entries drop off when full.
+#define CJSON_RETAINED_MAX 16
+static _Thread_local cwist_cjson_binding cjson_retained[CJSON_RETAINED_MAX];
+static _Thread_local size_t cjson_retained_count;
+
+static bool cjson_range_owns(const cwist_cjson_binding *binding, const void *ptr) {
+    return (uintptr_t)ptr - (uintptr_t)binding->base < binding->size;
+}
+
+static bool cjson_binding_owns(const void *ptr) {
+    return cjson_binding.size == 0 || cjson_range_owns(&cjson_binding, ptr);
+}
+
+static void cjson_retained_remove(const void *base) {
+    size_t kept = 0;
+    for (size_t i = 0; i < cjson_retained_count; i++) {
+        if (cjson_retained[i].base != base) cjson_retained[kept++] = cjson_retained[i];
+    }
+    cjson_retained_count = kept;
+}
+
+static void cjson_retained_add(cwist_cjson_binding binding) {
+    cjson_retained_remove(binding.base);
+    if (cjson_retained_count == CJSON_RETAINED_MAX) {
+        memmove(cjson_retained, cjson_retained + 1, (CJSON_RETAINED_MAX - 1) * sizeof(cjson_retained[0]));
+        cjson_retained_count--;
+    }
+    cjson_retained[cjson_retained_count++] = binding;
+}
+
+static void *cjson_hook_malloc(size_t size) {
+    if (cjson_binding.allocator) {
+        void *ptr = cwist_alloc(cjson_binding.allocator, size);
+        // Out of room: a ranged binding can fall back, since the free hook
+        // sends blocks outside the range to the process-wide allocator.
+        if (ptr || cjson_binding.size == 0) return ptr;
+    }
+    const cwist_allocator *a = atomic_load_explicit(&cjson_allocator, memory_order_acquire);
+    return cwist_alloc(a, size);
+}
+
+static void cjson_hook_free(void *ptr) {
+    if (!ptr) return;
+    if (cjson_binding.allocator && cjson_binding_owns(ptr)) {
+        cwist_free(cjson_binding.allocator, ptr, 0);
+        return;
+    }
+    for (size_t i = cjson_retained_count; i-- > 0;) {
+        if (cjson_range_owns(&cjson_retained[i], ptr)) {
+            cwist_free(cjson_retained[i].allocator, ptr, 0);
+            return;
+        }
+    }
+    const cwist_allocator *a = atomic_load_explicit(&cjson_allocator, memory_order_acquire);
+    cwist_free(a, ptr, 0);
+}
+
+static void cjson_install_hooks(void) {
+    cJSON_Hooks hooks = { cjson_hook_malloc, cjson_hook_free };
+    cJSON_InitHooks(&hooks);
+}
+
+void cwist_allocator_install_cjson(const cwist_allocator *allocator) {
+    atomic_store_explicit(&cjson_allocator, allocator ? allocator : cwist_allocator_default(), memory_order_release);
+    pthread_once(&cjson_hooks_once, cjson_install_hooks);
+}
+
+cwist_cjson_binding cwist_allocator_bind_cjson(cwist_cjson_binding binding) {
+    pthread_once(&cjson_hooks_once, cjson_install_hooks);
+    cwist_cjson_binding previous = cjson_binding;
+    if (binding.allocator && binding.size) cjson_retained_remove(binding.base);
+    if (previous.allocator && previous.size && previous.base != binding.base) cjson_retained_add(previous);
+    cjson_binding = binding;
+    return previous;
+}
+
+void cwist_allocator_forget_cjson(const void *base) {
+    cjson_retained_remove(base);
+}
@@ -0,0 +1,191 @@
+#include <cwist/buffer_pool.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_CACHE_LINE 64
+#define BUFFER_HEADER_SIZE ((sizeof(cwist_buffer) + BUFFER_CACHE_LINE - 1) & ~(size_t)(BUFFER_CACHE_LINE - 1))
+#define BUFFER_REFILL_BATCH 8
+
+static const size_t buffer_class_size[CWIST_BUFFER_CLASS_COUNT] = { 4096, 16384, 65536 };
+// Per-thread cache limits; bigger slabs are cached more sparingly.
+static const unsigned buffer_thread_limit[CWIST_BUFFER_CLASS_COUNT] = { 32, 8, 4 };
+// Beyond this many parked slabs the global list hands memory back to the system.
+static const size_t buffer_global_limit[CWIST_BUFFER_CLASS_COUNT] = { 4096, 1024, 256 };
+
+struct buffer_global_list {
+    pthread_mutex_t lock;
+    cwist_buffer *head;
+    size_t count;
+    size_t allocated;
+} __attribute__((aligned(BUFFER_CACHE_LINE)));
+
+struct buffer_thread_cache {
+    cwist_buffer *head;
+    unsigned count;
+};
+
+static struct buffer_global_list buffer_global[CWIST_BUFFER_CLASS_COUNT] = {
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 },
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 },
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 },
+};
+
+static _Thread_local struct buffer_thread_cache buffer_tcache[CWIST_BUFFER_CLASS_COUNT];
+static _Thread_local bool buffer_tcache_registered = false;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t buffer_key;
+
+static void buffer_thread_exit(void *unused) {
+    (void)unused;
+    cwist_buffer_pool_flush_thread();
+}
+
+static void buffer_key_init(void) {
+    pthread_key_create(&buffer_key, buffer_thread_exit);
+}
+
+static void buffer_register_thread(void) {
+    if (buffer_tcache_registered) return;
+    pthread_once(&buffer_key_once, buffer_key_init);
+    // Any non-NULL value makes the destructor fire on thread exit.
+    pthread_setspecific(buffer_key, (void *)1);
+    buffer_tcache_registered = true;
+}
+
+// Header and data share one aligned block; data starts on its own cache line.
+static cwist_buffer *buffer_slab_new(cwist_buffer_class_t size_class) {
+    void *raw = NULL;
+    if (posix_memalign(&raw, BUFFER_CACHE_LINE, BUFFER_HEADER_SIZE + buffer_class_size[size_class]) != 0) {
+        return NULL;
+    }
+    cwist_buffer *buf = (cwist_buffer *)raw;
+    buf->data = (char *)raw + BUFFER_HEADER_SIZE;
+    buf->capacity = buffer_class_size[size_class];
+    buf->size_class = size_class;
+    buf->len = 0;
+    buf->next = NULL;
+
+    struct buffer_global_list *global = &buffer_global[size_class];
+    pthread_mutex_lock(&global->lock);
+    global->allocated++;
+    pthread_mutex_unlock(&global->lock);
+    return buf;
+}
+
+static void buffer_refill(cwist_buffer_class_t size_class) {
+    struct buffer_thread_cache *cache = &buffer_tcache[size_class];
+    struct buffer_global_list *global = &buffer_global[size_class];
+
+    pthread_mutex_lock(&global->lock);
+    while (global->head && cache->count < BUFFER_REFILL_BATCH) {
+        cwist_buffer *buf = global->head;
+        global->head = buf->next;
+        global->count--;
+        buf->next = cache->head;
+        cache->head = buf;
+        cache->count++;
+    }
+    pthread_mutex_unlock(&global->lock);
+}
+
+// Moves the colder half of the thread cache to the global list.
+static void buffer_spill(cwist_buffer_class_t size_class, unsigned keep) {
+    struct buffer_thread_cache *cache = &buffer_tcache[size_class];
+    struct buffer_global_list *global = &buffer_global[size_class];
+    cwist_buffer *to_free = NULL;
+
+    pthread_mutex_lock(&global->lock);
+    while (cache->count > keep) {
+        cwist_buffer *buf = cache->head;
+        cache->head = buf->next;
+        cache->count--;
+        if (global->count >= buffer_global_limit[size_class]) {
+            global->allocated--;
+            buf->next = to_free;
+            to_free = buf;
+        } else {
+            buf->next = global->head;
+            global->head = buf;
+            global->count++;
+        }
+    }
+    pthread_mutex_unlock(&global->lock);
+
+    while (to_free) {
+        cwist_buffer *next = to_free->next;
+        free(to_free);
+        to_free = next;
+    }
+}
+
+cwist_buffer *cwist_buffer_acquire(size_t min_capacity) {
+    cwist_buffer_class_t size_class = CWIST_BUFFER_4K;
+    while (size_class < CWIST_BUFFER_CLASS_COUNT && buffer_class_size[size_class] < min_capacity) {
+        size_class++;
+    }
+    if (size_class == CWIST_BUFFER_CLASS_COUNT) return NULL;
+
+    buffer_register_thread();
+    struct buffer_thread_cache *cache = &buffer_tcache[size_class];
+    if (!cache->head) buffer_refill(size_class);
+
+    cwist_buffer *buf = cache->head;
+    if (buf) {
+        cache->head = buf->next;
+        cache->count--;
+    } else {
+        buf = buffer_slab_new(size_class);
+        if (!buf) return NULL;
+    }
+
+    buf->next = NULL;
+    buf->len = 0;
+    return buf;
+}
+
+void cwist_buffer_release(cwist_buffer *buf) {
+    if (!buf) return;
+
+    buffer_register_thread();
+    struct buffer_thread_cache *cache = &buffer_tcache[buf->size_class];
+    buf->len = 0;
+    buf->next = cache->head;
+    cache->head = buf;
+    cache->count++;
+
+    if (cache->count > buffer_thread_limit[buf->size_class]) {
+        buffer_spill(buf->size_class, buffer_thread_limit[buf->size_class] / 2);
+    }
+}
+
+cwist_buffer *cwist_buffer_grow(cwist_buffer *buf, size_t min_capacity) {
+    if (!buf) return cwist_buffer_acquire(min_capacity);
+    if (buf->capacity >= min_capacity) return buf;
+
+    cwist_buffer *bigger = cwist_buffer_acquire(min_capacity);
+    if (!bigger) return buf;
+
+    memcpy(bigger->data, buf->data, buf->len);
+    bigger->len = buf->len;
+    cwist_buffer_release(buf);
+    return bigger;
+}
+
+void cwist_buffer_pool_flush_thread(void) {
+    for (int i = 0; i < CWIST_BUFFER_CLASS_COUNT; i++) {
+        if (buffer_tcache[i].count > 0) buffer_spill((cwist_buffer_class_t)i, 0);
+    }
+}
+
+void cwist_buffer_pool_get_stats(cwist_buffer_pool_stats *stats) {
+    if (!stats) return;
+    for (int i = 0; i < CWIST_BUFFER_CLASS_COUNT; i++) {
+        pthread_mutex_lock(&buffer_global[i].lock);
+        stats->allocated[i] = buffer_global[i].allocated;
+        stats->global_free[i] = buffer_global[i].count;
+        pthread_mutex_unlock(&buffer_global[i].lock);
+    }
+}
@@ -1,7 +1,123 @@
 #include <cwist/err/cwist_err.h>
+#include <cwist/sstring.h>
+#include <cwist/json.h>
+#include <cwist/template.h>
+
+#include <string.h>
 
 cwist_error_t make_error(cwist_errtype_t type) {
     cwist_error_t err;
+    memset(&err, 0, sizeof(err));
     err.errtype = type;
+    err.domain = CWIST_ERRDOMAIN_NONE;
     return err;
 }
+
+cwist_error_t cwist_error_make(cwist_errdomain_t domain, cwist_errtype_t type, int64_t code) {
+    cwist_error_t err = make_error(type);
+    err.domain = domain;
+    switch (type) {
+        case CWIST_ERR_INT8:   err.error.err_i8 = (int8_t)code; break;
+        case CWIST_ERR_INT16:  err.error.err_i16 = (int16_t)code; break;
+        case CWIST_ERR_INT32:  err.error.err_i32 = (int32_t)code; break;
+        case CWIST_ERR_UINT8:  err.error.err_u8 = (uint8_t)code; break;
+        case CWIST_ERR_UINT16: err.error.err_u16 = (uint16_t)code; break;
+        case CWIST_ERR_UINT32: err.error.err_u32 = (uint32_t)code; break;
+        case CWIST_ERR_UINT64: err.error.err_u64 = (uint64_t)code; break;
+        default:               err.error.err_i64 = code; break;
+    }
+    return err;
+}
+
+int64_t cwist_error_code(cwist_error_t err) {
+    switch (err.errtype) {
+        case CWIST_ERR_INT8:   return err.error.err_i8;
+        case CWIST_ERR_INT16:  return err.error.err_i16;
+        case CWIST_ERR_INT32:  return err.error.err_i32;
+        case CWIST_ERR_INT64:  return err.error.err_i64;
+        case CWIST_ERR_UINT8:  return err.error.err_u8;
+        case CWIST_ERR_UINT16: return err.error.err_u16;
+        case CWIST_ERR_UINT32: return err.error.err_u32;
+        case CWIST_ERR_UINT64: return (int64_t)err.error.err_u64;
+        default:               return 0;
+    }
+}
+
+static const char *error_domain_name(cwist_errdomain_t domain) {
+    switch (domain) {
+        case CWIST_ERRDOMAIN_ERRNO:   return "errno";
+        case CWIST_ERRDOMAIN_SSTRING: return "sstring";
+        case CWIST_ERRDOMAIN_JSON:    return "json";
+        case CWIST_ERRDOMAIN_TEMPLATE: return "template";
+        default:                      return "none";
+    }
+}
+
+static const char *error_sstring_message(int64_t code) {
+    switch (code) {
+        case ERR_SSTRING_OKAY:             return "ok";
+        case ERR_SSTRING_ZERO_LENGTH:      return "string is empty";
+        case ERR_SSTRING_NULL_STRING:      return "string is NULL";
+        case ERR_SSTRING_CONSTANT:         return "fixed-size string cannot hold the result";
+        case ERR_SSTRING_RESIZE_TOO_SMALL: return "new size is smaller than the current length and blow_data is false";
+        case ERR_SSTRING_RESIZE_TOO_LARGE: return "cannot allocate string storage";
+        case ERR_SSTRING_OUTOFBOUND:       return "position out of bounds";
+        default:                           return "";
+    }
+}
+
+static const char *error_json_message(int64_t code) {
+    switch (code) {
+        case ERR_JSON_OKAY:       return "ok";
+        case ERR_JSON_TOO_DEEP:   return "JSON nesting is too deep";
+        case ERR_JSON_UNBALANCED: return "JSON containers are not balanced";
+        case ERR_JSON_MISPLACED:  return "JSON key or value out of place";
+        case ERR_JSON_SYNTAX:     return "malformed JSON";
+        case ERR_JSON_ENCODING:   return "JSON text is not valid UTF-8";
+        default:                  return "";
+    }
+}
+
+static const char *error_template_message(int64_t code) {
+    switch (code) {
+        case ERR_TEMPLATE_OKAY:           return "ok";
+        case ERR_TEMPLATE_UNCLOSED_TAG:   return "template tag is not closed";
+        case ERR_TEMPLATE_BAD_NAME:       return "template slot name is empty or invalid";
+        case ERR_TEMPLATE_UNKNOWN_FILTER: return "unknown template filter";
+        case ERR_TEMPLATE_UNBALANCED:     return "template sections are not balanced";
+        case ERR_TEMPLATE_TOO_DEEP:       return "template sections nest too deep";
+        default:                          return "";
+    }
+}
+
+const char *cwist_error_message(cwist_error_t err) {
+    if (err.errtype == CWIST_ERR_STRING) {
+        return err.error.err_string && err.error.err_string->data ? err.error.err_string->data : "";
+    }
+    if (err.errtype == CWIST_ERR_JSON) {
+        cJSON *msg = err.error.err_json ? cJSON_GetObjectItem(err.error.err_json, "err") : NULL;
+        return cJSON_IsString(msg) ? msg->valuestring : "";
+    }
+
+    int64_t code = cwist_error_code(err);
+    switch (err.domain) {
+        case CWIST_ERRDOMAIN_ERRNO:   return code == 0 ? "ok" : strerror((int)code);
+        case CWIST_ERRDOMAIN_SSTRING: return error_sstring_message(code);
+        case CWIST_ERRDOMAIN_JSON:    return error_json_message(code);
+        case CWIST_ERRDOMAIN_TEMPLATE: return error_template_message(code);
+        default:                      return "";
+    }
+}
+
+cJSON *cwist_error_to_json(cwist_error_t err) {
+    if (err.errtype == CWIST_ERR_JSON) {
+        return err.error.err_json ? cJSON_Duplicate(err.error.err_json, 1) : cJSON_CreateObject();
+    }
+
+    cJSON *json = cJSON_CreateObject();
+    if (!json) return NULL;
+    cJSON_AddStringToObject(json, "domain", error_domain_name(err.domain));
+    cJSON_AddNumberToObject(json, "code", (double)cwist_error_code(err));
+    cJSON_AddStringToObject(json, "err", cwist_error_message(err));
+    return json;
+}
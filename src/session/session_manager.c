@@ -1,18 +1,72 @@
 #include <cwist/session_manager.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+static void *arena_allocator_alloc(void *ctx, size_t size) {
+    return session_arena_alloc((struct session_arena *)ctx, size);
+}
+
+// The most recent block grows in place; anything else is bumped and copied.
+static void *arena_allocator_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    struct session_arena *arena = ctx;
+    if (ptr) {
+        size_t old_rounded = (old_size + 7u) & ~(size_t)7u;
+        size_t new_rounded = (new_size + 7u) & ~(size_t)7u;
+        uint8_t *top = arena->buffer + arena->offset;
+        if ((uint8_t *)ptr + old_rounded == top && (uint8_t *)ptr + new_rounded <= arena->buffer + arena->capacity) {
+            arena->offset = (size_t)((uint8_t *)ptr - arena->buffer) + new_rounded;
+            return ptr;
+        }
+    }
+    void *grown = session_arena_alloc(arena, new_size);
+    if (grown && ptr) memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+static void arena_allocator_free(void *ctx, void *ptr, size_t size) {
+    // Reclaimed wholesale by session_arena_reset
+    (void)ctx;
+    (void)ptr;
+    (void)size;
+}
+
 void session_arena_init(struct session_arena *arena, uint8_t *buffer, size_t capacity) {
     if (!arena) return;
     arena->buffer = buffer;
     arena->capacity = capacity;
     arena->offset = 0;
+    arena->destructors = NULL;
+    arena->allocator.alloc = arena_allocator_alloc;
+    arena->allocator.realloc = arena_allocator_realloc;
+    arena->allocator.free = arena_allocator_free;
+    arena->allocator.ctx = arena;
+}
+
+const cwist_allocator *session_arena_allocator(struct session_arena *arena) {
+    return arena ? &arena->allocator : cwist_allocator_default();
+}
+
+struct session_arena *session_arena_from_allocator(const cwist_allocator *allocator) {
+    if (!allocator || allocator->alloc != arena_allocator_alloc) return NULL;
+    return (struct session_arena *)allocator->ctx;
+}
+
+void session_arena_cjson_begin(struct session_cjson_scope *scope, struct session_arena *arena) {
+    if (!scope || !arena) return;
+    cwist_cjson_binding binding = { &arena->allocator, arena->buffer, arena->capacity };
+    scope->previous = cwist_allocator_bind_cjson(binding);
+}
+
+void session_arena_cjson_end(struct session_cjson_scope *scope) {
+    if (!scope) return;
+    cwist_allocator_bind_cjson(scope->previous);
 }
 
 void *session_arena_alloc(struct session_arena *arena, size_t size) {
     if (!arena || !arena->buffer) return NULL;
-    size = (size + 7u) & ~7u;
-    if (arena->offset + size > arena->capacity) {
+    size = (size + 7u) & ~(size_t)7u;
+    if (size > arena->capacity - arena->offset) {
         return NULL;
     }
     void *ptr = arena->buffer + arena->offset;
@@ -22,42 +76,235 @@ void *session_arena_alloc(struct session_arena *arena, size_t size) {
 
 void session_arena_reset(struct session_arena *arena) {
     if (!arena) return;
+    // Destructors were pushed in registration order, so this runs them LIFO.
+    struct session_arena_destructor *curr = arena->destructors;
+    arena->destructors = NULL;
+    while (curr) {
+        struct session_arena_destructor *next = curr->next;
+        curr->fn(curr->ctx);
+        curr = next;
+    }
+    // cJSON trees from an ended scope may be deleted up to here
+    cwist_allocator_forget_cjson(arena->buffer);
     arena->offset = 0;
 }
 
+int session_arena_register_destructor(struct session_arena *arena, void (*fn)(void *), void *ctx) {
+    if (!arena || !fn) return -1;
+    struct session_arena_destructor *node = session_arena_alloc(arena, sizeof(*node));
+    if (!node) return -1;
+    node->fn = fn;
+    node->ctx = ctx;
+    node->next = arena->destructors;
+    arena->destructors = node;
+    return 0;
+}
+
 void session_rc_init(struct session_rc_header *header, void (*destructor)(void *)) {
     if (!header) return;
-    header->ref_count = 1;
+    atomic_init(&header->ref_count, 1);
+    header->flags = 0;
     header->destructor = destructor;
+    header->allocator = NULL;
+}
+
+// Limbo link that SESSION_SHARED_DEFERRED blocks carry in front of their
+// header, so retiring one never has to allocate.
+struct session_epoch_retired {
+    uint64_t epoch;
+    struct session_epoch_retired *next;
+} __attribute__((aligned(16)));
+
+static struct session_rc_header *session_header_of(void *payload) {
+    return (struct session_rc_header *)((uint8_t *)payload - sizeof(struct session_rc_header));
 }
 
 void *session_shared_alloc(size_t payload_size, void (*destructor)(void *)) {
-    size_t total = sizeof(struct session_rc_header) + payload_size;
-    uint8_t *raw = (uint8_t *)malloc(total);
+    return session_shared_alloc_ex(payload_size, destructor, 0);
+}
+
+void *session_shared_alloc_ex(size_t payload_size, void (*destructor)(void *), uint32_t flags) {
+    return session_shared_alloc_with(NULL, payload_size, destructor, flags);
+}
+
+void *session_shared_alloc_with(const cwist_allocator *allocator, size_t payload_size, void (*destructor)(void *), uint32_t flags) {
+    if (!allocator) allocator = cwist_allocator_default();
+    size_t prefix = (flags & SESSION_SHARED_DEFERRED) ? sizeof(struct session_epoch_retired) : 0;
+    size_t total = prefix + sizeof(struct session_rc_header) + payload_size;
+    uint8_t *raw = (uint8_t *)cwist_alloc(allocator, total);
     if (!raw) return NULL;
-    struct session_rc_header *header = (struct session_rc_header *)raw;
+    struct session_rc_header *header = (struct session_rc_header *)(raw + prefix);
     session_rc_init(header, destructor);
-    void *payload = raw + sizeof(struct session_rc_header);
+    header->flags = flags;
+    header->allocator = allocator;
+    void *payload = (uint8_t *)header + sizeof(struct session_rc_header);
     memset(payload, 0, payload_size);
     return payload;
 }
 
 void session_shared_inc(void *payload) {
     if (!payload) return;
-    struct session_rc_header *header = (struct session_rc_header *)((uint8_t *)payload - sizeof(struct session_rc_header));
-    header->ref_count += 1;
+    // Taking another reference needs no ordering: the caller already holds one.
+    atomic_fetch_add_explicit(&session_header_of(payload)->ref_count, 1, memory_order_relaxed);
+}
+
+bool session_shared_try_inc(void *payload) {
+    if (!payload) return false;
+    struct session_rc_header *header = session_header_of(payload);
+    uint32_t count = atomic_load_explicit(&header->ref_count, memory_order_relaxed);
+    while (count != 0) {
+        if (atomic_compare_exchange_weak_explicit(&header->ref_count, &count, count + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t session_shared_count(void *payload) {
+    if (!payload) return 0;
+    return atomic_load_explicit(&session_header_of(payload)->ref_count, memory_order_acquire);
+}
+
+static void session_shared_release(struct session_rc_header *header) {
+    if (header->destructor) {
+        header->destructor((uint8_t *)header + sizeof(struct session_rc_header));
+    }
+    void *block = header;
+    if (header->flags & SESSION_SHARED_DEFERRED) block = (struct session_epoch_retired *)header - 1;
+    // Headers set up by hand with session_rc_init came from malloc
+    cwist_free(header->allocator ? header->allocator : cwist_allocator_libc(), block, 0);
 }
 
+static void session_epoch_retire(struct session_rc_header *header);
+
 void session_shared_dec(void *payload) {
     if (!payload) return;
-    struct session_rc_header *header = (struct session_rc_header *)((uint8_t *)payload - sizeof(struct session_rc_header));
-    if (header->ref_count == 0) return;
-    header->ref_count -= 1;
-    if (header->ref_count == 0) {
-        if (header->destructor) {
-            header->destructor(payload);
+    struct session_rc_header *header = session_header_of(payload);
+    if (atomic_load_explicit(&header->ref_count, memory_order_relaxed) == 0) return;
+    // Release publishes our writes to whoever drops the last reference;
+    // the acquire fence makes everyone else's writes visible to the destructor.
+    if (atomic_fetch_sub_explicit(&header->ref_count, 1, memory_order_release) == 1) {
+        atomic_thread_fence(memory_order_acquire);
+        if (header->flags & SESSION_SHARED_DEFERRED) {
+            session_epoch_retire(header);
+        } else {
+            session_shared_release(header);
+        }
+    }
+}
+
+/* --- Epoch-based reclamation --- */
+
+#define SESSION_EPOCH_MAX_THREADS 256
+#define SESSION_EPOCH_COLLECT_BATCH 64
+
+// One cache line per reader so entering/leaving never bounces a shared line.
+struct session_epoch_slot {
+    _Atomic uint64_t epoch; // 0 while the thread is outside a read section
+    _Atomic bool in_use;
+    char pad[64 - sizeof(uint64_t) - sizeof(bool)];
+} __attribute__((aligned(64)));
+
+static struct session_epoch_slot epoch_slots[SESSION_EPOCH_MAX_THREADS];
+static _Atomic uint64_t epoch_global = 1;
+static pthread_mutex_t epoch_limbo_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct session_epoch_retired *epoch_limbo = NULL;
+static size_t epoch_limbo_count = 0;
+
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t epoch_key;
+static _Thread_local int epoch_slot = -1;
+static _Thread_local unsigned epoch_depth = 0;
+
+static void session_epoch_thread_exit(void *value) {
+    int slot = (int)(intptr_t)value - 1;
+    if (slot < 0) return;
+    atomic_store_explicit(&epoch_slots[slot].epoch, 0, memory_order_release);
+    atomic_store_explicit(&epoch_slots[slot].in_use, false, memory_order_release);
+}
+
+static void session_epoch_key_init(void) {
+    pthread_key_create(&epoch_key, session_epoch_thread_exit);
+}
+
+static bool session_epoch_claim_slot(void) {
+    pthread_once(&epoch_key_once, session_epoch_key_init);
+    for (int i = 0; i < SESSION_EPOCH_MAX_THREADS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&epoch_slots[i].in_use, &expected, true)) {
+            epoch_slot = i;
+            pthread_setspecific(epoch_key, (void *)(intptr_t)(i + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool session_epoch_enter(void) {
+    if (epoch_depth > 0) {
+        epoch_depth++;
+        return true;
+    }
+    if (epoch_slot < 0 && !session_epoch_claim_slot()) return false;
+
+    // seq_cst store: a retirer that bumps the epoch after this point is
+    // guaranteed to see us, and we are guaranteed to see its unlink.
+    uint64_t epoch = atomic_load(&epoch_global);
+    atomic_store(&epoch_slots[epoch_slot].epoch, epoch);
+    epoch_depth = 1;
+    return true;
+}
+
+void session_epoch_exit(void) {
+    if (epoch_depth == 0) return;
+    if (--epoch_depth == 0) {
+        atomic_store_explicit(&epoch_slots[epoch_slot].epoch, 0, memory_order_release);
+    }
+}
+
+static void session_epoch_retire(struct session_rc_header *header) {
+    struct session_epoch_retired *node = (struct session_epoch_retired *)header - 1;
+    // Readers that entered at or before this epoch may still hold the payload.
+    node->epoch = atomic_fetch_add(&epoch_global, 1);
+
+    pthread_mutex_lock(&epoch_limbo_lock);
+    node->next = epoch_limbo;
+    epoch_limbo = node;
+    bool collect = ++epoch_limbo_count >= SESSION_EPOCH_COLLECT_BATCH;
+    pthread_mutex_unlock(&epoch_limbo_lock);
+
+    if (collect) session_epoch_collect();
+}
+
+void session_epoch_collect(void) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < SESSION_EPOCH_MAX_THREADS; i++) {
+        uint64_t seen = atomic_load(&epoch_slots[i].epoch);
+        if (seen != 0 && seen < oldest) oldest = seen;
+    }
+
+    struct session_epoch_retired *ready = NULL;
+    pthread_mutex_lock(&epoch_limbo_lock);
+    struct session_epoch_retired **link = &epoch_limbo;
+    while (*link) {
+        struct session_epoch_retired *node = *link;
+        if (node->epoch < oldest) {
+            *link = node->next;
+            node->next = ready;
+            ready = node;
+            epoch_limbo_count--;
+        } else {
+            link = &node->next;
         }
-        free(header);
+    }
+    pthread_mutex_unlock(&epoch_limbo_lock);
+
+    // Destructors may drop further deferred references, so run them unlocked.
+    while (ready) {
+        struct session_epoch_retired *next = ready->next;
+        session_shared_release((struct session_rc_header *)(ready + 1));
+        ready = next;
     }
 }
 
@@ -0,0 +1,489 @@
+#include <cwist/session_store.h>
+#include <cwist/session_manager.h>
+#include <cwist/hash.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SESSION_STORE_DEFAULT_SHARDS 16
+#define SESSION_STORE_DEFAULT_WHEEL 256
+#define SESSION_STORE_INITIAL_BUCKETS 64
+#define SESSION_STORE_NO_SLOT UINT32_MAX
+
+struct session_store_entry {
+    struct session_store_entry *hash_next;
+    struct session_store_entry *wheel_prev;
+    struct session_store_entry *wheel_next;
+    struct session_store_entry *clock_prev;
+    struct session_store_entry *clock_next;
+    void *payload;
+    uint64_t hash;
+    size_t charge;
+    _Atomic uint64_t expires_at;    // slid by readers under the read lock
+    _Atomic bool referenced;        // CLOCK second-chance bit
+    uint32_t wheel_slot;
+    size_t token_len;
+    char token[];
+};
+
+struct session_store_shard {
+    pthread_rwlock_t lock;
+    struct session_store_entry **buckets;
+    size_t bucket_mask;
+    size_t count;
+    size_t memory_used;
+    struct session_store_entry **wheel;
+    uint64_t wheel_time;            // last second the wheel was advanced to
+    struct session_store_entry *clock_hand;
+} __attribute__((aligned(64)));
+
+struct session_store {
+    struct session_store_shard *shards;
+    size_t shard_mask;
+    size_t shard_cap;               // memory_cap / shard_count, 0 = unlimited
+    uint32_t ttl;
+    uint32_t wheel_slots;
+    uint64_t seed;
+    uint64_t (*clock)(void);
+    const cwist_allocator *allocator;
+
+    pthread_t sweeper;
+    pthread_mutex_t sweeper_lock;
+    pthread_cond_t sweeper_cond;
+    bool sweeper_running;
+    unsigned sweeper_interval_ms;
+};
+
+static uint64_t session_store_monotonic(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+static void *store_calloc(struct session_store *store, size_t count, size_t size) {
+    void *ptr = cwist_alloc(store->allocator, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+static size_t round_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+/* --- Lifecycle --- */
+
+struct session_store *session_store_create(const struct session_store_config *config) {
+    struct session_store *store = calloc(1, sizeof(*store));
+    if (!store) return NULL;
+
+    size_t shard_count = round_pow2(config && config->shard_count ? config->shard_count : SESSION_STORE_DEFAULT_SHARDS);
+    store->shard_mask = shard_count - 1;
+    store->ttl = config ? config->ttl_seconds : 0;
+    store->wheel_slots = config && config->wheel_slots ? config->wheel_slots : SESSION_STORE_DEFAULT_WHEEL;
+    store->shard_cap = config && config->memory_cap ? config->memory_cap / shard_count : 0;
+    store->clock = config && config->clock ? config->clock : session_store_monotonic;
+    store->allocator = config && config->allocator ? config->allocator : cwist_allocator_default();
+    uintptr_t addr = (uintptr_t)store;
+    store->seed = cwist_hash64(&addr, sizeof(addr), (uint64_t)time(NULL));
+    pthread_mutex_init(&store->sweeper_lock, NULL);
+    pthread_cond_init(&store->sweeper_cond, NULL);
+
+    if (posix_memalign((void **)&store->shards, 64, shard_count * sizeof(struct session_store_shard)) != 0) {
+        free(store);
+        return NULL;
+    }
+    memset(store->shards, 0, shard_count * sizeof(struct session_store_shard));
+
+    uint64_t now = store->clock();
+    for (size_t i = 0; i < shard_count; i++) {
+        struct session_store_shard *shard = &store->shards[i];
+        pthread_rwlock_init(&shard->lock, NULL);
+        shard->buckets = store_calloc(store, SESSION_STORE_INITIAL_BUCKETS, sizeof(*shard->buckets));
+        shard->bucket_mask = SESSION_STORE_INITIAL_BUCKETS - 1;
+        shard->wheel = store_calloc(store, store->wheel_slots, sizeof(*shard->wheel));
+        shard->wheel_time = now;
+        if (!shard->buckets || !shard->wheel) {
+            store->shard_mask = i;  // only tear down what was initialised
+            session_store_destroy(store);
+            return NULL;
+        }
+    }
+
+    return store;
+}
+
+void session_store_destroy(struct session_store *store) {
+    if (!store) return;
+    session_store_stop_sweeper(store);
+
+    for (size_t i = 0; i <= store->shard_mask; i++) {
+        struct session_store_shard *shard = &store->shards[i];
+        if (shard->buckets) {
+            for (size_t b = 0; b <= shard->bucket_mask; b++) {
+                struct session_store_entry *entry = shard->buckets[b];
+                while (entry) {
+                    struct session_store_entry *next = entry->hash_next;
+                    session_shared_dec(entry->payload);
+                    cwist_free(store->allocator, entry, sizeof(*entry) + entry->token_len + 1);
+                    entry = next;
+                }
+            }
+        }
+        cwist_free(store->allocator, shard->buckets, (shard->bucket_mask + 1) * sizeof(*shard->buckets));
+        cwist_free(store->allocator, shard->wheel, store->wheel_slots * sizeof(*shard->wheel));
+        pthread_rwlock_destroy(&shard->lock);
+    }
+
+    pthread_mutex_destroy(&store->sweeper_lock);
+    pthread_cond_destroy(&store->sweeper_cond);
+    free(store->shards);
+    free(store);
+}
+
+/* --- Shard internals (caller holds the shard lock) --- */
+
+static struct session_store_shard *store_shard_for(struct session_store *store, uint64_t hash) {
+    // High bits pick the shard, low bits pick the bucket.
+    return &store->shards[(hash >> 48) & store->shard_mask];
+}
+
+static struct session_store_entry *shard_find(struct session_store_shard *shard, uint64_t hash, const char *token, size_t token_len) {
+    struct session_store_entry *entry = shard->buckets[hash & shard->bucket_mask];
+    while (entry) {
+        if (entry->hash == hash && entry->token_len == token_len && memcmp(entry->token, token, token_len) == 0) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+static void shard_grow(struct session_store *store, struct session_store_shard *shard) {
+    size_t new_count = (shard->bucket_mask + 1) * 2;
+    struct session_store_entry **buckets = store_calloc(store, new_count, sizeof(*buckets));
+    if (!buckets) return; // keep the longer chains rather than fail the insert
+
+    for (size_t b = 0; b <= shard->bucket_mask; b++) {
+        struct session_store_entry *entry = shard->buckets[b];
+        while (entry) {
+            struct session_store_entry *next = entry->hash_next;
+            size_t idx = entry->hash & (new_count - 1);
+            entry->hash_next = buckets[idx];
+            buckets[idx] = entry;
+            entry = next;
+        }
+    }
+    cwist_free(store->allocator, shard->buckets, (shard->bucket_mask + 1) * sizeof(*buckets));
+    shard->buckets = buckets;
+    shard->bucket_mask = new_count - 1;
+}
+
+static void wheel_insert(struct session_store *store, struct session_store_shard *shard, struct session_store_entry *entry, uint64_t expires_at) {
+    if (store->ttl == 0) {
+        entry->wheel_slot = SESSION_STORE_NO_SLOT;
+        return;
+    }
+    uint32_t slot = (uint32_t)(expires_at % store->wheel_slots);
+    entry->wheel_slot = slot;
+    entry->wheel_prev = NULL;
+    entry->wheel_next = shard->wheel[slot];
+    if (entry->wheel_next) entry->wheel_next->wheel_prev = entry;
+    shard->wheel[slot] = entry;
+}
+
+static void wheel_remove(struct session_store_shard *shard, struct session_store_entry *entry) {
+    if (entry->wheel_slot == SESSION_STORE_NO_SLOT) return;
+    if (entry->wheel_prev) entry->wheel_prev->wheel_next = entry->wheel_next;
+    else shard->wheel[entry->wheel_slot] = entry->wheel_next;
+    if (entry->wheel_next) entry->wheel_next->wheel_prev = entry->wheel_prev;
+    entry->wheel_slot = SESSION_STORE_NO_SLOT;
+}
+
+static void clock_insert(struct session_store_shard *shard, struct session_store_entry *entry) {
+    // New entries go right behind the hand so they get a full lap first.
+    if (!shard->clock_hand) {
+        entry->clock_next = entry->clock_prev = entry;
+        shard->clock_hand = entry;
+        return;
+    }
+    struct session_store_entry *hand = shard->clock_hand;
+    entry->clock_next = hand;
+    entry->clock_prev = hand->clock_prev;
+    hand->clock_prev->clock_next = entry;
+    hand->clock_prev = entry;
+}
+
+static void clock_remove(struct session_store_shard *shard, struct session_store_entry *entry) {
+    if (entry->clock_next == entry) {
+        shard->clock_hand = NULL;
+        return;
+    }
+    if (shard->clock_hand == entry) shard->clock_hand = entry->clock_next;
+    entry->clock_prev->clock_next = entry->clock_next;
+    entry->clock_next->clock_prev = entry->clock_prev;
+}
+
+// Unlinks entry and chains it on *graveyard; payload refs are dropped after unlock.
+static void shard_unlink(struct session_store_shard *shard, struct session_store_entry *entry, struct session_store_entry **graveyard) {
+    struct session_store_entry **link = &shard->buckets[entry->hash & shard->bucket_mask];
+    while (*link && *link != entry) link = &(*link)->hash_next;
+    if (*link) *link = entry->hash_next;
+
+    wheel_remove(shard, entry);
+    clock_remove(shard, entry);
+    shard->count--;
+    shard->memory_used -= entry->charge;
+
+    entry->hash_next = *graveyard;
+    *graveyard = entry;
+}
+
+static void bury(struct session_store *store, struct session_store_entry *graveyard) {
+    while (graveyard) {
+        struct session_store_entry *next = graveyard->hash_next;
+        session_shared_dec(graveyard->payload);
+        cwist_free(store->allocator, graveyard, sizeof(*graveyard) + graveyard->token_len + 1);
+        graveyard = next;
+    }
+}
+
+static void shard_evict_for(struct session_store *store, struct session_store_shard *shard, size_t incoming, struct session_store_entry **graveyard) {
+    if (store->shard_cap == 0) return;
+
+    size_t budget = shard->count * 2; // every entry gets at most one second chance
+    while (shard->clock_hand && shard->memory_used + incoming > store->shard_cap && budget-- > 0) {
+        struct session_store_entry *victim = shard->clock_hand;
+        if (atomic_exchange_explicit(&victim->referenced, false, memory_order_relaxed)) {
+            shard->clock_hand = victim->clock_next;
+            continue;
+        }
+        shard_unlink(shard, victim, graveyard);
+    }
+}
+
+/* --- Public API --- */
+
+int session_store_put(struct session_store *store, const char *token, void *payload, size_t charge) {
+    if (!store || !token || !payload) return -1;
+
+    size_t token_len = strlen(token);
+    struct session_store_entry *entry = cwist_alloc(store->allocator, sizeof(*entry) + token_len + 1);
+    if (!entry) return -1;
+
+    uint64_t hash = cwist_hash64(token, token_len, store->seed);
+    uint64_t expires_at = store->ttl ? store->clock() + store->ttl : UINT64_MAX;
+
+    entry->hash_next = NULL;
+    entry->payload = payload;
+    entry->hash = hash;
+    entry->charge = charge + sizeof(*entry) + token_len + 1;
+    atomic_init(&entry->expires_at, expires_at);
+    atomic_init(&entry->referenced, false);
+    entry->wheel_slot = SESSION_STORE_NO_SLOT;
+    entry->token_len = token_len;
+    memcpy(entry->token, token, token_len + 1);
+
+    session_shared_inc(payload);
+
+    struct session_store_shard *shard = store_shard_for(store, hash);
+    struct session_store_entry *graveyard = NULL;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    struct session_store_entry *old = shard_find(shard, hash, token, token_len);
+    if (old) shard_unlink(shard, old, &graveyard);
+
+    shard_evict_for(store, shard, entry->charge, &graveyard);
+
+    if (shard->count >= shard->bucket_mask + 1) shard_grow(store, shard);
+    size_t idx = hash & shard->bucket_mask;
+    entry->hash_next = shard->buckets[idx];
+    shard->buckets[idx] = entry;
+    wheel_insert(store, shard, entry, expires_at);
+    clock_insert(shard, entry);
+    shard->count++;
+    shard->memory_used += entry->charge;
+    pthread_rwlock_unlock(&shard->lock);
+
+    bury(store, graveyard);
+    return 0;
+}
+
+static void *store_lookup(struct session_store *store, const char *token, bool take_ref) {
+    if (!store || !token) return NULL;
+
+    size_t token_len = strlen(token);
+    uint64_t hash = cwist_hash64(token, token_len, store->seed);
+    struct session_store_shard *shard = store_shard_for(store, hash);
+    uint64_t now = store->clock();
+    void *payload = NULL;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    struct session_store_entry *entry = shard_find(shard, hash, token, token_len);
+    if (entry && atomic_load_explicit(&entry->expires_at, memory_order_relaxed) > now) {
+        payload = entry->payload;
+        // Readers only slide the deadline; the sweeper moves the entry
+        // to its new wheel slot when the old one comes due.
+        if (store->ttl) {
+            atomic_store_explicit(&entry->expires_at, now + store->ttl, memory_order_relaxed);
+        }
+        if (!atomic_load_explicit(&entry->referenced, memory_order_relaxed)) {
+            atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+        }
+        if (take_ref) session_shared_inc(payload);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return payload;
+}
+
+void *session_store_get(struct session_store *store, const char *token) {
+    return store_lookup(store, token, true);
+}
+
+void *session_store_borrow(struct session_store *store, const char *token) {
+    return store_lookup(store, token, false);
+}
+
+bool session_store_remove(struct session_store *store, const char *token) {
+    if (!store || !token) return false;
+
+    size_t token_len = strlen(token);
+    uint64_t hash = cwist_hash64(token, token_len, store->seed);
+    struct session_store_shard *shard = store_shard_for(store, hash);
+    struct session_store_entry *graveyard = NULL;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    struct session_store_entry *entry = shard_find(shard, hash, token, token_len);
+    if (entry) shard_unlink(shard, entry, &graveyard);
+    pthread_rwlock_unlock(&shard->lock);
+
+    bury(store, graveyard);
+    return entry != NULL;
+}
+
+size_t session_store_sweep(struct session_store *store) {
+    if (!store || store->ttl == 0) return 0;
+
+    uint64_t now = store->clock();
+    size_t expired = 0;
+
+    for (size_t i = 0; i <= store->shard_mask; i++) {
+        struct session_store_shard *shard = &store->shards[i];
+        struct session_store_entry *graveyard = NULL;
+
+        pthread_rwlock_wrlock(&shard->lock);
+        uint64_t from = shard->wheel_time + 1;
+        if (now >= from && now - from >= store->wheel_slots) {
+            from = now - store->wheel_slots + 1; // a full lap covers every slot
+        }
+        for (uint64_t t = from; t <= now; t++) {
+            uint32_t slot = (uint32_t)(t % store->wheel_slots);
+            struct session_store_entry *entry = shard->wheel[slot];
+            shard->wheel[slot] = NULL;
+            while (entry) {
+                struct session_store_entry *next = entry->wheel_next;
+                uint64_t expires_at = atomic_load_explicit(&entry->expires_at, memory_order_relaxed);
+                entry->wheel_slot = SESSION_STORE_NO_SLOT;
+                if (expires_at <= now) {
+                    shard_unlink(shard, entry, &graveyard);
+                    expired++;
+                } else {
+                    wheel_insert(store, shard, entry, expires_at);
+                }
+                entry = next;
+            }
+        }
+        if (now > shard->wheel_time) shard->wheel_time = now;
+        pthread_rwlock_unlock(&shard->lock);
+
+        bury(store, graveyard);
+    }
+
+    return expired;
+}
+
+size_t session_store_count(struct session_store *store) {
+    if (!store) return 0;
+    size_t total = 0;
+    for (size_t i = 0; i <= store->shard_mask; i++) {
+        pthread_rwlock_rdlock(&store->shards[i].lock);
+        total += store->shards[i].count;
+        pthread_rwlock_unlock(&store->shards[i].lock);
+    }
+    return total;
+}
+
+size_t session_store_memory_used(struct session_store *store) {
+    if (!store) return 0;
+    size_t total = 0;
+    for (size_t i = 0; i <= store->shard_mask; i++) {
+        pthread_rwlock_rdlock(&store->shards[i].lock);
+        total += store->shards[i].memory_used;
+        pthread_rwlock_unlock(&store->shards[i].lock);
+    }
+    return total;
+}
+
+/* --- Background sweeper --- */
+
+static void *session_store_sweeper_main(void *arg) {
+    struct session_store *store = arg;
+
+    pthread_mutex_lock(&store->sweeper_lock);
+    while (store->sweeper_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += store->sweeper_interval_ms / 1000;
+        deadline.tv_nsec += (long)(store->sweeper_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = pthread_cond_timedwait(&store->sweeper_cond, &store->sweeper_lock, &deadline);
+        if (!store->sweeper_running) break;
+        if (rc == ETIMEDOUT) {
+            pthread_mutex_unlock(&store->sweeper_lock);
+            session_store_sweep(store);
+            pthread_mutex_lock(&store->sweeper_lock);
+        }
+    }
+    pthread_mutex_unlock(&store->sweeper_lock);
+    return NULL;
+}
+
+int session_store_start_sweeper(struct session_store *store, unsigned interval_ms) {
+    if (!store || interval_ms == 0) return -1;
+
+    pthread_mutex_lock(&store->sweeper_lock);
+    if (store->sweeper_running) {
+        pthread_mutex_unlock(&store->sweeper_lock);
+        return -1;
+    }
+    store->sweeper_running = true;
+    store->sweeper_interval_ms = interval_ms;
+    pthread_mutex_unlock(&store->sweeper_lock);
+
+    if (pthread_create(&store->sweeper, NULL, session_store_sweeper_main, store) != 0) {
+        store->sweeper_running = false;
+        return -1;
+    }
+    return 0;
+}
+
+void session_store_stop_sweeper(struct session_store *store) {
+    if (!store) return;
+
+    pthread_mutex_lock(&store->sweeper_lock);
+    bool running = store->sweeper_running;
+    store->sweeper_running = false;
+    pthread_cond_signal(&store->sweeper_cond);
+    pthread_mutex_unlock(&store->sweeper_lock);
+
+    if (running) pthread_join(store->sweeper, NULL);
+}
@@ -0,0 +1,739 @@
+#include <cwist/simd.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define SIMD_NPOS ((size_t)-1)
+#define SIMD_SHORT 16          // below one vector the dispatch costs more than it saves
+#define SIMD_MAX_SET 8         // wider sets use the scalar lookup table
+
+struct simd_kernels {
+    cwist_simd_level_t level;
+    size_t (*find)(const char *hay, size_t hay_len, const char *needle, size_t needle_len);
+    size_t (*find_first_of)(const char *data, size_t len, const char *set, size_t set_len);
+    bool   (*equals_nocase)(const char *left, const char *right, size_t len);
+    size_t (*skip_space)(const char *data, size_t len);
+    size_t (*trim_space_end)(const char *data, size_t len);
+    bool   (*utf8_valid)(const char *data, size_t len);
+    size_t (*json_plain)(const char *data, size_t len);
+    size_t (*html_plain)(const char *data, size_t len);
+    void   (*json_classify)(const char *block, cwist_simd_json_masks *masks);
+};
+
+/* --- Scalar --- */
+
+static inline bool scalar_is_space(unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static inline unsigned char scalar_fold(unsigned char c) {
+    return (unsigned char)(c - 'A') <= 'Z' - 'A' ? (unsigned char)(c | 0x20) : c;
+}
+
+// memchr for the first byte, memcmp to confirm.
+static size_t scalar_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len) {
+    if (needle_len == 0) return 0;
+    if (needle_len > hay_len) return SIMD_NPOS;
+
+    const char *p = hay;
+    const char *last = hay + hay_len - needle_len;
+    while (p <= last) {
+        p = memchr(p, needle[0], (size_t)(last - p) + 1);
+        if (!p) break;
+        if (memcmp(p + 1, needle + 1, needle_len - 1) == 0) return (size_t)(p - hay);
+        p++;
+    }
+    return SIMD_NPOS;
+}
+
+static size_t scalar_find_first_of(const char *data, size_t len, const char *set, size_t set_len) {
+    bool member[256] = { false };
+    for (size_t i = 0; i < set_len; i++) member[(unsigned char)set[i]] = true;
+    for (size_t i = 0; i < len; i++) {
+        if (member[(unsigned char)data[i]]) return i;
+    }
+    return SIMD_NPOS;
+}
+
+static bool scalar_equals_nocase(const char *left, const char *right, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (scalar_fold((unsigned char)left[i]) != scalar_fold((unsigned char)right[i])) return false;
+    }
+    return true;
+}
+
+static size_t scalar_skip_space(const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len && scalar_is_space((unsigned char)data[i])) i++;
+    return i;
+}
+
+static size_t scalar_trim_space_end(const char *data, size_t len) {
+    while (len > 0 && scalar_is_space((unsigned char)data[len - 1])) len--;
+    return len;
+}
+
+// Length of the well-formed UTF-8 sequence at p (RFC 3629: no overlongs,
+// surrogates or code points past U+10FFFF), 0 when it is not.
+static size_t scalar_utf8_sequence(const unsigned char *p, size_t len) {
+    unsigned char c = p[0];
+    if (c < 0x80) return 1;
+    if (c < 0xC2) return 0;
+    if (c < 0xE0) return len >= 2 && (p[1] & 0xC0) == 0x80 ? 2 : 0;
+    if (c < 0xF0) {
+        if (len < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80) return 0;
+        if (c == 0xE0 && p[1] < 0xA0) return 0;
+        if (c == 0xED && p[1] > 0x9F) return 0;
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (len < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80) return 0;
+        if (c == 0xF0 && p[1] < 0x90) return 0;
+        if (c == 0xF4 && p[1] > 0x8F) return 0;
+        return 4;
+    }
+    return 0;
+}
+
+static bool scalar_utf8_valid(const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < len) {
+        size_t n = scalar_utf8_sequence(p + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+// '"', '\\' and control characters need escaping inside a JSON string.
+static inline bool scalar_json_special(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+static inline bool scalar_html_special(unsigned char c) {
+    return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+static size_t scalar_json_plain(const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len && !scalar_json_special((unsigned char)data[i])) i++;
+    return i;
+}
+
+static size_t scalar_html_plain(const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len && !scalar_html_special((unsigned char)data[i])) i++;
+    return i;
+}
+
+// JSON whitespace is narrower than isspace: no \v or \f.
+static void scalar_json_classify(const char *block, cwist_simd_json_masks *masks) {
+    uint64_t quote = 0, backslash = 0, op = 0, space = 0;
+    for (unsigned i = 0; i < CWIST_SIMD_JSON_BLOCK; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (block[i]) {
+            case '"':  quote |= bit; break;
+            case '\\': backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': space |= bit; break;
+            default: break;
+        }
+    }
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->op = op;
+    masks->space = space;
+}
+
+static const struct simd_kernels scalar_kernels = {
+    CWIST_SIMD_SCALAR,
+    scalar_find,
+    scalar_find_first_of,
+    scalar_equals_nocase,
+    scalar_skip_space,
+    scalar_trim_space_end,
+    scalar_utf8_valid,
+    scalar_json_plain,
+    scalar_html_plain,
+    scalar_json_classify,
+};
+
+#ifdef SIMD_X86
+
+/* --- SSE2 (16 bytes) --- */
+
+SIMD_TARGET("sse2") static inline __m128i sse2_fold(__m128i v) {
+    // v - 'A' <= 25 (unsigned) selects 'A'..'Z'; those get +0x20.
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+    __m128i upper = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('Z' - 'A')), shifted);
+    return _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+SIMD_TARGET("sse2") static inline unsigned sse2_space_mask(__m128i v) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    __m128i blank = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(control, blank));
+}
+
+// Two-byte prefix filter: a candidate needs needle[0] at i and needle[1] at
+// i + 1, checked 16 positions at a time; memcmp only confirms survivors.
+SIMD_TARGET("sse2") static size_t sse2_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len) {
+    if (needle_len < 2 || needle_len > hay_len) return scalar_find(hay, hay_len, needle, needle_len);
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i second = _mm_set1_epi8(needle[1]);
+    size_t candidates = hay_len - needle_len + 1;
+    size_t i = 0;
+    for (; i + 16 <= candidates; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 2, needle + 2, needle_len - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t tail = scalar_find(hay + i, hay_len - i, needle, needle_len);
+    return tail == SIMD_NPOS ? SIMD_NPOS : i + tail;
+}
+
+SIMD_TARGET("sse2") static size_t sse2_find_first_of(const char *data, size_t len, const char *set, size_t set_len) {
+    if (set_len == 0 || set_len > SIMD_MAX_SET) return scalar_find_first_of(data, len, set, set_len);
+
+    __m128i members[SIMD_MAX_SET];
+    for (size_t s = 0; s < set_len; s++) members[s] = _mm_set1_epi8(set[s]);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hit = _mm_setzero_si128();
+        for (size_t s = 0; s < set_len; s++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, members[s]));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    size_t tail = scalar_find_first_of(data + i, len - i, set, set_len);
+    return tail == SIMD_NPOS ? SIMD_NPOS : i + tail;
+}
+
+SIMD_TARGET("sse2") static bool sse2_equals_nocase(const char *left, const char *right, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = sse2_fold(_mm_loadu_si128((const __m128i *)(left + i)));
+        __m128i b = sse2_fold(_mm_loadu_si128((const __m128i *)(right + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) return false;
+    }
+    return scalar_equals_nocase(left + i, right + i, len - i);
+}
+
+SIMD_TARGET("sse2") static size_t sse2_skip_space(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = sse2_space_mask(_mm_loadu_si128((const __m128i *)(data + i)));
+        if (mask != 0xFFFF) return i + (unsigned)__builtin_ctz(~mask);
+    }
+    return i + scalar_skip_space(data + i, len - i);
+}
+
+SIMD_TARGET("sse2") static size_t sse2_trim_space_end(const char *data, size_t len) {
+    while (len >= 16) {
+        unsigned mask = sse2_space_mask(_mm_loadu_si128((const __m128i *)(data + len - 16)));
+        if (mask != 0xFFFF) {
+            unsigned keep = ~mask & 0xFFFF;
+            return len - 16 + (31 - (unsigned)__builtin_clz(keep)) + 1;
+        }
+        len -= 16;
+    }
+    return scalar_trim_space_end(data, len);
+}
+
+// No byte shuffle in SSE2, so only ASCII runs are vectorized; multi-byte
+// sequences are checked one at a time.
+SIMD_TARGET("sse2") static bool sse2_utf8_valid(const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < len) {
+        if (i + 16 <= len && _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p + i))) == 0) {
+            i += 16;
+            continue;
+        }
+        size_t n = scalar_utf8_sequence(p + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+SIMD_TARGET("sse2") static inline unsigned sse2_json_mask(__m128i v) {
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+    __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    __m128i backslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(control, _mm_or_si128(quote, backslash)));
+}
+
+SIMD_TARGET("sse2") static inline unsigned sse2_html_mask(__m128i v) {
+    __m128i hit = _mm_cmpeq_epi8(v, _mm_set1_epi8('&'));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    return (unsigned)_mm_movemask_epi8(hit);
+}
+
+SIMD_TARGET("sse2") static size_t sse2_json_plain(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = sse2_json_mask(_mm_loadu_si128((const __m128i *)(data + i)));
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    return i + scalar_json_plain(data + i, len - i);
+}
+
+SIMD_TARGET("sse2") static size_t sse2_html_plain(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = sse2_html_mask(_mm_loadu_si128((const __m128i *)(data + i)));
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    return i + scalar_html_plain(data + i, len - i);
+}
+
+SIMD_TARGET("sse2") static void sse2_json_classify(const char *block, cwist_simd_json_masks *masks) {
+    uint64_t quote = 0, backslash = 0, op = 0, space = 0;
+    for (unsigned i = 0; i < CWIST_SIMD_JSON_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i));
+        __m128i ops = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']'))));
+        ops = _mm_or_si128(ops, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        quote |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        backslash |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        op |= (uint64_t)(unsigned)_mm_movemask_epi8(ops) << i;
+        space |= (uint64_t)(unsigned)_mm_movemask_epi8(ws) << i;
+    }
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->op = op;
+    masks->space = space;
+}
+
+static const struct simd_kernels sse2_kernels = {
+    CWIST_SIMD_SSE2,
+    sse2_find,
+    sse2_find_first_of,
+    sse2_equals_nocase,
+    sse2_skip_space,
+    sse2_trim_space_end,
+    sse2_utf8_valid,
+    sse2_json_plain,
+    sse2_html_plain,
+    sse2_json_classify,
+};
+
+/* --- AVX2 (32 bytes) --- */
+
+SIMD_TARGET("avx2") static inline __m256i avx2_fold(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+    __m256i upper = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('Z' - 'A')), shifted);
+    return _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+SIMD_TARGET("avx2") static inline uint32_t avx2_space_mask(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+    __m256i blank = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(control, blank));
+}
+
+SIMD_TARGET("avx2") static size_t avx2_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len) {
+    if (needle_len < 2 || needle_len > hay_len) return scalar_find(hay, hay_len, needle, needle_len);
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i second = _mm256_set1_epi8(needle[1]);
+    size_t candidates = hay_len - needle_len + 1;
+    size_t i = 0;
+    for (; i + 32 <= candidates; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(hay + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(hay + i + 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, second)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 2, needle + 2, needle_len - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t tail = sse2_find(hay + i, hay_len - i, needle, needle_len);
+    return tail == SIMD_NPOS ? SIMD_NPOS : i + tail;
+}
+
+SIMD_TARGET("avx2") static size_t avx2_find_first_of(const char *data, size_t len, const char *set, size_t set_len) {
+    if (set_len == 0 || set_len > SIMD_MAX_SET) return scalar_find_first_of(data, len, set, set_len);
+
+    __m256i members[SIMD_MAX_SET];
+    for (size_t s = 0; s < set_len; s++) members[s] = _mm256_set1_epi8(set[s]);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hit = _mm256_setzero_si256();
+        for (size_t s = 0; s < set_len; s++) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, members[s]));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    size_t tail = sse2_find_first_of(data + i, len - i, set, set_len);
+    return tail == SIMD_NPOS ? SIMD_NPOS : i + tail;
+}
+
+SIMD_TARGET("avx2") static bool avx2_equals_nocase(const char *left, const char *right, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = avx2_fold(_mm256_loadu_si256((const __m256i *)(left + i)));
+        __m256i b = avx2_fold(_mm256_loadu_si256((const __m256i *)(right + i)));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != UINT32_MAX) return false;
+    }
+    return sse2_equals_nocase(left + i, right + i, len - i);
+}
+
+SIMD_TARGET("avx2") static size_t avx2_skip_space(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t mask = avx2_space_mask(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (mask != UINT32_MAX) return i + (unsigned)__builtin_ctz(~mask);
+    }
+    return i + sse2_skip_space(data + i, len - i);
+}
+
+SIMD_TARGET("avx2") static size_t avx2_trim_space_end(const char *data, size_t len) {
+    while (len >= 32) {
+        uint32_t mask = avx2_space_mask(_mm256_loadu_si256((const __m256i *)(data + len - 32)));
+        if (mask != UINT32_MAX) return len - 32 + (31 - (unsigned)__builtin_clz(~mask)) + 1;
+        len -= 32;
+    }
+    return sse2_trim_space_end(data, len);
+}
+
+/*
+ * UTF-8 validation by table lookup (Keiser & Lemire, "Validating UTF-8 in less
+ * than one instruction per byte"). Each byte pair (prev, cur) is classified by
+ * three 16-entry tables indexed by prev's high nibble, prev's low nibble and
+ * cur's high nibble; a bit that survives the AND of all three names an error.
+ * Three- and four-byte sequences are then checked by requiring continuation
+ * bytes exactly where a lead two or three bytes back demands them.
+ */
+#define UTF8_TOO_SHORT   (1 << 0)
+#define UTF8_TOO_LONG    (1 << 1)
+#define UTF8_OVERLONG_3  (1 << 2)
+#define UTF8_TOO_LARGE   (1 << 3)
+#define UTF8_SURROGATE   (1 << 4)
+#define UTF8_OVERLONG_2  (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4  (1 << 6)
+#define UTF8_TWO_CONTS   (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// prev<N>: the 32 bytes ending N bytes before the end of `input`.
+#define AVX2_PREV(input, prev_input, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev_input), (input), 0x21), 16 - (n))
+
+SIMD_TARGET("avx2") static inline __m256i avx2_high_nibble(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+SIMD_TARGET("avx2") static inline __m256i avx2_utf8_special_cases(__m256i input, __m256i prev1) {
+    const __m256i byte_1_high_table = UTF8_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low_table = UTF8_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high_table = UTF8_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table, avx2_high_nibble(prev1));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table, avx2_high_nibble(input));
+    return _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+}
+
+SIMD_TARGET("avx2") static inline __m256i avx2_utf8_block_errors(__m256i input, __m256i prev_input) {
+    __m256i prev1 = AVX2_PREV(input, prev_input, 1);
+    __m256i special = avx2_utf8_special_cases(input, prev1);
+
+    // Only 111_____ two back or 1111____ three back leave the high bit set.
+    __m256i prev2 = AVX2_PREV(input, prev_input, 2);
+    __m256i prev3 = AVX2_PREV(input, prev_input, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_continue, special);
+}
+
+// Non-zero when the block ends inside a multi-byte sequence.
+SIMD_TARGET("avx2") static inline __m256i avx2_utf8_incomplete(__m256i input) {
+    const __m256i max_tail = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_tail);
+}
+
+SIMD_TARGET("avx2") static bool avx2_utf8_valid(const char *data, size_t len) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (;;) {
+        __m256i input;
+        if (i + 32 <= len) {
+            input = _mm256_loadu_si256((const __m256i *)(data + i));
+        } else if (i < len) {
+            // Zero padding is ASCII, so a truncated tail shows up as TOO_SHORT.
+            char tail[32] = { 0 };
+            memcpy(tail, data + i, len - i);
+            input = _mm256_loadu_si256((const __m256i *)tail);
+        } else {
+            break;
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+        } else {
+            error = _mm256_or_si256(error, avx2_utf8_block_errors(input, prev_input));
+            prev_incomplete = avx2_utf8_incomplete(input);
+        }
+        prev_input = input;
+        i += 32;
+        if (!_mm256_testz_si256(error, error)) return false;
+    }
+
+    error = _mm256_or_si256(error, prev_incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+SIMD_TARGET("avx2") static inline uint32_t avx2_json_mask(__m256i v) {
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+    __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+    __m256i backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(control, _mm256_or_si256(quote, backslash)));
+}
+
+SIMD_TARGET("avx2") static inline uint32_t avx2_html_mask(__m256i v) {
+    __m256i hit = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&'));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    return (uint32_t)_mm256_movemask_epi8(hit);
+}
+
+SIMD_TARGET("avx2") static size_t avx2_json_plain(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t mask = avx2_json_mask(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    return i + sse2_json_plain(data + i, len - i);
+}
+
+SIMD_TARGET("avx2") static size_t avx2_html_plain(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t mask = avx2_html_mask(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (mask) return i + (unsigned)__builtin_ctz(mask);
+    }
+    return i + sse2_html_plain(data + i, len - i);
+}
+
+// Within each table the bytes have distinct low nibbles, so one shuffle
+// replaces a chain of compares: the table maps a low nibble to the one byte
+// that could match. Unused slots hold 0xFF, which no ASCII byte equals, and
+// bytes >= 0x80 keep their top bit in the index so the shuffle yields 0.
+#define J_ ((char)0xFF)
+
+SIMD_TARGET("avx2") static void avx2_json_classify(const char *block, cwist_simd_json_masks *masks) {
+    // '[' / '{' and ']' / '}' share low nibbles, hence two tables.
+    const __m256i op_table = _mm256_setr_epi8(
+        J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, ':', '{', ',', '}', J_, J_,
+        J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, ':', '{', ',', '}', J_, J_);
+    const __m256i bracket_table = _mm256_setr_epi8(
+        J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, '[', J_, ']', J_, J_,
+        J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, J_, '[', J_, ']', J_, J_);
+    const __m256i space_table = _mm256_setr_epi8(
+        ' ', J_, J_, J_, J_, J_, J_, J_, J_, '\t', '\n', J_, J_, '\r', J_, J_,
+        ' ', J_, J_, J_, J_, J_, J_, J_, J_, '\t', '\n', J_, J_, '\r', J_, J_);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+
+    uint64_t quote = 0, backslash = 0, op = 0, space = 0;
+    for (unsigned i = 0; i < CWIST_SIMD_JSON_BLOCK; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + i));
+        // Keep the top bit so high bytes miss; drop bits 4-6 for the index.
+        __m256i index = _mm256_and_si256(v, _mm256_or_si256(low_nibble, _mm256_set1_epi8((char)0x80)));
+        uint32_t ops = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(op_table, index), v))
+                     | (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(bracket_table, index), v));
+        uint32_t ws = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(space_table, index), v));
+        quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        op |= (uint64_t)ops << i;
+        space |= (uint64_t)ws << i;
+    }
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->op = op;
+    masks->space = space;
+}
+
+#undef J_
+
+static const struct simd_kernels avx2_kernels = {
+    CWIST_SIMD_AVX2,
+    avx2_find,
+    avx2_find_first_of,
+    avx2_equals_nocase,
+    avx2_skip_space,
+    avx2_trim_space_end,
+    avx2_utf8_valid,
+    avx2_json_plain,
+    avx2_html_plain,
+    avx2_json_classify,
+};
+
+#endif /* SIMD_X86 */
+
+/* --- Dispatch --- */
+
+static _Atomic(const struct simd_kernels *) simd_active = NULL;
+
+static cwist_simd_level_t simd_detect(void) {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CWIST_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return CWIST_SIMD_SSE2;
+#endif
+    return CWIST_SIMD_SCALAR;
+}
+
+static const struct simd_kernels *simd_for_level(cwist_simd_level_t level) {
+#ifdef SIMD_X86
+    if (level >= CWIST_SIMD_AVX2) return &avx2_kernels;
+    if (level == CWIST_SIMD_SSE2) return &sse2_kernels;
+#else
+    (void)level;
+#endif
+    return &scalar_kernels;
+}
+
+// Racing first calls all store the same table, so relaxed ordering is enough.
+static const struct simd_kernels *simd_kernels(void) {
+    const struct simd_kernels *k = atomic_load_explicit(&simd_active, memory_order_relaxed);
+    if (!k) {
+        k = simd_for_level(simd_detect());
+        atomic_store_explicit(&simd_active, k, memory_order_relaxed);
+    }
+    return k;
+}
+
+cwist_simd_level_t cwist_simd_level(void) {
+    return simd_kernels()->level;
+}
+
+cwist_simd_level_t cwist_simd_set_level(cwist_simd_level_t level) {
+    cwist_simd_level_t supported = simd_detect();
+    if (level > supported) level = supported;
+    const struct simd_kernels *k = simd_for_level(level);
+    atomic_store_explicit(&simd_active, k, memory_order_relaxed);
+    return k->level;
+}
+
+const char *cwist_simd_level_name(cwist_simd_level_t level) {
+    switch (level) {
+        case CWIST_SIMD_AVX2: return "avx2";
+        case CWIST_SIMD_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+/* --- Entry points --- */
+
+size_t cwist_simd_find(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    if (haystack_len < SIMD_SHORT) return scalar_find(haystack, haystack_len, needle, needle_len);
+    return simd_kernels()->find(haystack, haystack_len, needle, needle_len);
+}
+
+size_t cwist_simd_find_first_of(const char *data, size_t len, const char *set, size_t set_len) {
+    if (len < SIMD_SHORT) return scalar_find_first_of(data, len, set, set_len);
+    return simd_kernels()->find_first_of(data, len, set, set_len);
+}
+
+bool cwist_simd_equals_nocase(const char *left, const char *right, size_t len) {
+    if (len < SIMD_SHORT) return scalar_equals_nocase(left, right, len);
+    return simd_kernels()->equals_nocase(left, right, len);
+}
+
+size_t cwist_simd_skip_space(const char *data, size_t len) {
+    if (len < SIMD_SHORT) return scalar_skip_space(data, len);
+    return simd_kernels()->skip_space(data, len);
+}
+
+size_t cwist_simd_trim_space_end(const char *data, size_t len) {
+    if (len < SIMD_SHORT) return scalar_trim_space_end(data, len);
+    return simd_kernels()->trim_space_end(data, len);
+}
+
+bool cwist_simd_utf8_valid(const char *data, size_t len) {
+    if (len < SIMD_SHORT) return scalar_utf8_valid(data, len);
+    return simd_kernels()->utf8_valid(data, len);
+}
+
+size_t cwist_simd_json_plain(const char *data, size_t len) {
+    if (len < SIMD_SHORT) return scalar_json_plain(data, len);
+    return simd_kernels()->json_plain(data, len);
+}
+
+size_t cwist_simd_html_plain(const char *data, size_t len) {
+    if (len < SIMD_SHORT) return scalar_html_plain(data, len);
+    return simd_kernels()->html_plain(data, len);
+}
+
+void cwist_simd_json_classify(const char *block, cwist_simd_json_masks *masks) {
+    simd_kernels()->json_classify(block, masks);
+}
@@ -1,17 +1,162 @@
 #include <cwist/sstring.h>
 #include <cwist/err/cwist_err.h>
+#include <cwist/session_manager.h>
+#include <cwist/simd.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
 
 size_t cwist_sstring_get_size(cwist_sstring *str);
 int cwist_sstring_compare_sstring(cwist_sstring *left, const cwist_sstring *right);
 cwist_error_t cwist_sstring_copy_sstring(cwist_sstring *origin, const cwist_sstring *from);
 cwist_error_t cwist_sstring_append_sstring(cwist_sstring *str, const cwist_sstring *from);
 
+const cwist_sstring_vtable cwist_sstring_methods = {
+    cwist_sstring_get_size,
+    cwist_sstring_compare_sstring,
+    cwist_sstring_copy_sstring,
+    cwist_sstring_append_sstring,
+};
+
+// Built in place rather than through make_error: this is on every append.
+static inline cwist_error_t sstring_status(int8_t code) {
+    cwist_error_t err = { CWIST_ERR_INT8, CWIST_ERRDOMAIN_SSTRING, { .err_i64 = 0 } };
+    err.error.err_i8 = code;
+    return err;
+}
+
+static inline cwist_error_t sstring_error(void) {
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+/* --- Storage --- */
+
+// `size` is the length; capacity is the longest string the storage can hold
+// without the terminator. Heap buffers are always capacity + 1 bytes.
+
+static size_t sstring_capacity(const cwist_sstring *str) {
+    if (str->is_inline) return CWIST_SSTRING_INLINE_CAP;
+    if (str->is_shared) return str->size;
+    return str->data ? str->capacity : 0;
+}
+
+/* --- Shared (copy-on-write) storage --- */
+
+// A shared string's data is the payload of a session_shared_alloc block
+// holding the terminated text. Arena-backed strings hand their reference to
+// an arena destructor, since arena objects are usually never destroyed.
+
+static void sstring_shared_dec(void *payload) {
+    session_shared_dec(payload);
+}
+
+static void sstring_shared_release(cwist_sstring *str) {
+    if (!str->shared_in_arena) session_shared_dec(str->data);
+    str->is_shared = false;
+    str->shared_in_arena = false;
+}
+
+// Takes over one reference on payload.
+static bool sstring_adopt_shared(cwist_sstring *str, char *payload, size_t size) {
+    struct session_arena *arena = session_arena_from_allocator(str->allocator);
+    if (arena && session_arena_register_destructor(arena, sstring_shared_dec, payload) != 0) {
+        return false;
+    }
+    str->data = payload;
+    str->size = size;
+    str->is_inline = false;
+    str->is_shared = true;
+    str->shared_in_arena = arena != NULL;
+    return true;
+}
+
+// Clones the shared text into private storage of at least `capacity`.
+static bool sstring_unshare(cwist_sstring *str, size_t capacity) {
+    char *shared = str->data;
+    if (capacity < str->size) capacity = str->size;
+
+    if (capacity <= CWIST_SSTRING_INLINE_CAP) {
+        memcpy(str->inline_buf, shared, str->size + 1);
+        str->data = str->inline_buf;
+        str->is_inline = true;
+    } else {
+        char *heap = (char *)cwist_alloc(str->allocator, capacity + 1);
+        if (!heap) return false;
+        memcpy(heap, shared, str->size + 1);
+        str->data = heap;
+        str->capacity = capacity;
+    }
+
+    bool arena_owned = str->shared_in_arena;
+    str->is_shared = false;
+    str->shared_in_arena = false;
+    if (!arena_owned) session_shared_dec(shared);
+    return true;
+}
+
+// Every in-place writer goes through here first.
+static bool sstring_writable(cwist_sstring *str) {
+    return !str->is_shared || sstring_unshare(str, str->size);
+}
+
+// Moves the string into storage of exactly `capacity` (inline when it fits).
+// The caller guarantees capacity >= size.
+static bool sstring_storage_set_capacity(cwist_sstring *str, size_t capacity) {
+    if (capacity == SIZE_MAX) return false;
+    if (str->is_shared) return sstring_unshare(str, capacity);
+
+    if (capacity <= CWIST_SSTRING_INLINE_CAP) {
+        if (str->is_inline) return true;
+        char *heap = str->data;
+        size_t heap_capacity = heap ? str->capacity : 0;
+        if (heap) memcpy(str->inline_buf, heap, str->size + 1);   // overwrites capacity
+        else str->inline_buf[0] = '\0';
+        str->data = str->inline_buf;
+        str->is_inline = true;
+        cwist_free(str->allocator, heap, heap_capacity + 1);
+        return true;
+    }
+
+    char *heap;
+    if (str->is_inline) {
+        heap = (char *)cwist_alloc(str->allocator, capacity + 1);
+        if (!heap) return false;
+        memcpy(heap, str->inline_buf, str->size + 1);
+        str->is_inline = false;
+    } else {
+        size_t old_size = str->data ? str->capacity + 1 : 0;
+        heap = (char *)cwist_realloc(str->allocator, str->data, old_size, capacity + 1);
+        if (!heap) return false;
+        if (!str->data) heap[0] = '\0';
+    }
+    str->data = heap;
+    str->capacity = capacity;
+    return true;
+}
+
+// Amortized growth: at least doubles, so N appends cost O(N) copies.
+static bool sstring_storage_reserve(cwist_sstring *str, size_t capacity) {
+    if (str->is_shared) return sstring_unshare(str, capacity);
+    size_t current = sstring_capacity(str);
+    if (str->data && capacity <= current) return true;
+    size_t grown = current > SIZE_MAX / 2 ? SIZE_MAX - 1 : current * 2;
+    return sstring_storage_set_capacity(str, grown > capacity ? grown : capacity);
+}
+
+static void sstring_storage_free(cwist_sstring *str) {
+    if (str->is_shared) sstring_shared_release(str);
+    else if (!str->is_inline && str->data) cwist_free(str->allocator, str->data, str->capacity + 1);
+}
+
 cwist_error_t cwist_sstring_init(cwist_sstring *str) {
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    return cwist_sstring_init_with(str, NULL);
+}
+
+cwist_error_t cwist_sstring_init_with(cwist_sstring *str, const cwist_allocator *allocator) {
+    cwist_error_t err = sstring_error();
     if (!str) {
         err.error.err_i8 = ERR_SSTRING_NULL_STRING;
         return err;
@@ -20,10 +165,11 @@ cwist_error_t cwist_sstring_init(cwist_sstring *str) {
     str->data = NULL;
     str->size = 0;
     str->is_fixed = false;
-    str->get_size = cwist_sstring_get_size;
-    str->compare = cwist_sstring_compare_sstring;
-    str->copy = cwist_sstring_copy_sstring;
-    str->append = cwist_sstring_append_sstring;
+    str->is_inline = false;
+    str->is_shared = false;
+    str->shared_in_arena = false;
+    str->capacity = 0;
+    str->allocator = allocator ? allocator : cwist_allocator_default();
 
     err.error.err_i8 = ERR_SSTRING_OKAY;
     return err;
@@ -43,45 +189,44 @@ int cwist_sstring_compare_sstring(cwist_sstring *left, const cwist_sstring *righ
 }
 
 cwist_error_t cwist_sstring_ltrim(cwist_sstring *str) {
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    cwist_error_t err = sstring_error();
     err.error.err_i8 = ERR_SSTRING_NULL_STRING;
     if (!str || !str->data) return err;
 
-    size_t len = strlen(str->data);
-    size_t start = 0;
-    while (start < len && isspace((unsigned char)str->data[start])) {
-        start++;
-    }
+    size_t start = cwist_simd_skip_space(str->data, str->size);
 
     if (start > 0) {
-        memmove(str->data, str->data + start, len - start + 1);
-        str->size -= start; 
+        if (!sstring_writable(str)) {
+            err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+            return err;
+        }
+        memmove(str->data, str->data + start, str->size - start + 1);
+        str->size -= start;
     }
 
     err.error.err_i8 = ERR_SSTRING_OKAY;
-    return err;                              
+    return err;
 }
 
 cwist_error_t cwist_sstring_rtrim(cwist_sstring *str) {
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    cwist_error_t err = sstring_error();
     err.error.err_i8 = ERR_SSTRING_NULL_STRING;
-    if (!str || !str->data) return err; 
+    if (!str || !str->data) return err;
 
-    size_t len = strlen(str->data);
-    
-    if (len == 0) {
+    if (str->size == 0) {
       err.error.err_i8 = ERR_SSTRING_ZERO_LENGTH;
       return err;
     }
 
-    size_t end = len - 1;
-    while (end < len && 
-        isspace((unsigned char)str->data[end])) { 
-        end--;
+    size_t end = cwist_simd_trim_space_end(str->data, str->size);
+    if (end < str->size && !sstring_writable(str)) {
+        err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+        return err;
     }
-    
-    str->data[end + 1] = '\0';
-    
+
+    str->data[end] = '\0';
+    str->size = end;
+
     err.error.err_i8 = ERR_SSTRING_OKAY;
     return err;
 }
@@ -93,7 +238,7 @@ cwist_error_t cwist_sstring_trim(cwist_sstring *str) {
 }
 
 cwist_error_t cwist_sstring_change_size(cwist_sstring *str, size_t new_size, bool blow_data) {
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    cwist_error_t err = sstring_error();
 
     if (!str) {
       err.error.err_i8 = ERR_SSTRING_NULL_STRING;
@@ -105,157 +250,482 @@ cwist_error_t cwist_sstring_change_size(cwist_sstring *str, size_t new_size, boo
       return err;
     }
 
-    size_t current_len = str->data ? strlen(str->data) : 0;
-
-    if (new_size < current_len && !blow_data) {
-        err = make_error(CWIST_ERR_JSON);
-        err.error.err_json = cJSON_CreateObject();
-        cJSON_AddStringToObject(err.error.err_json, "err", "New size is smaller than current data length and blow_data is false.");
+    if (new_size < str->size && !blow_data) {
+        err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_SMALL;
         return err;
     }
 
-    char *new_data = (char *)realloc(str->data, new_size + 1); 
-    if (!new_data && new_size > 0) {
+    if (new_size < str->size && !sstring_writable(str)) {
         err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
-        return err;                                                
+        return err;
     }
 
-    str->data = new_data;
-    str->size = new_size;
-    
-    // Ensure null termination if growing or if it was just allocated
-    if (new_size >= current_len) {
-        if (current_len == 0) {
-             str->data[0] = '\0';
-        }
-    } else {
+    // Truncate first so the move to smaller storage only copies what is kept.
+    if (new_size < str->size) {
         str->data[new_size] = '\0';
+        str->size = new_size;
+    }
+
+    if (!sstring_storage_set_capacity(str, new_size)) {
+        err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+        return err;
     }
 
    err.error.err_i8 = ERR_SSTRING_OKAY;
    return err;
 }
 
+cwist_error_t cwist_sstring_reserve(cwist_sstring *str, size_t capacity) {
+    cwist_error_t err = sstring_error();
+    if (!str) {
+        err.error.err_i8 = ERR_SSTRING_NULL_STRING;
+        return err;
+    }
+    if (str->is_fixed) {
+        err.error.err_i8 = capacity <= sstring_capacity(str) ? ERR_SSTRING_OKAY : ERR_SSTRING_CONSTANT;
+        return err;
+    }
+    if (capacity > sstring_capacity(str) && !sstring_storage_set_capacity(str, capacity)) {
+        err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+        return err;
+    }
+    err.error.err_i8 = ERR_SSTRING_OKAY;
+    return err;
+}
+
+cwist_error_t cwist_sstring_shrink_to_fit(cwist_sstring *str) {
+    cwist_error_t err = sstring_error();
+    if (!str) {
+        err.error.err_i8 = ERR_SSTRING_NULL_STRING;
+        return err;
+    }
+    if (str->is_fixed) {
+        err.error.err_i8 = ERR_SSTRING_CONSTANT;
+        return err;
+    }
+    if (str->data && !str->is_shared && !sstring_storage_set_capacity(str, str->size)) {
+        // A failed shrinking realloc leaves the old buffer valid.
+        err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+        return err;
+    }
+    err.error.err_i8 = ERR_SSTRING_OKAY;
+    return err;
+}
+
+cwist_sview cwist_sstring_view(const cwist_sstring *str) {
+    if (!str) return cwist_sview_make(NULL, 0);
+    return cwist_sview_make(str->data, str->size);
+}
+
+size_t cwist_sstring_capacity(const cwist_sstring *str) {
+    return str ? sstring_capacity(str) : 0;
+}
+
 cwist_error_t cwist_sstring_assign(cwist_sstring *str, char *data) {
+    return cwist_sstring_assign_view(str, cwist_sview_from_cstr(data));
+}
+
+cwist_error_t cwist_sstring_assign_view(cwist_sstring *str, cwist_sview view) {
     if (!str) {
-      cwist_error_t err = make_error(CWIST_ERR_INT8);
+      cwist_error_t err = sstring_error();
       err.error.err_i8 = ERR_SSTRING_NULL_STRING;
       return err;
     }
     
-    cwist_error_t err = make_error(CWIST_ERR_JSON);
-    err.error.err_json = cJSON_CreateObject();
-
-    size_t data_len = data ? strlen(data) : 0;
+    size_t data_len = view.len;
+
+    // Overwriting shared text: drop the reference instead of cloning it.
+    // When the view reads from that very block, pin the block so unsharing
+    // cannot free it before the copy below.
+    char *pinned = NULL;
+    if (str->is_shared) {
+        if (view.ptr >= str->data && view.ptr <= str->data + str->size) {
+            if (!str->shared_in_arena) {
+                pinned = str->data;
+                session_shared_inc(pinned);
+            }
+        } else {
+            sstring_shared_release(str);
+            str->data = NULL;
+            str->size = 0;
+        }
+    }
 
     if (str->is_fixed) {
-        if (data_len > str->size) {
-          cJSON_AddStringToObject(err.error.err_json, "err", "string's assigned size is smaller than given data");
-
-          
-          cwist_error_t err_resize = cwist_sstring_change_size(str, strlen(str->data), false);
-          if(err_resize.error.err_i8 == ERR_SSTRING_OKAY) {
-            return err_resize;
-          } else {
-            return err;
-          }
-        }
-        if (str->data) strcpy(str->data, data ? data : "");
-    } else {
-        char *new_data = (char *)realloc(str->data, data_len + 1);
-        if (!new_data) {
-          cJSON_AddStringToObject(err.error.err_json, "err", "cannot assign string: memory is full");
-          return err;
-        }
-        str->data = new_data;
-        str->size = data_len; 
-        if (data) strcpy(str->data, data);
-        else str->data[0] = '\0';
+        if (data_len > sstring_capacity(str)) return sstring_status(ERR_SSTRING_CONSTANT);
+    } else if (!sstring_storage_reserve(str, data_len)) {
+        if (pinned) session_shared_dec(pinned);
+        return sstring_status(ERR_SSTRING_RESIZE_TOO_LARGE);
     }
 
-    cJSON_Delete(err.error.err_json); 
-    err = make_error(CWIST_ERR_INT8);
-    err.error.err_i8 = ERR_SSTRING_OKAY;
+    if (str->data) {
+        // memmove: the view may point into the string itself
+        if (data_len) memmove(str->data, view.ptr, data_len);
+        str->data[data_len] = '\0';
+        str->size = data_len;
+    }
+    if (pinned) session_shared_dec(pinned);
 
-    return err;
+    return sstring_status(ERR_SSTRING_OKAY);
 }
 
 cwist_error_t cwist_sstring_append(cwist_sstring *str, const char *data) {
+    return cwist_sstring_append_view(str, cwist_sview_from_cstr(data));
+}
+
+cwist_error_t cwist_sstring_append_view(cwist_sstring *str, cwist_sview view) {
     if (!str) {
-        cwist_error_t err = make_error(CWIST_ERR_INT8);
+        cwist_error_t err = sstring_error();
         err.error.err_i8 = ERR_SSTRING_NULL_STRING;
         return err;
     }
-    if (!data) {
+    if (!view.ptr) {
         // Appending nothing is success
-        cwist_error_t err = make_error(CWIST_ERR_INT8);
+        cwist_error_t err = sstring_error();
         err.error.err_i8 = ERR_SSTRING_OKAY;
         return err;
     }
 
-    size_t current_len = str->data ? strlen(str->data) : 0;
-    size_t append_len = strlen(data);
-    size_t new_size = current_len + append_len;
+    const char *data = view.ptr;
+    size_t append_len = view.len;
+    size_t new_size = str->size + append_len;
 
-    cwist_error_t err = make_error(CWIST_ERR_JSON);
-    err.error.err_json = cJSON_CreateObject();
+    // Appending the string to itself: remember where the source sits
+    // because growing may move the buffer.
+    bool self = str->data && data >= str->data && data <= str->data + str->size;
+    size_t self_offset = self ? (size_t)(data - str->data) : 0;
 
     if (str->is_fixed) {
-        if (new_size > str->size) {
-            cJSON_AddStringToObject(err.error.err_json, "err", "Cannot append: would exceed fixed size");
-            return err;
-        }
+        if (new_size > sstring_capacity(str)) return sstring_status(ERR_SSTRING_CONSTANT);
+    } else if (!sstring_storage_reserve(str, new_size)) {
+        return sstring_status(ERR_SSTRING_RESIZE_TOO_LARGE);
+    }
+
+    if (str->data) {
+        if (self) data = str->data + self_offset;
+        if (append_len) memmove(str->data + str->size, data, append_len);
+        str->data[new_size] = '\0';
+        str->size = new_size;
+    }
+
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+/* --- Formatting --- */
+
+static const char sstring_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static unsigned sstring_count_digits(uint64_t value) {
+    unsigned digits = 1;
+    for (;;) {
+        if (value < 10) return digits;
+        if (value < 100) return digits + 1;
+        if (value < 1000) return digits + 2;
+        if (value < 10000) return digits + 3;
+        value /= 10000;
+        digits += 4;
+    }
+}
+
+// Makes room for `extra` more bytes and returns where they start.
+static char *sstring_spare(cwist_sstring *str, size_t extra) {
+    if (str->is_fixed) {
+        if (!str->data || str->size + extra > sstring_capacity(str)) return NULL;
+    } else if (!sstring_storage_reserve(str, str->size + extra)) {
+        return NULL;
+    }
+    return str->data + str->size;
+}
+
+static void sstring_commit(cwist_sstring *str, size_t written) {
+    str->size += written;
+    str->data[str->size] = '\0';
+}
+
+// Two digits per step, right to left, straight into the buffer.
+static void sstring_write_uint(char *end, uint64_t value) {
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--end = sstring_digit_pairs[pair + 1];
+        *--end = sstring_digit_pairs[pair];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        *--end = sstring_digit_pairs[pair + 1];
+        *--end = sstring_digit_pairs[pair];
     } else {
-        char *new_data = (char *)realloc(str->data, new_size + 1);
-        if (!new_data) {
-             cJSON_AddStringToObject(err.error.err_json, "err", "Cannot append: memory full");
-             return err;
+        *--end = (char)('0' + value);
+    }
+}
+
+cwist_error_t cwist_sstring_append_uint(cwist_sstring *str, uint64_t value) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+
+    unsigned digits = sstring_count_digits(value);
+    char *out = sstring_spare(str, digits);
+    if (!out) return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+
+    sstring_write_uint(out + digits, value);
+    sstring_commit(str, digits);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+cwist_error_t cwist_sstring_append_int(cwist_sstring *str, int64_t value) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+    if (value >= 0) return cwist_sstring_append_uint(str, (uint64_t)value);
+
+    uint64_t magnitude = (uint64_t)0 - (uint64_t)value;   // well defined for INT64_MIN
+    unsigned digits = sstring_count_digits(magnitude);
+    char *out = sstring_spare(str, digits + 1);
+    if (!out) return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+
+    out[0] = '-';
+    sstring_write_uint(out + 1 + digits, magnitude);
+    sstring_commit(str, digits + 1);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+cwist_error_t cwist_sstring_append_hex(cwist_sstring *str, uint64_t value, bool uppercase) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+
+    const char *alphabet = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    unsigned digits = 1;
+    while (digits < 16 && (value >> (digits * 4)) != 0) digits++;
+
+    char *out = sstring_spare(str, digits);
+    if (!out) return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+
+    for (unsigned i = digits; i > 0; i--) {
+        out[i - 1] = alphabet[value & 0xf];
+        value >>= 4;
+    }
+    sstring_commit(str, digits);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+/* --- Escaping --- */
+
+// Writes the escape for one special byte into out (at most 6 bytes).
+static size_t sstring_json_escape(unsigned char c, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    out[0] = '\\';
+    switch (c) {
+        case '"':  out[1] = '"';  return 2;
+        case '\\': out[1] = '\\'; return 2;
+        case '\b': out[1] = 'b';  return 2;
+        case '\f': out[1] = 'f';  return 2;
+        case '\n': out[1] = 'n';  return 2;
+        case '\r': out[1] = 'r';  return 2;
+        case '\t': out[1] = 't';  return 2;
+        default:
+            memcpy(out + 1, "u00", 3);
+            out[4] = hex[c >> 4];
+            out[5] = hex[c & 0xf];
+            return 6;
+    }
+}
+
+static size_t sstring_html_escape(unsigned char c, char *out) {
+    const char *entity;
+    switch (c) {
+        case '&': entity = "&amp;";  break;
+        case '<': entity = "&lt;";   break;
+        case '>': entity = "&gt;";   break;
+        case '"': entity = "&quot;"; break;
+        default:  entity = "&#39;";  break;
+    }
+    size_t len = strlen(entity);
+    memcpy(out, entity, len);
+    return len;
+}
+
+// Plain runs (found by the vector kernel) are memcpy'd into the spare
+// capacity whole; only the special bytes take the slow path. On failure the
+// string is rolled back to what it held before the call.
+static cwist_error_t sstring_append_escaped(cwist_sstring *str, cwist_sview text,
+                                            size_t (*plain)(const char *, size_t),
+                                            size_t (*escape)(unsigned char, char *)) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+    if (!text.ptr || text.len == 0) return sstring_status(ERR_SSTRING_OKAY);
+
+    // Growing would move the source out from under us.
+    if (str->data && text.ptr >= str->data && text.ptr <= str->data + str->size) {
+        cwist_sstring copy;
+        cwist_sstring_init_with(&copy, str->allocator);
+        cwist_error_t err = cwist_sstring_assign_view(&copy, text);
+        if (err.error.err_i8 == ERR_SSTRING_OKAY) {
+            err = sstring_append_escaped(str, cwist_sstring_view(&copy), plain, escape);
         }
-        str->data = new_data;
-        str->size = new_size;
+        cwist_sstring_release(&copy);
+        return err;
     }
 
-    // Append logic
-    if (str->data) {
-        // If it was empty/null before, we need to make sure we don't strcat to garbage
-        if (current_len == 0) str->data[0] = '\0';
-        strcat(str->data, data);
+    size_t start = str->size;
+    size_t i = 0;
+    // Optimistic reservation: output is at least as long as the input.
+    if (!sstring_spare(str, text.len)) goto fail;
+
+    while (i < text.len) {
+        size_t run = plain(text.ptr + i, text.len - i);
+        if (run) {
+            char *out = sstring_spare(str, run);
+            if (!out) goto fail;
+            memcpy(out, text.ptr + i, run);
+            sstring_commit(str, run);
+            i += run;
+            if (i == text.len) break;
+        }
+
+        char *out = sstring_spare(str, 6);
+        if (!out) goto fail;
+        sstring_commit(str, escape((unsigned char)text.ptr[i], out));
+        i++;
     }
+    return sstring_status(ERR_SSTRING_OKAY);
 
-    cJSON_Delete(err.error.err_json);
-    err = make_error(CWIST_ERR_INT8);
-    err.error.err_i8 = ERR_SSTRING_OKAY;
+fail:
+    if (str->data && str->size != start) {
+        str->size = start;
+        str->data[start] = '\0';
+    }
+    return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+}
+
+cwist_error_t cwist_sstring_append_json_escaped(cwist_sstring *str, cwist_sview text) {
+    return sstring_append_escaped(str, text, cwist_simd_json_plain, sstring_json_escape);
+}
+
+cwist_error_t cwist_sstring_append_html_escaped(cwist_sstring *str, cwist_sview text) {
+    return sstring_append_escaped(str, text, cwist_simd_html_plain, sstring_html_escape);
+}
+
+static const double sstring_pow10[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+#define SSTRING_DOUBLE_EXACT 9007199254740992.0   // 2^53
+
+// Fixed notation through the integer path while the scaled value is still an
+// exact integer in a double; everything else goes to %.17g.
+cwist_error_t cwist_sstring_append_double(cwist_sstring *str, double value, int precision) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+    if (precision < 0) precision = 0;
+    if (precision > 9) precision = 9;
+
+    double magnitude = value < 0 ? -value : value;
+    double scale = sstring_pow10[precision];
+    if (!isfinite(value) || magnitude * scale >= SSTRING_DOUBLE_EXACT) {
+        return cwist_sstring_appendf(str, "%.17g", value);
+    }
+
+    uint64_t scaled = (uint64_t)(magnitude * scale + 0.5);
+    uint64_t whole = scaled / (uint64_t)scale;
+    uint64_t frac = scaled % (uint64_t)scale;
+
+    // Trailing zeros of the fraction carry no information.
+    int frac_digits = precision;
+    while (frac_digits > 0 && frac % 10 == 0) {
+        frac /= 10;
+        frac_digits--;
+    }
+
+    bool negative = signbit(value) && (whole != 0 || frac != 0);
+    unsigned whole_digits = sstring_count_digits(whole);
+    size_t total = (negative ? 1 : 0) + whole_digits + (frac_digits ? 1 + (size_t)frac_digits : 0);
+
+    char *out = sstring_spare(str, total);
+    if (!out) return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+
+    char *p = out;
+    if (negative) *p++ = '-';
+    sstring_write_uint(p + whole_digits, whole);
+    p += whole_digits;
+    if (frac_digits) {
+        *p++ = '.';
+        for (int i = frac_digits; i > 0; i--) {
+            p[i - 1] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+    }
+    sstring_commit(str, total);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+cwist_error_t cwist_sstring_vappendf(cwist_sstring *str, const char *format, va_list args) {
+    if (!str || !format) return sstring_status(ERR_SSTRING_NULL_STRING);
+    if (!sstring_writable(str)) return sstring_status(ERR_SSTRING_RESIZE_TOO_LARGE);
+
+    // First try whatever spare capacity there is; vsnprintf reports the
+    // full length, so at most one retry after growing.
+    size_t spare = str->data ? sstring_capacity(str) - str->size : 0;
+    va_list retry;
+    va_copy(retry, args);
+
+    int needed = vsnprintf(str->data ? str->data + str->size : NULL, str->data ? spare + 1 : 0, format, args);
+    if (needed < 0) {
+        va_end(retry);
+        if (str->data) str->data[str->size] = '\0';
+        return sstring_status(ERR_SSTRING_OUTOFBOUND);
+    }
+
+    if ((size_t)needed > spare || !str->data) {
+        char *out = sstring_spare(str, (size_t)needed);
+        if (!out) {
+            va_end(retry);
+            if (str->data) str->data[str->size] = '\0';
+            return sstring_status(str->is_fixed ? ERR_SSTRING_CONSTANT : ERR_SSTRING_RESIZE_TOO_LARGE);
+        }
+        vsnprintf(out, (size_t)needed + 1, format, retry);
+    }
+    va_end(retry);
+
+    sstring_commit(str, (size_t)needed);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+cwist_error_t cwist_sstring_appendf(cwist_sstring *str, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    cwist_error_t err = cwist_sstring_vappendf(str, format, args);
+    va_end(args);
     return err;
 }
 
 cwist_error_t cwist_sstring_append_sstring(cwist_sstring *str, const cwist_sstring *from) {
     if (!str) {
-        cwist_error_t err = make_error(CWIST_ERR_INT8);
+        cwist_error_t err = sstring_error();
         err.error.err_i8 = ERR_SSTRING_NULL_STRING;
         return err;
     }
     if (!from) {
-        cwist_error_t err = make_error(CWIST_ERR_INT8);
+        cwist_error_t err = sstring_error();
         err.error.err_i8 = ERR_SSTRING_OKAY;
         return err;
     }
-    return cwist_sstring_append(str, from->data);
+    return cwist_sstring_append_view(str, cwist_sstring_view(from));
 }
 
 cwist_error_t cwist_sstring_seek(cwist_sstring *str, char *substr, int location) {
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    cwist_error_t err = sstring_error();
     if (!str || !str->data || !substr) {
       err.error.err_i8 = ERR_SSTRING_NULL_STRING;
       return err;
     }
     
-    size_t len = strlen(str->data);
-    if (location < 0 || (size_t)location >= len) {
+    if (location < 0 || (size_t)location >= str->size) {
       err.error.err_i8 = ERR_SSTRING_OUTOFBOUND;
       return err;
     }
 
-    strcpy(substr, str->data + location);
+    memcpy(substr, str->data + location, str->size - location + 1);
     
     err.error.err_i8 = ERR_SSTRING_OKAY;
     return err;
@@ -263,13 +733,13 @@ cwist_error_t cwist_sstring_seek(cwist_sstring *str, char *substr, int location)
 
 cwist_error_t cwist_sstring_copy(cwist_sstring *origin, char *destination) {
 
-    cwist_error_t err = make_error(CWIST_ERR_INT8);
+    cwist_error_t err = sstring_error();
     if (!origin || !origin->data || !destination) {
       err.error.err_i8 = ERR_SSTRING_NULL_STRING;
       return err;
     }
     
-    strcpy(destination, origin->data);
+    memcpy(destination, origin->data, origin->size + 1);
     
     err.error.err_i8 = ERR_SSTRING_OKAY;
     return err;
@@ -277,39 +747,111 @@ cwist_error_t cwist_sstring_copy(cwist_sstring *origin, char *destination) {
 
 cwist_error_t cwist_sstring_copy_sstring(cwist_sstring *origin, const cwist_sstring *from) {
     if (!origin) {
-        cwist_error_t err = make_error(CWIST_ERR_INT8);
+        cwist_error_t err = sstring_error();
         err.error.err_i8 = ERR_SSTRING_NULL_STRING;
         return err;
     }
     if (!from) {
         return cwist_sstring_assign(origin, NULL);
     }
-    return cwist_sstring_assign(origin, from->data);
+    if (from->is_shared && from != origin && !origin->is_fixed) {
+        if (origin->is_shared && origin->data == from->data) {
+            return sstring_status(ERR_SSTRING_OKAY);
+        }
+        session_shared_inc(from->data);
+        sstring_storage_free(origin);
+        if (sstring_adopt_shared(origin, from->data, from->size)) {
+            return sstring_status(ERR_SSTRING_OKAY);
+        }
+        // No room to register the arena release: fall back to a private copy.
+        origin->data = NULL;
+        origin->size = 0;
+        cwist_error_t err = cwist_sstring_assign_view(origin, cwist_sstring_view(from));
+        session_shared_dec(from->data);
+        return err;
+    }
+    return cwist_sstring_assign_view(origin, cwist_sstring_view(from));
+}
+
+cwist_error_t cwist_sstring_make_shared(cwist_sstring *str) {
+    if (!str) return sstring_status(ERR_SSTRING_NULL_STRING);
+    if (str->is_shared) return sstring_status(ERR_SSTRING_OKAY);
+    if (str->is_fixed) return sstring_status(ERR_SSTRING_CONSTANT);
+
+    // The block outlives any one request, so arena strings share from the
+    // process default allocator.
+    const cwist_allocator *block_allocator = str->allocator;
+    if (session_arena_from_allocator(block_allocator)) block_allocator = cwist_allocator_default();
+
+    char *payload = session_shared_alloc_with(block_allocator, str->size + 1, NULL, 0);
+    if (!payload) return sstring_status(ERR_SSTRING_RESIZE_TOO_LARGE);
+    if (str->data) memcpy(payload, str->data, str->size + 1);
+    else payload[0] = '\0';
+
+    size_t size = str->size;
+    char *old_data = str->data;
+    bool old_inline = str->is_inline;
+    size_t old_capacity = old_inline || !old_data ? 0 : str->capacity;
+
+    if (!sstring_adopt_shared(str, payload, size)) {
+        session_shared_dec(payload);
+        return sstring_status(ERR_SSTRING_RESIZE_TOO_LARGE);
+    }
+    if (!old_inline && old_data) cwist_free(str->allocator, old_data, old_capacity + 1);
+    return sstring_status(ERR_SSTRING_OKAY);
+}
+
+bool cwist_sstring_is_shared(const cwist_sstring *str) {
+    return str && str->is_shared;
 }
 
 cwist_sstring *cwist_sstring_create(void) {
-    cwist_sstring *str = (cwist_sstring *)malloc(sizeof(cwist_sstring));
+    return cwist_sstring_create_with(NULL);
+}
+
+cwist_sstring *cwist_sstring_create_with(const cwist_allocator *allocator) {
+    if (!allocator) allocator = cwist_allocator_default();
+
+    cwist_sstring *str = (cwist_sstring *)cwist_alloc(allocator, sizeof(cwist_sstring));
     if (!str) return NULL;
 
     memset(str, 0, sizeof(cwist_sstring));
-    str->is_fixed = false;
-    str->size = 0;
-    str->data = NULL; // Initially empty
-    str->get_size = cwist_sstring_get_size;
-    str->compare = cwist_sstring_compare_sstring;
-    str->copy = cwist_sstring_copy_sstring;
-    str->append = cwist_sstring_append_sstring;
-
+    cwist_sstring_init_with(str, allocator);
     return str;
 }
 
+cwist_sstring *cwist_sstring_create_in(struct session_arena *arena) {
+    return cwist_sstring_create_with(session_arena_allocator(arena));
+}
+
 void cwist_sstring_destroy(cwist_sstring *str) {
     if (str) {
-        if (str->data) free(str->data);
-        free(str);
+        const cwist_allocator *allocator = str->allocator;
+        sstring_storage_free(str);
+        cwist_free(allocator, str, sizeof(cwist_sstring));
     }
 }
 
+void cwist_sstring_release(cwist_sstring *str) {
+    if (!str) return;
+    sstring_storage_free(str);
+    str->data = NULL;
+    str->size = 0;
+    str->is_inline = false;
+    str->capacity = 0;
+}
+
+size_t cwist_sstring_find(const cwist_sstring *str, const char *needle) {
+    if (!str || !str->data || !needle) return CWIST_SVIEW_NPOS;
+    return cwist_simd_find(str->data, str->size, needle, strlen(needle));
+}
+
+bool cwist_sstring_equals_nocase(const cwist_sstring *str, const char *other) {
+    if (!str || !str->data || !other) return false;
+    size_t len = strlen(other);
+    return len == str->size && cwist_simd_equals_nocase(str->data, other, len);
+}
+
 int cwist_sstring_compare(cwist_sstring *str, const char *compare_to) {
     if (!str || !str->data) {
         if (!compare_to) return 0; // Both NULL-ish (empty treated as NULL for comparison?)
@@ -323,7 +865,7 @@ int cwist_sstring_compare(cwist_sstring *str, const char *compare_to) {
 cwist_sstring *cwist_sstring_substr(cwist_sstring *str, int start, int length) {
     if (!str || !str->data || start < 0 || length < 0) return NULL;
     
-    size_t current_len = strlen(str->data);
+    size_t current_len = str->size;
     if ((size_t)start >= current_len) return NULL;
     
     // Adjust length if it goes beyond end
@@ -331,11 +873,10 @@ cwist_sstring *cwist_sstring_substr(cwist_sstring *str, int start, int length) {
         length = current_len - start;
     }
     
-    cwist_sstring *sub = cwist_sstring_create();
+    cwist_sstring *sub = cwist_sstring_create_with(str->allocator);
     if (!sub) return NULL;
     
-    sub->data = (char *)malloc(length + 1);
-    if (!sub->data) {
+    if (!sstring_storage_set_capacity(sub, length)) {
         cwist_sstring_destroy(sub);
         return NULL;
     }
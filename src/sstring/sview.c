@@ -0,0 +1,181 @@
+#include <cwist/sview.h>
+#include <cwist/simd.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SVIEW_DOUBLE_MAX 64   // longest text handed to strtod
+
+cwist_sview cwist_sview_make(const char *ptr, size_t len) {
+    cwist_sview view = { ptr, ptr ? len : 0 };
+    return view;
+}
+
+cwist_sview cwist_sview_from_cstr(const char *str) {
+    return cwist_sview_make(str, str ? strlen(str) : 0);
+}
+
+/* --- Comparison --- */
+
+int cwist_sview_compare(cwist_sview left, cwist_sview right) {
+    size_t n = left.len < right.len ? left.len : right.len;
+    int cmp = n ? memcmp(left.ptr, right.ptr, n) : 0;
+    if (cmp != 0) return cmp;
+    return (left.len > right.len) - (left.len < right.len);
+}
+
+// ASCII only, like the SIMD fold: tolower() would follow the locale.
+static inline int sview_fold(unsigned char c) {
+    return (unsigned char)(c - 'A') <= 'Z' - 'A' ? c | 0x20 : c;
+}
+
+int cwist_sview_casecmp(cwist_sview left, cwist_sview right) {
+    size_t n = left.len < right.len ? left.len : right.len;
+    for (size_t i = 0; i < n; i++) {
+        int a = sview_fold((unsigned char)left.ptr[i]);
+        int b = sview_fold((unsigned char)right.ptr[i]);
+        if (a != b) return a - b;
+    }
+    return (left.len > right.len) - (left.len < right.len);
+}
+
+bool cwist_sview_equals(cwist_sview left, cwist_sview right) {
+    return left.len == right.len && (left.len == 0 || memcmp(left.ptr, right.ptr, left.len) == 0);
+}
+
+bool cwist_sview_equals_nocase(cwist_sview left, cwist_sview right) {
+    return left.len == right.len && (left.len == 0 || cwist_simd_equals_nocase(left.ptr, right.ptr, left.len));
+}
+
+bool cwist_sview_starts_with(cwist_sview view, cwist_sview prefix) {
+    return view.len >= prefix.len && (prefix.len == 0 || memcmp(view.ptr, prefix.ptr, prefix.len) == 0);
+}
+
+bool cwist_sview_ends_with(cwist_sview view, cwist_sview suffix) {
+    return view.len >= suffix.len &&
+           (suffix.len == 0 || memcmp(view.ptr + view.len - suffix.len, suffix.ptr, suffix.len) == 0);
+}
+
+/* --- Search --- */
+
+size_t cwist_sview_find_char(cwist_sview view, char c) {
+    if (view.len == 0) return CWIST_SVIEW_NPOS;
+    const char *hit = memchr(view.ptr, c, view.len);
+    return hit ? (size_t)(hit - view.ptr) : CWIST_SVIEW_NPOS;
+}
+
+size_t cwist_sview_find(cwist_sview haystack, cwist_sview needle) {
+    if (needle.len == 0) return 0;
+    return cwist_simd_find(haystack.ptr, haystack.len, needle.ptr, needle.len);
+}
+
+size_t cwist_sview_find_first_of(cwist_sview view, cwist_sview set) {
+    if (view.len == 0 || set.len == 0) return CWIST_SVIEW_NPOS;
+    return cwist_simd_find_first_of(view.ptr, view.len, set.ptr, set.len);
+}
+
+/* --- Slicing --- */
+
+cwist_sview cwist_sview_substr(cwist_sview view, size_t pos, size_t len) {
+    if (pos > view.len) pos = view.len;
+    if (len > view.len - pos) len = view.len - pos;
+    return cwist_sview_make(view.ptr ? view.ptr + pos : NULL, len);
+}
+
+cwist_sview cwist_sview_ltrim(cwist_sview view) {
+    if (view.len == 0) return view;
+    size_t skip = cwist_simd_skip_space(view.ptr, view.len);
+    view.ptr += skip;
+    view.len -= skip;
+    return view;
+}
+
+cwist_sview cwist_sview_rtrim(cwist_sview view) {
+    if (view.len == 0) return view;
+    view.len = cwist_simd_trim_space_end(view.ptr, view.len);
+    return view;
+}
+
+cwist_sview cwist_sview_trim(cwist_sview view) {
+    return cwist_sview_ltrim(cwist_sview_rtrim(view));
+}
+
+bool cwist_sview_split(cwist_sview *rest, char delim, cwist_sview *token) {
+    if (!rest || !rest->ptr || !token) return false;
+
+    size_t at = cwist_sview_find_char(*rest, delim);
+    if (at == CWIST_SVIEW_NPOS) {
+        *token = *rest;
+        rest->ptr = NULL;   // used up
+        rest->len = 0;
+        return true;
+    }
+    *token = cwist_sview_make(rest->ptr, at);
+    rest->ptr += at + 1;
+    rest->len -= at + 1;
+    return true;
+}
+
+bool cwist_sview_utf8_valid(cwist_sview view) {
+    return view.len == 0 || cwist_simd_utf8_valid(view.ptr, view.len);
+}
+
+/* --- Numbers --- */
+
+static int sview_digit(char c, int base) {
+    int value;
+    if (c >= '0' && c <= '9') value = c - '0';
+    else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+    else return -1;
+    return value < base ? value : -1;
+}
+
+bool cwist_sview_to_uint64(cwist_sview view, int base, uint64_t *out) {
+    if (view.len == 0 || !out || (base != 10 && base != 16)) return false;
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < view.len; i++) {
+        int digit = sview_digit(view.ptr[i], base);
+        if (digit < 0) return false;
+        if (value > (UINT64_MAX - (uint64_t)digit) / (uint64_t)base) return false;
+        value = value * (uint64_t)base + (uint64_t)digit;
+    }
+    *out = value;
+    return true;
+}
+
+bool cwist_sview_to_int64(cwist_sview view, int64_t *out) {
+    if (view.len == 0 || !out) return false;
+
+    bool negative = view.ptr[0] == '-';
+    if (negative || view.ptr[0] == '+') view = cwist_sview_substr(view, 1, view.len);
+
+    uint64_t magnitude;
+    if (!cwist_sview_to_uint64(view, 10, &magnitude)) return false;
+    if (negative) {
+        if (magnitude > (uint64_t)INT64_MAX + 1) return false;
+        *out = magnitude == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)magnitude;
+    } else {
+        if (magnitude > (uint64_t)INT64_MAX) return false;
+        *out = (int64_t)magnitude;
+    }
+    return true;
+}
+
+// strtod wants a terminated string, so copy to the stack first.
+bool cwist_sview_to_double(cwist_sview view, double *out) {
+    if (view.len == 0 || view.len >= SVIEW_DOUBLE_MAX || !out) return false;
+    if (isspace((unsigned char)view.ptr[0])) return false;
+
+    char buf[SVIEW_DOUBLE_MAX];
+    memcpy(buf, view.ptr, view.len);
+    buf[view.len] = '\0';
+
+    char *end;
+    double value = strtod(buf, &end);
+    if (end != buf + view.len) return false;
+    *out = value;
+    return true;
+}
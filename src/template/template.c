@@ -0,0 +1,366 @@
+#include <cwist/template.h>
+#include <cwist/simd.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEMPLATE_NO_SCRATCH SIZE_MAX
+
+enum template_op {
+    TEMPLATE_STATIC,
+    TEMPLATE_HTML,
+    TEMPLATE_RAW,
+    TEMPLATE_JSON,
+    TEMPLATE_INT,
+    TEMPLATE_SECTION,
+};
+
+struct template_node {
+    enum template_op op;
+    uint32_t slot;
+    uint32_t end;           // sections: first node after the body
+    const char *text;       // static text inside tpl->source
+    size_t len;
+};
+
+struct cwist_template {
+    char *source;           // private copy; static nodes point into it
+    size_t source_len;
+    struct template_node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    char **slot_names;
+    size_t slot_count;
+    const cwist_allocator *allocator;
+};
+
+static cwist_error_t template_status(int8_t code) {
+    return cwist_error_make(CWIST_ERRDOMAIN_TEMPLATE, CWIST_ERR_INT8, code);
+}
+
+static cwist_error_t template_no_memory(void) {
+    return cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+}
+
+/* --- Compile --- */
+
+static bool template_name_valid(cwist_sview name) {
+    if (name.len == 0) return false;
+    for (size_t i = 0; i < name.len; i++) {
+        char c = name.ptr[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '_' || c == '.' || c == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Index of name, registering it on first use; -1 when out of memory.
+static int template_intern(cwist_template *tpl, cwist_sview name) {
+    for (size_t i = 0; i < tpl->slot_count; i++) {
+        if (cwist_sview_equals(cwist_sview_from_cstr(tpl->slot_names[i]), name)) return (int)i;
+    }
+
+    size_t size = tpl->slot_count * sizeof(char *);
+    char **names = cwist_realloc(tpl->allocator, tpl->slot_names, size, size + sizeof(char *));
+    if (!names) return -1;
+    tpl->slot_names = names;
+    char *copy = cwist_alloc(tpl->allocator, name.len + 1);
+    if (!copy) return -1;
+    memcpy(copy, name.ptr, name.len);
+    copy[name.len] = '\0';
+    tpl->slot_names[tpl->slot_count] = copy;
+    return (int)tpl->slot_count++;
+}
+
+static struct template_node *template_push(cwist_template *tpl, enum template_op op) {
+    if (tpl->node_count == tpl->node_capacity) {
+        size_t grown = tpl->node_capacity ? tpl->node_capacity * 2 : 16;
+        struct template_node *nodes = cwist_realloc(tpl->allocator, tpl->nodes,
+                                                    tpl->node_capacity * sizeof(*nodes), grown * sizeof(*nodes));
+        if (!nodes) return NULL;
+        tpl->nodes = nodes;
+        tpl->node_capacity = grown;
+    }
+    struct template_node *node = &tpl->nodes[tpl->node_count++];
+    memset(node, 0, sizeof(*node));
+    node->op = op;
+    return node;
+}
+
+static bool template_push_static(cwist_template *tpl, const char *text, size_t len) {
+    if (len == 0) return true;
+    struct template_node *node = template_push(tpl, TEMPLATE_STATIC);
+    if (!node) return false;
+    node->text = text;
+    node->len = len;
+    return true;
+}
+
+static cwist_error_t template_parse(cwist_template *tpl, size_t *error_at) {
+    cwist_sview source = cwist_sview_make(tpl->source, tpl->source_len);
+    uint32_t sections[CWIST_TEMPLATE_MAX_DEPTH];
+    size_t depth = 0;
+    size_t pos = 0;
+
+    while (pos < source.len) {
+        cwist_sview rest = cwist_sview_substr(source, pos, source.len - pos);
+        size_t open = cwist_sview_find(rest, CWIST_SVIEW_LIT("{{"));
+        if (open == CWIST_SVIEW_NPOS) {
+            if (!template_push_static(tpl, rest.ptr, rest.len)) return template_no_memory();
+            break;
+        }
+        if (!template_push_static(tpl, rest.ptr, open)) return template_no_memory();
+        open += pos;
+        *error_at = open;
+
+        bool triple = open + 2 < source.len && source.ptr[open + 2] == '{';
+        cwist_sview marker = triple ? CWIST_SVIEW_LIT("}}}") : CWIST_SVIEW_LIT("}}");
+        size_t inner_at = open + (triple ? 3 : 2);
+        size_t close = cwist_sview_find(cwist_sview_substr(source, inner_at, source.len - inner_at), marker);
+        if (close == CWIST_SVIEW_NPOS) return template_status(ERR_TEMPLATE_UNCLOSED_TAG);
+        cwist_sview inner = cwist_sview_trim(cwist_sview_make(source.ptr + inner_at, close));
+        pos = inner_at + close + marker.len;
+
+        enum template_op op = triple ? TEMPLATE_RAW : TEMPLATE_HTML;
+        char sigil = !triple && inner.len > 0 ? inner.ptr[0] : '\0';
+        if (sigil == '!') continue;
+        if (sigil == '#' || sigil == '/') inner = cwist_sview_trim(cwist_sview_substr(inner, 1, inner.len));
+
+        size_t bar = cwist_sview_find(inner, CWIST_SVIEW_LIT("|"));
+        if (!triple && sigil != '#' && sigil != '/' && bar != CWIST_SVIEW_NPOS) {
+            cwist_sview filter = cwist_sview_trim(cwist_sview_substr(inner, bar + 1, inner.len));
+            inner = cwist_sview_trim(cwist_sview_substr(inner, 0, bar));
+            if (cwist_sview_equals(filter, CWIST_SVIEW_LIT("json"))) op = TEMPLATE_JSON;
+            else if (cwist_sview_equals(filter, CWIST_SVIEW_LIT("int"))) op = TEMPLATE_INT;
+            else return template_status(ERR_TEMPLATE_UNKNOWN_FILTER);
+        }
+        if (!template_name_valid(inner)) return template_status(ERR_TEMPLATE_BAD_NAME);
+        int slot = template_intern(tpl, inner);
+        if (slot < 0) return template_no_memory();
+
+        if (sigil == '/') {
+            if (depth == 0 || tpl->nodes[sections[depth - 1]].slot != (uint32_t)slot) {
+                return template_status(ERR_TEMPLATE_UNBALANCED);
+            }
+            tpl->nodes[sections[--depth]].end = (uint32_t)tpl->node_count;
+            continue;
+        }
+        if (sigil == '#') {
+            if (depth == CWIST_TEMPLATE_MAX_DEPTH) return template_status(ERR_TEMPLATE_TOO_DEEP);
+            op = TEMPLATE_SECTION;
+            sections[depth++] = (uint32_t)tpl->node_count;
+        }
+        struct template_node *node = template_push(tpl, op);
+        if (!node) return template_no_memory();
+        node->slot = (uint32_t)slot;
+    }
+
+    if (depth != 0) {
+        *error_at = tpl->source_len;
+        return template_status(ERR_TEMPLATE_UNBALANCED);
+    }
+    return template_status(ERR_TEMPLATE_OKAY);
+}
+
+cwist_error_t cwist_template_compile(cwist_sview source, cwist_template **out, size_t *error_at) {
+    size_t at = 0;
+    if (!error_at) error_at = &at;
+    *error_at = 0;
+    if (!out) return template_status(ERR_TEMPLATE_BAD_NAME);
+    *out = NULL;
+
+    const cwist_allocator *allocator = cwist_allocator_default();
+    cwist_template *tpl = cwist_alloc(allocator, sizeof(*tpl));
+    if (!tpl) return template_no_memory();
+    memset(tpl, 0, sizeof(*tpl));
+    tpl->allocator = allocator;
+
+    tpl->source = cwist_alloc(allocator, source.len + 1);
+    if (!tpl->source) {
+        cwist_template_destroy(tpl);
+        return template_no_memory();
+    }
+    if (source.len) memcpy(tpl->source, source.ptr, source.len);
+    tpl->source[source.len] = '\0';
+    tpl->source_len = source.len;
+
+    cwist_error_t err = template_parse(tpl, error_at);
+    if (cwist_error_code(err) != 0) {
+        cwist_template_destroy(tpl);
+        return err;
+    }
+    *out = tpl;
+    return err;
+}
+
+void cwist_template_destroy(cwist_template *tpl) {
+    if (!tpl) return;
+    const cwist_allocator *allocator = tpl->allocator;
+    for (size_t i = 0; i < tpl->slot_count; i++) {
+        cwist_free(allocator, tpl->slot_names[i], strlen(tpl->slot_names[i]) + 1);
+    }
+    cwist_free(allocator, tpl->slot_names, tpl->slot_count * sizeof(char *));
+    cwist_free(allocator, tpl->nodes, tpl->node_capacity * sizeof(struct template_node));
+    cwist_free(allocator, tpl->source, tpl->source_len + 1);
+    cwist_free(allocator, tpl, sizeof(*tpl));
+}
+
+int cwist_template_slot(const cwist_template *tpl, const char *name) {
+    if (!tpl || !name) return -1;
+    for (size_t i = 0; i < tpl->slot_count; i++) {
+        if (strcmp(tpl->slot_names[i], name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+size_t cwist_template_slot_count(const cwist_template *tpl) {
+    return tpl ? tpl->slot_count : 0;
+}
+
+/* --- Output --- */
+
+void cwist_template_output_init(cwist_template_output *out, const cwist_allocator *allocator) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->allocator = allocator ? allocator : cwist_allocator_default();
+    out->scratch = cwist_sstring_create_with(out->allocator);
+}
+
+void cwist_template_output_reset(cwist_template_output *out) {
+    if (!out) return;
+    out->count = 0;
+    out->total = 0;
+    if (out->scratch && out->scratch->data) {
+        out->scratch->size = 0;
+        out->scratch->data[0] = '\0';
+    }
+}
+
+void cwist_template_output_destroy(cwist_template_output *out) {
+    if (!out) return;
+    cwist_free(out->allocator, out->iov, out->capacity * sizeof(struct iovec));
+    cwist_free(out->allocator, out->scratch_at, out->capacity * sizeof(size_t));
+    cwist_sstring_destroy(out->scratch);
+    memset(out, 0, sizeof(*out));
+}
+
+static bool output_reserve(cwist_template_output *out) {
+    if (out->count < out->capacity) return true;
+    size_t grown = out->capacity ? out->capacity * 2 : 32;
+    struct iovec *iov = cwist_realloc(out->allocator, out->iov, out->capacity * sizeof(*iov), grown * sizeof(*iov));
+    if (!iov) return false;
+    out->iov = iov;
+    size_t *scratch_at = cwist_realloc(out->allocator, out->scratch_at, out->capacity * sizeof(size_t), grown * sizeof(size_t));
+    if (!scratch_at) return false;
+    out->scratch_at = scratch_at;
+    out->capacity = grown;
+    return true;
+}
+
+static bool output_borrow(cwist_template_output *out, const char *bytes, size_t len) {
+    if (len == 0) return true;
+    if (!output_reserve(out)) return false;
+    out->iov[out->count].iov_base = (void *)bytes;
+    out->iov[out->count].iov_len = len;
+    out->scratch_at[out->count] = TEMPLATE_NO_SCRATCH;
+    out->count++;
+    out->total += len;
+    return true;
+}
+
+// Records scratch[offset, scratch->size) as the next entry; neighbours in
+// scratch merge into one entry.
+static bool output_scratch(cwist_template_output *out, size_t offset) {
+    size_t len = out->scratch->size - offset;
+    if (len == 0) return true;
+    out->total += len;
+    if (out->count > 0) {
+        size_t last = out->count - 1;
+        if (out->scratch_at[last] != TEMPLATE_NO_SCRATCH && out->scratch_at[last] + out->iov[last].iov_len == offset) {
+            out->iov[last].iov_len += len;
+            return true;
+        }
+    }
+    if (!output_reserve(out)) return false;
+    out->iov[out->count].iov_base = NULL;
+    out->iov[out->count].iov_len = len;
+    out->scratch_at[out->count] = offset;
+    out->count++;
+    return true;
+}
+
+/* --- Render --- */
+
+static cwist_error_t template_escaped(cwist_template_output *out, cwist_sview text, bool json) {
+    size_t plain = json ? cwist_simd_json_plain(text.ptr, text.len) : cwist_simd_html_plain(text.ptr, text.len);
+    if (plain == text.len) {
+        return output_borrow(out, text.ptr, text.len) ? template_status(ERR_TEMPLATE_OKAY) : template_no_memory();
+    }
+
+    size_t offset = out->scratch->size;
+    cwist_error_t err = json ? cwist_sstring_append_json_escaped(out->scratch, text)
+                             : cwist_sstring_append_html_escaped(out->scratch, text);
+    if (cwist_error_code(err) != 0) return err;
+    return output_scratch(out, offset) ? template_status(ERR_TEMPLATE_OKAY) : template_no_memory();
+}
+
+static cwist_error_t template_render_range(const cwist_template *tpl, uint32_t begin, uint32_t end,
+                                           const cwist_template_arg *args, cwist_template_output *out) {
+    static const cwist_template_arg empty = { { NULL, 0 }, 0, NULL, 0 };
+
+    for (uint32_t i = begin; i < end; i++) {
+        const struct template_node *node = &tpl->nodes[i];
+        const cwist_template_arg *arg = args && node->op != TEMPLATE_STATIC ? &args[node->slot] : &empty;
+        cwist_error_t err = template_status(ERR_TEMPLATE_OKAY);
+
+        switch (node->op) {
+            case TEMPLATE_STATIC:
+                if (!output_borrow(out, node->text, node->len)) return template_no_memory();
+                break;
+            case TEMPLATE_RAW:
+                if (arg->text.ptr && !output_borrow(out, arg->text.ptr, arg->text.len)) return template_no_memory();
+                break;
+            case TEMPLATE_HTML:
+            case TEMPLATE_JSON:
+                if (arg->text.ptr && arg->text.len) err = template_escaped(out, arg->text, node->op == TEMPLATE_JSON);
+                break;
+            case TEMPLATE_INT: {
+                size_t offset = out->scratch->size;
+                err = cwist_sstring_append_int(out->scratch, arg->number);
+                if (cwist_error_code(err) == 0 && !output_scratch(out, offset)) return template_no_memory();
+                break;
+            }
+            case TEMPLATE_SECTION:
+                for (size_t row = 0; row < arg->count && arg->rows; row++) {
+                    err = template_render_range(tpl, i + 1, node->end, arg->rows + row * tpl->slot_count, out);
+                    if (cwist_error_code(err) != 0) return err;
+                }
+                i = node->end - 1;
+                break;
+        }
+        if (cwist_error_code(err) != 0) return err;
+    }
+    return template_status(ERR_TEMPLATE_OKAY);
+}
+
+cwist_error_t cwist_template_render(const cwist_template *tpl, const cwist_template_arg *args, cwist_template_output *out) {
+    if (!tpl || !out || !out->scratch) return template_status(ERR_TEMPLATE_BAD_NAME);
+    cwist_error_t err = template_render_range(tpl, 0, (uint32_t)tpl->node_count, args, out);
+
+    // scratch may have moved while growing: point its entries at the final buffer.
+    for (size_t i = 0; i < out->count; i++) {
+        if (out->scratch_at[i] != TEMPLATE_NO_SCRATCH) out->iov[i].iov_base = out->scratch->data + out->scratch_at[i];
+    }
+    return err;
+}
+
+cwist_error_t cwist_template_output_flatten(const cwist_template_output *out, cwist_sstring *dst) {
+    if (!out || !dst) return cwist_error_make(CWIST_ERRDOMAIN_SSTRING, CWIST_ERR_INT8, ERR_SSTRING_NULL_STRING);
+    cwist_error_t err = cwist_sstring_assign_view(dst, CWIST_SVIEW_LIT(""));
+    for (size_t i = 0; i < out->count && cwist_error_code(err) == 0; i++) {
+        err = cwist_sstring_append_view(dst, cwist_sview_make(out->iov[i].iov_base, out->iov[i].iov_len));
+    }
+    return err;
+}
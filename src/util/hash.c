@@ -0,0 +1,47 @@
+#include <cwist/hash.h>
+#include <string.h>
+
+#define HASH_K1 0x9e3779b97f4a7c15ULL
+#define HASH_K2 0xff51afd7ed558ccdULL
+#define HASH_K3 0xc4ceb9fe1a85ec53ULL
+
+static inline uint64_t hash_fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= HASH_K2;
+    h ^= h >> 33;
+    h *= HASH_K3;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t hash_rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+uint64_t cwist_hash64(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t h = seed ^ ((uint64_t)len * HASH_K1);
+
+    while (len >= 8) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        k *= HASH_K2;
+        k = hash_rotl(k, 31);
+        k *= HASH_K3;
+        h ^= k;
+        h = hash_rotl(h, 27) * 5 + 0x52dce729;
+        p += 8;
+        len -= 8;
+    }
+
+    if (len > 0) {
+        uint64_t k = 0;
+        memcpy(&k, p, len);
+        k *= HASH_K2;
+        k = hash_rotl(k, 31);
+        k *= HASH_K3;
+        h ^= k;
+    }
+
+    return hash_fmix(h);
+}
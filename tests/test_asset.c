@@ -0,0 +1,215 @@
+#include <cwist/asset.h>
+#include <cwist/http.h>
+#include "test_assets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    assert(fread(data, 1, *len, f) == *len);
+    fclose(f);
+    return data;
+}
+
+void test_asset_table() {
+    printf("Testing embedded asset table...\n");
+    // Sorted, hidden files skipped, prefix applied.
+    assert(test_assets_count == 3);
+    assert(strcmp(test_assets[0].path, "/static/css/site.css") == 0);
+    assert(strcmp(test_assets[1].path, "/static/index.html") == 0);
+    assert(strcmp(test_assets[2].path, "/static/logo.png") == 0);
+    assert(cwist_asset_find(test_assets, test_assets_count, CWIST_SVIEW_LIT("/static/.hidden")) == NULL);
+    assert(cwist_asset_find(test_assets, test_assets_count, CWIST_SVIEW_LIT("/static/index")) == NULL);
+
+    const cwist_asset *html = cwist_asset_find(test_assets, test_assets_count, CWIST_SVIEW_LIT("/static/index.html"));
+    assert(html == &test_assets[1]);
+    size_t len;
+    char *disk = read_file("tests/assets/index.html", &len);
+    assert(html->body_len == len && memcmp(html->body, disk, len) == 0);
+    assert(strcmp(html->content_type, "text/html; charset=utf-8") == 0);
+    assert(strlen(html->head) == html->head_len);
+    assert(strncmp(html->head, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(html->head, "Cache-Control: public, max-age=3600\r\n") != NULL);
+    assert(strstr(html->head, "Vary: Accept-Encoding\r\n") != NULL);
+    assert(strstr(html->head, html->etag) != NULL);
+    assert(strcmp(html->head + html->head_len - 4, "\r\n\r\n") == 0);
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Content-Length: %zu\r\n", len);
+    assert(strstr(html->head, expect) != NULL);
+
+    // The gzip variant inflates back to the file.
+    assert(html->gzip != NULL && html->gzip_len < html->body_len);
+    assert(strstr(html->gzip_head, "Content-Encoding: gzip\r\n") != NULL);
+    snprintf(expect, sizeof(expect), "Content-Length: %zu\r\n", html->gzip_len);
+    assert(strstr(html->gzip_head, expect) != NULL);
+    char *inflated = malloc(len);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    assert(inflateInit2(&z, 15 + 16) == Z_OK);
+    z.next_in = (Bytef *)html->gzip;
+    z.avail_in = (uInt)html->gzip_len;
+    z.next_out = (Bytef *)inflated;
+    z.avail_out = (uInt)len;
+    assert(inflate(&z, Z_FINISH) == Z_STREAM_END);
+    assert(z.total_out == len && memcmp(inflated, disk, len) == 0);
+    inflateEnd(&z);
+
+    // Binary and tiny files get no variant.
+    const cwist_asset *png = &test_assets[2];
+    assert(strcmp(png->content_type, "image/png") == 0 && png->gzip == NULL);
+    assert(strstr(png->head, "Vary:") == NULL);
+    assert(test_assets[0].gzip == NULL);
+
+    free(inflated);
+    free(disk);
+    printf("Passed embedded asset table.\n");
+}
+
+static size_t drain(int fd, char *buffer, size_t size) {
+    size_t got = 0;
+    ssize_t n;
+    while ((n = recv(fd, buffer + got, size - got, 0)) > 0) got += (size_t)n;
+    return got;
+}
+
+void test_asset_send() {
+    printf("Testing embedded asset send...\n");
+    const cwist_asset *html = &test_assets[1];
+    char buffer[4096];
+    int sv[2];
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(cwist_error_code(cwist_asset_send(sv[0], html, false)) == 0);
+    close(sv[0]);
+    size_t got = drain(sv[1], buffer, sizeof(buffer));
+    close(sv[1]);
+    assert(got == html->head_len + html->body_len);
+    assert(memcmp(buffer, html->head, html->head_len) == 0);
+    assert(memcmp(buffer + html->head_len, html->body, html->body_len) == 0);
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(cwist_error_code(cwist_asset_send(sv[0], html, true)) == 0);
+    close(sv[0]);
+    got = drain(sv[1], buffer, sizeof(buffer));
+    close(sv[1]);
+    assert(got == html->gzip_head_len + html->gzip_len);
+    assert(memcmp(buffer + html->gzip_head_len, html->gzip, html->gzip_len) == 0);
+
+    // No variant: gzip falls back to the identity body.
+    const cwist_asset *png = &test_assets[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(cwist_error_code(cwist_asset_send_head(sv[0], png, true)) == 0);
+    close(sv[0]);
+    got = drain(sv[1], buffer, sizeof(buffer));
+    close(sv[1]);
+    assert(got == png->head_len && memcmp(buffer, png->head, got) == 0);
+    printf("Passed embedded asset send.\n");
+}
+
+static size_t serve(const cwist_asset *asset, const char *headers, char *buffer, size_t size) {
+    cwist_http_request *req = cwist_http_parse_request(headers);
+    assert(req != NULL);
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(cwist_error_code(cwist_asset_serve(sv[0], asset, req)) == 0);
+    close(sv[0]);
+    size_t got = drain(sv[1], buffer, size - 1);
+    buffer[got] = '\0';
+    close(sv[1]);
+    cwist_http_request_destroy(req);
+    return got;
+}
+
+void test_asset_serve() {
+    printf("Testing conditional asset serving...\n");
+    const cwist_asset *html = &test_assets[1];
+    char buffer[4096], headers[256];
+
+    // The generated 304 heads repeat the validator and caching headers only.
+    assert(strlen(html->not_modified) == html->not_modified_len);
+    assert(strncmp(html->not_modified, "HTTP/1.1 304 Not Modified\r\n", 27) == 0);
+    assert(strstr(html->not_modified, html->etag) && !strstr(html->not_modified, "Content-"));
+    assert(strstr(html->gzip_not_modified, html->gzip_etag) && strstr(html->head, "Accept-Ranges: bytes\r\n"));
+    assert(strcmp(html->cache_control, "public, max-age=3600") == 0);
+
+    size_t got = serve(html, "GET /static/index.html HTTP/1.1\r\n\r\n", buffer, sizeof(buffer));
+    assert(got == html->head_len + html->body_len && memcmp(buffer, html->head, html->head_len) == 0);
+    got = serve(html, "GET /static/index.html HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n", buffer, sizeof(buffer));
+    assert(got == html->gzip_head_len + html->gzip_len);
+    got = serve(html, "HEAD /static/index.html HTTP/1.1\r\n\r\n", buffer, sizeof(buffer));
+    assert(got == html->head_len);
+
+    // Each variant revalidates against its own ETag.
+    snprintf(headers, sizeof(headers), "GET /static/index.html HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", html->etag);
+    got = serve(html, headers, buffer, sizeof(buffer));
+    assert(got == html->not_modified_len && memcmp(buffer, html->not_modified, got) == 0);
+    snprintf(headers, sizeof(headers),
+             "GET /static/index.html HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: \"x\", %s\r\n\r\n", html->gzip_etag);
+    got = serve(html, headers, buffer, sizeof(buffer));
+    assert(got == html->gzip_not_modified_len && memcmp(buffer, html->gzip_not_modified, got) == 0);
+    snprintf(headers, sizeof(headers), "GET /static/index.html HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: %s\r\n\r\n",
+             html->etag);
+    got = serve(html, headers, buffer, sizeof(buffer));
+    assert(got == html->gzip_head_len + html->gzip_len);
+    got = serve(html, "PUT /static/index.html HTTP/1.1\r\nIf-Match: \"x\"\r\n\r\n", buffer, sizeof(buffer));
+    assert(strncmp(buffer, "HTTP/1.1 412 ", 13) == 0);
+
+    // Ranges slice the identity body even when gzip is acceptable.
+    got = serve(html, "GET /static/index.html HTTP/1.1\r\nAccept-Encoding: gzip\r\nRange: bytes=10-19\r\n\r\n",
+                buffer, sizeof(buffer));
+    assert(strncmp(buffer, "HTTP/1.1 206 Partial Content\r\n", 30) == 0);
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Content-Range: bytes 10-19/%zu\r\n", html->body_len);
+    assert(strstr(buffer, expect) && strstr(buffer, "Content-Length: 10\r\n") && strstr(buffer, html->etag));
+    const char *body = strstr(buffer, "\r\n\r\n") + 4;
+    assert(buffer + got - body == 10 && memcmp(body, html->body + 10, 10) == 0);
+
+    snprintf(headers, sizeof(headers), "GET /static/index.html HTTP/1.1\r\nRange: bytes=%zu-\r\n\r\n", html->body_len);
+    serve(html, headers, buffer, sizeof(buffer));
+    assert(strncmp(buffer, "HTTP/1.1 416 Range Not Satisfiable\r\n", 36) == 0);
+    got = serve(html, "GET /static/index.html HTTP/1.1\r\nRange: bytes=0-0\r\nIf-Range: \"old\"\r\n\r\n", buffer, sizeof(buffer));
+    assert(got == html->head_len + html->body_len);
+    printf("Passed conditional asset serving.\n");
+}
+
+static bool accepts(const char *value) {
+    cwist_http_request *req = cwist_http_request_create();
+    if (value) cwist_http_header_add(&req->headers, "Accept-Encoding", value);
+    bool ok = cwist_http_accepts_gzip(req);
+    cwist_http_request_destroy(req);
+    return ok;
+}
+
+void test_accepts_gzip() {
+    printf("Testing Accept-Encoding negotiation...\n");
+    assert(!accepts(NULL));
+    assert(accepts("gzip"));
+    assert(accepts("deflate, GZIP;q=0.5, br"));
+    assert(accepts("*"));
+    assert(!accepts("identity"));
+    assert(!accepts("gzip;q=0"));
+    assert(!accepts("gzip; q=0.000, *"));
+    assert(accepts("gzip;q=0.001"));
+    assert(!accepts("*;q=0"));
+    assert(!accepts("br, gzip;q=0, *;q=1"));
+    printf("Passed Accept-Encoding negotiation.\n");
+}
+
+int main() {
+    test_asset_table();
+    test_asset_send();
+    test_asset_serve();
+    test_accepts_gzip();
+    printf("All asset tests passed!\n");
+    return 0;
+}
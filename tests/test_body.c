@@ -0,0 +1,270 @@
+#include <cwist/body.h>
+#include <cwist/http.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// Writes data into one end of a socketpair from its own thread, so bodies
+// larger than the socket buffer can be sent.
+struct peer {
+    int fd;
+    const char *data;
+    size_t len;
+    bool close_after;
+    pthread_t thread;
+};
+
+static void *peer_run(void *arg) {
+    struct peer *peer = arg;
+    size_t off = 0;
+    while (off < peer->len) {
+        ssize_t n = send(peer->fd, peer->data + off, peer->len - off, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    if (peer->close_after) shutdown(peer->fd, SHUT_WR);
+    return NULL;
+}
+
+static int peer_start(struct peer *peer, const char *data, size_t len, bool close_after) {
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    peer->fd = sv[1];
+    peer->data = data;
+    peer->len = len;
+    peer->close_after = close_after;
+    assert(pthread_create(&peer->thread, NULL, peer_run, peer) == 0);
+    return sv[0];
+}
+
+static void peer_finish(struct peer *peer, int fd) {
+    pthread_join(peer->thread, NULL);
+    close(peer->fd);
+    close(fd);
+}
+
+static cwist_http_request *request(const char *headers) {
+    cwist_http_request *req = cwist_http_parse_request(headers);
+    assert(req != NULL);
+    return req;
+}
+
+static char *pattern(size_t len) {
+    char *data = malloc(len);
+    for (size_t i = 0; i < len; i++) data[i] = (char)('a' + (i * 7) % 26);
+    return data;
+}
+
+void test_content_length_read() {
+    printf("Testing Content-Length body reads...\n");
+    size_t len = 1 << 20;
+    char *body = pattern(len);
+    cwist_http_request *req = request("POST /upload HTTP/1.1\r\nContent-Length: 1048576\r\n\r\n");
+
+    // The first 100 bytes arrived with the headers; the rest plus a pipelined
+    // request is still on the socket.
+    char *wire = malloc(len - 100 + 9);
+    memcpy(wire, body + 100, len - 100);
+    memcpy(wire + len - 100, "GET /next", 9);
+    struct peer peer;
+    int fd = peer_start(&peer, wire, len - 100 + 9, false);
+
+    cwist_body_reader reader;
+    assert(cwist_error_code(cwist_body_reader_init(&reader, fd, req, body, 100, 2 << 20)) == 0);
+    char *got = malloc(len);
+    size_t total = 0, n;
+    while (cwist_error_code(cwist_body_read(&reader, got + total, 1000, &n)) == 0 && n > 0) total += n;
+    assert(total == len && memcmp(got, body, len) == 0);
+    assert(reader.done && reader.received == len);
+
+    // The next request was left on the socket.
+    char next[16];
+    assert(recv(fd, next, sizeof(next), 0) == 9 && memcmp(next, "GET /next", 9) == 0);
+
+    peer_finish(&peer, fd);
+    cwist_http_request_destroy(req);
+    free(got);
+    free(wire);
+    free(body);
+    printf("Passed Content-Length body reads.\n");
+}
+
+void test_limits() {
+    printf("Testing body limits...\n");
+    cwist_body_reader reader;
+    size_t n;
+    char buf[64];
+
+    // Refused from the header alone; nothing is read.
+    cwist_http_request *req = request("POST / HTTP/1.1\r\nContent-Length: 2000\r\n\r\n");
+    struct peer peer;
+    int fd = peer_start(&peer, "xyz", 3, false);
+    assert(cwist_error_code(cwist_body_reader_init(&reader, fd, req, NULL, 0, 1000)) == EFBIG);
+    assert(cwist_error_code(cwist_body_read(&reader, buf, sizeof(buf), &n)) == EFBIG && n == 0);
+    pthread_join(peer.thread, NULL);
+    assert(recv(fd, buf, sizeof(buf), 0) == 3);
+    close(peer.fd);
+    close(fd);
+    cwist_http_request_destroy(req);
+
+    // A chunk that would cross the limit fails before its data is read.
+    req = request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    const char *chunks = "a\r\n0123456789\r\n64\r\n";
+    assert(cwist_error_code(cwist_body_reader_init(&reader, -1, req, chunks, strlen(chunks), 50)) == 0);
+    assert(cwist_error_code(cwist_body_read(&reader, buf, sizeof(buf), &n)) == 0 && n == 10);
+    assert(cwist_error_code(cwist_body_read(&reader, buf, sizeof(buf), &n)) == EFBIG);
+    cwist_http_request_destroy(req);
+
+    req = request("POST / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n");
+    assert(cwist_error_code(cwist_body_reader_init(&reader, -1, req, NULL, 0, 0)) == EINVAL);
+    cwist_http_request_destroy(req);
+    req = request("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n");
+    assert(cwist_error_code(cwist_body_reader_init(&reader, -1, req, NULL, 0, 0)) == ENOSYS);
+    cwist_http_request_destroy(req);
+
+    // No framing: an empty body.
+    req = request("GET / HTTP/1.1\r\n\r\n");
+    assert(cwist_error_code(cwist_body_reader_init(&reader, -1, req, NULL, 0, 0)) == 0);
+    assert(cwist_error_code(cwist_body_read(&reader, buf, sizeof(buf), &n)) == 0 && n == 0);
+    cwist_http_request_destroy(req);
+    printf("Passed body limits.\n");
+}
+
+static int collect(void *ctx, const char *data, size_t len) {
+    cwist_sstring_append_view((cwist_sstring *)ctx, cwist_sview_make(data, len));
+    return 0;
+}
+
+static int stop(void *ctx, const char *data, size_t len) {
+    (void)ctx; (void)data; (void)len;
+    return 1;
+}
+
+void test_chunked_stream() {
+    printf("Testing chunked body streaming...\n");
+    cwist_http_request *req = request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    const char *extra = "5\r\nHel";
+    const char *wire = "lo\r\n7;x=y\r\n, World\r\n0\r\nX-Check: 1\r\n\r\nGET /next";
+
+    struct peer peer;
+    int fd = peer_start(&peer, wire, strlen(wire), false);
+    cwist_body_reader reader;
+    assert(cwist_error_code(cwist_body_reader_init(&reader, fd, req, extra, strlen(extra), 1000)) == 0);
+    cwist_sstring *out = cwist_sstring_create();
+    assert(cwist_error_code(cwist_body_reader_stream(&reader, collect, out)) == 0);
+    assert(strcmp(out->data, "Hello, World") == 0 && reader.received == 12);
+
+    // Whatever the last read pulled in past the body is handed back.
+    size_t left;
+    const char *rest = cwist_body_reader_leftover(&reader, &left);
+    assert(left == 9 && memcmp(rest, "GET /next", 9) == 0);
+    peer_finish(&peer, fd);
+
+    // Malformed framing, early close and an aborting handler.
+    cwist_body_reader_init(&reader, -1, req, "zz\r\n", 4, 0);
+    assert(cwist_error_code(cwist_body_reader_stream(&reader, collect, out)) == EBADMSG);
+
+    fd = peer_start(&peer, "5\r\nab", 5, true);
+    cwist_body_reader_init(&reader, fd, req, NULL, 0, 0);
+    assert(cwist_error_code(cwist_body_reader_stream(&reader, collect, out)) == ECONNRESET);
+    peer_finish(&peer, fd);
+
+    cwist_body_reader_init(&reader, -1, req, "3\r\nabc\r\n0\r\n\r\n", 13, 0);
+    assert(cwist_error_code(cwist_body_reader_stream(&reader, stop, NULL)) == ECANCELED);
+
+    cwist_sstring_destroy(out);
+    cwist_http_request_destroy(req);
+    printf("Passed chunked body streaming.\n");
+}
+
+static char *read_back(int fd, size_t *len) {
+    *len = (size_t)lseek(fd, 0, SEEK_END);
+    char *data = malloc(*len + 1);
+    assert(pread(fd, data, *len, 0) == (ssize_t)*len);
+    return data;
+}
+
+static int temp_file(int extra_flags) {
+    char path[] = "/tmp/cwist_body_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    if (extra_flags) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | extra_flags);
+    return fd;
+}
+
+void test_splice() {
+    printf("Testing body splice to a file...\n");
+    size_t len = 3 << 20;
+    char *body = pattern(len);
+    cwist_http_request *req = request("POST / HTTP/1.1\r\nContent-Length: 3145728\r\n\r\n");
+
+    // Plain file: splice path. O_APPEND file: copy path.
+    int flags[] = { 0, O_APPEND };
+    for (int i = 0; i < 2; i++) {
+        struct peer peer;
+        int fd = peer_start(&peer, body + 10, len - 10, false);
+        int file = temp_file(flags[i]);
+        cwist_body_reader reader;
+        uint64_t written = 0;
+        assert(cwist_error_code(cwist_body_reader_init(&reader, fd, req, body, 10, 0)) == 0);
+        assert(cwist_error_code(cwist_body_reader_splice(&reader, file, &written)) == 0);
+        assert(written == len && reader.done && reader.received == len);
+        size_t got_len;
+        char *got = read_back(file, &got_len);
+        assert(got_len == len && memcmp(got, body, len) == 0);
+        free(got);
+        close(file);
+        peer_finish(&peer, fd);
+    }
+    cwist_http_request_destroy(req);
+
+    // Chunked bodies are decoded on the way.
+    req = request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    const char *wire = "4\r\nabcd\r\n2\r\nef\r\n0\r\n\r\n";
+    struct peer peer;
+    int fd = peer_start(&peer, wire, strlen(wire), false);
+    int file = temp_file(0);
+    cwist_body_reader reader;
+    uint64_t written = 0;
+    cwist_body_reader_init(&reader, fd, req, NULL, 0, 0);
+    assert(cwist_error_code(cwist_body_reader_splice(&reader, file, &written)) == 0 && written == 6);
+    size_t got_len;
+    char *got = read_back(file, &got_len);
+    assert(got_len == 6 && memcmp(got, "abcdef", 6) == 0);
+    free(got);
+    close(file);
+    peer_finish(&peer, fd);
+    cwist_http_request_destroy(req);
+
+    // /proc/self/comm takes write(2) but not splice: the bytes already in
+    // the pipe are copied out and the body still arrives whole.
+    int comm = open("/proc/self/comm", O_WRONLY);
+    if (comm >= 0) {
+        req = request("POST / HTTP/1.1\r\nContent-Length: 7\r\n\r\n");
+        fd = peer_start(&peer, "body-cp", 7, false);
+        cwist_body_reader_init(&reader, fd, req, NULL, 0, 0);
+        assert(cwist_error_code(cwist_body_reader_splice(&reader, comm, &written)) == 0);
+        assert(written == 7 && reader.done);
+        close(comm);
+        peer_finish(&peer, fd);
+        cwist_http_request_destroy(req);
+    }
+    free(body);
+    printf("Passed body splice to a file.\n");
+}
+
+int main() {
+    test_content_length_read();
+    test_limits();
+    test_chunked_stream();
+    test_splice();
+    printf("All body tests passed!\n");
+    return 0;
+}
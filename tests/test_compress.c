@@ -0,0 +1,356 @@
+#include <cwist/compress.h>
+#include <cwist/http.h>
+#include <cwist/sstring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+
+// Inflates gzip or zlib data (auto-detected) into a fresh string.
+static cwist_sstring *inflate_all(const char *data, size_t len) {
+    cwist_sstring *out = cwist_sstring_create();
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    assert(inflateInit2(&z, 15 + 32) == Z_OK);
+    z.next_in = (Bytef *)data;
+    z.avail_in = (uInt)len;
+    int rc;
+    do {
+        cwist_sstring_reserve(out, out->size + 4096 + 1);
+        z.next_out = (Bytef *)out->data + out->size;
+        z.avail_out = 4096;
+        rc = inflate(&z, Z_NO_FLUSH);
+        assert(rc == Z_OK || rc == Z_STREAM_END || rc == Z_BUF_ERROR);
+        out->size += 4096 - z.avail_out;
+        out->data[out->size] = '\0';
+    } while (rc != Z_STREAM_END && (z.avail_in > 0 || z.avail_out == 0));
+    inflateEnd(&z);
+    return out;
+}
+
+static cwist_sstring *make_text(size_t len) {
+    cwist_sstring *text = cwist_sstring_create();
+    for (size_t i = 0; text->size < len; i++) {
+        cwist_sstring_appendf(text, "{\"id\":%zu,\"name\":\"item %zu\",\"ok\":true},", i, i % 7);
+    }
+    return text;
+}
+
+static cwist_http_request *request_with(const char *accept) {
+    cwist_http_request *req = cwist_http_request_create();
+    if (accept) cwist_http_header_add(&req->headers, "Accept-Encoding", accept);
+    return req;
+}
+
+void test_negotiation() {
+    printf("Testing encoding negotiation...\n");
+    struct { const char *accept; cwist_encoding_t expect; } cases[] = {
+        { NULL,                           CWIST_ENCODING_IDENTITY },
+        { "",                             CWIST_ENCODING_IDENTITY },
+        { "gzip, deflate, br",            CWIST_ENCODING_GZIP },
+        { "deflate",                      CWIST_ENCODING_DEFLATE },
+        { "deflate;q=1, gzip;q=0.8",      CWIST_ENCODING_DEFLATE },
+        { "gzip;q=0.5, deflate;q=0.5",    CWIST_ENCODING_GZIP },
+        { "x-gzip",                       CWIST_ENCODING_GZIP },
+        { "*",                            CWIST_ENCODING_GZIP },
+        { "gzip;q=0, *",                  CWIST_ENCODING_DEFLATE },
+        { "gzip;q=0, deflate;q=0.000",    CWIST_ENCODING_IDENTITY },
+        { "identity, *;q=0",              CWIST_ENCODING_IDENTITY },
+        { "br",                           CWIST_ENCODING_IDENTITY },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        cwist_http_request *req = request_with(cases[i].accept);
+        assert(cwist_http_negotiate_encoding(req) == cases[i].expect);
+        cwist_http_request_destroy(req);
+    }
+
+    cwist_http_request *req = request_with("gzip;q=0.25, *;q=0.5");
+    assert(cwist_http_encoding_q(req, "gzip") == 250);
+    assert(cwist_http_encoding_q(req, "deflate") == 500);
+    cwist_http_request_destroy(req);
+
+    assert(cwist_compress_type_ok(CWIST_SVIEW_LIT("text/html; charset=utf-8")));
+    assert(cwist_compress_type_ok(CWIST_SVIEW_LIT("Application/JSON")));
+    assert(cwist_compress_type_ok(CWIST_SVIEW_LIT("application/problem+json")));
+    assert(cwist_compress_type_ok(CWIST_SVIEW_LIT("image/svg+xml")));
+    assert(!cwist_compress_type_ok(CWIST_SVIEW_LIT("image/png")));
+    assert(!cwist_compress_type_ok(CWIST_SVIEW_LIT("application/octet-stream")));
+    assert(!cwist_compress_type_ok(cwist_sview_make(NULL, 0)));
+    printf("Passed encoding negotiation.\n");
+}
+
+void test_compress_roundtrip() {
+    printf("Testing one-shot compression...\n");
+    cwist_sstring *text = make_text(100000);
+    cwist_encoding_t encodings[] = { CWIST_ENCODING_GZIP, CWIST_ENCODING_DEFLATE };
+    for (size_t e = 0; e < 2; e++) {
+        for (int level = 1; level <= 9; level += 4) {
+            cwist_sstring *packed = cwist_sstring_create();
+            cwist_sstring_append(packed, "prefix");
+            assert(cwist_error_code(cwist_compress(encodings[e], level, cwist_sstring_view(text), packed)) == 0);
+            assert(packed->size < text->size / 4);
+            assert(memcmp(packed->data, "prefix", 6) == 0);   // appends
+            if (encodings[e] == CWIST_ENCODING_GZIP) {
+                assert((unsigned char)packed->data[6] == 0x1f && (unsigned char)packed->data[7] == 0x8b);
+            }
+            cwist_sstring *plain = inflate_all(packed->data + 6, packed->size - 6);
+            assert(plain->size == text->size && memcmp(plain->data, text->data, text->size) == 0);
+            cwist_sstring_destroy(plain);
+            cwist_sstring_destroy(packed);
+        }
+    }
+
+    cwist_sstring *packed = cwist_sstring_create();
+    assert(cwist_error_code(cwist_compress(CWIST_ENCODING_IDENTITY, 0, cwist_sstring_view(text), packed)) == EINVAL);
+    assert(cwist_error_code(cwist_compress(CWIST_ENCODING_GZIP, 0, CWIST_SVIEW_LIT(""), packed)) == 0);
+    cwist_sstring *plain = inflate_all(packed->data, packed->size);
+    assert(plain->size == 0);
+    cwist_sstring_destroy(plain);
+    cwist_sstring_destroy(packed);
+    cwist_sstring_destroy(text);
+    printf("Passed one-shot compression.\n");
+}
+
+static cwist_http_response *response_with(const char *type, const cwist_sstring *body) {
+    cwist_http_response *res = cwist_http_response_create();
+    if (type) cwist_http_header_add(&res->headers, "Content-Type", type);
+    cwist_sstring_copy_sstring(res->body, body);
+    return res;
+}
+
+void test_response_compress() {
+    printf("Testing response compression...\n");
+    cwist_sstring *text = make_text(8000);
+    cwist_http_request *req = request_with("gzip, deflate");
+
+    cwist_http_response *res = response_with("application/json", text);
+    assert(cwist_error_code(cwist_http_response_compress(res, req, NULL)) == 0);
+    assert(strcmp(cwist_http_header_get(res->headers, "Content-Encoding"), "gzip") == 0);
+    assert(strcmp(cwist_http_header_get(res->headers, "Vary"), "Accept-Encoding") == 0);
+    assert(res->body->size < text->size);
+    cwist_sstring *plain = inflate_all(res->body->data, res->body->size);
+    assert(strcmp(plain->data, text->data) == 0);
+    cwist_sstring_destroy(plain);
+    cwist_http_response_destroy(res);
+
+    // The identity body's strong ETag becomes weak; a weak one is kept.
+    const char *etags[][2] = { { "\"abc\"", "W/\"abc\"" }, { "W/\"abc\"", "W/\"abc\"" } };
+    for (size_t i = 0; i < 2; i++) {
+        res = response_with("application/json", text);
+        cwist_http_header_add(&res->headers, "ETag", etags[i][0]);
+        cwist_http_response_compress(res, req, NULL);
+        assert(strcmp(cwist_http_header_get(res->headers, "ETag"), etags[i][1]) == 0);
+        cwist_http_response_destroy(res);
+    }
+
+    // Left alone: small, wrong type, already encoded, fixed length, no-transform, 204, 206.
+    cwist_sstring *small = cwist_sstring_create();
+    cwist_sstring_append(small, "{\"ok\":true}");
+    res = response_with("application/json", small);
+    cwist_http_response_compress(res, req, NULL);
+    assert(!cwist_http_header_get(res->headers, "Content-Encoding") && res->body->size == small->size);
+    cwist_http_response_destroy(res);
+
+    cwist_compress_config config = { .min_size = 4 };
+    res = response_with("application/json", small);
+    cwist_http_response_compress(res, req, &config);
+    assert(!cwist_http_header_get(res->headers, "Content-Encoding"));   // gzip would be larger
+    assert(cwist_http_header_get(res->headers, "Vary") && res->body->size == small->size);
+    cwist_http_response_destroy(res);
+    cwist_sstring_destroy(small);
+
+    const char *skip_headers[][2] = {
+        { "Content-Encoding", "br" },
+        { "Content-Length", "8000" },
+        { "Cache-Control", "public, no-transform" },
+    };
+    for (size_t i = 0; i < 3; i++) {
+        res = response_with("text/plain", text);
+        cwist_http_header_add(&res->headers, skip_headers[i][0], skip_headers[i][1]);
+        cwist_http_response_compress(res, req, NULL);
+        assert(res->body->size == text->size && !cwist_http_header_get(res->headers, "Vary"));
+        cwist_http_response_destroy(res);
+    }
+    res = response_with("image/png", text);
+    cwist_http_response_compress(res, req, NULL);
+    assert(res->body->size == text->size);
+    cwist_http_response_destroy(res);
+    cwist_http_status_t skip_status[] = { CWIST_HTTP_NO_CONTENT, CWIST_HTTP_PARTIAL_CONTENT };
+    for (size_t i = 0; i < 2; i++) {
+        res = response_with("text/plain", text);
+        res->status_code = skip_status[i];
+        cwist_http_response_compress(res, req, NULL);
+        assert(res->body->size == text->size);
+        cwist_http_response_destroy(res);
+    }
+
+    // The client does not accept any: only Vary is added.
+    cwist_http_request *plain_req = request_with("identity");
+    res = response_with("text/plain", text);
+    cwist_http_response_compress(res, plain_req, NULL);
+    assert(res->body->size == text->size && !cwist_http_header_get(res->headers, "Content-Encoding"));
+    assert(cwist_http_header_get(res->headers, "Vary"));
+    cwist_http_response_destroy(res);
+    cwist_http_request_destroy(plain_req);
+
+    cwist_http_request_destroy(req);
+    cwist_sstring_destroy(text);
+    printf("Passed response compression.\n");
+}
+
+void test_cache() {
+    printf("Testing compressed variant cache...\n");
+    struct cwist_compress_cache *cache = cwist_compress_cache_create(0);
+    cwist_sstring *text = make_text(20000);
+    cwist_http_request *req = request_with("gzip");
+    cwist_compress_config config = { .cache = cache };
+
+    cwist_sstring *first = NULL;
+    for (int i = 0; i < 5; i++) {
+        cwist_http_response *res = response_with("text/html", text);
+        assert(cwist_error_code(cwist_http_response_compress(res, req, &config)) == 0);
+        if (!first) {
+            first = cwist_sstring_create();
+            cwist_sstring_copy_sstring(first, res->body);
+        }
+        assert(res->body->size == first->size && memcmp(res->body->data, first->data, first->size) == 0);
+        cwist_http_response_destroy(res);
+    }
+    cwist_compress_cache_stats stats = cwist_compress_cache_stats_get(cache);
+    assert(stats.misses == 1 && stats.hits == 4 && stats.entries == 1);
+
+    // Encoding and level are part of the key.
+    cwist_sstring *out = cwist_sstring_create();
+    cwist_compress_cached(cache, CWIST_ENCODING_DEFLATE, 0, cwist_sstring_view(text), out);
+    cwist_compress_cached(cache, CWIST_ENCODING_GZIP, 9, cwist_sstring_view(text), out);
+    stats = cwist_compress_cache_stats_get(cache);
+    assert(stats.misses == 3 && stats.entries == 3);
+
+    // no-store responses bypass it.
+    cwist_http_response *res = response_with("text/html", text);
+    cwist_http_header_add(&res->headers, "Cache-Control", "no-store");
+    cwist_http_response_compress(res, req, &config);
+    assert(cwist_http_header_get(res->headers, "Content-Encoding"));
+    cwist_http_response_destroy(res);
+    stats = cwist_compress_cache_stats_get(cache);
+    assert(stats.misses == 3 && stats.hits == 4);
+    cwist_compress_cache_destroy(cache);
+
+    // A small cap keeps memory bounded; recently hit entries survive.
+    cache = cwist_compress_cache_create(4096);
+    cwist_sstring *bodies[16];
+    for (int i = 0; i < 16; i++) {
+        bodies[i] = cwist_sstring_create();
+        for (int j = 0; j < 400; j++) cwist_sstring_appendf(bodies[i], "%d-%d ", i, j * 7919 % 1000);
+        cwist_sstring_assign(out, "");
+        cwist_compress_cached(cache, CWIST_ENCODING_GZIP, 0, cwist_sstring_view(bodies[i]), out);
+        cwist_sstring_assign(out, "");
+        cwist_compress_cached(cache, CWIST_ENCODING_GZIP, 0, cwist_sstring_view(bodies[0]), out);   // keep 0 hot
+        stats = cwist_compress_cache_stats_get(cache);
+        assert(stats.memory_used <= 4096);
+    }
+    stats = cwist_compress_cache_stats_get(cache);
+    assert(stats.entries < 16);
+    uint64_t misses = stats.misses;
+    cwist_sstring_assign(out, "");
+    cwist_compress_cached(cache, CWIST_ENCODING_GZIP, 0, cwist_sstring_view(bodies[0]), out);
+    assert(cwist_compress_cache_stats_get(cache).misses == misses);
+    cwist_sstring *plain = inflate_all(out->data, out->size);
+    assert(strcmp(plain->data, bodies[0]->data) == 0);
+    cwist_sstring_destroy(plain);
+    for (int i = 0; i < 16; i++) cwist_sstring_destroy(bodies[i]);
+
+    cwist_compress_cache_destroy(cache);
+    cwist_sstring_destroy(out);
+    cwist_sstring_destroy(first);
+    cwist_http_request_destroy(req);
+    cwist_sstring_destroy(text);
+    printf("Passed compressed variant cache.\n");
+}
+
+struct cache_worker {
+    struct cwist_compress_cache *cache;
+    cwist_sstring **bodies;
+};
+
+static void *cache_worker_main(void *arg) {
+    struct cache_worker *worker = arg;
+    cwist_sstring *out = cwist_sstring_create();
+    for (int i = 0; i < 400; i++) {
+        const cwist_sstring *body = worker->bodies[i % 8];
+        cwist_sstring_assign(out, "");
+        assert(cwist_error_code(cwist_compress_cached(worker->cache, CWIST_ENCODING_GZIP, 1, cwist_sstring_view(body), out)) == 0);
+        cwist_sstring *plain = inflate_all(out->data, out->size);
+        assert(plain->size == body->size && memcmp(plain->data, body->data, body->size) == 0);
+        cwist_sstring_destroy(plain);
+    }
+    cwist_sstring_destroy(out);
+    return NULL;
+}
+
+void test_cache_threads() {
+    printf("Testing compressed variant cache across threads...\n");
+    struct cwist_compress_cache *cache = cwist_compress_cache_create(6000);
+    cwist_sstring *bodies[8];
+    for (int i = 0; i < 8; i++) bodies[i] = make_text(3000 + (size_t)i * 500);
+
+    pthread_t threads[4];
+    struct cache_worker worker = { cache, bodies };
+    for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, cache_worker_main, &worker);
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+    cwist_compress_cache_stats stats = cwist_compress_cache_stats_get(cache);
+    assert(stats.hits + stats.misses == 1600 && stats.memory_used <= 6000);
+    for (int i = 0; i < 8; i++) cwist_sstring_destroy(bodies[i]);
+    cwist_compress_cache_destroy(cache);
+    printf("Passed compressed variant cache across threads.\n");
+}
+
+void test_stream() {
+    printf("Testing streaming compression...\n");
+    cwist_sstring *text = make_text(50000);
+    cwist_encoding_t encodings[] = { CWIST_ENCODING_GZIP, CWIST_ENCODING_DEFLATE };
+    for (size_t e = 0; e < 2; e++) {
+        cwist_compress_stream *stream = cwist_compress_stream_create(encodings[e], 0);
+        assert(stream != NULL);
+        cwist_sstring *out = cwist_sstring_create();
+        size_t step = 1777;
+        for (size_t pos = 0; pos < text->size; pos += step) {
+            size_t len = pos + step > text->size ? text->size - pos : step;
+            size_t before = out->size;
+            bool flush = (pos / step) % 5 == 4;
+            assert(cwist_error_code(cwist_compress_stream_write(stream, cwist_sview_make(text->data + pos, len), flush, out)) == 0);
+            // A flush ends on a byte boundary with output for everything so far.
+            if (flush) {
+                assert(out->size > before);
+                cwist_sstring *partial = inflate_all(out->data, out->size);
+                assert(partial->size == pos + len && memcmp(partial->data, text->data, partial->size) == 0);
+                cwist_sstring_destroy(partial);
+            }
+        }
+        assert(cwist_error_code(cwist_compress_stream_finish(stream, out)) == 0);
+        assert(cwist_error_code(cwist_compress_stream_finish(stream, out)) == EINVAL);
+        cwist_sstring *plain = inflate_all(out->data, out->size);
+        assert(plain->size == text->size && memcmp(plain->data, text->data, text->size) == 0);
+        cwist_sstring_destroy(plain);
+        cwist_sstring_destroy(out);
+        cwist_compress_stream_destroy(stream);
+    }
+    assert(cwist_compress_stream_create(CWIST_ENCODING_IDENTITY, 0) == NULL);
+    cwist_sstring_destroy(text);
+    printf("Passed streaming compression.\n");
+}
+
+int main() {
+    test_negotiation();
+    test_compress_roundtrip();
+    test_response_compress();
+    test_cache();
+    test_cache_threads();
+    test_stream();
+    printf("All compression tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include <cwist/conditional.h>
+#include <cwist/http.h>
+#include <cwist/sstring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static cwist_http_request *request(const char *headers) {
+    cwist_http_request *req = cwist_http_parse_request(headers);
+    assert(req != NULL);
+    return req;
+}
+
+// Drains the other end of a socketpair from its own thread, so responses
+// larger than the socket buffer can be sent.
+struct sink {
+    int fd;
+    cwist_sstring *data;
+    pthread_t thread;
+};
+
+static void *sink_run(void *arg) {
+    struct sink *sink = arg;
+    char buf[65536];
+    ssize_t n;
+    while ((n = recv(sink->fd, buf, sizeof(buf), 0)) > 0) {
+        cwist_sstring_append_view(sink->data, cwist_sview_make(buf, (size_t)n));
+    }
+    return NULL;
+}
+
+static int sink_start(struct sink *sink) {
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    sink->fd = sv[1];
+    sink->data = cwist_sstring_create();
+    assert(pthread_create(&sink->thread, NULL, sink_run, sink) == 0);
+    return sv[0];
+}
+
+// Closes the sending end and waits for everything to arrive.
+static cwist_sstring *sink_finish(struct sink *sink, int fd) {
+    close(fd);
+    pthread_join(sink->thread, NULL);
+    close(sink->fd);
+    return sink->data;
+}
+
+void test_etags() {
+    printf("Testing entity-tags...\n");
+    char etag[CWIST_ETAG_SIZE];
+    assert(cwist_http_etag_make(etag, 0xabc, false) == 18 && strcmp(etag, "\"0000000000000abc\"") == 0);
+    assert(cwist_http_etag_make(etag, 0xabc, true) == 20 && strcmp(etag, "W/\"0000000000000abc\"") == 0);
+
+    cwist_sview strong = CWIST_SVIEW_LIT("\"v1\""), weak = CWIST_SVIEW_LIT("W/\"v1\"");
+    assert(cwist_http_etag_match(CWIST_SVIEW_LIT("\"v1\""), strong, false));
+    assert(cwist_http_etag_match(CWIST_SVIEW_LIT("\"v0\", \"v1\""), strong, false));
+    assert(cwist_http_etag_match(CWIST_SVIEW_LIT("\"a,b\",W/\"v1\""), strong, true));
+    assert(!cwist_http_etag_match(CWIST_SVIEW_LIT("W/\"v1\""), strong, false));
+    assert(!cwist_http_etag_match(CWIST_SVIEW_LIT("\"v1\""), weak, false));
+    assert(cwist_http_etag_match(CWIST_SVIEW_LIT("\"v1\""), weak, true));
+    assert(!cwist_http_etag_match(CWIST_SVIEW_LIT("\"v11\""), strong, true));
+    assert(!cwist_http_etag_match(CWIST_SVIEW_LIT("v1"), strong, true));
+    assert(cwist_http_etag_match(CWIST_SVIEW_LIT(" * "), cwist_sview_make(NULL, 0), false));
+    assert(!cwist_http_etag_match(CWIST_SVIEW_LIT("\"v1\""), cwist_sview_make(NULL, 0), true));
+    printf("Passed entity-tags.\n");
+}
+
+void test_dates() {
+    printf("Testing HTTP dates...\n");
+    char date[CWIST_HTTP_DATE_SIZE];
+    assert(cwist_http_date_format(784111777, date) == 29);
+    assert(strcmp(date, "Sun, 06 Nov 1994 08:49:37 GMT") == 0);
+    assert(cwist_http_date_format(0, date) == 29 && strcmp(date, "Thu, 01 Jan 1970 00:00:00 GMT") == 0);
+
+    time_t t;
+    assert(cwist_http_date_parse(CWIST_SVIEW_LIT("Sun, 06 Nov 1994 08:49:37 GMT"), &t) && t == 784111777);
+    assert(cwist_http_date_parse(CWIST_SVIEW_LIT("Sunday, 06-Nov-94 08:49:37 GMT"), &t) && t == 784111777);
+    assert(cwist_http_date_parse(CWIST_SVIEW_LIT("Sun Nov  6 08:49:37 1994"), &t) && t == 784111777);
+    assert(cwist_http_date_parse(CWIST_SVIEW_LIT("Tue, 29 Feb 2028 23:59:59 GMT"), &t) && t == 1835481599);
+
+    // Round trip across the leap days.
+    for (time_t when = 0; when < 4102444800; when += 86400 * 37 + 3601) {
+        assert(cwist_http_date_format(when, date) == 29);
+        assert(cwist_http_date_parse(cwist_sview_from_cstr(date), &t) && t == when);
+    }
+
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT("Sun, 06 Nov 1994 08:49:37 UTC"), &t));
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT("Sun, 6 Nov 1994 08:49:37 GMT"), &t));
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT("Sun, 06 Foo 1994 08:49:37 GMT"), &t));
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT("Sun, 06 Nov 1994 25:49:37 GMT"), &t));
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT("yesterday"), &t));
+    assert(!cwist_http_date_parse(CWIST_SVIEW_LIT(""), &t));
+    printf("Passed HTTP dates.\n");
+}
+
+static cwist_precondition_t evaluate(const char *headers, const char *etag, time_t last_modified) {
+    cwist_http_request *req = request(headers);
+    cwist_precondition_t result = cwist_http_evaluate_preconditions(
+        req, etag ? cwist_sview_from_cstr(etag) : cwist_sview_make(NULL, 0), last_modified);
+    cwist_http_request_destroy(req);
+    return result;
+}
+
+void test_preconditions() {
+    printf("Testing precondition evaluation...\n");
+    const char *etag = "\"v1\"";
+    time_t modified = 784111777;   // Sun, 06 Nov 1994 08:49:37 GMT
+
+    assert(evaluate("GET / HTTP/1.1\r\n\r\n", etag, modified) == CWIST_PRECONDITION_PASS);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-None-Match: \"v1\"\r\n\r\n", etag, modified) == CWIST_PRECONDITION_NOT_MODIFIED);
+    assert(evaluate("HEAD / HTTP/1.1\r\nIf-None-Match: W/\"v1\"\r\n\r\n", etag, modified) == CWIST_PRECONDITION_NOT_MODIFIED);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-None-Match: \"v0\"\r\n\r\n", etag, modified) == CWIST_PRECONDITION_PASS);
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-None-Match: *\r\n\r\n", etag, modified) == CWIST_PRECONDITION_FAILED);
+
+    // Dates: equal or later means unchanged.
+    assert(evaluate("GET / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_NOT_MODIFIED);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_PASS);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-Modified-Since: garbage\r\n\r\n", etag, modified) == CWIST_PRECONDITION_PASS);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", etag, 0) ==
+           CWIST_PRECONDITION_PASS);
+    assert(evaluate("POST / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_PASS);
+
+    // If-None-Match decides alone when present.
+    assert(evaluate("GET / HTTP/1.1\r\nIf-None-Match: \"v0\"\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n",
+                    etag, modified) == CWIST_PRECONDITION_PASS);
+
+    // If-Match uses strong comparison and comes first.
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-Match: \"v1\"\r\n\r\n", etag, modified) == CWIST_PRECONDITION_PASS);
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-Match: W/\"v1\"\r\n\r\n", etag, modified) == CWIST_PRECONDITION_FAILED);
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-Match: \"v1\"\r\n\r\n", NULL, modified) == CWIST_PRECONDITION_FAILED);
+    assert(evaluate("GET / HTTP/1.1\r\nIf-Match: \"v0\"\r\nIf-None-Match: \"v1\"\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_FAILED);
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-Unmodified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_FAILED);
+    assert(evaluate("PUT / HTTP/1.1\r\nIf-Unmodified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", etag, modified) ==
+           CWIST_PRECONDITION_PASS);
+    printf("Passed precondition evaluation.\n");
+}
+
+void test_not_modified_send() {
+    printf("Testing the 304 send path...\n");
+    cwist_http_request *req = request("GET /data HTTP/1.1\r\nIf-None-Match: \"0000000000000007\"\r\n\r\n");
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    cwist_http_header_add(&res->headers, "Cache-Control", "max-age=60");
+    assert(cwist_error_code(cwist_http_response_set_etag(res, 7, false)) == 0);
+
+    // Checked before the body exists, as a handler would.
+    assert(cwist_http_response_conditional(req, res));
+    assert(res->status_code == CWIST_HTTP_NOT_MODIFIED && strcmp(res->status_text->data, "Not Modified") == 0);
+
+    cwist_sstring_assign(res->body, "ignored");
+    struct sink sink;
+    int fd = sink_start(&sink);
+    assert(cwist_error_code(cwist_http_send_response(fd, res)) == 0);
+    cwist_sstring *wire = sink_finish(&sink, fd);
+    assert(strcmp(wire->data,
+                  "HTTP/1.1 304 Not Modified\r\n"
+                  "ETag: \"0000000000000007\"\r\n"
+                  "Cache-Control: max-age=60\r\n"
+                  "Connection: keep-alive\r\n\r\n") == 0);
+    cwist_sstring_destroy(wire);
+
+    // A long header list goes out in several writes, all of it intact.
+    for (int i = 0; i < 40; i++) cwist_http_header_add(&res->headers, "Vary", "Accept-Encoding");
+    cwist_http_header_add(&res->headers, "Connection", "close");
+    fd = sink_start(&sink);
+    assert(cwist_error_code(cwist_http_send_response(fd, res)) == 0);
+    wire = sink_finish(&sink, fd);
+    size_t varies = 0;
+    for (const char *p = wire->data; (p = strstr(p, "Vary: Accept-Encoding\r\n")); p++) varies++;
+    assert(varies == 40 && strstr(wire->data, "Connection: close\r\n") && !strstr(wire->data, "keep-alive"));
+    assert(!strstr(wire->data, "Content-") && strcmp(wire->data + wire->size - 4, "\r\n\r\n") == 0);
+    cwist_sstring_destroy(wire);
+    cwist_http_response_destroy(res);
+
+    // A miss leaves the response alone; the body hash is the ETag.
+    res = cwist_http_response_create();
+    cwist_sstring_assign(res->body, "{\"n\":1}");
+    assert(cwist_error_code(cwist_http_response_etag_body(res)) == 0);
+    assert(!cwist_http_response_conditional(req, res) && res->status_code == CWIST_HTTP_OK);
+    cwist_sview etag = cwist_http_header_get_view(res->headers, CWIST_SVIEW_LIT("ETag"));
+    assert(etag.len == 18 && etag.ptr[0] == '"');
+    cwist_http_request_destroy(req);
+
+    // Resending that tag hits; a failed If-Match empties the body.
+    cwist_sstring *again = cwist_sstring_create();
+    cwist_sstring_append(again, "GET /data HTTP/1.1\r\nIf-None-Match: ");
+    cwist_sstring_append_view(again, etag);
+    cwist_sstring_append(again, "\r\n\r\n");
+    req = request(again->data);
+    assert(cwist_http_response_conditional(req, res) && res->status_code == CWIST_HTTP_NOT_MODIFIED);
+    cwist_http_request_destroy(req);
+    cwist_sstring_destroy(again);
+    cwist_http_response_destroy(res);
+
+    req = request("DELETE /data HTTP/1.1\r\nIf-Match: \"other\"\r\n\r\n");
+    res = cwist_http_response_create();
+    cwist_sstring_assign(res->body, "gone");
+    cwist_http_response_set_etag(res, 7, false);
+    assert(cwist_http_response_conditional(req, res) && res->status_code == CWIST_HTTP_PRECONDITION_FAILED);
+    assert(res->body->size == 0);
+
+    // Error responses are not subject to preconditions.
+    res->status_code = CWIST_HTTP_NOT_FOUND;
+    assert(!cwist_http_response_conditional(req, res));
+    cwist_http_request_destroy(req);
+    cwist_http_response_destroy(res);
+    printf("Passed the 304 send path.\n");
+}
+
+static cwist_range_status_t range(const char *value, uint64_t size, uint64_t *offset, uint64_t *length) {
+    return cwist_http_range_parse(cwist_sview_from_cstr(value), size, offset, length);
+}
+
+void test_ranges() {
+    printf("Testing byte ranges...\n");
+    uint64_t off, len;
+    assert(range("bytes=0-99", 1000, &off, &len) == CWIST_RANGE_OK && off == 0 && len == 100);
+    assert(range("bytes=500-", 1000, &off, &len) == CWIST_RANGE_OK && off == 500 && len == 500);
+    assert(range("bytes=-100", 1000, &off, &len) == CWIST_RANGE_OK && off == 900 && len == 100);
+    assert(range("bytes=-5000", 1000, &off, &len) == CWIST_RANGE_OK && off == 0 && len == 1000);
+    assert(range("bytes=990-5000", 1000, &off, &len) == CWIST_RANGE_OK && off == 990 && len == 10);
+    assert(range("Bytes = 7-7", 1000, &off, &len) == CWIST_RANGE_NONE);
+    assert(range("BYTES=7-7", 1000, &off, &len) == CWIST_RANGE_OK && off == 7 && len == 1);
+
+    assert(range("bytes=1000-", 1000, &off, &len) == CWIST_RANGE_UNSATISFIABLE);
+    assert(range("bytes=-0", 1000, &off, &len) == CWIST_RANGE_UNSATISFIABLE);
+    assert(range("bytes=0-", 0, &off, &len) == CWIST_RANGE_UNSATISFIABLE);
+
+    assert(range("bytes=5-1", 1000, &off, &len) == CWIST_RANGE_NONE);
+    assert(range("bytes=0-1,5-6", 1000, &off, &len) == CWIST_RANGE_NONE);
+    assert(range("items=0-1", 1000, &off, &len) == CWIST_RANGE_NONE);
+    assert(range("bytes=x-1", 1000, &off, &len) == CWIST_RANGE_NONE);
+    assert(range("bytes=", 1000, &off, &len) == CWIST_RANGE_NONE);
+
+    // Applied to a response body.
+    cwist_http_request *req = request("GET /f HTTP/1.1\r\nRange: bytes=2-5\r\n\r\n");
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_sstring_assign(res->body, "0123456789");
+    assert(cwist_error_code(cwist_http_response_range(req, res)) == 0);
+    assert(res->status_code == CWIST_HTTP_PARTIAL_CONTENT && strcmp(res->body->data, "2345") == 0);
+    assert(strcmp(cwist_http_header_get(res->headers, "Content-Range"), "bytes 2-5/10") == 0);
+    assert(strcmp(cwist_http_header_get(res->headers, "Accept-Ranges"), "bytes") == 0);
+    cwist_http_request_destroy(req);
+    cwist_http_response_destroy(res);
+
+    req = request("GET /f HTTP/1.1\r\nRange: bytes=10-\r\n\r\n");
+    res = cwist_http_response_create();
+    cwist_sstring_assign(res->body, "0123456789");
+    assert(cwist_error_code(cwist_http_response_range(req, res)) == 0);
+    assert(res->status_code == CWIST_HTTP_RANGE_NOT_SATISFIABLE && res->body->size == 0);
+    assert(strcmp(cwist_http_header_get(res->headers, "Content-Range"), "bytes */10") == 0);
+    cwist_http_request_destroy(req);
+    cwist_http_response_destroy(res);
+
+    // If-Range: only a strong match or the exact date keeps the range.
+    req = request("GET /f HTTP/1.1\r\nRange: bytes=0-0\r\nIf-Range: \"v1\"\r\n\r\n");
+    assert(cwist_http_request_range(req, 10, CWIST_SVIEW_LIT("\"v1\""), 0, &off, &len) == CWIST_RANGE_OK);
+    assert(cwist_http_request_range(req, 10, CWIST_SVIEW_LIT("\"v2\""), 0, &off, &len) == CWIST_RANGE_NONE);
+    assert(cwist_http_request_range(req, 10, CWIST_SVIEW_LIT("W/\"v1\""), 0, &off, &len) == CWIST_RANGE_NONE);
+    cwist_http_request_destroy(req);
+    req = request("GET /f HTTP/1.1\r\nRange: bytes=0-0\r\nIf-Range: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n");
+    assert(cwist_http_request_range(req, 10, cwist_sview_make(NULL, 0), 784111777, &off, &len) == CWIST_RANGE_OK);
+    assert(cwist_http_request_range(req, 10, cwist_sview_make(NULL, 0), 784111778, &off, &len) == CWIST_RANGE_NONE);
+    cwist_http_request_destroy(req);
+
+    // Range means nothing outside GET.
+    req = request("HEAD /f HTTP/1.1\r\nRange: bytes=0-0\r\n\r\n");
+    assert(cwist_http_request_range(req, 10, cwist_sview_make(NULL, 0), 0, &off, &len) == CWIST_RANGE_NONE);
+    cwist_http_request_destroy(req);
+    printf("Passed byte ranges.\n");
+}
+
+static cwist_sstring *send_file(const char *headers, int file) {
+    cwist_http_request *req = request(headers);
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Content-Type", "application/octet-stream");
+    struct sink sink;
+    int fd = sink_start(&sink);
+    assert(cwist_error_code(cwist_http_send_file(fd, req, res, file)) == 0);
+    cwist_http_request_destroy(req);
+    cwist_http_response_destroy(res);
+    return sink_finish(&sink, fd);
+}
+
+static const char *body_of(cwist_sstring *wire) {
+    const char *end = strstr(wire->data, "\r\n\r\n");
+    assert(end != NULL);
+    return end + 4;
+}
+
+static cwist_sview header_of(cwist_sstring *wire, const char *name) {
+    char key[64];
+    snprintf(key, sizeof(key), "\r\n%s: ", name);
+    const char *at = strstr(wire->data, key);
+    if (!at || at > body_of(wire)) return cwist_sview_make(NULL, 0);
+    at += strlen(key);
+    return cwist_sview_make(at, (size_t)(strstr(at, "\r\n") - at));
+}
+
+void test_send_file() {
+    printf("Testing file sends...\n");
+    size_t len = 3 << 20;
+    char *data = malloc(len);
+    for (size_t i = 0; i < len; i++) data[i] = (char)('a' + (i * 13) % 26);
+    char path[] = "/tmp/cwist_conditional_XXXXXX";
+    int file = mkstemp(path);
+    assert(file >= 0);
+    unlink(path);
+    assert(write(file, data, len) == (ssize_t)len);
+
+    cwist_sstring *wire = send_file("GET /big HTTP/1.1\r\n\r\n", file);
+    assert(strncmp(wire->data, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(cwist_sview_equals(header_of(wire, "Content-Length"), CWIST_SVIEW_LIT("3145728")));
+    assert(cwist_sview_equals(header_of(wire, "Accept-Ranges"), CWIST_SVIEW_LIT("bytes")));
+    const char *body = body_of(wire);
+    assert((size_t)(wire->data + wire->size - body) == len && memcmp(body, data, len) == 0);
+
+    // Revalidation with the validators the first response carried.
+    cwist_sview etag = header_of(wire, "ETag"), modified = header_of(wire, "Last-Modified");
+    time_t t;
+    assert(etag.len == 18 && cwist_http_date_parse(modified, &t));
+    char headers[256];
+    snprintf(headers, sizeof(headers), "GET /big HTTP/1.1\r\nIf-None-Match: %.*s\r\n\r\n", (int)etag.len, etag.ptr);
+    cwist_sstring *hit = send_file(headers, file);
+    assert(strncmp(hit->data, "HTTP/1.1 304 Not Modified\r\n", 27) == 0 && *body_of(hit) == '\0');
+    cwist_sstring_destroy(hit);
+    snprintf(headers, sizeof(headers), "GET /big HTTP/1.1\r\nIf-Modified-Since: %.*s\r\n\r\n", (int)modified.len, modified.ptr);
+    hit = send_file(headers, file);
+    assert(strncmp(hit->data, "HTTP/1.1 304 Not Modified\r\n", 27) == 0);
+    cwist_sstring_destroy(hit);
+
+    // A range from the middle, then one resumed with a stale If-Range.
+    snprintf(headers, sizeof(headers), "GET /big HTTP/1.1\r\nRange: bytes=1000000-1999999\r\nIf-Range: %.*s\r\n\r\n",
+             (int)etag.len, etag.ptr);
+    cwist_sstring *part = send_file(headers, file);
+    assert(strncmp(part->data, "HTTP/1.1 206 Partial Content\r\n", 30) == 0);
+    assert(cwist_sview_equals(header_of(part, "Content-Range"), CWIST_SVIEW_LIT("bytes 1000000-1999999/3145728")));
+    assert(cwist_sview_equals(header_of(part, "Content-Length"), CWIST_SVIEW_LIT("1000000")));
+    body = body_of(part);
+    assert((size_t)(part->data + part->size - body) == 1000000 && memcmp(body, data + 1000000, 1000000) == 0);
+    cwist_sstring_destroy(part);
+
+    part = send_file("GET /big HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: \"stale\"\r\n\r\n", file);
+    assert(strncmp(part->data, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    cwist_sstring_destroy(part);
+
+    part = send_file("GET /big HTTP/1.1\r\nRange: bytes=4000000-\r\n\r\n", file);
+    assert(strncmp(part->data, "HTTP/1.1 416 Range Not Satisfiable\r\n", 36) == 0);
+    assert(cwist_sview_equals(header_of(part, "Content-Range"), CWIST_SVIEW_LIT("bytes */3145728")));
+    assert(*body_of(part) == '\0');
+    cwist_sstring_destroy(part);
+
+    part = send_file("HEAD /big HTTP/1.1\r\n\r\n", file);
+    assert(cwist_sview_equals(header_of(part, "Content-Length"), CWIST_SVIEW_LIT("3145728")) && *body_of(part) == '\0');
+    cwist_sstring_destroy(part);
+
+    // Directories and the like are refused.
+    cwist_http_request *req = request("GET / HTTP/1.1\r\n\r\n");
+    cwist_http_response *res = cwist_http_response_create();
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(cwist_error_code(cwist_http_send_file(sv[0], req, res, sv[1])) == EINVAL);
+    close(sv[0]);
+    close(sv[1]);
+    cwist_http_request_destroy(req);
+    cwist_http_response_destroy(res);
+
+    cwist_sstring_destroy(wire);
+    close(file);
+    free(data);
+    printf("Passed file sends.\n");
+}
+
+int main() {
+    test_etags();
+    test_dates();
+    test_preconditions();
+    test_not_modified_send();
+    test_ranges();
+    test_send_file();
+    printf("All conditional tests passed!\n");
+    return 0;
+}
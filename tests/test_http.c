@@ -1,9 +1,11 @@
 #include <cwist/http.h>
+#include <cwist/session_manager.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <zlib.h>
 
 void test_methods() {
     printf("Testing HTTP methods...\n");
@@ -26,6 +28,7 @@ void test_request_lifecycle() {
     assert(strcmp(cwist_http_header_get(req->headers, "Host"), "example.com") == 0);
     assert(strcmp(cwist_http_header_get(req->headers, "Content-Type"), "application/json") == 0);
     assert(cwist_http_header_get(req->headers, "Invalid") == NULL);
+    assert(strcmp(cwist_http_header_get(req->headers, "content-type"), "application/json") == 0);
 
     cwist_sstring_assign(req->body, "{\"key\": \"value\"}");
     assert(strcmp(req->body->data, "{\"key\": \"value\"}") == 0);
@@ -67,6 +70,75 @@ void test_parse_request() {
     printf("Passed Request Parsing.\n");
 }
 
+void test_request_views() {
+    printf("Testing request views...\n");
+    const char *raw = "GET /items HTTP/1.1\r\nHost: localhost\r\nContent-Length: 42\r\n\r\n";
+    cwist_http_request *req = cwist_http_parse_request(raw);
+    assert(req != NULL);
+
+    assert(cwist_sview_equals(cwist_http_request_path_view(req), CWIST_SVIEW_LIT("/items")));
+    assert(cwist_sview_equals(cwist_http_request_version_view(req), CWIST_SVIEW_LIT("HTTP/1.1")));
+
+    cwist_sview host = cwist_http_header_get_view(req->headers, CWIST_SVIEW_LIT("host"));
+    assert(host.ptr == cwist_http_header_get(req->headers, "Host")); // borrowed, not copied
+    assert(cwist_sview_equals(host, CWIST_SVIEW_LIT("localhost")));
+
+    uint64_t length = 0;
+    assert(cwist_sview_to_uint64(cwist_http_request_header_view(req, "CONTENT-LENGTH"), 10, &length));
+    assert(length == 42);
+    assert(cwist_http_request_header_view(req, "Missing").ptr == NULL);
+
+    cwist_http_request_destroy(req);
+    printf("Passed request views.\n");
+}
+
+static int arena_cleanups = 0;
+
+static void count_cleanup(void *ctx) {
+    (void)ctx;
+    arena_cleanups++;
+}
+
+void test_arena_request() {
+    printf("Testing Arena-backed Request/Response...\n");
+    static uint8_t buffer[8192];
+    struct session_manager manager;
+    session_manager_init(&manager, buffer, sizeof(buffer));
+
+    const char *raw = "GET /arena HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    cwist_http_request *req = cwist_http_parse_request_in(&manager.request_arena, raw);
+    assert(req != NULL);
+    assert(req->allocator == session_arena_allocator(&manager.request_arena));
+    assert(strcmp(req->path->data, "/arena") == 0);
+    assert(strcmp(cwist_http_header_get(req->headers, "Accept"), "*/*") == 0);
+    assert((uint8_t *)req >= buffer && (uint8_t *)req < buffer + sizeof(buffer));
+    assert((uint8_t *)req->headers->value->data >= buffer);
+
+    cwist_http_response *res = cwist_http_response_create_in(&manager.request_arena);
+    assert(res != NULL);
+    cwist_http_header_add_with(res->allocator, &res->headers, "Server", "Cwist/0.1");
+    cwist_sstring_assign(res->body, "arena body");
+    assert(strcmp(res->body->data, "arena body") == 0);
+
+    assert(session_arena_register_destructor(&manager.request_arena, count_cleanup, NULL) == 0);
+    assert(session_arena_register_destructor(&manager.request_arena, count_cleanup, NULL) == 0);
+
+    // destroy is a no-op for arena objects; reset reclaims everything
+    cwist_http_response_destroy(res);
+    cwist_http_request_destroy(req);
+    session_manager_reset(&manager);
+    assert(arena_cleanups == 2);
+    assert(manager.request_arena.offset == 0);
+
+    // Exhausted arena reports failure instead of falling back to malloc
+    uint8_t tiny[16];
+    struct session_arena small;
+    session_arena_init(&small, tiny, sizeof(tiny));
+    assert(cwist_http_request_create_in(&small) == NULL);
+
+    printf("Passed Arena-backed Request/Response.\n");
+}
+
 void test_send_response() {
     printf("Testing Response Sending...\n");
     int sv[2];
@@ -100,12 +172,268 @@ void test_send_response() {
     printf("Passed Response Sending.\n");
 }
 
+static bool view_is(cwist_sview view, const char *expected) {
+    if (!expected) return view.ptr == NULL;
+    return view.ptr && cwist_sview_equals(view, cwist_sview_from_cstr(expected));
+}
+
+void test_query_params() {
+    printf("Testing lazy query parameters...\n");
+    cwist_http_request *req = cwist_http_parse_request(
+        "GET /search?q=caf%C3%A9+au+lait&page=2&empty=&flag&a%20b=x%2By&q=second&bad=%zz%4 HTTP/1.1\r\n\r\n");
+    assert(req != NULL);
+    assert(strcmp(req->path->data, "/search") == 0);
+    assert(strncmp(req->query->data, "q=caf%C3%A9", 11) == 0);
+    assert(req->query_params == NULL);   // nothing split until asked
+
+    assert(view_is(cwist_http_query_get(req, "q"), "caf\xC3\xA9 au lait"));   // first match wins
+    assert(req->query_params != NULL);
+    assert(view_is(cwist_http_query_get(req, "page"), "2"));
+    assert(view_is(cwist_http_query_get(req, "empty"), ""));
+    assert(view_is(cwist_http_query_get(req, "flag"), ""));
+    assert(view_is(cwist_http_query_get(req, "a b"), "x+y"));
+    assert(view_is(cwist_http_query_get(req, "bad"), "%zz%4"));
+    assert(view_is(cwist_http_query_get(req, "missing"), NULL));
+    // Decoded once; the raw query is untouched.
+    assert(view_is(cwist_http_query_get(req, "q"), "caf\xC3\xA9 au lait"));
+    assert(strstr(req->query->data, "caf%C3%A9+au+lait") != NULL);
+    cwist_http_request_destroy(req);
+
+    req = cwist_http_parse_request("GET /plain HTTP/1.1\r\n\r\n");
+    assert(req->query->size == 0 && view_is(cwist_http_query_get(req, "q"), NULL));
+    cwist_http_request_destroy(req);
+
+    char text[] = "a%41%4a+%2b%";
+    assert(cwist_http_url_decode(text, strlen(text), false) == 6 && memcmp(text, "aAJ++%", 6) == 0);
+    char long_text[200];
+    memset(long_text, 'x', sizeof(long_text));
+    memcpy(long_text + 150, "%41", 3);
+    assert(cwist_http_url_decode(long_text, sizeof(long_text), true) == 198 && long_text[150] == 'A');
+    printf("Passed lazy query parameters.\n");
+}
+
+void test_cookie_and_form_params() {
+    printf("Testing cookie and form parameters...\n");
+    cwist_http_request *req = cwist_http_parse_request(
+        "POST /login HTTP/1.1\r\nCookie: sid=abc%20def; theme=\"dark\" ;  lang = ko ;;\r\n"
+        "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n\r\n"
+        "user=kim&pass=p%26ss+word&remember");
+    assert(req != NULL);
+    assert(view_is(cwist_http_cookie_get(req, "sid"), "abc%20def"));
+    assert(view_is(cwist_http_cookie_get(req, "theme"), "dark"));
+    assert(view_is(cwist_http_cookie_get(req, "lang"), "ko"));
+    assert(view_is(cwist_http_cookie_get(req, "user"), NULL));
+    assert(view_is(cwist_http_form_get(req, "pass"), "p&ss word"));
+    assert(view_is(cwist_http_form_get(req, "user"), "kim"));
+    assert(view_is(cwist_http_form_get(req, "remember"), ""));
+    cwist_http_request_destroy(req);
+
+    // Not a urlencoded body; no Cookie header.
+    req = cwist_http_parse_request("POST / HTTP/1.1\r\nContent-Type: application/json\r\n\r\nuser=kim");
+    assert(view_is(cwist_http_form_get(req, "user"), NULL));
+    assert(view_is(cwist_http_cookie_get(req, "sid"), NULL));
+    cwist_http_request_destroy(req);
+
+    // Arena requests keep their indexes in the arena.
+    static uint8_t buffer[8192];
+    struct session_manager manager;
+    session_manager_init(&manager, buffer, sizeof(buffer));
+    req = cwist_http_parse_request_in(&manager.request_arena, "GET /a?x=1&y=%32 HTTP/1.1\r\n\r\n");
+    assert(view_is(cwist_http_query_get(req, "y"), "2"));
+    assert((uint8_t *)req->query_params >= buffer && (uint8_t *)req->query_params < buffer + sizeof(buffer));
+    cwist_http_request_destroy(req);
+    session_manager_reset(&manager);
+    printf("Passed cookie and form parameters.\n");
+}
+
+static int collect(void *ctx, const char *data, size_t len) {
+    cwist_sstring_append_view((cwist_sstring *)ctx, cwist_sview_make(data, len));
+    return 0;
+}
+
+static int stop_early(void *ctx, const char *data, size_t len) {
+    (void)data; (void)len;
+    return ++*(int *)ctx >= 1;
+}
+
+static cwist_chunked_status_t decode_all(const char *in, uint64_t limit, cwist_sstring *out, size_t *consumed) {
+    cwist_chunked_decoder dec;
+    cwist_chunked_decoder_init(&dec, limit);
+    return cwist_chunked_decode(&dec, in, strlen(in), consumed, collect, out);
+}
+
+void test_chunked_decode() {
+    printf("Testing chunked decoding...\n");
+    const char *body = "5;ext=1\r\nHello\r\n7 \r\n, World\r\n0\r\nX-Sum: 12\r\n\r\nGET /next";
+    size_t len = strlen(body), consumed = 0;
+
+    cwist_sstring *out = cwist_sstring_create();
+    assert(decode_all(body, 0, out, &consumed) == CWIST_CHUNKED_DONE);
+    assert(strcmp(out->data, "Hello, World") == 0);
+    assert(strcmp(body + consumed, "GET /next") == 0);   // pipelined bytes untouched
+
+    // One byte at a time gives the same result.
+    cwist_sstring_assign(out, "");
+    cwist_chunked_decoder dec;
+    cwist_chunked_decoder_init(&dec, 0);
+    cwist_chunked_status_t status = CWIST_CHUNKED_NEED_MORE;
+    size_t pos = 0;
+    while (status == CWIST_CHUNKED_NEED_MORE && pos < len) {
+        status = cwist_chunked_decode(&dec, body + pos, 1, &consumed, collect, out);
+        pos += consumed;
+    }
+    assert(status == CWIST_CHUNKED_DONE && strcmp(body + pos, "GET /next") == 0);
+    assert(strcmp(out->data, "Hello, World") == 0);
+
+    cwist_sstring_assign(out, "");
+    assert(decode_all("A\r\n0123456789\r\n0\r\n", 0, out, &consumed) == CWIST_CHUNKED_NEED_MORE);
+    assert(consumed == strlen("A\r\n0123456789\r\n0\r\n"));
+
+    const char *malformed[] = {
+        "\r\n", "g\r\n", "5\nHello\r\n", "5\r\nHelloX\r\n", "5\r\nHello\n", "0\r\n\n",
+        "0\r\nX: 1\n\r\n", "11111111111111111\r\n", " 5\r\n",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        assert(decode_all(malformed[i], 0, out, NULL) == CWIST_CHUNKED_MALFORMED);
+    }
+
+    // The limit is checked against the declared size, before any data arrives.
+    cwist_sstring_assign(out, "");
+    assert(decode_all("5\r\nHello\r\n6\r\n", 10, out, &consumed) == CWIST_CHUNKED_TOO_LARGE);
+    assert(strcmp(out->data, "Hello") == 0);
+    assert(decode_all("5\r\nHello\r\n5\r\nWorld\r\n0\r\n\r\n", 10, out, NULL) == CWIST_CHUNKED_DONE);
+
+    int calls = 0;
+    cwist_chunked_decoder_init(&dec, 0);
+    assert(cwist_chunked_decode(&dec, body, len, &consumed, stop_early, &calls) == CWIST_CHUNKED_ABORTED);
+    assert(calls == 1 && consumed == strlen("5;ext=1\r\nHello"));
+
+    cwist_sstring_destroy(out);
+    printf("Passed chunked decoding.\n");
+}
+
+void test_parse_chunked_request() {
+    printf("Testing chunked request parsing...\n");
+    cwist_http_request *req = cwist_http_parse_request(
+        "POST /upload HTTP/1.1\r\nTransfer-Encoding: gzip, Chunked\r\n\r\n"
+        "3\r\nabc\r\n3\r\ndef\r\n0\r\n\r\n");
+    assert(req != NULL && cwist_http_request_is_chunked(req));
+    assert(strcmp(req->body->data, "abcdef") == 0);
+    cwist_http_request_destroy(req);
+
+    // Headers only: the body is read separately.
+    req = cwist_http_parse_request("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    assert(req != NULL && req->body->size == 0);
+    cwist_http_request_destroy(req);
+
+    assert(cwist_http_parse_request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n") == NULL);
+    assert(cwist_http_parse_request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n") == NULL);
+
+    req = cwist_http_parse_request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n3\r\n");
+    assert(req != NULL && !cwist_http_request_is_chunked(req));
+    cwist_http_request_destroy(req);
+    printf("Passed chunked request parsing.\n");
+}
+
+static size_t read_all(int fd, char *buffer, size_t size) {
+    size_t got = 0;
+    ssize_t n;
+    while (got < size && (n = recv(fd, buffer + got, size - got, 0)) > 0) got += (size_t)n;
+    return got;
+}
+
+// Decodes the chunked body following the head into out.
+static void dechunk_response(char *raw, size_t len, cwist_sstring *out) {
+    char *body = strstr(raw, "\r\n\r\n");
+    assert(body != NULL);
+    body += 4;
+    cwist_chunked_decoder dec;
+    cwist_chunked_decoder_init(&dec, 0);
+    size_t consumed;
+    assert(cwist_chunked_decode(&dec, body, len - (size_t)(body - raw), &consumed, collect, out) == CWIST_CHUNKED_DONE);
+    assert(body + consumed == raw + len);
+}
+
+void test_chunked_writer() {
+    printf("Testing chunked response writer...\n");
+    static char buffer[1 << 16];
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Content-Length", "99");   // dropped in chunked mode
+    res->keep_alive = false;
+    cwist_http_chunked_writer writer;
+    assert(cwist_error_code(cwist_http_chunked_begin(&writer, sv[0], res, CWIST_ENCODING_IDENTITY)) == 0);
+    assert(cwist_error_code(cwist_http_chunked_write(&writer, "Hello", 5)) == 0);
+    assert(cwist_error_code(cwist_http_chunked_write(&writer, "", 0)) == 0);   // no premature last-chunk
+    assert(cwist_error_code(cwist_http_chunked_write(&writer, ", World", 7)) == 0);
+    assert(cwist_error_code(cwist_http_chunked_end(&writer)) == 0);
+    assert(cwist_error_code(cwist_http_chunked_write(&writer, "x", 1)) != 0);
+    close(sv[0]);
+    size_t got = read_all(sv[1], buffer, sizeof(buffer) - 1);
+    close(sv[1]);
+    buffer[got] = '\0';
+    assert(strstr(buffer, "Transfer-Encoding: chunked\r\n") != NULL);
+    assert(strstr(buffer, "Content-Length") == NULL);
+    assert(strstr(buffer, "\r\n\r\n5\r\nHello\r\n7\r\n, World\r\n0\r\n\r\n") != NULL);
+    cwist_http_response_destroy(res);
+
+    // gzip: the decoded chunks inflate back to everything written.
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    res = cwist_http_response_create();
+    res->keep_alive = false;
+    cwist_sstring *expected = cwist_sstring_create();
+    assert(cwist_error_code(cwist_http_chunked_begin(&writer, sv[0], res, CWIST_ENCODING_GZIP)) == 0);
+    for (int i = 0; i < 200; i++) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), "{\"row\":%d,\"name\":\"item-%d\"}\n", i, i);
+        cwist_sstring_append(expected, line);
+        assert(cwist_error_code(cwist_http_chunked_write(&writer, line, (size_t)n)) == 0);
+        if (i == 100) assert(cwist_error_code(cwist_http_chunked_flush(&writer)) == 0);
+    }
+    assert(cwist_error_code(cwist_http_chunked_end(&writer)) == 0);
+    close(sv[0]);
+    got = read_all(sv[1], buffer, sizeof(buffer) - 1);
+    close(sv[1]);
+    buffer[got] = '\0';
+    assert(strstr(buffer, "Content-Encoding: gzip\r\n") != NULL);
+    assert(strstr(buffer, "Vary: Accept-Encoding\r\n") != NULL);
+
+    cwist_sstring *compressed = cwist_sstring_create();
+    dechunk_response(buffer, got, compressed);
+    assert(compressed->size < expected->size);
+    static char inflated[1 << 16];
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    assert(inflateInit2(&z, 15 + 16) == Z_OK);
+    z.next_in = (Bytef *)compressed->data;
+    z.avail_in = (uInt)compressed->size;
+    z.next_out = (Bytef *)inflated;
+    z.avail_out = sizeof(inflated);
+    assert(inflate(&z, Z_FINISH) == Z_STREAM_END);
+    assert(z.total_out == expected->size && memcmp(inflated, expected->data, expected->size) == 0);
+    inflateEnd(&z);
+
+    cwist_sstring_destroy(compressed);
+    cwist_sstring_destroy(expected);
+    cwist_http_response_destroy(res);
+    printf("Passed chunked response writer.\n");
+}
+
 int main() {
     test_methods();
     test_request_lifecycle();
     test_response_lifecycle();
     test_parse_request();
+    test_request_views();
+    test_arena_request();
     test_send_response();
+    test_chunked_decode();
+    test_parse_chunked_request();
+    test_chunked_writer();
+    test_query_params();
+    test_cookie_and_form_params();
     printf("All HTTP tests passed!\n");
     return 0;
 }
@@ -0,0 +1,376 @@
+#include <cwist/json.h>
+#include <cwist/sstring.h>
+#include <cwist/simd.h>
+#include <cwist/http.h>
+#include <cwist/session_manager.h>
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+void test_writer_compact() {
+    printf("Testing JSON writer (compact)...\n");
+    cwist_sstring *out = cwist_sstring_create();
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, out, false);
+
+    cwist_json_begin_object(&w);
+    cwist_json_key(&w, "name");
+    cwist_json_string(&w, "say \"hi\"\n");
+    cwist_json_key(&w, "count");
+    cwist_json_int(&w, -42);
+    cwist_json_key(&w, "big");
+    cwist_json_uint(&w, 18446744073709551615ULL);
+    cwist_json_key(&w, "ok");
+    cwist_json_bool(&w, true);
+    cwist_json_key(&w, "none");
+    cwist_json_null(&w);
+    cwist_json_key(&w, "list");
+    cwist_json_begin_array(&w);
+    cwist_json_int(&w, 1);
+    cwist_json_double(&w, 2.5);
+    cwist_json_begin_object(&w);
+    cwist_json_end_object(&w);
+    cwist_json_begin_array(&w);
+    cwist_json_end_array(&w);
+    cwist_json_end_array(&w);
+    cwist_json_end_object(&w);
+
+    cwist_error_t err = cwist_json_writer_finish(&w);
+    assert(cwist_error_code(err) == 0);
+    assert(strcmp(out->data, "{\"name\":\"say \\\"hi\\\"\\n\",\"count\":-42,\"big\":18446744073709551615,"
+                             "\"ok\":true,\"none\":null,\"list\":[1,2.5,{},[]]}") == 0);
+
+    // What the writer produced is what a parser reads back.
+    cJSON *parsed = cJSON_Parse(out->data);
+    assert(parsed != NULL);
+    assert(strcmp(cJSON_GetObjectItem(parsed, "name")->valuestring, "say \"hi\"\n") == 0);
+    assert(cJSON_GetArraySize(cJSON_GetObjectItem(parsed, "list")) == 4);
+    cJSON_Delete(parsed);
+    cwist_sstring_destroy(out);
+    printf("Passed JSON writer (compact).\n");
+}
+
+void test_writer_pretty() {
+    printf("Testing JSON writer (pretty)...\n");
+    cwist_sstring *out = cwist_sstring_create();
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, out, true);
+
+    cwist_json_begin_object(&w);
+    cwist_json_key(&w, "a");
+    cwist_json_begin_array(&w);
+    cwist_json_int(&w, 1);
+    cwist_json_int(&w, 2);
+    cwist_json_end_array(&w);
+    cwist_json_key(&w, "empty");
+    cwist_json_begin_object(&w);
+    cwist_json_end_object(&w);
+    cwist_json_end_object(&w);
+    assert(cwist_error_code(cwist_json_writer_finish(&w)) == 0);
+    assert(strcmp(out->data, "{\n  \"a\": [\n    1,\n    2\n  ],\n  \"empty\": {}\n}") == 0);
+    cwist_sstring_destroy(out);
+    printf("Passed JSON writer (pretty).\n");
+}
+
+void test_writer_numbers() {
+    printf("Testing JSON writer numbers...\n");
+    const double values[] = { 0.1, 1.0 / 3.0, -2.5e-300, 1e21, 123456789012345678.0, 3.0, -0.5, 5e-324 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        cwist_sstring *out = cwist_sstring_create();
+        cwist_json_writer w;
+        cwist_json_writer_init(&w, out, false);
+        cwist_json_double(&w, values[i]);
+        assert(cwist_error_code(cwist_json_writer_finish(&w)) == 0);
+        assert(strtod(out->data, NULL) == values[i]);   // round-trips exactly
+        cwist_sstring_destroy(out);
+    }
+
+    cwist_sstring *out = cwist_sstring_create();
+    cwist_json_writer w;
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_begin_array(&w);
+    cwist_json_double(&w, 0.1);
+    cwist_json_double(&w, 100.0);
+    cwist_json_double(&w, NAN);
+    cwist_json_double(&w, INFINITY);
+    cwist_json_end_array(&w);
+    assert(strcmp(out->data, "[0.1,100,null,null]") == 0);
+    cwist_sstring_destroy(out);
+    printf("Passed JSON writer numbers.\n");
+}
+
+void test_writer_errors() {
+    printf("Testing JSON writer errors...\n");
+    cwist_sstring *out = cwist_sstring_create();
+    cwist_json_writer w;
+
+    // A value where a key is due; later calls are ignored.
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_begin_object(&w);
+    cwist_error_t err = cwist_json_int(&w, 1);
+    assert(err.domain == CWIST_ERRDOMAIN_JSON && cwist_error_code(err) == ERR_JSON_MISPLACED);
+    size_t size = out->size;
+    cwist_json_key(&w, "late");
+    assert(out->size == size);
+    assert(cwist_error_code(cwist_json_writer_finish(&w)) == ERR_JSON_MISPLACED);
+
+    // Key outside an object, mismatched end, unterminated document.
+    cwist_sstring_assign(out, "");
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_begin_array(&w);
+    assert(cwist_error_code(cwist_json_key(&w, "k")) == ERR_JSON_MISPLACED);
+
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_begin_array(&w);
+    assert(cwist_error_code(cwist_json_end_object(&w)) == ERR_JSON_UNBALANCED);
+
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_begin_object(&w);
+    cwist_json_key(&w, "open");
+    assert(cwist_error_code(cwist_json_writer_finish(&w)) == ERR_JSON_UNBALANCED);
+
+    // Two top-level values.
+    cwist_json_writer_init(&w, out, false);
+    cwist_json_null(&w);
+    assert(cwist_error_code(cwist_json_null(&w)) == ERR_JSON_MISPLACED);
+
+    cwist_json_writer_init(&w, out, false);
+    for (int i = 0; i < CWIST_JSON_MAX_DEPTH; i++) cwist_json_begin_array(&w);
+    assert(cwist_error_code(cwist_json_begin_array(&w)) == ERR_JSON_TOO_DEEP);
+    assert(strcmp(cwist_error_message(w.err), "JSON nesting is too deep") == 0);
+    cwist_sstring_destroy(out);
+    printf("Passed JSON writer errors.\n");
+}
+
+void test_reader_access() {
+    printf("Testing JSON reader access...\n");
+    const char *text =
+        " {\"user\": {\"id\": 42, \"name\": \"Ada \\\"L\\\"\\n\", \"tags\": [\"a\", \"b\\u00e9\", \"\\ud83d\\ude00\"]},"
+        " \"ratio\": -1.5e2, \"big\": 18446744073709551615, \"ok\": true, \"off\": false, \"none\": null,"
+        " \"empty\": {}, \"list\": [], \"k\\u0065y\": 7 } ";
+    cwist_json_doc doc;
+    assert(cwist_error_code(cwist_json_doc_parse(&doc, cwist_sview_from_cstr(text), NULL)) == 0);
+    cwist_json_value root = cwist_json_root(&doc);
+    assert(cwist_json_type(root) == CWIST_JSON_OBJECT);
+    assert(cwist_json_size(root) == 9);
+
+    cwist_json_value user = cwist_json_get(root, "user");
+    int64_t id = 0;
+    assert(cwist_json_get_int64(cwist_json_get(user, "id"), &id) && id == 42);
+    size_t len = 0;
+    const char *name = cwist_json_get_string(cwist_json_get(user, "name"), &len);
+    assert(name && strcmp(name, "Ada \"L\"\n") == 0 && len == 8);
+    assert(cwist_sview_equals(cwist_json_raw_string(cwist_json_get(user, "name")), CWIST_SVIEW_LIT("Ada \\\"L\\\"\\n")));
+
+    cwist_json_value tags = cwist_json_get(user, "tags");
+    assert(cwist_json_size(tags) == 3);
+    assert(strcmp(cwist_json_get_string(cwist_json_at(tags, 1), NULL), "b\xc3\xa9") == 0);
+    assert(strcmp(cwist_json_get_string(cwist_json_at(tags, 2), NULL), "\xf0\x9f\x98\x80") == 0);
+    assert(!cwist_json_exists(cwist_json_at(tags, 3)));
+    assert(cwist_sview_equals(cwist_json_value_text(tags), cwist_sview_from_cstr("[\"a\", \"b\\u00e9\", \"\\ud83d\\ude00\"]")));
+
+    double ratio = 0;
+    assert(cwist_json_get_double(cwist_json_get(root, "ratio"), &ratio) && ratio == -150.0);
+    assert(!cwist_json_get_int64(cwist_json_get(root, "ratio"), &id));
+    uint64_t big = 0;
+    assert(cwist_json_get_uint64(cwist_json_get(root, "big"), &big) && big == UINT64_MAX);
+    assert(!cwist_json_get_int64(cwist_json_get(root, "big"), &id));
+    bool flag = false;
+    assert(cwist_json_get_bool(cwist_json_get(root, "ok"), &flag) && flag);
+    assert(cwist_json_get_bool(cwist_json_get(root, "off"), &flag) && !flag);
+    assert(cwist_json_is_null(cwist_json_get(root, "none")));
+    assert(cwist_json_type(cwist_json_get(root, "none")) == CWIST_JSON_NULL);
+    assert(cwist_json_size(cwist_json_get(root, "empty")) == 0);
+    assert(cwist_json_type(cwist_json_get(root, "list")) == CWIST_JSON_ARRAY);
+    assert(cwist_json_get_int64(cwist_json_get(root, "key"), &id) && id == 7);   // escaped key
+
+    // Missing values propagate through chains; type mismatches fail.
+    assert(!cwist_json_exists(cwist_json_get(cwist_json_get(root, "nope"), "deeper")));
+    assert(cwist_json_type(cwist_json_at(root, 0)) == CWIST_JSON_MISSING);
+    assert(cwist_json_get_string(cwist_json_get(root, "ok"), NULL) == NULL);
+
+    cwist_json_iter iter = cwist_json_iterate(root);
+    cwist_sview key;
+    cwist_json_value value;
+    size_t members = 0;
+    while (cwist_json_iter_next(&iter, &key, &value)) {
+        if (members == 0) assert(cwist_sview_equals(key, CWIST_SVIEW_LIT("user")));
+        members++;
+    }
+    assert(members == 9);
+
+    // The cJSON path hands existing code an ordinary tree.
+    cJSON *bridged = cwist_json_to_cjson(root);
+    assert(cJSON_IsObject(bridged) && cJSON_GetArraySize(bridged) == 9);
+    cJSON *bridged_user = cJSON_GetObjectItem(bridged, "user");
+    assert(cJSON_GetObjectItem(bridged_user, "id")->valuedouble == 42);
+    assert(strcmp(cJSON_GetObjectItem(bridged_user, "name")->valuestring, "Ada \"L\"\n") == 0);
+    assert(strcmp(cJSON_GetArrayItem(cJSON_GetObjectItem(bridged_user, "tags"), 2)->valuestring, "\xf0\x9f\x98\x80") == 0);
+    assert(cJSON_IsTrue(cJSON_GetObjectItem(bridged, "ok")));
+    assert(cJSON_IsNull(cJSON_GetObjectItem(bridged, "none")));
+    assert(cJSON_GetObjectItem(bridged, "key")->valuedouble == 7);
+    cJSON_Delete(bridged);
+    cwist_json_doc_release(&doc);
+    printf("Passed JSON reader access.\n");
+}
+
+static size_t json_tokens_at(cwist_simd_level_t level, const char *text, uint32_t *out) {
+    cwist_simd_set_level(level);
+    cwist_json_doc doc;
+    cwist_error_t err = cwist_json_doc_parse(&doc, cwist_sview_from_cstr(text), NULL);
+    cwist_simd_set_level(CWIST_SIMD_AVX2);
+    if (cwist_error_code(err) != 0) return (size_t)-1;
+    memcpy(out, doc.tokens, doc.count * sizeof(uint32_t));
+    size_t count = doc.count;
+    cwist_json_doc_release(&doc);
+    return count;
+}
+
+void test_reader_index() {
+    printf("Testing JSON reader index across SIMD levels...\n");
+    // Strings, escapes and words straddling the 64-byte block edges.
+    char text[2048];
+    static uint32_t expect[2048], got[2048];
+    for (int pad = 0; pad < 70; pad++) {
+        int n = snprintf(text, sizeof(text), "[%*s\"x\\\\\\\"y\\\\\", 12345, {\"k\\\\\":true}, \"%*s\\\\\", -0.5e-3, null]",
+                         pad, "", pad % 7, "");
+        assert(n > 0);
+        size_t count = json_tokens_at(CWIST_SIMD_SCALAR, text, expect);
+        assert(count == 17);
+        for (int level = CWIST_SIMD_SSE2; level <= CWIST_SIMD_AVX2; level++) {
+            assert(json_tokens_at((cwist_simd_level_t)level, text, got) == count);
+            assert(memcmp(expect, got, count * sizeof(uint32_t)) == 0);
+        }
+    }
+
+    // Random documents: every level agrees, and the tree matches cJSON's.
+    srand(7);
+    const char *atoms[] = { "1", "-2.5", "true", "null", "\"q\\\"\"", "\"\\\\\"", "\"{[,:]}\"", "\"\xc3\xa9\"" };
+    for (int round = 0; round < 300; round++) {
+        size_t len = 0;
+        int depth = 0;
+        bool need_value = true;
+        text[len++] = '[';
+        depth++;
+        while (len < 1500) {
+            int pick = rand() % 10;
+            if (!need_value) {
+                if (pick < 6 || depth == 1) { text[len++] = ','; need_value = true; }
+                else { text[len++] = ']'; depth--; }
+                continue;
+            }
+            if (pick < 2 && depth < 20) { text[len++] = '['; depth++; continue; }
+            const char *atom = atoms[rand() % 8];
+            memcpy(text + len, atom, strlen(atom));
+            len += strlen(atom);
+            if (rand() % 3 == 0) text[len++] = ' ';
+            need_value = false;
+        }
+        if (need_value) text[len++] = '0';
+        while (depth-- > 0) text[len++] = ']';
+        text[len] = '\0';
+
+        size_t count = json_tokens_at(CWIST_SIMD_SCALAR, text, expect);
+        assert(count != (size_t)-1);
+        for (int level = CWIST_SIMD_SSE2; level <= CWIST_SIMD_AVX2; level++) {
+            assert(json_tokens_at((cwist_simd_level_t)level, text, got) == count);
+            assert(memcmp(expect, got, count * sizeof(uint32_t)) == 0);
+        }
+
+        cwist_json_doc doc;
+        assert(cwist_error_code(cwist_json_doc_parse(&doc, cwist_sview_from_cstr(text), NULL)) == 0);
+        cJSON *bridged = cwist_json_to_cjson(cwist_json_root(&doc));
+        cJSON *parsed = cJSON_Parse(text);
+        assert(bridged && parsed);
+        char *left = cJSON_PrintUnformatted(bridged);
+        char *right = cJSON_PrintUnformatted(parsed);
+        assert(strcmp(left, right) == 0);
+        free(left);
+        free(right);
+        cJSON_Delete(bridged);
+        cJSON_Delete(parsed);
+        cwist_json_doc_release(&doc);
+    }
+    printf("Passed JSON reader index (dispatch: %s).\n", cwist_simd_level_name(cwist_simd_level()));
+}
+
+void test_reader_errors() {
+    printf("Testing JSON reader errors...\n");
+    const char *bad[] = {
+        "", "   ", "{", "}", "[1,]", "[,1]", "{\"a\"}", "{\"a\":}", "{\"a\" 1}", "{1:2}",
+        "[1 2]", "\"open", "[\"a\\\"]", "{} {}", "[}", "{]", "[x]", "[\"a\"\"b\"]", "[1]]",
+    };
+    cwist_json_doc doc;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        cwist_error_t err = cwist_json_doc_parse(&doc, cwist_sview_from_cstr(bad[i]), NULL);
+        assert(err.domain == CWIST_ERRDOMAIN_JSON && cwist_error_code(err) == ERR_JSON_SYNTAX);
+        assert(!cwist_json_exists(cwist_json_root(&doc)));
+    }
+
+    assert(cwist_error_code(cwist_json_doc_parse(&doc, CWIST_SVIEW_LIT("[\"\xff\"]"), NULL)) == ERR_JSON_ENCODING);
+
+    char deep[CWIST_JSON_MAX_NESTING * 2 + 4];
+    memset(deep, '[', CWIST_JSON_MAX_NESTING + 1);
+    memset(deep + CWIST_JSON_MAX_NESTING + 1, ']', CWIST_JSON_MAX_NESTING + 1);
+    cwist_sview deep_view = cwist_sview_make(deep, (CWIST_JSON_MAX_NESTING + 1) * 2);
+    assert(cwist_error_code(cwist_json_doc_parse(&doc, deep_view, NULL)) == ERR_JSON_TOO_DEEP);
+    deep_view = cwist_sview_make(deep + 1, CWIST_JSON_MAX_NESTING * 2);
+    assert(cwist_error_code(cwist_json_doc_parse(&doc, deep_view, NULL)) == 0);
+    cwist_json_doc_release(&doc);
+
+    // Words are checked on access, not while indexing.
+    assert(cwist_error_code(cwist_json_doc_parse(&doc, CWIST_SVIEW_LIT("[tru, 01, -, 1.5, \"\\x\"]"), NULL)) == 0);
+    cwist_json_value root = cwist_json_root(&doc);
+    assert(cwist_json_type(cwist_json_at(root, 0)) == CWIST_JSON_INVALID);
+    assert(cwist_json_type(cwist_json_at(root, 1)) == CWIST_JSON_INVALID);
+    assert(cwist_json_type(cwist_json_at(root, 2)) == CWIST_JSON_INVALID);
+    double number;
+    assert(!cwist_json_get_double(cwist_json_at(root, 1), &number));
+    assert(cwist_json_get_double(cwist_json_at(root, 3), &number) && number == 1.5);
+    assert(cwist_json_get_string(cwist_json_at(root, 4), NULL) == NULL);   // bad escape
+    assert(cwist_json_to_cjson(root) == NULL);
+    cwist_json_doc_release(&doc);
+    printf("Passed JSON reader errors.\n");
+}
+
+void test_reader_request_arena() {
+    printf("Testing JSON reader on an arena request...\n");
+    static uint8_t buffer[16384];
+    struct session_manager manager;
+    session_manager_init(&manager, buffer, sizeof(buffer));
+
+    const char *raw = "POST /users HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+                      "Content-Length: 40\r\n\r\n{\"name\": \"caf\\u00e9\", \"admin\": false}   ";
+    cwist_http_request *req = cwist_http_parse_request_in(&manager.request_arena, raw);
+    assert(req != NULL);
+
+    cwist_json_doc doc;
+    assert(cwist_error_code(cwist_http_request_json(req, &doc)) == 0);
+    assert(doc.allocator == session_arena_allocator(&manager.request_arena));
+    assert((uint8_t *)doc.tokens >= buffer && (uint8_t *)doc.tokens < buffer + sizeof(buffer));
+
+    const char *name = cwist_json_get_string(cwist_json_get(cwist_json_root(&doc), "name"), NULL);
+    assert(name && strcmp(name, "caf\xc3\xa9") == 0);
+    assert((const uint8_t *)name >= buffer && (const uint8_t *)name < buffer + sizeof(buffer));
+
+    // No release needed: the reset takes the index and strings with the request.
+    session_manager_reset(&manager);
+    assert(manager.request_arena.offset == 0);
+    printf("Passed JSON reader on an arena request.\n");
+}
+
+int main() {
+    test_writer_compact();
+    test_writer_pretty();
+    test_writer_numbers();
+    test_writer_errors();
+    test_reader_access();
+    test_reader_index();
+    test_reader_errors();
+    test_reader_request_arena();
+    printf("All JSON tests passed!\n");
+    return 0;
+}
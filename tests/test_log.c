@@ -0,0 +1,140 @@
+#include <cwist/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define LOG_THREADS 4
+#define LOG_PER_THREAD 2000
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc((size_t)len + 1);
+    assert(fread(data, 1, (size_t)len, f) == (size_t)len);
+    data[len] = '\0';
+    fclose(f);
+    return data;
+}
+
+static size_t count_substr(const char *text, const char *needle) {
+    size_t count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+void test_log_format() {
+    printf("Testing log formatting...\n");
+    char path[] = "/tmp/cwist_log_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    cwist_log_config config = { path, 64, 1000, CWIST_LOG_INFO };
+    assert(cwist_log_init(&config));
+    assert(!cwist_log_init(&config));   // already running
+
+    char volatile_text[32];
+    strcpy(volatile_text, "copied");
+    cwist_log(CWIST_LOG_INFO, "int=%d neg=%lld u=%zu hex=%#x str=%s pct=100%%", 42, -7LL, (size_t)9, 255u, volatile_text);
+    strcpy(volatile_text, "CHANGED");   // the record holds its own copy
+    cwist_log(CWIST_LOG_ERROR, "pad=[%5s] prec=%.2f char=%c", "ab", 3.14159, 'z');
+    cwist_log(CWIST_LOG_DEBUG, "below min level");
+    cwist_log_shutdown();
+
+    char *out = read_file(path);
+    assert(strstr(out, "INFO  int=42 neg=-7 u=9 hex=0xff str=copied pct=100%\n") != NULL);
+    assert(strstr(out, "ERROR pad=[   ab] prec=3.14 char=z\n") != NULL);
+    assert(strstr(out, "below min level") == NULL);
+    assert(strstr(out, "CHANGED") == NULL);
+    assert(out[4] == '-' && out[10] == 'T');   // ISO-8601 timestamp prefix
+    free(out);
+    unlink(path);
+    printf("Passed log formatting.\n");
+}
+
+static void *log_worker(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < LOG_PER_THREAD; i++) {
+        cwist_log(CWIST_LOG_INFO, "worker %d record %d", id, i);
+    }
+    return NULL;
+}
+
+void test_log_threads() {
+    printf("Testing log threads...\n");
+    char path[] = "/tmp/cwist_log_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    cwist_log_stats before;
+    cwist_log_get_stats(&before);
+    cwist_log_config config = { path, 256, 1, CWIST_LOG_DEBUG };
+    assert(cwist_log_init(&config));
+
+    pthread_t threads[LOG_THREADS];
+    for (int i = 0; i < LOG_THREADS; i++) {
+        pthread_create(&threads[i], NULL, log_worker, (void *)(intptr_t)i);
+    }
+    for (int i = 0; i < LOG_THREADS; i++) pthread_join(threads[i], NULL);
+    cwist_log_shutdown();
+
+    cwist_log_stats after;
+    cwist_log_get_stats(&after);
+    uint64_t written = after.written - before.written;
+    uint64_t dropped = after.dropped - before.dropped;
+    // Every record is either written or counted as dropped, never both.
+    assert(written + dropped == LOG_THREADS * LOG_PER_THREAD);
+
+    char *out = read_file(path);
+    size_t lines = count_substr(out, "INFO  worker ");
+    assert(lines + dropped == LOG_THREADS * LOG_PER_THREAD);
+    free(out);
+    unlink(path);
+    printf("Passed log threads (%zu written, %llu dropped).\n", lines, (unsigned long long)dropped);
+}
+
+void test_log_drops() {
+    printf("Testing log drop counter...\n");
+    char path[] = "/tmp/cwist_log_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    // A long drain period and a fresh 8-record ring: the 9th record on must drop.
+    cwist_log_config config = { path, 8, 60000, CWIST_LOG_DEBUG };
+    assert(cwist_log_init(&config));
+    cwist_log_stats before;
+    cwist_log_get_stats(&before);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, log_worker, (void *)(intptr_t)99);
+    pthread_join(thread, NULL);
+
+    cwist_log_stats after;
+    cwist_log_get_stats(&after);
+    assert(after.dropped - before.dropped == LOG_PER_THREAD - 8);
+    cwist_log_shutdown();
+
+    char *out = read_file(path);
+    assert(count_substr(out, "worker 99 record") == 8);
+    assert(strstr(out, "dropped 1992 records") != NULL);
+    free(out);
+    unlink(path);
+    printf("Passed log drop counter.\n");
+}
+
+int main() {
+    test_log_format();
+    test_log_threads();
+    test_log_drops();
+    printf("All log tests passed!\n");
+    return 0;
+}
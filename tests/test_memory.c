@@ -0,0 +1,165 @@
+#include <cwist/buffer_pool.h>
+#include <cwist/allocator.h>
+#include <cwist/http.h>
+#include <cwist/session_manager.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+
+void test_buffer_classes() {
+    printf("Testing buffer pool classes...\n");
+    cwist_buffer *small = cwist_buffer_acquire(100);
+    assert(small != NULL);
+    assert(small->capacity == 4096);
+    assert(((uintptr_t)small->data & 63) == 0);
+
+    cwist_buffer *mid = cwist_buffer_acquire(5000);
+    assert(mid->capacity == 16384);
+    cwist_buffer *big = cwist_buffer_acquire(65536);
+    assert(big->capacity == 65536);
+    assert(cwist_buffer_acquire(65537) == NULL);
+
+    // Released slabs are handed out again by the thread cache
+    cwist_buffer_release(small);
+    cwist_buffer *again = cwist_buffer_acquire(1);
+    assert(again == small);
+
+    cwist_buffer_release(again);
+    cwist_buffer_release(mid);
+    cwist_buffer_release(big);
+    printf("Passed buffer pool classes.\n");
+}
+
+void test_buffer_grow() {
+    printf("Testing buffer grow...\n");
+    cwist_buffer *buf = cwist_buffer_acquire(1);
+    memcpy(buf->data, "GET / HTTP/1.1\r\n", 16);
+    buf->len = 16;
+
+    buf = cwist_buffer_grow(buf, 10000);
+    assert(buf->capacity == 16384);
+    assert(buf->len == 16);
+    assert(memcmp(buf->data, "GET / HTTP/1.1\r\n", 16) == 0);
+
+    cwist_buffer_release(buf);
+    printf("Passed buffer grow.\n");
+}
+
+static void *churn_buffers(void *arg) {
+    (void)arg;
+    cwist_buffer *held[16];
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < 16; i++) held[i] = cwist_buffer_acquire(4096);
+        for (int i = 0; i < 16; i++) cwist_buffer_release(held[i]);
+    }
+    return NULL;
+}
+
+void test_buffer_threads() {
+    printf("Testing buffer pool across threads...\n");
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, churn_buffers, NULL);
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+    // Exited threads returned their caches; the pool reuses rather than grows
+    cwist_buffer_pool_flush_thread();
+    cwist_buffer_pool_stats stats;
+    cwist_buffer_pool_get_stats(&stats);
+    assert(stats.allocated[CWIST_BUFFER_4K] <= 4 * 16 + 1);
+    assert(stats.global_free[CWIST_BUFFER_4K] == stats.allocated[CWIST_BUFFER_4K]);
+    printf("Passed buffer pool across threads.\n");
+}
+
+static const char *RAW_REQUEST =
+    "GET /items?page=2 HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n"
+    "User-Agent: test\r\nConnection: keep-alive\r\n\r\n";
+
+void test_counting_allocator() {
+    printf("Testing counting allocator...\n");
+    cwist_counting_allocator counter;
+    cwist_counting_allocator_init(&counter, NULL);
+
+    cwist_http_request *req = cwist_http_parse_request_with(&counter.base, RAW_REQUEST);
+    assert(req != NULL);
+    assert(req->allocator == &counter.base);
+    assert(strcmp(cwist_http_header_get(req->headers, "Host"), "localhost") == 0);
+    assert(counter.stats.allocs > 0);
+
+    cwist_http_request_destroy(req);
+    // Every allocation (and realloc-from-NULL) went back through the counter
+    assert(counter.stats.frees == counter.stats.allocs);
+    printf("Passed counting allocator.\n");
+}
+
+void test_pool_allocator() {
+    printf("Testing pool allocator...\n");
+    cwist_pool_allocator pool;
+    cwist_pool_allocator_init(&pool, NULL);
+
+    void *a = cwist_alloc(&pool.base, 24);
+    void *b = cwist_alloc(&pool.base, 4000); // larger than any class
+    assert(a && b);
+    assert(((uintptr_t)a & 15) == 0);
+    memset(a, 'x', 24);
+    a = cwist_realloc(&pool.base, a, 24, 200);
+    assert(((char *)a)[23] == 'x');
+    cwist_free(&pool.base, a, 200);
+    cwist_free(&pool.base, b, 4000);
+    assert(cwist_alloc(&pool.base, 200) == a); // recycled from the class list
+
+    // old_size 0 ("unknown") still keeps the contents, small and large
+    void *c = cwist_alloc(&pool.base, 24);
+    memcpy(c, "keep", 5);
+    c = cwist_realloc(&pool.base, c, 0, 5000);
+    assert(strcmp(c, "keep") == 0);
+    memset((char *)c + 4990, 'y', 10);
+    c = cwist_realloc(&pool.base, c, 0, 9000);
+    assert(strcmp(c, "keep") == 0 && ((char *)c)[4999] == 'y');
+    c = cwist_realloc(&pool.base, c, 0, 32);
+    assert(strcmp(c, "keep") == 0);
+    cwist_free(&pool.base, c, 0);
+
+    cwist_http_response *res = cwist_http_response_create_with(&pool.base);
+    cwist_sstring_assign(res->body, "pooled");
+    assert(strcmp(res->body->data, "pooled") == 0);
+    cwist_http_response_destroy(res);
+
+    cwist_pool_allocator_destroy(&pool);
+    printf("Passed pool allocator.\n");
+}
+
+void test_default_allocator() {
+    printf("Testing default allocator override...\n");
+    cwist_counting_allocator counter;
+    cwist_counting_allocator_init(&counter, cwist_allocator_libc());
+    cwist_allocator_set_default(&counter.base);
+
+    cwist_sstring *s = cwist_sstring_create();
+    cwist_sstring_assign(s, "counted");
+    cwist_sstring_destroy(s);
+
+    cwist_allocator_install_cjson(NULL);
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "k", "v");
+    cJSON_Delete(obj);
+
+    cwist_allocator_set_default(NULL);
+    cwist_allocator_install_cjson(NULL);
+    assert(cwist_allocator_default() == cwist_allocator_libc());
+    assert(counter.stats.allocs >= 4);
+    assert(counter.stats.frees == counter.stats.allocs);
+    printf("Passed default allocator override.\n");
+}
+
+int main() {
+    test_buffer_classes();
+    test_buffer_grow();
+    test_buffer_threads();
+    test_counting_allocator();
+    test_pool_allocator();
+    test_default_allocator();
+    printf("All memory tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <cwist/multipart.h>
+#include <cwist/body.h>
+#include <cwist/sstring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#define MAX_PARTS 8
+
+// Records every callback so a parse can be compared part by part.
+struct collected {
+    int parts;
+    int ended;
+    char name[MAX_PARTS][64];
+    char filename[MAX_PARTS][64];
+    char content_type[MAX_PARTS][64];
+    cwist_sstring *data[MAX_PARTS];
+    int stop_after;   // abort on this many data callbacks, 0 = never
+    int data_calls;
+};
+
+static void copy_view(char *dst, cwist_sview view) {
+    snprintf(dst, 64, "%.*s", (int)view.len, view.ptr ? view.ptr : "");
+}
+
+static int on_begin(void *ctx, const cwist_multipart_part *part) {
+    struct collected *c = ctx;
+    assert(c->parts == c->ended && c->parts < MAX_PARTS);
+    copy_view(c->name[c->parts], part->name);
+    copy_view(c->filename[c->parts], part->filename.ptr ? part->filename : CWIST_SVIEW_LIT("-"));
+    copy_view(c->content_type[c->parts], part->content_type);
+    c->data[c->parts] = cwist_sstring_create();
+    c->parts++;
+    return 0;
+}
+
+static int on_data(void *ctx, const char *data, size_t len) {
+    struct collected *c = ctx;
+    assert(c->parts == c->ended + 1 && len > 0);
+    cwist_sstring_append_view(c->data[c->parts - 1], cwist_sview_make(data, len));
+    return c->stop_after && ++c->data_calls >= c->stop_after;
+}
+
+static int on_end(void *ctx) {
+    struct collected *c = ctx;
+    c->ended++;
+    return 0;
+}
+
+static const cwist_multipart_handlers handlers = { on_begin, on_data, on_end };
+
+static void collected_free(struct collected *c) {
+    for (int i = 0; i < c->parts; i++) cwist_sstring_destroy(c->data[i]);
+    memset(c, 0, sizeof(*c));
+}
+
+// Feeds body in pieces of step bytes (0 = all at once).
+static cwist_multipart_status_t parse(const char *boundary, const char *body, size_t len, size_t step,
+                                      struct collected *c) {
+    static cwist_multipart_parser parser;
+    assert(cwist_error_code(cwist_multipart_parser_init(&parser, cwist_sview_from_cstr(boundary), &handlers, c)) == 0);
+    if (step == 0) step = len;
+    cwist_multipart_status_t status = CWIST_MULTIPART_NEED_MORE;
+    for (size_t off = 0; off < len; off += step) {
+        size_t n = len - off < step ? len - off : step;
+        status = cwist_multipart_feed(&parser, body + off, n);
+        if (status == CWIST_MULTIPART_MALFORMED || status == CWIST_MULTIPART_ABORTED) break;
+    }
+    return status;
+}
+
+static const char form[] =
+    "preamble is ignored\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"title\"\r\n"
+    "\r\n"
+    "Hello --XyZ\r\n--XyW\r\n-\r\n--Xy\r\n"
+    "--XyZ  \r\n"
+    "Content-Disposition: form-data; name=\"upload\"; filename=\"a;b.txt\"\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "line one\r\nline two\r\n"
+    "\r\n--XyZ\r\n"
+    "\r\n"
+    "no headers\r\n"
+    "--XyZ--\r\n"
+    "epilogue";
+
+static void check_form(struct collected *c) {
+    assert(c->parts == 3 && c->ended == 3);
+    assert(strcmp(c->name[0], "title") == 0 && strcmp(c->filename[0], "-") == 0);
+    assert(strcmp(c->data[0]->data, "Hello --XyZ\r\n--XyW\r\n-\r\n--Xy") == 0);
+    assert(strcmp(c->name[1], "upload") == 0 && strcmp(c->filename[1], "a;b.txt") == 0);
+    assert(strcmp(c->content_type[1], "text/plain") == 0);
+    assert(strcmp(c->data[1]->data, "line one\r\nline two\r\n") == 0);
+    assert(c->name[2][0] == '\0' && strcmp(c->data[2]->data, "no headers") == 0);
+}
+
+void test_multipart_form() {
+    printf("Testing multipart form parsing...\n");
+    struct collected c;
+    memset(&c, 0, sizeof(c));
+    size_t len = strlen(form);
+
+    // Every feed size, down to one byte at a time, gives the same parts.
+    for (size_t step = 0; step <= 16; step++) {
+        assert(parse("XyZ", form, len, step, &c) == CWIST_MULTIPART_DONE);
+        check_form(&c);
+        collected_free(&c);
+    }
+    printf("Passed multipart form parsing.\n");
+}
+
+void test_multipart_binary() {
+    printf("Testing multipart binary parts...\n");
+    const char *boundary = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+    size_t file_len = 1 << 20;
+    char *file = malloc(file_len);
+    srand(7);
+    for (size_t i = 0; i < file_len; i++) file[i] = (char)(rand() & 0xff);
+    // Delimiter look-alikes inside the data.
+    memcpy(file + 1000, "\r\n------WebKitFormBoundary7MA4YWxkTrZu0g", 40);
+    memcpy(file + file_len - 3, "\r\n-", 3);
+
+    cwist_sstring *body = cwist_sstring_create();
+    cwist_sstring_append(body, "------WebKitFormBoundary7MA4YWxkTrZu0gW\r\n"
+                               "Content-Disposition: form-data; name=\"file\"; filename=\"blob.bin\"\r\n"
+                               "Content-Type: application/octet-stream\r\n\r\n");
+    cwist_sstring_append_view(body, cwist_sview_make(file, file_len));
+    cwist_sstring_append(body, "\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW--\r\n");
+
+    size_t steps[] = { 0, 1, 7, 41, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        struct collected c;
+        memset(&c, 0, sizeof(c));
+        assert(parse(boundary, body->data, body->size, steps[i], &c) == CWIST_MULTIPART_DONE);
+        assert(c.parts == 1 && c.ended == 1 && strcmp(c.filename[0], "blob.bin") == 0);
+        assert(c.data[0]->size == file_len && memcmp(c.data[0]->data, file, file_len) == 0);
+        collected_free(&c);
+    }
+    cwist_sstring_destroy(body);
+    free(file);
+    printf("Passed multipart binary parts.\n");
+}
+
+void test_multipart_errors() {
+    printf("Testing multipart errors...\n");
+    struct collected c;
+    memset(&c, 0, sizeof(c));
+
+    assert(parse("b", "--b\r\n\r\nabc", 11, 0, &c) == CWIST_MULTIPART_NEED_MORE);   // never closed
+    collected_free(&c);
+    assert(parse("b", "--bX\r\n\r\nabc", 12, 0, &c) == CWIST_MULTIPART_MALFORMED);
+    collected_free(&c);
+    assert(parse("b", "--b\r\n\r\nabc\r\n--b-x", 17, 0, &c) == CWIST_MULTIPART_MALFORMED);
+    collected_free(&c);
+    assert(parse("b", "--b  x\r\n", 8, 0, &c) == CWIST_MULTIPART_MALFORMED);
+    collected_free(&c);
+
+    // Part headers are bounded.
+    cwist_sstring *big = cwist_sstring_create();
+    cwist_sstring_append(big, "--b\r\nX-Long: ");
+    for (int i = 0; i < CWIST_MULTIPART_HEADER_MAX; i++) cwist_sstring_append(big, "a");
+    assert(parse("b", big->data, big->size, 0, &c) == CWIST_MULTIPART_MALFORMED);
+    collected_free(&c);
+    cwist_sstring_destroy(big);
+
+    c.stop_after = 1;
+    assert(parse("XyZ", form, strlen(form), 0, &c) == CWIST_MULTIPART_ABORTED);
+    assert(c.parts == 1);
+    collected_free(&c);
+
+    cwist_multipart_parser parser;
+    assert(cwist_error_code(cwist_multipart_parser_init(&parser, CWIST_SVIEW_LIT(""), &handlers, &c)) == EINVAL);
+    assert(cwist_error_code(cwist_multipart_parser_init(&parser, CWIST_SVIEW_LIT("a\r\nb"), &handlers, &c)) == EINVAL);
+    printf("Passed multipart errors.\n");
+}
+
+static bool boundary_is(const char *content_type, const char *expected) {
+    cwist_sview boundary;
+    if (!cwist_multipart_boundary(cwist_sview_from_cstr(content_type), &boundary)) return expected == NULL;
+    return expected && cwist_sview_equals(boundary, cwist_sview_from_cstr(expected));
+}
+
+void test_multipart_boundary() {
+    printf("Testing multipart boundary extraction...\n");
+    assert(boundary_is("multipart/form-data; boundary=abc123", "abc123"));
+    assert(boundary_is("Multipart/Form-Data;charset=utf-8; BOUNDARY=\"a b;c\"", "a b;c"));
+    assert(boundary_is("multipart/mixed; boundary=x", "x"));
+    assert(boundary_is("text/plain; boundary=abc", NULL));
+    assert(boundary_is("multipart/form-data", NULL));
+    assert(boundary_is("multipart/form-data; boundary=", NULL));
+    assert(boundary_is("multipart/form-data; boundary=\"\"", NULL));
+    printf("Passed multipart boundary extraction.\n");
+}
+
+void test_multipart_over_body_reader() {
+    printf("Testing multipart over a chunked body...\n");
+    cwist_http_request *req = cwist_http_parse_request(
+        "POST /form HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Type: multipart/form-data; boundary=XyZ\r\n\r\n");
+    assert(req != NULL);
+
+    // Re-frame the form as 10-byte chunks.
+    cwist_sstring *wire = cwist_sstring_create();
+    size_t len = strlen(form);
+    for (size_t off = 0; off < len; off += 10) {
+        size_t n = len - off < 10 ? len - off : 10;
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", n);
+        cwist_sstring_append(wire, size);
+        cwist_sstring_append_view(wire, cwist_sview_make(form + off, n));
+        cwist_sstring_append(wire, "\r\n");
+    }
+    cwist_sstring_append(wire, "0\r\n\r\n");
+
+    cwist_sview boundary;
+    assert(cwist_multipart_boundary(cwist_http_request_header_view(req, "Content-Type"), &boundary));
+    struct collected c;
+    memset(&c, 0, sizeof(c));
+    cwist_multipart_parser parser;
+    assert(cwist_error_code(cwist_multipart_parser_init(&parser, boundary, &handlers, &c)) == 0);
+    cwist_body_reader reader;
+    assert(cwist_error_code(cwist_body_reader_init(&reader, -1, req, wire->data, wire->size, 0)) == 0);
+    assert(cwist_error_code(cwist_body_reader_stream(&reader, cwist_multipart_on_body, &parser)) == 0);
+    assert(parser.status == CWIST_MULTIPART_DONE);
+    check_form(&c);
+
+    collected_free(&c);
+    cwist_sstring_destroy(wire);
+    cwist_http_request_destroy(req);
+    printf("Passed multipart over a chunked body.\n");
+}
+
+int main() {
+    test_multipart_form();
+    test_multipart_binary();
+    test_multipart_errors();
+    test_multipart_boundary();
+    test_multipart_over_body_reader();
+    printf("All multipart tests passed!\n");
+    return 0;
+}
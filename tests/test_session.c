@@ -0,0 +1,273 @@
+#include <cwist/session_manager.h>
+#include <cwist/session_store.h>
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+static _Atomic int destroyed = 0;
+
+static void count_destroy(void *payload) {
+    (void)payload;
+    destroyed++;
+}
+
+static void *hammer_refcount(void *arg) {
+    void *payload = arg;
+    for (int i = 0; i < 100000; i++) {
+        session_shared_inc(payload);
+        session_shared_dec(payload);
+    }
+    return NULL;
+}
+
+void test_shared_refcount_threads() {
+    printf("Testing shared ref count across threads...\n");
+    destroyed = 0;
+    void *payload = session_shared_alloc(64, count_destroy);
+    assert(payload != NULL);
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, hammer_refcount, payload);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    assert(session_shared_count(payload) == 1);
+    assert(destroyed == 0);
+    session_shared_dec(payload);
+    assert(destroyed == 1);
+    printf("Passed shared ref count across threads.\n");
+}
+
+void test_epoch_deferred() {
+    printf("Testing epoch-deferred reclamation...\n");
+    destroyed = 0;
+    void *payload = session_shared_alloc_ex(32, count_destroy, SESSION_SHARED_DEFERRED);
+    assert(payload != NULL);
+
+    assert(session_epoch_enter());
+    // Reader borrows the payload; the owner drops the last reference meanwhile.
+    session_shared_dec(payload);
+    assert(session_shared_try_inc(payload) == false);
+    session_epoch_collect();
+    assert(destroyed == 0);
+    session_epoch_exit();
+
+    session_epoch_collect();
+    assert(destroyed == 1);
+
+    // Retiring a full batch inside our own section collects without
+    // waiting on ourselves, and frees nothing until we leave.
+    destroyed = 0;
+    assert(session_epoch_enter());
+    for (int i = 0; i < 100; i++) {
+        session_shared_dec(session_shared_alloc_ex(16, count_destroy, SESSION_SHARED_DEFERRED));
+    }
+    assert(destroyed == 0);
+    session_epoch_exit();
+    session_epoch_collect();
+    assert(destroyed == 100);
+    printf("Passed epoch-deferred reclamation.\n");
+}
+
+static uint64_t fake_now = 1000;
+
+static uint64_t fake_clock(void) {
+    return fake_now;
+}
+
+void test_store_lookup_and_ttl() {
+    printf("Testing session store lookup and TTL...\n");
+    destroyed = 0;
+    struct session_store_config config = {0};
+    config.shard_count = 4;
+    config.ttl_seconds = 10;
+    config.wheel_slots = 8; // smaller than the TTL, exercises re-slotting
+    config.clock = fake_clock;
+    struct session_store *store = session_store_create(&config);
+    assert(store != NULL);
+
+    void *alice = session_shared_alloc(16, count_destroy);
+    void *bob = session_shared_alloc(16, count_destroy);
+    assert(session_store_put(store, "alice-token", alice, 16) == 0);
+    assert(session_store_put(store, "bob-token", bob, 16) == 0);
+    session_shared_dec(alice); // store keeps the only reference
+    session_shared_dec(bob);
+    assert(session_store_count(store) == 2);
+
+    void *found = session_store_get(store, "alice-token");
+    assert(found == alice);
+    assert(session_shared_count(found) == 2);
+    session_shared_dec(found);
+    assert(session_store_get(store, "nobody") == NULL);
+
+    // Alice keeps sliding her deadline, Bob goes idle
+    for (int i = 0; i < 3; i++) {
+        fake_now += 4;
+        session_store_sweep(store);
+        found = session_store_get(store, "alice-token");
+        assert(found == alice);
+        session_shared_dec(found);
+    }
+    assert(session_store_get(store, "bob-token") == NULL);
+    assert(session_store_count(store) == 1);
+    assert(destroyed == 1);
+
+    assert(session_store_remove(store, "alice-token"));
+    assert(!session_store_remove(store, "alice-token"));
+    assert(destroyed == 2);
+
+    session_store_destroy(store);
+    printf("Passed session store lookup and TTL.\n");
+}
+
+void test_store_memory_cap() {
+    printf("Testing session store CLOCK eviction...\n");
+    destroyed = 0;
+    struct session_store_config config = {0};
+    config.shard_count = 1;
+    config.memory_cap = 4 * 1024;
+    struct session_store *store = session_store_create(&config);
+
+    char token[32];
+    for (int i = 0; i < 4; i++) {
+        void *payload = session_shared_alloc(900, count_destroy);
+        snprintf(token, sizeof(token), "token-%d", i);
+        session_store_put(store, token, payload, 900);
+        session_shared_dec(payload);
+    }
+    assert(session_store_count(store) == 4);
+
+    // Touch the oldest entry so it survives the next eviction
+    void *hot = session_store_get(store, "token-0");
+    assert(hot != NULL);
+    session_shared_dec(hot);
+
+    void *payload = session_shared_alloc(900, count_destroy);
+    session_store_put(store, "token-4", payload, 900);
+    session_shared_dec(payload);
+
+    assert(session_store_memory_used(store) <= config.memory_cap);
+    assert(destroyed == 1);
+    hot = session_store_get(store, "token-0");
+    assert(hot != NULL);
+    session_shared_dec(hot);
+    assert(session_store_get(store, "token-1") == NULL);
+
+    session_store_destroy(store);
+    assert(destroyed == 5);
+    printf("Passed session store CLOCK eviction.\n");
+}
+
+#define CJSON_THREADS 4
+
+static bool in_buffer(const void *ptr, const uint8_t *buffer, size_t size) {
+    return (const uint8_t *)ptr >= buffer && (const uint8_t *)ptr < buffer + size;
+}
+
+static void *cjson_worker(void *arg) {
+    (void)arg;
+    static _Thread_local uint8_t buffer[32768];
+    struct session_manager manager;
+    session_manager_init(&manager, buffer, sizeof(buffer));
+
+    for (int round = 0; round < 200; round++) {
+        struct session_cjson_scope scope;
+        session_arena_cjson_begin(&scope, &manager.request_arena);
+        cJSON *obj = cJSON_CreateObject();
+        for (int i = 0; i < 20; i++) cJSON_AddNumberToObject(obj, "n", i);
+        char *text = cJSON_PrintUnformatted(obj);
+        assert(in_buffer(obj, buffer, sizeof(buffer)) && in_buffer(text, buffer, sizeof(buffer)));
+        cJSON_free(text);
+        cJSON_Delete(obj);
+        session_arena_cjson_end(&scope);
+        session_manager_reset(&manager);
+    }
+    return NULL;
+}
+
+void test_cjson_arena_scope() {
+    printf("Testing cJSON arena scope...\n");
+    static uint8_t buffer[8192];
+    struct session_manager manager;
+    session_manager_init(&manager, buffer, sizeof(buffer));
+
+    cJSON *before = cJSON_CreateObject();      // heap, made outside any scope
+    cJSON_AddStringToObject(before, "k", "v");
+
+    struct session_cjson_scope scope;
+    session_arena_cjson_begin(&scope, &manager.request_arena);
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "name", "arena");
+    assert(in_buffer(obj, buffer, sizeof(buffer)));
+    size_t used = manager.request_arena.offset;
+    assert(used > 0);
+    cJSON_Delete(obj);                           // no-op for arena nodes
+    assert(manager.request_arena.offset == used);
+    cJSON_Delete(before);                        // heap nodes still go back to the heap
+
+    // Nested scope on a second arena, then back to the first.
+    static uint8_t inner_buffer[1024];
+    struct session_arena inner;
+    session_arena_init(&inner, inner_buffer, sizeof(inner_buffer));
+    struct session_cjson_scope inner_scope;
+    cJSON *outer_early = cJSON_CreateTrue();
+    session_arena_cjson_begin(&inner_scope, &inner);
+    cJSON *nested = cJSON_CreateArray();
+    assert(in_buffer(nested, inner_buffer, sizeof(inner_buffer)));
+    cJSON_Delete(outer_early);                   // outer arena's node, freed while shadowed
+    session_arena_cjson_end(&inner_scope);
+    cJSON *outer = cJSON_CreateNull();
+    assert(in_buffer(outer, buffer, sizeof(buffer)));
+    cJSON_Delete(nested);                        // inner scope already ended
+
+    // An exhausted arena falls back to the heap; the free hook routes it back.
+    static uint8_t tiny_buffer[64];
+    struct session_arena tiny;
+    session_arena_init(&tiny, tiny_buffer, sizeof(tiny_buffer));
+    session_arena_cjson_begin(&inner_scope, &tiny);
+    char big[256];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    cJSON *spill = cJSON_CreateString(big);
+    assert(spill != NULL && !in_buffer(spill->valuestring, tiny_buffer, sizeof(tiny_buffer)));
+    cJSON_Delete(spill);
+    session_arena_cjson_end(&inner_scope);
+    session_arena_cjson_end(&scope);
+
+    // Outside the scope cJSON is back on the heap, and trees from the
+    // scope can still be deleted until the reset.
+    cJSON *after = cJSON_CreateObject();
+    assert(!in_buffer(after, buffer, sizeof(buffer)));
+    cJSON_Delete(after);
+    cJSON_Delete(outer);
+    session_manager_reset(&manager);
+    session_arena_reset(&inner);
+    session_arena_reset(&tiny);
+
+    // Each thread binds its own arena; no thread sees another's binding.
+    pthread_t threads[CJSON_THREADS];
+    for (int i = 0; i < CJSON_THREADS; i++) pthread_create(&threads[i], NULL, cjson_worker, NULL);
+    for (int i = 0; i < 1000; i++) {
+        cJSON *heap = cJSON_CreateNumber(i);
+        assert(!in_buffer(heap, buffer, sizeof(buffer)));
+        cJSON_Delete(heap);
+    }
+    for (int i = 0; i < CJSON_THREADS; i++) pthread_join(threads[i], NULL);
+    printf("Passed cJSON arena scope.\n");
+}
+
+int main() {
+    test_shared_refcount_threads();
+    test_epoch_deferred();
+    test_store_lookup_and_ttl();
+    test_store_memory_cap();
+    test_cjson_arena_scope();
+    printf("All session tests passed!\n");
+    return 0;
+}
@@ -1,7 +1,10 @@
 #include <cwist/sstring.h>
+#include <cwist/simd.h>
+#include <cwist/session_manager.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 
 void test_trim() {
@@ -29,7 +32,8 @@ void test_resize() {
     // Grow
     cwist_error_t err = cwist_sstring_change_size(s, 10, false);
     assert(err.errtype == CWIST_ERR_INT8); // Success
-    assert(s->size == 10);
+    assert(s->size == 5); // size is the length; change_size moves the capacity
+    assert(cwist_sstring_capacity(s) >= 10);
     
     // Shrink safely
     err = cwist_sstring_change_size(s, 5, false); // "12345" fits in 5
@@ -37,13 +41,14 @@ void test_resize() {
 
     // Shrink with data loss warning
     err = cwist_sstring_change_size(s, 2, false); // "12345" -> 2 bytes?
-    assert(err.errtype == CWIST_ERR_JSON); // Should fail
+    assert(err.errtype == CWIST_ERR_INT8 && err.error.err_i8 == ERR_SSTRING_RESIZE_TOO_SMALL); // Should fail
 
     // Shrink with blow_data
     err = cwist_sstring_change_size(s, 2, true);
     assert(err.errtype == CWIST_ERR_INT8);
     
     assert(strcmp(s->data, "12") == 0);
+    assert(s->size == 2);
 
     cwist_sstring_destroy(s);
     printf("Passed resize.\n");
@@ -109,21 +114,424 @@ void test_sstring_ops() {
     cwist_sstring_assign(&left, "hello");
     cwist_sstring_assign(&right, " world");
 
-    cwist_error_t err = left.append(&left, &right);
+    cwist_error_t err = cwist_sstring_methods.append(&left, &right);
     assert(err.error.err_i8 == ERR_SSTRING_OKAY);
     assert(strcmp(left.data, "hello world") == 0);
 
-    err = right.copy(&right, &left);
+    err = cwist_sstring_methods.copy(&right, &left);
     assert(err.error.err_i8 == ERR_SSTRING_OKAY);
     assert(strcmp(right.data, "hello world") == 0);
 
-    assert(left.compare(&left, &right) == 0);
+    assert(cwist_sstring_methods.compare(&left, &right) == 0);
 
-    free(left.data);
-    free(right.data);
+    cwist_sstring_release(&left);
+    cwist_sstring_release(&right);
     printf("Passed sstring-to-sstring ops.\n");
 }
 
+void test_growth() {
+    printf("Testing append growth...\n");
+    cwist_counting_allocator counter;
+    cwist_counting_allocator_init(&counter, NULL);
+
+    cwist_sstring *s = cwist_sstring_create_with(&counter.base);
+    for (int i = 0; i < 1000; i++) {
+        cwist_sstring_append(s, "0123456789");
+    }
+    assert(s->size == 10000);
+    assert(strlen(s->data) == 10000);
+    assert(counter.stats.reallocs < 16); // doubling, not one realloc per append
+
+    cwist_sstring_append(s, s->data + 9990); // self append
+    assert(s->size == 10010);
+    assert(strcmp(s->data + 10000, "0123456789") == 0);
+
+    cwist_sstring_assign(s, "  padded  ");
+    cwist_sstring_rtrim(s);
+    assert(s->size == 8);
+
+    cwist_sstring_shrink_to_fit(s);
+    assert(s->is_inline);
+    assert(strcmp(s->data, "  padded") == 0);
+
+    cwist_sstring_reserve(s, 4096);
+    assert(cwist_sstring_capacity(s) >= 4096);
+    assert(strcmp(s->data, "  padded") == 0);
+
+    cwist_sstring_destroy(s);
+    assert(counter.stats.allocs == counter.stats.frees);
+    printf("Passed append growth.\n");
+}
+
+void test_inline_storage() {
+    printf("Testing inline storage...\n");
+    cwist_counting_allocator counter;
+    cwist_counting_allocator_init(&counter, NULL);
+
+    cwist_sstring *s = cwist_sstring_create_with(&counter.base);
+    assert(counter.stats.allocs == 1); // the struct only
+
+    cwist_sstring_assign(s, "close");
+    assert(s->is_inline);
+    assert(s->data == s->inline_buf);
+    assert(counter.stats.allocs == 1);
+
+    cwist_sstring_append(s, "-and-some-more-than-22");
+    assert(!s->is_inline);
+    assert(strcmp(s->data, "close-and-some-more-than-22") == 0);
+    assert(counter.stats.allocs == 2);
+
+    cwist_sstring *sub = cwist_sstring_substr(s, 0, 5);
+    assert(sub->is_inline);
+    assert(strcmp(sub->data, "close") == 0);
+
+    cwist_sstring_destroy(sub);
+    cwist_sstring_destroy(s);
+    assert(counter.stats.frees == 3);
+    assert(sizeof(cwist_sstring) <= 48);
+    printf("Passed inline storage.\n");
+}
+
+void test_sview() {
+    printf("Testing string views...\n");
+    cwist_sview v = cwist_sview_trim(CWIST_SVIEW_LIT("  key=value; other  "));
+    assert(cwist_sview_equals(v, CWIST_SVIEW_LIT("key=value; other")));
+    assert(cwist_sview_starts_with(v, CWIST_SVIEW_LIT("key=")));
+    assert(cwist_sview_ends_with(v, CWIST_SVIEW_LIT("other")));
+    assert(cwist_sview_find(v, CWIST_SVIEW_LIT("; ")) == 9);
+    assert(cwist_sview_find(v, CWIST_SVIEW_LIT("nope")) == CWIST_SVIEW_NPOS);
+    assert(cwist_sview_equals_nocase(CWIST_SVIEW_LIT("Content-Type"), CWIST_SVIEW_LIT("content-type")));
+    assert(cwist_sview_compare(CWIST_SVIEW_LIT("ab"), CWIST_SVIEW_LIT("abc")) < 0);
+    assert(cwist_sview_casecmp(CWIST_SVIEW_LIT("Content-Type"), CWIST_SVIEW_LIT("content-TYPE")) == 0);
+    assert(cwist_sview_casecmp(CWIST_SVIEW_LIT("Keep-Alive"), CWIST_SVIEW_LIT("keep-alivE!")) < 0);
+    // ASCII folding only, whatever the locale; agrees with equals_nocase
+    assert(cwist_sview_casecmp(CWIST_SVIEW_LIT("\xc9"), CWIST_SVIEW_LIT("\xe9")) != 0);
+    assert(!cwist_sview_equals_nocase(CWIST_SVIEW_LIT("\xc9"), CWIST_SVIEW_LIT("\xe9")));
+
+    cwist_sview rest = CWIST_SVIEW_LIT("a,,b"), token;
+    const char *expected[] = { "a", "", "b" };
+    int n = 0;
+    while (cwist_sview_split(&rest, ',', &token)) {
+        assert(cwist_sview_equals(token, cwist_sview_from_cstr(expected[n])));
+        n++;
+    }
+    assert(n == 3);
+
+    int64_t i;
+    uint64_t u;
+    double d;
+    assert(cwist_sview_to_int64(CWIST_SVIEW_LIT("-9223372036854775808"), &i) && i == INT64_MIN);
+    assert(!cwist_sview_to_int64(CWIST_SVIEW_LIT("9223372036854775808"), &i));
+    assert(!cwist_sview_to_int64(CWIST_SVIEW_LIT("12a"), &i));
+    assert(cwist_sview_to_uint64(CWIST_SVIEW_LIT("1aF"), 16, &u) && u == 0x1af);
+    assert(cwist_sview_to_double(CWIST_SVIEW_LIT("2.5"), &d) && d == 2.5);
+
+    // Views and sstrings interoperate without intermediate copies
+    cwist_sstring *s = cwist_sstring_create();
+    cwist_sstring_assign_view(s, cwist_sview_substr(v, 4, 5));
+    cwist_sstring_append_view(s, CWIST_SVIEW_LIT("!"));
+    assert(strcmp(s->data, "value!") == 0);
+    assert(cwist_sview_equals(cwist_sstring_view(s), CWIST_SVIEW_LIT("value!")));
+    cwist_sstring_destroy(s);
+    printf("Passed string views.\n");
+}
+
+void test_format() {
+    printf("Testing formatted appends...\n");
+    cwist_sstring *s = cwist_sstring_create();
+
+    cwist_sstring_append_int(s, 0);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_int(s, -1234567);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_int(s, INT64_MIN);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_uint(s, UINT64_MAX);
+    assert(strcmp(s->data, "0 -1234567 -9223372036854775808 18446744073709551615") == 0);
+
+    cwist_sstring_assign(s, "");
+    cwist_sstring_append_hex(s, 0x1f, false);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_hex(s, 0xDEADBEEFULL, true);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_hex(s, 0, false);
+    assert(strcmp(s->data, "1f DEADBEEF 0") == 0);
+
+    cwist_sstring_assign(s, "");
+    cwist_sstring_append_double(s, 2.5, 3);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_double(s, -0.125, 2);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_double(s, 3.0, 6);
+    cwist_sstring_append(s, " ");
+    cwist_sstring_append_double(s, 0.999, 2);
+    assert(strcmp(s->data, "2.5 -0.13 3 1") == 0);
+
+    // Longer than both the inline buffer and any previous stack buffer
+    cwist_sstring_assign(s, "");
+    char big[600];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    cwist_sstring_appendf(s, "%s|%d|%s", "start", 42, big);
+    assert(s->size == strlen("start|42|") + sizeof(big) - 1);
+    assert(strncmp(s->data, "start|42|xxx", 12) == 0);
+    assert(strlen(s->data) == s->size);
+
+    cwist_sstring_destroy(s);
+    printf("Passed formatted appends.\n");
+}
+
+static size_t naive_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len) {
+    for (size_t i = 0; i + needle_len <= hay_len; i++) {
+        if (memcmp(hay + i, needle, needle_len) == 0) return i;
+    }
+    return (size_t)-1;
+}
+
+void test_simd_kernels() {
+    printf("Testing string kernels...\n");
+    cwist_simd_level_t best = cwist_simd_level();
+    printf("  dispatch: %s\n", cwist_simd_level_name(best));
+
+    char hay[300], upper[300];
+    unsigned seed = 12345;
+    for (int level = CWIST_SIMD_SCALAR; level <= (int)best; level++) {
+        assert(cwist_simd_set_level((cwist_simd_level_t)level) == (cwist_simd_level_t)level);
+        for (int round = 0; round < 200; round++) {
+            size_t len = (size_t)(rand_r(&seed) % sizeof(hay));
+            for (size_t i = 0; i < len; i++) {
+                // small alphabet so needles actually recur; some whitespace
+                hay[i] = " \tabAB\r"[rand_r(&seed) % 8];
+                upper[i] = (hay[i] >= 'a' && hay[i] <= 'z') ? (char)(hay[i] - 32) : hay[i];
+            }
+
+            size_t needle_len = 1 + (size_t)(rand_r(&seed) % 5);
+            size_t at = len > needle_len ? (size_t)(rand_r(&seed) % (len - needle_len)) : 0;
+            const char *needle = len >= needle_len ? hay + at : "ab";
+            if (len < needle_len) needle_len = 2;
+            assert(cwist_simd_find(hay, len, needle, needle_len) == naive_find(hay, len, needle, needle_len));
+
+            assert(cwist_simd_equals_nocase(hay, upper, len));
+            if (len > 0) {
+                char saved = upper[len - 1];
+                upper[len - 1] = 'z';
+                assert(cwist_simd_equals_nocase(hay, upper, len) == (hay[len - 1] == 'z' || hay[len - 1] == 'Z'));
+                upper[len - 1] = saved;
+            }
+
+            size_t lead = 0, end = len;
+            while (lead < len && (hay[lead] == ' ' || hay[lead] == '\t' || hay[lead] == '\r')) lead++;
+            while (end > 0 && (hay[end - 1] == ' ' || hay[end - 1] == '\t' || hay[end - 1] == '\r')) end--;
+            assert(cwist_simd_skip_space(hay, len) == lead);
+            assert(cwist_simd_trim_space_end(hay, len) == end);
+
+            size_t first_b = (size_t)-1;
+            for (size_t i = 0; i < len; i++) if (hay[i] == 'b' || hay[i] == 'B') { first_b = i; break; }
+            assert(cwist_simd_find_first_of(hay, len, "bB", 2) == first_b);
+        }
+    }
+    cwist_simd_set_level(best);
+
+    cwist_sstring *s = cwist_sstring_create();
+    cwist_sstring_assign(s, "\t  Content-Type: application/json; charset=utf-8  \r\n");
+    cwist_sstring_trim(s);
+    assert(strcmp(s->data, "Content-Type: application/json; charset=utf-8") == 0);
+    assert(cwist_sstring_find(s, "charset") == 32);
+    assert(cwist_sstring_find(s, "missing") == CWIST_SVIEW_NPOS);
+    assert(cwist_sstring_equals_nocase(s, "CONTENT-TYPE: APPLICATION/JSON; CHARSET=UTF-8"));
+    cwist_sstring_destroy(s);
+    printf("Passed string kernels.\n");
+}
+
+void test_shared() {
+    printf("Testing copy-on-write sharing...\n");
+    char body[200];
+    memset(body, 'b', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+
+    cwist_sstring *cached = cwist_sstring_create();
+    cwist_sstring_assign(cached, body);
+    assert(cwist_sstring_make_shared(cached).error.err_i8 == ERR_SSTRING_OKAY);
+    assert(cwist_sstring_is_shared(cached));
+    assert(session_shared_count(cached->data) == 1);
+
+    cwist_sstring *a = cwist_sstring_create();
+    cwist_sstring *b = cwist_sstring_create();
+    cwist_sstring_assign(a, "previous contents");
+    cwist_sstring_copy_sstring(a, cached);
+    cwist_sstring_copy_sstring(b, cached);
+    assert(a->data == cached->data && b->data == cached->data);
+    assert(session_shared_count(cached->data) == 3);
+
+    // Writes clone first and leave the other holders alone
+    cwist_sstring_append(a, "!");
+    assert(!a->is_shared && a->data != cached->data);
+    assert(a->size == sizeof(body));
+    assert(session_shared_count(cached->data) == 2);
+    cwist_sstring_change_size(b, 3, true);
+    assert(strcmp(b->data, "bbb") == 0 && b->is_inline);
+    assert(strlen(cached->data) == sizeof(body) - 1);
+    assert(session_shared_count(cached->data) == 1);
+
+    // Arena-backed holders give their reference back on reset
+    uint8_t buffer[4096];
+    struct session_arena arena;
+    session_arena_init(&arena, buffer, sizeof(buffer));
+    cwist_sstring *scoped = cwist_sstring_create_in(&arena);
+    cwist_sstring_copy_sstring(scoped, cached);
+    assert(scoped->shared_in_arena);
+    assert(session_shared_count(cached->data) == 2);
+    session_arena_reset(&arena);
+    assert(session_shared_count(cached->data) == 1);
+
+    // Assigning a slice of the sole shared reference to itself
+    cwist_sstring *slice = cwist_sstring_create();
+    cwist_sstring_assign(slice, "0123456789abcdefghijklmnopqrstuvwxyzABCDEF");
+    assert(cwist_sstring_make_shared(slice).error.err_i8 == ERR_SSTRING_OKAY);
+    assert(session_shared_count(slice->data) == 1);
+    assert(cwist_sstring_assign_view(slice, cwist_sview_substr(cwist_sstring_view(slice), 5, 30)).error.err_i8 ==
+           ERR_SSTRING_OKAY);
+    assert(!slice->is_shared && slice->size == 30);
+    assert(strcmp(slice->data, "56789abcdefghijklmnopqrstuvwxy") == 0);
+    cwist_sstring_destroy(slice);
+
+    cwist_sstring_destroy(a);
+    cwist_sstring_destroy(b);
+    cwist_sstring_destroy(cached);
+    printf("Passed copy-on-write sharing.\n");
+}
+
+// Random mix of ASCII and well-formed multi-byte sequences, sometimes damaged.
+static size_t random_utf8(char *out, size_t cap, unsigned *seed) {
+    static const char *pieces[] = { "a", "Z", " ", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+                                    "\xed\x9f\xbf", "\xf4\x8f\xbf\xbf", "<", "\"", "\n" };
+    size_t len = 0, target = (size_t)(rand_r(seed) % cap);
+    while (len < target) {
+        const char *piece = pieces[rand_r(seed) % (sizeof(pieces) / sizeof(pieces[0]))];
+        size_t n = strlen(piece);
+        if (len + n > cap) break;
+        memcpy(out + len, piece, n);
+        len += n;
+    }
+    if (len > 0 && rand_r(seed) % 2) out[rand_r(seed) % len] = (char)(rand_r(seed) & 0xff);
+    return len;
+}
+
+void test_utf8_escape() {
+    printf("Testing UTF-8 validation and escaping...\n");
+    static const char *valid[] = { "", "plain ascii", "caf\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+                                   "\xed\x9f\xbf", "\xf4\x8f\xbf\xbf", "\xef\xbb\xbf" };
+    static const char *invalid[] = { "\x80", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xed\xa0\x80",
+                                     "\xf0\x80\x80\xaf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+                                     "\xff", "\xc3", "\xe2\x82", "\xc3\xa9\xa9" };
+    char buf[320];
+    cwist_simd_level_t best = cwist_simd_level();
+    for (int level = CWIST_SIMD_SCALAR; level <= (int)best; level++) {
+        cwist_simd_set_level((cwist_simd_level_t)level);
+        // Each case also sits at every offset of a long ASCII run, so the
+        // vector paths see it straddling block boundaries.
+        for (size_t k = 0; k < sizeof(valid) / sizeof(valid[0]); k++) {
+            for (size_t pad = 0; pad < 40; pad++) {
+                memset(buf, 'x', 80);
+                memcpy(buf + pad, valid[k], strlen(valid[k]));
+                assert(cwist_sview_utf8_valid(cwist_sview_make(buf, pad + strlen(valid[k]))));
+                assert(cwist_sview_utf8_valid(cwist_sview_make(buf, 80)));
+            }
+        }
+        for (size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++) {
+            for (size_t pad = 0; pad < 40; pad++) {
+                memset(buf, 'x', 80);
+                memcpy(buf + pad, invalid[k], strlen(invalid[k]));
+                assert(!cwist_sview_utf8_valid(cwist_sview_make(buf, pad + strlen(invalid[k]))));
+                assert(!cwist_sview_utf8_valid(cwist_sview_make(buf, 80)));
+            }
+        }
+    }
+
+    // Every level must agree with the scalar reference.
+    unsigned seed = 777;
+    for (int round = 0; round < 2000; round++) {
+        size_t len = random_utf8(buf, sizeof(buf), &seed);
+        cwist_sview view = cwist_sview_make(buf, len);
+
+        cwist_simd_set_level(CWIST_SIMD_SCALAR);
+        bool expect_valid = cwist_sview_utf8_valid(view);
+        cwist_sstring *json = cwist_sstring_create();
+        cwist_sstring *html = cwist_sstring_create();
+        cwist_sstring_append_json_escaped(json, view);
+        cwist_sstring_append_html_escaped(html, view);
+
+        for (int level = CWIST_SIMD_SSE2; level <= (int)best; level++) {
+            cwist_simd_set_level((cwist_simd_level_t)level);
+            assert(cwist_sview_utf8_valid(view) == expect_valid);
+            cwist_sstring *json_v = cwist_sstring_create();
+            cwist_sstring *html_v = cwist_sstring_create();
+            cwist_sstring_append_json_escaped(json_v, view);
+            cwist_sstring_append_html_escaped(html_v, view);
+            assert(cwist_sstring_compare_sstring(json_v, json) == 0);
+            assert(cwist_sstring_compare_sstring(html_v, html) == 0);
+            cwist_sstring_destroy(json_v);
+            cwist_sstring_destroy(html_v);
+        }
+        cwist_sstring_destroy(json);
+        cwist_sstring_destroy(html);
+    }
+    cwist_simd_set_level(best);
+
+    cwist_sstring *s = cwist_sstring_create();
+    cwist_sstring_append_json_escaped(s, CWIST_SVIEW_LIT("say \"hi\"\\\n\t\x01 caf\xc3\xa9"));
+    assert(strcmp(s->data, "say \\\"hi\\\"\\\\\\n\\t\\u0001 caf\xc3\xa9") == 0);
+
+    cwist_sstring_assign(s, "");
+    cwist_sstring_append_html_escaped(s, CWIST_SVIEW_LIT("<a href=\"x\">Tom & Jerry's</a>"));
+    assert(strcmp(s->data, "&lt;a href=&quot;x&quot;&gt;Tom &amp; Jerry&#39;s&lt;/a&gt;") == 0);
+
+    // Escaping a string into itself must survive the buffer moving.
+    cwist_sstring_assign(s, "<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<");
+    cwist_sstring_append_html_escaped(s, cwist_sstring_view(s));
+    assert(s->size == 40 + 40 * 4);
+
+    // A fixed string that cannot take the output is left untouched.
+    cwist_sstring_assign(s, "ok");
+    cwist_sstring_shrink_to_fit(s);
+    s->is_fixed = true;
+    memset(buf, '"', 64);
+    cwist_error_t err = cwist_sstring_append_json_escaped(s, cwist_sview_make(buf, 64));
+    assert(err.error.err_i8 == ERR_SSTRING_CONSTANT);
+    assert(strcmp(s->data, "ok") == 0);
+    s->is_fixed = false;
+    cwist_sstring_destroy(s);
+    printf("Passed UTF-8 validation and escaping.\n");
+}
+
+void test_error_values() {
+    printf("Testing error values...\n");
+    assert(sizeof(cwist_error_t) <= 16);
+
+    cwist_sstring *s = cwist_sstring_create();
+    cwist_error_t err = cwist_sstring_append(s, "ok");
+    assert(err.domain == CWIST_ERRDOMAIN_SSTRING && cwist_error_code(err) == ERR_SSTRING_OKAY);
+
+    s->is_fixed = true;
+    cwist_sstring_shrink_to_fit(s);
+    err = cwist_sstring_append(s, "this does not fit into the inline buffer");
+    assert(cwist_error_code(err) == ERR_SSTRING_CONSTANT);
+    assert(strstr(cwist_error_message(err), "fixed") != NULL);
+
+    // Details only exist once asked for.
+    cJSON *json = cwist_error_to_json(err);
+    assert(strcmp(cJSON_GetObjectItem(json, "domain")->valuestring, "sstring") == 0);
+    assert(cJSON_GetObjectItem(json, "code")->valueint == ERR_SSTRING_CONSTANT);
+    cJSON_Delete(json);
+    s->is_fixed = false;
+    cwist_sstring_destroy(s);
+
+    err = cwist_error_make(CWIST_ERRDOMAIN_ERRNO, CWIST_ERR_INT16, ENOMEM);
+    assert(err.error.err_i16 == ENOMEM && strcmp(cwist_error_message(err), strerror(ENOMEM)) == 0);
+    assert(cwist_error_message(make_error(CWIST_ERR_INT16))[0] == '\0');
+    printf("Passed error values.\n");
+}
+
 int main() {
     test_trim();
     test_resize();
@@ -131,6 +539,14 @@ int main() {
     test_compare();
     test_substr();
     test_sstring_ops();
+    test_inline_storage();
+    test_growth();
+    test_sview();
+    test_format();
+    test_simd_kernels();
+    test_shared();
+    test_utf8_escape();
+    test_error_values();
     printf("All tests passed!\n");
     return 0;
 }
@@ -0,0 +1,230 @@
+#include <cwist/template.h>
+#include <cwist/http.h>
+#include <cwist/sstring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static cwist_template *compile(const char *source) {
+    cwist_template *tpl = NULL;
+    cwist_error_t err = cwist_template_compile(cwist_sview_from_cstr(source), &tpl, NULL);
+    assert(cwist_error_code(err) == 0);
+    assert(tpl != NULL);
+    return tpl;
+}
+
+static void assert_render(const cwist_template *tpl, const cwist_template_arg *args, const char *expected) {
+    cwist_template_output out;
+    cwist_template_output_init(&out, NULL);
+    assert(cwist_error_code(cwist_template_render(tpl, args, &out)) == 0);
+
+    cwist_sstring *flat = cwist_sstring_create();
+    assert(cwist_error_code(cwist_template_output_flatten(&out, flat)) == 0);
+    assert(strcmp(flat->data, expected) == 0);
+    assert(out.total == strlen(expected));
+    cwist_sstring_destroy(flat);
+    cwist_template_output_destroy(&out);
+}
+
+void test_template_slots() {
+    printf("Testing template slots and filters...\n");
+    cwist_template *tpl = compile("<p>{{ name }}</p><i>{{{raw}}}</i>{{! ignored }}"
+                                  "<script>var s=\"{{name|json}}\";</script>{{n|int}}/{{name}}");
+    assert(cwist_template_slot_count(tpl) == 3);
+    int name = cwist_template_slot(tpl, "name");
+    int raw = cwist_template_slot(tpl, "raw");
+    int n = cwist_template_slot(tpl, "n");
+    assert(name == 0 && raw == 1 && n == 2);
+    assert(cwist_template_slot(tpl, "missing") == -1);
+
+    cwist_template_arg args[3];
+    args[name] = cwist_template_str("<a & \"b\">");
+    args[raw] = cwist_template_str("<b>");
+    args[n] = cwist_template_int(-42);
+    assert_render(tpl, args,
+                  "<p>&lt;a &amp; &quot;b&quot;&gt;</p><i><b></i>"
+                  "<script>var s=\"<a & \\\"b\\\">\";</script>-42/&lt;a &amp; &quot;b&quot;&gt;");
+
+    // Unset text slots render nothing; a NULL args array is all unset.
+    memset(args, 0, sizeof(args));
+    assert_render(tpl, args, "<p></p><i></i><script>var s=\"\";</script>0/");
+    cwist_template_destroy(tpl);
+    printf("Passed template slots and filters.\n");
+}
+
+void test_template_zero_copy() {
+    printf("Testing template zero-copy output...\n");
+    const char *value = "plain text";
+    cwist_template *tpl = compile("Hello, {{who}}! You are #{{rank|int}}{{who}}.");
+
+    cwist_template_arg args[2];
+    args[cwist_template_slot(tpl, "who")] = cwist_template_str(value);
+    args[cwist_template_slot(tpl, "rank")] = cwist_template_int(7);
+
+    cwist_template_output out;
+    cwist_template_output_init(&out, NULL);
+    assert(cwist_error_code(cwist_template_render(tpl, args, &out)) == 0);
+
+    // Plain values point at the caller's bytes; nothing escaped, only the
+    // number lands in scratch.
+    bool borrowed = false;
+    for (size_t i = 0; i < out.count; i++) {
+        if (out.iov[i].iov_base == value) borrowed = true;
+    }
+    assert(borrowed);
+    assert(out.scratch->size == 1);
+
+    // Renders append, and reset keeps the buffers.
+    assert(cwist_error_code(cwist_template_render(tpl, args, &out)) == 0);
+    size_t capacity = out.capacity;
+    cwist_sstring *flat = cwist_sstring_create();
+    cwist_template_output_flatten(&out, flat);
+    assert(strcmp(flat->data, "Hello, plain text! You are #7plain text.Hello, plain text! You are #7plain text.") == 0);
+
+    cwist_template_output_reset(&out);
+    assert(out.count == 0 && out.total == 0 && out.capacity == capacity);
+    cwist_sstring_destroy(flat);
+    cwist_template_output_destroy(&out);
+    cwist_template_destroy(tpl);
+    printf("Passed template zero-copy output.\n");
+}
+
+void test_template_sections() {
+    printf("Testing template sections...\n");
+    cwist_template *tpl = compile("<ul>{{#items}}<li>{{label}}:{{#tags}}[{{label}}]{{/tags}}</li>{{/items}}</ul>{{title}}");
+    size_t slots = cwist_template_slot_count(tpl);
+    int items = cwist_template_slot(tpl, "items");
+    int label = cwist_template_slot(tpl, "label");
+    int tags = cwist_template_slot(tpl, "tags");
+    int title = cwist_template_slot(tpl, "title");
+    assert(slots == 4);
+
+    cwist_template_arg *tag_rows = calloc(2 * slots, sizeof(*tag_rows));
+    tag_rows[0 * slots + label] = cwist_template_str("x");
+    tag_rows[1 * slots + label] = cwist_template_str("<y>");
+
+    cwist_template_arg *rows = calloc(3 * slots, sizeof(*rows));
+    rows[0 * slots + label] = cwist_template_str("one");
+    rows[0 * slots + tags] = cwist_template_rows(tag_rows, 2);
+    rows[1 * slots + label] = cwist_template_str("two");
+    rows[2 * slots + label] = cwist_template_str("a&b");
+
+    cwist_template_arg args[4] = {0};
+    args[items] = cwist_template_rows(rows, 3);
+    args[title] = cwist_template_str("done");
+    assert_render(tpl, args, "<ul><li>one:[x][&lt;y&gt;]</li><li>two:</li><li>a&amp;b:</li></ul>done");
+
+    // No rows: the body is skipped.
+    args[items] = cwist_template_rows(NULL, 0);
+    assert_render(tpl, args, "<ul></ul>done");
+
+    // Many escaped values: scratch grows while entries already point into it.
+    size_t many = 500;
+    cwist_template_arg *big = calloc(many * slots, sizeof(*big));
+    cwist_sstring *expected = cwist_sstring_create();
+    cwist_sstring_append(expected, "<ul>");
+    for (size_t i = 0; i < many; i++) {
+        big[i * slots + label] = cwist_template_str(i % 2 ? "<odd>" : "even");
+        cwist_sstring_append(expected, i % 2 ? "<li>&lt;odd&gt;:</li>" : "<li>even:</li>");
+    }
+    cwist_sstring_append(expected, "</ul>done");
+    args[items] = cwist_template_rows(big, many);
+    assert_render(tpl, args, expected->data);
+
+    cwist_sstring_destroy(expected);
+    free(big);
+    free(rows);
+    free(tag_rows);
+    cwist_template_destroy(tpl);
+    printf("Passed template sections.\n");
+}
+
+static void assert_compile_error(const char *source, int code, size_t at) {
+    cwist_template *tpl = (cwist_template *)1;
+    size_t error_at = 0;
+    cwist_error_t err = cwist_template_compile(cwist_sview_from_cstr(source), &tpl, &error_at);
+    assert(err.domain == CWIST_ERRDOMAIN_TEMPLATE);
+    assert(cwist_error_code(err) == code);
+    assert(error_at == at);
+    assert(tpl == NULL);
+}
+
+void test_template_errors() {
+    printf("Testing template compile errors...\n");
+    assert_compile_error("ab{{name", ERR_TEMPLATE_UNCLOSED_TAG, 2);
+    assert_compile_error("{{{raw}}", ERR_TEMPLATE_UNCLOSED_TAG, 0);
+    assert_compile_error("x{{ }}", ERR_TEMPLATE_BAD_NAME, 1);
+    assert_compile_error("{{a b}}", ERR_TEMPLATE_BAD_NAME, 0);
+    assert_compile_error("{{a|upper}}", ERR_TEMPLATE_UNKNOWN_FILTER, 0);
+    assert_compile_error("{{#a}}{{/b}}", ERR_TEMPLATE_UNBALANCED, 6);
+    assert_compile_error("{{/a}}", ERR_TEMPLATE_UNBALANCED, 0);
+    assert_compile_error("{{#a}}open", ERR_TEMPLATE_UNBALANCED, 10);
+
+    cwist_sstring *deep = cwist_sstring_create();
+    for (int i = 0; i <= CWIST_TEMPLATE_MAX_DEPTH; i++) cwist_sstring_append(deep, "{{#s}}");
+    assert_compile_error(deep->data, ERR_TEMPLATE_TOO_DEEP, 6 * CWIST_TEMPLATE_MAX_DEPTH);
+    cwist_sstring_destroy(deep);
+
+    cwist_error_t err = cwist_error_make(CWIST_ERRDOMAIN_TEMPLATE, CWIST_ERR_INT8, ERR_TEMPLATE_UNBALANCED);
+    assert(strcmp(cwist_error_message(err), "template sections are not balanced") == 0);
+
+    // Text without tags is one static segment.
+    cwist_template *tpl = compile("no tags here");
+    assert(cwist_template_slot_count(tpl) == 0);
+    assert_render(tpl, NULL, "no tags here");
+    cwist_template_destroy(tpl);
+    printf("Passed template compile errors.\n");
+}
+
+void test_template_send() {
+    printf("Testing template output over writev...\n");
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    cwist_template *tpl = compile("<h1>{{title}}</h1>{{#rows}}<p>{{v|int}}</p>{{/rows}}");
+    size_t slots = cwist_template_slot_count(tpl);
+    cwist_template_arg rows[2 * 3] = {0};
+    rows[0 * slots + cwist_template_slot(tpl, "v")] = cwist_template_int(1);
+    rows[1 * slots + cwist_template_slot(tpl, "v")] = cwist_template_int(2);
+    cwist_template_arg args[3] = {0};
+    args[cwist_template_slot(tpl, "title")] = cwist_template_str("T&C");
+    args[cwist_template_slot(tpl, "rows")] = cwist_template_rows(rows, 2);
+
+    cwist_template_output out;
+    cwist_template_output_init(&out, NULL);
+    assert(cwist_error_code(cwist_template_render(tpl, args, &out)) == 0);
+
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Content-Type", "text/html");
+    assert(cwist_error_code(cwist_http_send_response_iov(sv[0], res, out.iov, out.count)) == 0);
+    close(sv[0]);
+
+    char buffer[1024];
+    size_t got = 0;
+    ssize_t n;
+    while ((n = recv(sv[1], buffer + got, sizeof(buffer) - 1 - got, 0)) > 0) got += (size_t)n;
+    buffer[got] = '\0';
+    assert(strstr(buffer, "HTTP/1.1 200 OK\r\n") == buffer);
+    assert(strstr(buffer, "Content-Length: 32\r\n") != NULL);
+    const char *body = strstr(buffer, "\r\n\r\n");
+    assert(body && strcmp(body + 4, "<h1>T&amp;C</h1><p>1</p><p>2</p>") == 0);
+
+    close(sv[1]);
+    cwist_http_response_destroy(res);
+    cwist_template_output_destroy(&out);
+    cwist_template_destroy(tpl);
+    printf("Passed template output over writev.\n");
+}
+
+int main() {
+    test_template_slots();
+    test_template_zero_copy();
+    test_template_sections();
+    test_template_errors();
+    test_template_send();
+    printf("All template tests passed!\n");
+    return 0;
+}
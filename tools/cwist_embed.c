@@ -0,0 +1,402 @@
+/*
+ * cwist-embed: compiles a directory of static files into C source.
+ *
+ *   cwist-embed [-n name] [-p /prefix] [-c cache-control] <dir> <out.c>
+ *
+ * Writes out.c with one cwist_asset per file (sorted by path, ready for
+ * cwist_asset_find) and out.h declaring `name` and `name_count`. Response
+ * heads (200 and 304), ETags and gzip variants are computed here, so the
+ * server does no work for them at startup or per request.
+ */
+#include <cwist/hash.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define EMBED_DEFAULT_CACHE "public, max-age=3600"
+
+struct embed_file {
+    char *path;         // URL path
+    char *source;       // file on disk
+    const char *type;
+    char etag[24];
+    char gzip_etag[28];
+    size_t len, head_len, not_modified_len;
+    size_t gzip_len, gzip_head_len, gzip_not_modified_len;   // gzip_len 0: no variant
+};
+
+struct embed_list {
+    struct embed_file *files;
+    size_t count;
+    size_t capacity;
+};
+
+static const struct {
+    const char *ext;
+    const char *type;
+    bool compress;
+} embed_types[] = {
+    { "html",  "text/html; charset=utf-8",               true  },
+    { "htm",   "text/html; charset=utf-8",               true  },
+    { "css",   "text/css; charset=utf-8",                true  },
+    { "js",    "text/javascript; charset=utf-8",         true  },
+    { "mjs",   "text/javascript; charset=utf-8",         true  },
+    { "json",  "application/json",                       true  },
+    { "map",   "application/json",                       true  },
+    { "txt",   "text/plain; charset=utf-8",              true  },
+    { "xml",   "application/xml",                        true  },
+    { "svg",   "image/svg+xml",                          true  },
+    { "wasm",  "application/wasm",                       true  },
+    { "ico",   "image/x-icon",                           true  },
+    { "png",   "image/png",                              false },
+    { "jpg",   "image/jpeg",                             false },
+    { "jpeg",  "image/jpeg",                             false },
+    { "gif",   "image/gif",                              false },
+    { "webp",  "image/webp",                             false },
+    { "woff",  "font/woff",                              false },
+    { "woff2", "font/woff2",                             false },
+    { "pdf",   "application/pdf",                        false },
+};
+
+static void embed_type(const char *path, const char **type, bool *compress) {
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    *type = "application/octet-stream";
+    *compress = false;
+    if (!dot || (slash && dot < slash)) return;
+    for (size_t i = 0; i < sizeof(embed_types) / sizeof(embed_types[0]); i++) {
+        if (strcasecmp(dot + 1, embed_types[i].ext) == 0) {
+            *type = embed_types[i].type;
+            *compress = embed_types[i].compress;
+            return;
+        }
+    }
+}
+
+static char *embed_join(const char *a, const char *sep, const char *b) {
+    size_t la = strlen(a), ls = strlen(sep), lb = strlen(b);
+    char *out = malloc(la + ls + lb + 1);
+    if (!out) return NULL;
+    memcpy(out, a, la);
+    memcpy(out + la, sep, ls);
+    memcpy(out + la + ls, b, lb + 1);
+    return out;
+}
+
+static int embed_walk(struct embed_list *list, const char *dir, const char *url) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "cwist-embed: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    struct dirent *entry;
+    int rc = 0;
+    while (rc == 0 && (entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;   // ., .. and hidden files
+        char *source = embed_join(dir, "/", entry->d_name);
+        char *path = embed_join(url, "/", entry->d_name);
+        struct stat st;
+        if (!source || !path || stat(source, &st) != 0) {
+            fprintf(stderr, "cwist-embed: %s: %s\n", source ? source : dir, strerror(errno));
+            rc = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            rc = embed_walk(list, source, path);
+        } else if (S_ISREG(st.st_mode)) {
+            if (list->count == list->capacity) {
+                size_t capacity = list->capacity ? list->capacity * 2 : 16;
+                struct embed_file *files = realloc(list->files, capacity * sizeof(*files));
+                if (!files) {
+                    fprintf(stderr, "cwist-embed: %s: %s\n", source, strerror(errno));
+                    rc = -1;
+                    free(source);
+                    free(path);
+                    break;
+                }
+                list->files = files;
+                list->capacity = capacity;
+            }
+            list->files[list->count++] = (struct embed_file){ .path = path, .source = source };
+            continue;
+        }
+        free(source);
+        free(path);
+    }
+    closedir(d);
+    return rc;
+}
+
+static int embed_compare(const void *a, const void *b) {
+    return strcmp(((const struct embed_file *)a)->path, ((const struct embed_file *)b)->path);
+}
+
+static unsigned char *embed_read(const char *source, size_t *len) {
+    FILE *f = fopen(source, "rb");
+    if (!f) return NULL;
+    size_t capacity = 4096, size = 0;
+    unsigned char *data = malloc(capacity);
+    size_t n;
+    while (data && (n = fread(data + size, 1, capacity - size, f)) > 0) {
+        size += n;
+        if (size == capacity) {
+            capacity *= 2;
+            unsigned char *grown = realloc(data, capacity);
+            if (!grown) free(data);
+            data = grown;
+        }
+    }
+    if (ferror(f)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = size;
+    return data;
+}
+
+// gzip container (RFC 1952) at the best level; NULL on failure.
+static unsigned char *embed_gzip(const unsigned char *data, size_t len, size_t *out_len) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return NULL;
+    uLong bound = deflateBound(&z, (uLong)len) + 32;
+    unsigned char *out = malloc(bound);
+    if (!out) {
+        deflateEnd(&z);
+        return NULL;
+    }
+    z.next_in = (Bytef *)data;
+    z.avail_in = (uInt)len;
+    z.next_out = out;
+    z.avail_out = (uInt)bound;
+    int rc = deflate(&z, Z_FINISH);
+    *out_len = z.total_out;
+    deflateEnd(&z);
+    if (rc != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+static void emit_bytes(FILE *out, const char *name, const unsigned char *data, size_t len) {
+    fprintf(out, "static const unsigned char %s[%zu] = {", name, len ? len : 1);
+    if (len == 0) fputs("0", out);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n    " : "", data[i]);
+    }
+    fputs("\n};\n", out);
+}
+
+static void emit_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '\r') fputs("\\r", out);
+        else if (c == '\n') fputs(s[1] ? "\\n\"\n    \"" : "\\n", out);
+        else if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7f) fprintf(out, "\\%03o", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static char *embed_head(const char *type, size_t len, const char *etag, const char *cache, bool gzip, bool vary) {
+    char *head = malloc(1024 + strlen(type) + strlen(cache));
+    if (!head) return NULL;
+    sprintf(head,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %zu\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: %s\r\n"
+            "%s%s"
+            "\r\n",
+            type, len, etag, cache,
+            // Ranges are served from the identity body only.
+            gzip ? "Content-Encoding: gzip\r\n" : "Accept-Ranges: bytes\r\n",
+            vary ? "Vary: Accept-Encoding\r\n" : "");
+    return head;
+}
+
+// The 304 for a variant repeats its validator and caching headers only.
+static char *embed_not_modified(const char *etag, const char *cache, bool vary) {
+    char *head = malloc(1024 + strlen(cache));
+    if (!head) return NULL;
+    sprintf(head,
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: %s\r\n"
+            "%s"
+            "\r\n",
+            etag, cache, vary ? "Vary: Accept-Encoding\r\n" : "");
+    return head;
+}
+
+static int embed_usage(void) {
+    fprintf(stderr, "usage: cwist-embed [-n name] [-p /prefix] [-c cache-control] <dir> <out.c>\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    const char *name = "cwist_assets";
+    const char *prefix = "";
+    const char *cache = EMBED_DEFAULT_CACHE;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        if (strcmp(argv[arg], "-n") == 0) name = argv[arg + 1];
+        else if (strcmp(argv[arg], "-p") == 0) prefix = argv[arg + 1];
+        else if (strcmp(argv[arg], "-c") == 0) cache = argv[arg + 1];
+        else return embed_usage();
+    }
+    if (argc - arg != 2) return embed_usage();
+    const char *dir = argv[arg];
+    const char *out_c = argv[arg + 1];
+
+    size_t prefix_len = strlen(prefix);
+    while (prefix_len > 0 && prefix[prefix_len - 1] == '/') prefix_len--;
+    char *url = strndup(prefix, prefix_len);
+
+    struct embed_list list = { NULL, 0, 0 };
+    if (!url || embed_walk(&list, dir, url) != 0) return 1;
+    qsort(list.files, list.count, sizeof(*list.files), embed_compare);
+
+    size_t out_len = strlen(out_c);
+    char *out_h = strdup(out_c);
+    if (!out_h) return 1;
+    if (out_len > 2 && strcmp(out_c + out_len - 2, ".c") == 0) out_h[out_len - 1] = 'h';
+    else {
+        free(out_h);
+        out_h = embed_join(out_c, "", ".h");
+    }
+    const char *header_name = strrchr(out_h, '/') ? strrchr(out_h, '/') + 1 : out_h;
+
+    FILE *out = fopen(out_c, "w");
+    if (!out) {
+        fprintf(stderr, "cwist-embed: %s: %s\n", out_c, strerror(errno));
+        return 1;
+    }
+    fprintf(out, "/* Generated by cwist-embed from %s. Do not edit. */\n#include \"%s\"\n\n", dir, header_name);
+
+    for (size_t i = 0; i < list.count; i++) {
+        struct embed_file *file = &list.files[i];
+        size_t len = 0;
+        unsigned char *data = embed_read(file->source, &len);
+        if (!data) {
+            fprintf(stderr, "cwist-embed: %s: %s\n", file->source, strerror(errno));
+            fclose(out);
+            return 1;
+        }
+
+        bool compress;
+        embed_type(file->path, &file->type, &compress);
+        uint64_t hash = cwist_hash64(data, len, 0);
+        snprintf(file->etag, sizeof(file->etag), "\"%016llx\"", (unsigned long long)hash);
+        snprintf(file->gzip_etag, sizeof(file->gzip_etag), "\"%016llx-gz\"", (unsigned long long)hash);
+
+        // Keep the gzip variant only when it saves at least a tenth.
+        size_t gzip_len = 0;
+        unsigned char *gzip = compress && len > 0 ? embed_gzip(data, len, &gzip_len) : NULL;
+        if (gzip && gzip_len * 10 > len * 9) {
+            free(gzip);
+            gzip = NULL;
+        }
+
+        char sym[32];
+        snprintf(sym, sizeof(sym), "asset_%zu_body", i);
+        emit_bytes(out, sym, data, len);
+        char *head = embed_head(file->type, len, file->etag, cache, false, gzip != NULL);
+        char *gzip_head = gzip ? embed_head(file->type, gzip_len, file->gzip_etag, cache, true, true) : NULL;
+        char *not_modified = embed_not_modified(file->etag, cache, gzip != NULL);
+        char *gzip_not_modified = gzip ? embed_not_modified(file->gzip_etag, cache, true) : NULL;
+        if (!head || !not_modified || (gzip && (!gzip_head || !gzip_not_modified))) return 1;
+        fprintf(out, "static const char asset_%zu_head[] =\n    ", i);
+        emit_string(out, head);
+        fprintf(out, ";\nstatic const char asset_%zu_not_modified[] =\n    ", i);
+        emit_string(out, not_modified);
+        fputs(";\n", out);
+        file->len = len;
+        file->head_len = strlen(head);
+        file->not_modified_len = strlen(not_modified);
+        if (gzip) {
+            snprintf(sym, sizeof(sym), "asset_%zu_gzip", i);
+            emit_bytes(out, sym, gzip, gzip_len);
+            fprintf(out, "static const char asset_%zu_gzip_head[] =\n    ", i);
+            emit_string(out, gzip_head);
+            fprintf(out, ";\nstatic const char asset_%zu_gzip_not_modified[] =\n    ", i);
+            emit_string(out, gzip_not_modified);
+            fputs(";\n", out);
+            file->gzip_len = gzip_len;
+            file->gzip_head_len = strlen(gzip_head);
+            file->gzip_not_modified_len = strlen(gzip_not_modified);
+        }
+        fputc('\n', out);
+
+        free(gzip_not_modified);
+        free(not_modified);
+        free(gzip_head);
+        free(head);
+        free(gzip);
+        free(data);
+    }
+
+    fprintf(out, "const cwist_asset %s[%zu] = {\n", name, list.count ? list.count : 1);
+    for (size_t i = 0; i < list.count; i++) {
+        const struct embed_file *file = &list.files[i];
+        fputs("    { ", out);
+        emit_string(out, file->path);
+        fputs(", ", out);
+        emit_string(out, file->type);
+        fputs(", ", out);
+        emit_string(out, file->etag);
+        fprintf(out, ",\n      asset_%zu_body, %zu, asset_%zu_head, %zu,\n", i, file->len, i, file->head_len);
+        if (file->gzip_len) {
+            fprintf(out, "      asset_%zu_gzip, %zu, asset_%zu_gzip_head, %zu,\n", i, file->gzip_len, i, file->gzip_head_len);
+        } else {
+            fputs("      NULL, 0, NULL, 0,\n", out);
+        }
+        fputs("      ", out);
+        emit_string(out, cache);
+        fputs(", ", out);
+        if (file->gzip_len) emit_string(out, file->gzip_etag);
+        else fputs("NULL", out);
+        fprintf(out, ", asset_%zu_not_modified, %zu,\n", i, file->not_modified_len);
+        if (file->gzip_len) {
+            fprintf(out, "      asset_%zu_gzip_not_modified, %zu },\n", i, file->gzip_not_modified_len);
+        } else {
+            fputs("      NULL, 0 },\n", out);
+        }
+    }
+    if (list.count == 0) fputs("    { 0 }\n", out);
+    fprintf(out, "};\nconst size_t %s_count = %zu;\n", name, list.count);
+    if (fclose(out) != 0) return 1;
+
+    FILE *header = fopen(out_h, "w");
+    if (!header) {
+        fprintf(stderr, "cwist-embed: %s: %s\n", out_h, strerror(errno));
+        return 1;
+    }
+    fprintf(header,
+            "/* Generated by cwist-embed from %s. Do not edit. */\n"
+            "#ifndef CWIST_EMBED_%s_H\n#define CWIST_EMBED_%s_H\n\n"
+            "#include <cwist/asset.h>\n\n"
+            "extern const cwist_asset %s[];\n"
+            "extern const size_t %s_count;\n\n#endif\n",
+            dir, name, name, name, name);
+    int rc = fclose(header) == 0 ? 0 : 1;
+
+    for (size_t i = 0; i < list.count; i++) {
+        free(list.files[i].path);
+        free(list.files[i].source);
+    }
+    free(list.files);
+    free(out_h);
+    free(url);
+    return rc;
+}